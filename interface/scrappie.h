@@ -36,6 +36,7 @@ extern "C" {
 /*  Matrix definitions from scrappie_matrix.h  */
     typedef struct {
         unsigned int nr, nrq, nc;
+        size_t capacity;
         union {
             __m128 *v;
             float *f;
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+""" Convert a model header, as written by the parse_*.py scripts, into a
+binary model file that scrappie can map into memory (see src/model_file.h).
+
+    header_to_model.py model.h model.crm
+"""
+import array
+import re
+import struct
+import sys
+
+MAGIC = b'SCRPMODL'
+VERSION = 1
+ALIGN = 64
+NAMELEN = 48
+
+header_file = sys.argv[1]
+model_file = sys.argv[2]
+
+float_array = re.compile(r'float\s+__(\w+)\[\d*\]\s*=\s*\{([^}]*)\};')
+mat_struct = re.compile(r'_Mat\s+_(\w+)\s*=\s*\{\s*\.nr\s*=\s*(\d+),\s*\.nrq\s*=\s*(\d+),'
+                        r'\s*\.nc\s*=\s*(\d+),\s*\.data\.f\s*=\s*__(\w+)\s*\};')
+
+
+def parse_float(s):
+    """ Parse float written in either hexadecimal or decimal """
+    s = s.strip()
+    return float.fromhex(s) if 'x' in s else float(s)
+
+
+def padded(data, nr, nrq, nc):
+    """ Pad each column of data to nrq * 4 elements
+
+    Matrices written with explicit padding already hold nrq * 4 elements per
+    column; vectors may hold only nr.
+    """
+    if len(data) == nrq * 4 * nc:
+        return data
+    assert len(data) == nr * nc, 'Matrix data has unexpected length'
+    res = array.array('f')
+    for c in range(nc):
+        res.extend(data[c * nr : (c + 1) * nr])
+        res.extend([0.0] * (nrq * 4 - nr))
+    return res
+
+
+with open(header_file, 'r') as fh:
+    source = fh.read()
+
+arrays = {}
+for name, values in float_array.findall(source):
+    arrays[name] = array.array('f', [parse_float(v) for v in values.split(',') if v.strip()])
+
+matrices = []
+for name, nr, nrq, nc, data_name in mat_struct.findall(source):
+    nr, nrq, nc = int(nr), int(nrq), int(nc)
+    assert nrq == (nr + 3) // 4, 'Inconsistent nrq for {}'.format(name)
+    assert len(name) < NAMELEN, 'Name {} too long'.format(name)
+    matrices.append((name, nr, nrq, nc, padded(arrays[data_name], nr, nrq, nc)))
+
+if len(matrices) == 0:
+    sys.stderr.write('No matrices found in {}\n'.format(header_file))
+    sys.exit(1)
+
+entry = struct.Struct('<{}sIIIIQ'.format(NAMELEN))
+offset = 16 + len(matrices) * entry.size
+directory = []
+for name, nr, nrq, nc, data in matrices:
+    offset = ALIGN * ((offset + ALIGN - 1) // ALIGN)
+    directory.append(entry.pack(name.encode('ascii'), nr, nrq, nc, 0, offset))
+    offset += 4 * len(data)
+
+with open(model_file, 'wb') as fh:
+    fh.write(struct.pack('<8sII', MAGIC, VERSION, len(matrices)))
+    for d in directory:
+        fh.write(d)
+    for (name, nr, nrq, nc, data), d in zip(matrices, directory):
+        start = entry.unpack(d)[-1]
+        fh.write(b'\0' * (start - fh.tell()))
+        if sys.byteorder != 'little':
+            data.byteswap()
+        data.tofile(fh)
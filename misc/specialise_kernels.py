@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+""" Write kernels specialised to the shapes of the weights of models
+
+Reads model headers, as written by the parse_*.py scripts, and writes C
+kernels for the shape of each weight matrix and the size of each GRU layer
+found.  The kernels call the generic kernels of src/packed_kernels.h with
+constant sizes, so every trip count is known at compile time.  Shapes
+without a specialised kernel use the generic kernels.
+
+Every shipped model header should be given; the output file itself is
+skipped if it matches, so from the top of the repository
+
+    misc/specialise_kernels.py --output src/models/specialised_kernels.h src/models/*.h
+
+which is also what the CMake target `specialised_kernels` runs.
+"""
+import argparse
+import os
+import re
+import sys
+
+PANEL = 8
+
+mat_struct = re.compile(r'_Mat\s+_(\w+)\s*=\s*\{\s*\.nr\s*=\s*(\d+),\s*\.nrq\s*=\s*(\d+),'
+                        r'\s*\.nc\s*=\s*(\d+),')
+
+
+def read_shapes(filenames):
+    """ Shapes of weight matrices and sizes of GRU layers in model headers """
+    shapes = set()
+    gru_sizes = set()
+    for filename in filenames:
+        with open(filename, 'r') as fh:
+            header = fh.read()
+        for name, nr, _, nc in mat_struct.findall(header):
+            nr, nc = int(nr), int(nc)
+            if nc == 1:
+                #  Biases and peepholes are vectors
+                continue
+            shapes.add((nr, nc))
+            if name.endswith('_sW2'):
+                assert nr == nc, 'GRU weight {} should be square'.format(name)
+                gru_sizes.add(nr)
+    return sorted(shapes), sorted(gru_sizes)
+
+
+def npanel(nc):
+    return (nc + PANEL - 1) // PANEL
+
+
+def write_kernels(fh, filenames, shapes, gru_sizes):
+    fh.write('/*  Kernels specialised to the shapes of the weights of the shipped models.\n'
+             ' *  Generated by misc/specialise_kernels.py, CMake target specialised_kernels, from\n')
+    for filename in filenames:
+        fh.write(' *    {}\n'.format(os.path.basename(filename)))
+    fh.write(' *  Do not edit.\n */\n')
+    fh.write('#pragma once\n#ifndef SPECIALISED_KERNELS_MODELS_H\n#define SPECIALISED_KERNELS_MODELS_H\n\n')
+
+    for nr, nc in shapes:
+        fh.write('static void pgemm_{nr}x{nc}(const float * W, const float * X, size_t ldX, size_t ncol,\n'
+                 '                            float * C, size_t ldC){{\n'
+                 '    pgemm_panels(W, {nr} * PMAT_PANEL, {nr}, {np}, {nc}, X, ldX, ncol, C, ldC);\n'
+                 '}}\n\n'.format(nr=nr, nc=nc, np=npanel(nc)))
+
+    for size in gru_sizes:
+        fh.write('static void gru_step_{size}(const float * x, const float * istate, const float * sW,\n'
+                 '                          const float * sW2, float * xF, float * ostate){{\n'
+                 '    gru_step_panels({size}, x, istate, sW, sW2, xF, ostate);\n'
+                 '}}\n\n'.format(size=size))
+
+    fh.write('static const struct pgemm_specialisation pgemm_specialisations[] = {\n')
+    fh.write(',\n'.join('    {{{nr}, {nc}, pgemm_{nr}x{nc}}}'.format(nr=nr, nc=nc) for nr, nc in shapes))
+    fh.write('\n};\n\n')
+
+    fh.write('static const struct gru_step_specialisation gru_step_specialisations[] = {\n')
+    fh.write(',\n'.join('    {{{size}, gru_step_{size}}}'.format(size=size) for size in gru_sizes))
+    fh.write('\n};\n\n')
+
+    fh.write('#endif /* SPECIALISED_KERNELS_MODELS_H */\n')
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Write kernels specialised to model weights')
+    parser.add_argument('--output', default=None, help='File to write (default stdout)')
+    parser.add_argument('headers', nargs='+', help='Model headers')
+    args = parser.parse_args()
+
+    output = os.path.realpath(args.output) if args.output is not None else None
+    filenames = sorted((f for f in args.headers if os.path.realpath(f) != output),
+                       key=os.path.basename)
+    assert len(filenames) > 0, 'No model headers given'
+    shapes, gru_sizes = read_shapes(filenames)
+    if args.output is None:
+        write_kernels(sys.stdout, filenames, shapes, gru_sizes)
+    else:
+        with open(args.output, 'w') as fh:
+            write_kernels(fh, filenames, shapes, gru_sizes)
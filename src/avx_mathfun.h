@@ -0,0 +1,315 @@
+/* AVX2 and AVX-512 implementations of exp and log
+
+   Eight and sixteen wide versions of exp_ps and log_ps from
+   sse_mathfun.h.  The algorithms, constants and order of operations
+   are those of the four wide versions, which are themselves based on
+   the cephes math library, so results agree with exp_ps and log_ps
+   element for element.
+
+   Only the functions for the instruction sets enabled at compile time
+   are defined; callers should test __AVX2__ and __AVX512F__.
+*/
+
+/* Copyright (C) 2007  Julien Pommier
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  (this is the zlib license)
+*/
+
+/* Copyright (C) 2016 Oxford Nanopore technologies
+
+   This software contain modifications (C) Oxford Nanopore Technologies
+   and is not the original software, which can be obtained from
+   http://gruntthepeon.free.fr/ssemath/
+*/
+#pragma once
+#ifndef AVX_MATHFUN_H
+#define AVX_MATHFUN_H
+
+#include <immintrin.h>
+
+/* Constants shared with sse_mathfun.h */
+#define _AVX_MIN_NORM_POS 0x00800000
+#define _AVX_INV_MANT_MASK ~0x7f800000
+#define _AVX_SQRTHF 0.707106781186547524f
+#define _AVX_LOG_P0 7.0376836292E-2f
+#define _AVX_LOG_P1 -1.1514610310E-1f
+#define _AVX_LOG_P2 1.1676998740E-1f
+#define _AVX_LOG_P3 -1.2420140846E-1f
+#define _AVX_LOG_P4 1.4249322787E-1f
+#define _AVX_LOG_P5 -1.6668057665E-1f
+#define _AVX_LOG_P6 2.0000714765E-1f
+#define _AVX_LOG_P7 -2.4999993993E-1f
+#define _AVX_LOG_P8 3.3333331174E-1f
+#define _AVX_LOG_Q1 -2.12194440e-4f
+#define _AVX_LOG_Q2 0.693359375f
+#define _AVX_EXP_HI 88.3762626647949f
+#define _AVX_EXP_LO -88.3762626647949f
+#define _AVX_LOG2EF 1.44269504088896341f
+#define _AVX_EXP_C1 0.693359375f
+#define _AVX_EXP_C2 -2.12194440e-4f
+#define _AVX_EXP_P0 1.9875691500E-4f
+#define _AVX_EXP_P1 1.3981999507E-3f
+#define _AVX_EXP_P2 8.3334519073E-3f
+#define _AVX_EXP_P3 4.1665795894E-2f
+#define _AVX_EXP_P4 1.6666665459E-1f
+#define _AVX_EXP_P5 5.0000001201E-1f
+
+
+#ifdef __AVX2__
+typedef __m256 v8sf;
+typedef __m256i v8si;
+
+#define _PS256(Val) _mm256_set1_ps(Val)
+#define _PS256_INT(Val) _mm256_castsi256_ps(_mm256_set1_epi32(Val))
+
+/* natural logarithm computed for 8 simultaneous float
+   return NaN for x <= 0
+*/
+static inline v8sf __attribute__((__always_inline__)) log256_ps(v8sf x) {
+  const v8sf one = _PS256(1.0f);
+
+  v8sf invalid_mask = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LE_OS);
+
+  x = _mm256_max_ps(x, _PS256_INT(_AVX_MIN_NORM_POS));  /* cut off denormalized stuff */
+
+  v8si emm0 = _mm256_srli_epi32(_mm256_castps_si256(x), 23);
+  /* keep only the fractional part */
+  x = _mm256_and_ps(x, _PS256_INT(_AVX_INV_MANT_MASK));
+  x = _mm256_or_ps(x, _PS256(0.5f));
+
+  emm0 = _mm256_sub_epi32(emm0, _mm256_set1_epi32(0x7f));
+  v8sf e = _mm256_cvtepi32_ps(emm0);
+
+  e = _mm256_add_ps(e, one);
+
+  v8sf mask = _mm256_cmp_ps(x, _PS256(_AVX_SQRTHF), _CMP_LT_OS);
+  v8sf tmp = _mm256_and_ps(x, mask);
+  x = _mm256_sub_ps(x, one);
+  e = _mm256_sub_ps(e, _mm256_and_ps(one, mask));
+  x = _mm256_add_ps(x, tmp);
+
+  v8sf z = _mm256_mul_ps(x, x);
+
+  v8sf y = _PS256(_AVX_LOG_P0);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _PS256(_AVX_LOG_P1));
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _PS256(_AVX_LOG_P2));
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _PS256(_AVX_LOG_P3));
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _PS256(_AVX_LOG_P4));
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _PS256(_AVX_LOG_P5));
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _PS256(_AVX_LOG_P6));
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _PS256(_AVX_LOG_P7));
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _PS256(_AVX_LOG_P8));
+  y = _mm256_mul_ps(y, x);
+
+  y = _mm256_mul_ps(y, z);
+
+  tmp = _mm256_mul_ps(e, _PS256(_AVX_LOG_Q1));
+  y = _mm256_add_ps(y, tmp);
+
+  tmp = _mm256_mul_ps(z, _PS256(0.5f));
+  y = _mm256_sub_ps(y, tmp);
+
+  tmp = _mm256_mul_ps(e, _PS256(_AVX_LOG_Q2));
+  x = _mm256_add_ps(x, y);
+  x = _mm256_add_ps(x, tmp);
+  x = _mm256_or_ps(x, invalid_mask); // negative arg will be NAN
+  return x;
+}
+
+static inline v8sf __attribute__((__always_inline__)) exp256_ps(v8sf x) {
+  const v8sf one = _PS256(1.0f);
+
+  x = _mm256_min_ps(x, _PS256(_AVX_EXP_HI));
+  x = _mm256_max_ps(x, _PS256(_AVX_EXP_LO));
+
+  /* express exp(x) as exp(g + n*log(2)) */
+  v8sf fx = _mm256_mul_ps(x, _PS256(_AVX_LOG2EF));
+  fx = _mm256_add_ps(fx, _PS256(0.5f));
+
+  /* floorf by truncation, as exp_ps */
+  v8si emm0 = _mm256_cvttps_epi32(fx);
+  v8sf tmp = _mm256_cvtepi32_ps(emm0);
+  /* if greater, substract 1 */
+  v8sf mask = _mm256_cmp_ps(tmp, fx, _CMP_GT_OS);
+  mask = _mm256_and_ps(mask, one);
+  fx = _mm256_sub_ps(tmp, mask);
+
+  tmp = _mm256_mul_ps(fx, _PS256(_AVX_EXP_C1));
+  v8sf z = _mm256_mul_ps(fx, _PS256(_AVX_EXP_C2));
+  x = _mm256_sub_ps(x, tmp);
+  x = _mm256_sub_ps(x, z);
+
+  z = _mm256_mul_ps(x, x);
+
+  v8sf y = _PS256(_AVX_EXP_P0);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _PS256(_AVX_EXP_P1));
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _PS256(_AVX_EXP_P2));
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _PS256(_AVX_EXP_P3));
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _PS256(_AVX_EXP_P4));
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, _PS256(_AVX_EXP_P5));
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, x);
+  y = _mm256_add_ps(y, one);
+
+  /* build 2^n */
+  emm0 = _mm256_cvttps_epi32(fx);
+  emm0 = _mm256_add_epi32(emm0, _mm256_set1_epi32(0x7f));
+  emm0 = _mm256_slli_epi32(emm0, 23);
+  v8sf pow2n = _mm256_castsi256_ps(emm0);
+
+  y = _mm256_mul_ps(y, pow2n);
+  return y;
+}
+#endif /* __AVX2__ */
+
+
+#ifdef __AVX512F__
+typedef __m512 v16sf;
+typedef __m512i v16si;
+
+#define _PS512(Val) _mm512_set1_ps(Val)
+#define _PS512_INT(Val) _mm512_castsi512_ps(_mm512_set1_epi32(Val))
+
+/* natural logarithm computed for 16 simultaneous float
+   return NaN for x <= 0
+*/
+static inline v16sf __attribute__((__always_inline__)) log512_ps(v16sf x) {
+  const v16sf one = _PS512(1.0f);
+
+  __mmask16 invalid_mask = _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_LE_OS);
+
+  x = _mm512_max_ps(x, _PS512_INT(_AVX_MIN_NORM_POS));  /* cut off denormalized stuff */
+
+  v16si emm0 = _mm512_srli_epi32(_mm512_castps_si512(x), 23);
+  /* keep only the fractional part */
+  v16si xi = _mm512_and_si512(_mm512_castps_si512(x), _mm512_set1_epi32(_AVX_INV_MANT_MASK));
+  xi = _mm512_or_si512(xi, _mm512_castps_si512(_PS512(0.5f)));
+  x = _mm512_castsi512_ps(xi);
+
+  emm0 = _mm512_sub_epi32(emm0, _mm512_set1_epi32(0x7f));
+  v16sf e = _mm512_cvtepi32_ps(emm0);
+
+  e = _mm512_add_ps(e, one);
+
+  __mmask16 mask = _mm512_cmp_ps_mask(x, _PS512(_AVX_SQRTHF), _CMP_LT_OS);
+  v16sf tmp = _mm512_maskz_mov_ps(mask, x);
+  x = _mm512_sub_ps(x, one);
+  e = _mm512_mask_sub_ps(e, mask, e, one);
+  x = _mm512_add_ps(x, tmp);
+
+  v16sf z = _mm512_mul_ps(x, x);
+
+  v16sf y = _PS512(_AVX_LOG_P0);
+  y = _mm512_mul_ps(y, x);
+  y = _mm512_add_ps(y, _PS512(_AVX_LOG_P1));
+  y = _mm512_mul_ps(y, x);
+  y = _mm512_add_ps(y, _PS512(_AVX_LOG_P2));
+  y = _mm512_mul_ps(y, x);
+  y = _mm512_add_ps(y, _PS512(_AVX_LOG_P3));
+  y = _mm512_mul_ps(y, x);
+  y = _mm512_add_ps(y, _PS512(_AVX_LOG_P4));
+  y = _mm512_mul_ps(y, x);
+  y = _mm512_add_ps(y, _PS512(_AVX_LOG_P5));
+  y = _mm512_mul_ps(y, x);
+  y = _mm512_add_ps(y, _PS512(_AVX_LOG_P6));
+  y = _mm512_mul_ps(y, x);
+  y = _mm512_add_ps(y, _PS512(_AVX_LOG_P7));
+  y = _mm512_mul_ps(y, x);
+  y = _mm512_add_ps(y, _PS512(_AVX_LOG_P8));
+  y = _mm512_mul_ps(y, x);
+
+  y = _mm512_mul_ps(y, z);
+
+  tmp = _mm512_mul_ps(e, _PS512(_AVX_LOG_Q1));
+  y = _mm512_add_ps(y, tmp);
+
+  tmp = _mm512_mul_ps(z, _PS512(0.5f));
+  y = _mm512_sub_ps(y, tmp);
+
+  tmp = _mm512_mul_ps(e, _PS512(_AVX_LOG_Q2));
+  x = _mm512_add_ps(x, y);
+  x = _mm512_add_ps(x, tmp);
+  x = _mm512_mask_mov_ps(x, invalid_mask, _PS512_INT(-1)); // negative arg will be NAN
+  return x;
+}
+
+static inline v16sf __attribute__((__always_inline__)) exp512_ps(v16sf x) {
+  const v16sf one = _PS512(1.0f);
+
+  x = _mm512_min_ps(x, _PS512(_AVX_EXP_HI));
+  x = _mm512_max_ps(x, _PS512(_AVX_EXP_LO));
+
+  /* express exp(x) as exp(g + n*log(2)) */
+  v16sf fx = _mm512_mul_ps(x, _PS512(_AVX_LOG2EF));
+  fx = _mm512_add_ps(fx, _PS512(0.5f));
+
+  /* floorf by truncation, as exp_ps */
+  v16si emm0 = _mm512_cvttps_epi32(fx);
+  v16sf tmp = _mm512_cvtepi32_ps(emm0);
+  /* if greater, substract 1 */
+  __mmask16 mask = _mm512_cmp_ps_mask(tmp, fx, _CMP_GT_OS);
+  fx = _mm512_mask_sub_ps(tmp, mask, tmp, one);
+
+  tmp = _mm512_mul_ps(fx, _PS512(_AVX_EXP_C1));
+  v16sf z = _mm512_mul_ps(fx, _PS512(_AVX_EXP_C2));
+  x = _mm512_sub_ps(x, tmp);
+  x = _mm512_sub_ps(x, z);
+
+  z = _mm512_mul_ps(x, x);
+
+  v16sf y = _PS512(_AVX_EXP_P0);
+  y = _mm512_mul_ps(y, x);
+  y = _mm512_add_ps(y, _PS512(_AVX_EXP_P1));
+  y = _mm512_mul_ps(y, x);
+  y = _mm512_add_ps(y, _PS512(_AVX_EXP_P2));
+  y = _mm512_mul_ps(y, x);
+  y = _mm512_add_ps(y, _PS512(_AVX_EXP_P3));
+  y = _mm512_mul_ps(y, x);
+  y = _mm512_add_ps(y, _PS512(_AVX_EXP_P4));
+  y = _mm512_mul_ps(y, x);
+  y = _mm512_add_ps(y, _PS512(_AVX_EXP_P5));
+  y = _mm512_mul_ps(y, z);
+  y = _mm512_add_ps(y, x);
+  y = _mm512_add_ps(y, one);
+
+  /* build 2^n */
+  emm0 = _mm512_cvttps_epi32(fx);
+  emm0 = _mm512_add_epi32(emm0, _mm512_set1_epi32(0x7f));
+  emm0 = _mm512_slli_epi32(emm0, 23);
+  v16sf pow2n = _mm512_castsi512_ps(emm0);
+
+  y = _mm512_mul_ps(y, pow2n);
+  return y;
+}
+#endif /* __AVX512F__ */
+
+#endif /* AVX_MATHFUN_H */
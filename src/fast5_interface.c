@@ -1,10 +1,21 @@
 // fast5_interface needs cleaning
 #define BANANA 1
+#define _DEFAULT_SOURCE 1
 #include <assert.h>
+#include <dirent.h>
 #include <err.h>
+#include <libgen.h>
 #include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <zlib.h>
 #include "fast5_interface.h"
+#include "scrappie_common.h"
 #include "scrappie_stdlib.h"
+#include "signal_codec.h"
+#include "tar_reader.h"
 #include "util.h"
 
 struct _gop_data {
@@ -12,6 +23,13 @@ struct _gop_data {
     int latest;
 };
 
+/*  HDF5 need not be built thread safe, so every call into it from this file
+ *  is made holding hdf5_lock.  Compressed signal is read from the file as
+ *  stored, chunk by chunk, and decompressed after the lock is released, so
+ *  threads reading reads only contend for the lock while HDF5 is working.
+ */
+static pthread_mutex_t hdf5_lock = PTHREAD_MUTEX_INITIALIZER;
+
 typedef struct {
     //  Information for scaling raw data from ADC values to pA
     float digitisation;
@@ -39,10 +57,75 @@ float read_float_attribute(hid_t group, const char *attribute) {
     return val;
 }
 
-fast5_raw_scaling get_raw_scaling(hid_t hdf5file) {
+/**  Concatenate strings
+ *
+ *   @returns New string, to be freed by caller, or NULL on failure
+ **/
+static char *concat_string(const char *a, const char *b) {
+    //  strlen is a macro in scrappie_stdlib.h, so not used in an expression
+    const size_t lena = strlen(a);
+    const size_t lenb = strlen(b);
+    const size_t len = lena + lenb + 1;
+    char *str = calloc(len, sizeof(char));
+    RETURN_NULL_IF(NULL == str, NULL);
+    (void)snprintf(str, len, "%s%s", a, b);
+    return str;
+}
+
+//  strdup is not part of C11
+static char *copy_string(const char *str) {
+    return concat_string(str, "");
+}
+
+/**  Read a string attribute
+ *
+ *   @param group Group or dataset containing attribute
+ *   @param attribute Name of attribute
+ *
+ *   @returns Copy of string, to be freed by caller, or NULL on failure
+ **/
+char *read_string_attribute(hid_t group, const char *attribute) {
+    if (H5Aexists(group, attribute) <= 0) {
+        return NULL;
+    }
+    hid_t attr = H5Aopen(group, attribute, H5P_DEFAULT);
+    RETURN_NULL_IF(attr < 0, NULL);
+    hid_t type = H5Aget_type(attr);
+    if (type < 0 || H5T_STRING != H5Tget_class(type)) {
+        if (type >= 0) {
+            H5Tclose(type);
+        }
+        H5Aclose(attr);
+        return NULL;
+    }
+
+    char *val = NULL;
+    if (H5Tis_variable_str(type) > 0) {
+        char *vlval = NULL;
+        hid_t memtype = H5Tcopy(H5T_C_S1);
+        H5Tset_size(memtype, H5T_VARIABLE);
+        if (H5Aread(attr, memtype, &vlval) >= 0 && NULL != vlval) {
+            val = copy_string(vlval);
+            H5free_memory(vlval);
+        }
+        H5Tclose(memtype);
+    } else {
+        const size_t len = H5Tget_size(type);
+        val = calloc(len + 1, sizeof(char));
+        if (NULL != val && H5Aread(attr, type, val) < 0) {
+            free(val);
+            val = NULL;
+        }
+    }
+    H5Tclose(type);
+    H5Aclose(attr);
+
+    return val;
+}
+
+fast5_raw_scaling get_raw_scaling(hid_t hdf5file, const char *scaling_path) {
     // Add 1e-5 to sensible sample rate as a sentinel value
     fast5_raw_scaling scaling = { NAN, NAN, NAN, NAN };
-    const char *scaling_path = "/UniqueGlobalKey/channel_id";
 
     hid_t scaling_group = H5Gopen(hdf5file, scaling_path, H5P_DEFAULT);
     if (scaling_group < 0) {
@@ -60,37 +143,522 @@ fast5_raw_scaling get_raw_scaling(hid_t hdf5file) {
     return scaling;
 }
 
-raw_table read_raw(const char *filename, bool scale_to_pA) {
-    assert(NULL != filename);
-    raw_table rawtbl = { 0, 0, 0, NULL };
+/**  Name of link under a group
+ *
+ *   @param hdf5file Open fast5 file
+ *   @param root Path of group
+ *   @param idx Index of link, in order of name
+ *
+ *   @returns Name of link, to be freed by caller, or NULL on failure
+ **/
+static char *link_name_by_idx(hid_t hdf5file, const char *root, size_t idx) {
+    ssize_t size =
+        H5Lget_name_by_idx(hdf5file, root, H5_INDEX_NAME, H5_ITER_INC, idx,
+                           NULL, 0, H5P_DEFAULT);
+    RETURN_NULL_IF(size < 0, NULL);
+    char *name = calloc(1 + size, sizeof(char));
+    RETURN_NULL_IF(NULL == name, NULL);
+    H5Lget_name_by_idx(hdf5file, root, H5_INDEX_NAME, H5_ITER_INC, idx, name,
+                       1 + size, H5P_DEFAULT);
+    return name;
+}
 
-    hid_t hdf5file = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+static struct fast5_file *free_fast5_file_locked(struct fast5_file *f5);
+
+static struct fast5_file *open_fast5_file_locked(const char *filename, hid_t fapl) {
+    hid_t hdf5file = H5Fopen(filename, H5F_ACC_RDONLY, fapl);
     if (hdf5file < 0) {
         warnx("Failed to open %s for reading.", filename);
-        return rawtbl;
+        return NULL;
     }
     H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
 
-    const char *root = "/Raw/Reads/";
-    const int rootstr_len = strlen(root);
-    ssize_t size =
-        H5Lget_name_by_idx(hdf5file, root, H5_INDEX_NAME, H5_ITER_INC, 0, NULL,
-                           0, H5P_DEFAULT);
-    if (size < 0) {
+    struct fast5_file *f5 = calloc(1, sizeof(struct fast5_file));
+    if (NULL == f5) {
+        H5Fclose(hdf5file);
+        return NULL;
+    }
+    f5->hdf5file = hdf5file;
+    f5->nref = 1;
+    f5->multiread = (H5Lexists(hdf5file, "/Raw", H5P_DEFAULT) <= 0);
+
+    const char *root = f5->multiread ? "/" : "/Raw/Reads/";
+    H5G_info_t info;
+    if (H5Gget_info_by_name(hdf5file, root, &info, H5P_DEFAULT) < 0) {
+        warnx("Failed find reads under %s in %s.", root, filename);
+        return free_fast5_file_locked(f5);
+    }
+    f5->read_group = calloc(info.nlinks, sizeof(char *));
+    f5->read_id = calloc(info.nlinks, sizeof(char *));
+    if (NULL == f5->read_group || NULL == f5->read_id) {
+        return free_fast5_file_locked(f5);
+    }
+
+    for (size_t i = 0; i < info.nlinks; i++) {
+        char *name = link_name_by_idx(hdf5file, root, i);
+        if (NULL == name) {
+            continue;
+        }
+        if (f5->multiread) {
+            //  Groups of multi-read files are named read_<read_id>
+            if (0 == strncmp(name, "read_", 5)) {
+                f5->read_group[f5->nread] = concat_string(root, name);
+                f5->read_id[f5->nread] = copy_string(name + 5);
+                f5->nread += 1;
+            }
+        } else {
+            char *group = concat_string(root, name);
+            hid_t gid = H5Gopen(hdf5file, group, H5P_DEFAULT);
+            char *read_id = NULL;
+            if (gid >= 0) {
+                read_id = read_string_attribute(gid, "read_id");
+                H5Gclose(gid);
+            }
+            f5->read_group[f5->nread] = group;
+            f5->read_id[f5->nread] = (NULL != read_id) ? read_id : copy_string(name);
+            f5->nread += 1;
+        }
+        free(name);
+    }
+
+    if (0 == f5->nread) {
         warnx("Failed find read name under %s.", root);
-        goto cleanup1;
     }
-    char *name = calloc(1 + size, sizeof(char));
-    H5Lget_name_by_idx(hdf5file, root, H5_INDEX_NAME, H5_ITER_INC, 0, name,
-                       1 + size, H5P_DEFAULT);
 
-    // Create group name
-    char *signal_path = calloc(rootstr_len + size + 8, sizeof(char));
-    (void)snprintf(signal_path, rootstr_len + size + 8, "%s%s/Signal", root,
-                   name);
-    free(name);
+    return f5;
+}
+
+/**  Open a fast5 file to read the reads it contains
+ *
+ *   Single read files contain one read, under /Raw/Reads/.  Multi-read files
+ *   contain a group /read_<read_id> for each read.  The groups of all reads
+ *   are found when the file is opened and the file is kept open until closed
+ *   by free_fast5_file, so reading many reads costs one open.  Thread safe.
+ *
+ *   @param filename Name of fast5 file
+ *
+ *   @returns Opened file or NULL on failure
+ **/
+struct fast5_file *open_fast5_file(const char *filename) {
+    RETURN_NULL_IF(NULL == filename, NULL);
+    pthread_mutex_lock(&hdf5_lock);
+    struct fast5_file *f5 = open_fast5_file_locked(filename, H5P_DEFAULT);
+    pthread_mutex_unlock(&hdf5_lock);
+    return f5;
+}
+
+/**  Open a fast5 file, reading it whole into memory
+ *
+ *   The file is read by the core driver of HDF5, in a few large sequential
+ *   reads, rather than by many small reads of its metadata, attributes and
+ *   signal as they are needed.  Lookups into the file are then made in
+ *   memory, which helps most on network file systems where each read is
+ *   slow.  The image is held until the file is closed, so files larger than
+ *   max_size are opened as by open_fast5_file instead.  Thread safe.
+ *
+ *   @param filename Name of fast5 file
+ *   @param max_size Size of largest file read into memory, in bytes
+ *
+ *   @returns Opened file or NULL on failure
+ **/
+struct fast5_file *open_fast5_file_in_memory(const char *filename, size_t max_size) {
+    RETURN_NULL_IF(NULL == filename, NULL);
+    struct stat st;
+    if (0 != stat(filename, &st) || st.st_size <= 0 || (size_t)st.st_size > max_size) {
+        return open_fast5_file(filename);
+    }
+
+    pthread_mutex_lock(&hdf5_lock);
+    struct fast5_file *f5 = NULL;
+    hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+    //  Read only, so the image is never grown or written back
+    if (fapl >= 0 && H5Pset_fapl_core(fapl, st.st_size, false) >= 0) {
+        f5 = open_fast5_file_locked(filename, fapl);
+    } else {
+        warnx("Failed to set up reading %s into memory.", filename);
+    }
+    if (fapl >= 0) {
+        H5Pclose(fapl);
+    }
+    pthread_mutex_unlock(&hdf5_lock);
+    return f5;
+}
+
+/*  Callbacks for the core driver of HDF5 to read a file image in place.
+ *  Without them HDF5 copies the image as it is set on the file access
+ *  properties and again as the file is opened.  Every allocation asked for
+ *  is the image itself and none is freed, so the image must outlive the
+ *  file.  The record of the image is shared by the copies HDF5 makes of
+ *  the properties and counted, so it is freed with the last of them; calls
+ *  are made holding hdf5_lock.
+ */
+struct image_in_place {
+    void *image;
+    size_t size;
+    size_t nref;
+};
+
+static void *image_malloc(size_t size, H5FD_file_image_op_t op, void *udata) {
+    const struct image_in_place *img = udata;
+    (void)op;
+    return (size == img->size) ? img->image : NULL;
+}
+
+static void *image_memcpy(void *dest, const void *src, size_t size,
+                          H5FD_file_image_op_t op, void *udata) {
+    (void)size;
+    (void)op;
+    (void)udata;
+    //  Source and destination are both the image
+    return (dest == src) ? dest : NULL;
+}
+
+static void *image_realloc(void *ptr, size_t size, H5FD_file_image_op_t op, void *udata) {
+    (void)ptr;
+    (void)size;
+    (void)op;
+    (void)udata;
+    //  Files are opened read only, so the image is never grown
+    return NULL;
+}
+
+static herr_t image_free(void *ptr, H5FD_file_image_op_t op, void *udata) {
+    (void)ptr;
+    (void)op;
+    (void)udata;
+    return 0;
+}
+
+static void *image_udata_copy(void *udata) {
+    struct image_in_place *img = udata;
+    img->nref += 1;
+    return img;
+}
+
+static herr_t image_udata_free(void *udata) {
+    struct image_in_place *img = udata;
+    img->nref -= 1;
+    if (0 == img->nref) {
+        free(img);
+    }
+    return 0;
+}
+
+/**  Open a fast5 file from an image of it held in memory
+ *
+ *   Used for files read out of an archive, which are never on disk.  The
+ *   image is read in place by the core driver of HDF5, without being copied,
+ *   so it must be left unchanged until the file is closed by
+ *   free_fast5_file.  Thread safe.
+ *
+ *   @param name Name of file, for messages
+ *   @param image Contents of fast5 file
+ *   @param size Size of image in bytes
+ *
+ *   @returns Opened file or NULL on failure
+ **/
+struct fast5_file *open_fast5_file_image(const char *name, const void *image, size_t size) {
+    RETURN_NULL_IF(NULL == name, NULL);
+    RETURN_NULL_IF(NULL == image, NULL);
+    RETURN_NULL_IF(0 == size, NULL);
+    struct image_in_place *img = malloc(sizeof(struct image_in_place));
+    RETURN_NULL_IF(NULL == img, NULL);
+    *img = (struct image_in_place) {(void *)image, size, 1};
+    H5FD_file_image_callbacks_t callbacks = {
+        image_malloc, image_memcpy, image_realloc, image_free,
+        image_udata_copy, image_udata_free, img
+    };
 
-    hid_t dset = H5Dopen(hdf5file, signal_path, H5P_DEFAULT);
+    pthread_mutex_lock(&hdf5_lock);
+    struct fast5_file *f5 = NULL;
+    hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+    //  The name is not opened when the core driver is given an image, and the
+    // callbacks must be set before the image is
+    if (fapl >= 0 && H5Pset_fapl_core(fapl, size, false) >= 0
+        && H5Pset_file_image_callbacks(fapl, &callbacks) >= 0
+        && H5Pset_file_image(fapl, (void *)image, size) >= 0) {
+        f5 = open_fast5_file_locked(name, fapl);
+    } else {
+        warnx("Failed to set up reading %s from memory.", name);
+    }
+    if (fapl >= 0) {
+        H5Pclose(fapl);
+    }
+    image_udata_free(img);
+    pthread_mutex_unlock(&hdf5_lock);
+    return f5;
+}
+
+static struct fast5_file *free_fast5_file_locked(struct fast5_file *f5) {
+    if (NULL == f5) {
+        return NULL;
+    }
+    for (size_t i = 0; i < f5->nread; i++) {
+        if (NULL != f5->read_group) {
+            free(f5->read_group[i]);
+        }
+        if (NULL != f5->read_id) {
+            free(f5->read_id[i]);
+        }
+    }
+    free(f5->read_group);
+    free(f5->read_id);
+    H5Fclose(f5->hdf5file);
+    //  Image is read in place, so must outlive the file
+    free(f5->image);
+    free(f5);
+    return NULL;
+}
+
+/**  Take another reference to an open fast5 file
+ *
+ *   Lets a read of the file be read by a thread after whoever opened the
+ *   file has moved on and released it.  Thread safe.
+ *
+ *   @param f5 Open fast5 file
+ *
+ *   @returns The file
+ **/
+struct fast5_file *retain_fast5_file(struct fast5_file *f5) {
+    RETURN_NULL_IF(NULL == f5, NULL);
+    pthread_mutex_lock(&hdf5_lock);
+    f5->nref += 1;
+    pthread_mutex_unlock(&hdf5_lock);
+    return f5;
+}
+
+/**  Release a reference to a fast5 file, closing it if it is the last
+ *
+ *   @param f5 File opened by open_fast5_file
+ *
+ *   @returns NULL
+ **/
+struct fast5_file *free_fast5_file(struct fast5_file *f5) {
+    if (NULL == f5) {
+        return NULL;
+    }
+    pthread_mutex_lock(&hdf5_lock);
+    f5->nref -= 1;
+    if (0 == f5->nref) {
+        free_fast5_file_locked(f5);
+    }
+    pthread_mutex_unlock(&hdf5_lock);
+    return NULL;
+}
+
+/*  Chunks of a signal dataset, as stored in the file, to be decompressed
+ *  once the HDF5 lock has been released.  Only datasets of int16 stored in
+ *  native order, whose filters are all gzip (deflate) or shuffle, are read
+ *  this way; others are read by H5Dread.
+ */
+#define MAX_SIGNAL_FILTERS 4
+struct signal_chunks {
+    size_t nchunk;
+    //  Samples in each chunk
+    size_t chunk_size;
+    size_t nfilter;
+    H5Z_filter_t filter[MAX_SIGNAL_FILTERS];
+    //  Filters skipped for each chunk, its size and data as stored
+    uint32_t *filter_mask;
+    size_t *nbyte;
+    unsigned char **data;
+};
+
+static void free_signal_chunks(struct signal_chunks *chunks) {
+    if (NULL != chunks->data) {
+        for (size_t i = 0; i < chunks->nchunk; i++) {
+            free(chunks->data[i]);
+        }
+    }
+    free(chunks->data);
+    free(chunks->nbyte);
+    free(chunks->filter_mask);
+    *chunks = (struct signal_chunks) {0};
+}
+
+/**  Whether signal dataset can be read chunk by chunk and decompressed here
+ *
+ *   @param dset Signal dataset
+ *   @param chunks [out] Chunk size and filters of dataset
+ *
+ *   @returns true if the dataset should be read by read_signal_chunks
+ **/
+static bool can_read_signal_chunks(hid_t dset, struct signal_chunks *chunks) {
+#if !H5_VERSION_GE(1, 10, 2)
+    //  Reading chunks as stored needs H5Dread_chunk, from HDF5 1.10.2
+    (void)dset;
+    (void)chunks;
+    return false;
+#else
+    bool ok = false;
+    hid_t type = H5Dget_type(dset);
+    if (type >= 0) {
+        ok = H5T_INTEGER == H5Tget_class(type) && sizeof(int16_t) == H5Tget_size(type)
+            && H5T_SGN_2 == H5Tget_sign(type)
+            && H5Tget_order(H5T_NATIVE_INT16) == H5Tget_order(type);
+        H5Tclose(type);
+    }
+    //  Datasets of other types, and those below, are read by H5Dread
+    if (!ok) {
+        return false;
+    }
+
+    hid_t dcpl = H5Dget_create_plist(dset);
+    RETURN_NULL_IF(dcpl < 0, false);
+    hsize_t chunk_size = 0;
+    ok = (H5D_CHUNKED == H5Pget_layout(dcpl)) && (1 == H5Pget_chunk(dcpl, 1, &chunk_size));
+    const int nfilter = ok ? H5Pget_nfilters(dcpl) : -1;
+    ok = ok && nfilter >= 0 && nfilter <= MAX_SIGNAL_FILTERS;
+    for (int i = 0; ok && i < nfilter; i++) {
+        unsigned int flags;
+        size_t ncd = 0;
+        const H5Z_filter_t filter = H5Pget_filter2(dcpl, i, &flags, &ncd, NULL, 0, NULL,
+                                                   NULL);
+        ok = (H5Z_FILTER_DEFLATE == filter || H5Z_FILTER_SHUFFLE == filter);
+        chunks->filter[i] = filter;
+    }
+    H5Pclose(dcpl);
+    if (!ok || 0 == chunk_size) {
+        return false;
+    }
+
+    chunks->chunk_size = chunk_size;
+    chunks->nfilter = nfilter;
+    return true;
+#endif
+}
+
+/**  Read chunks of signal dataset as stored
+ *
+ *   Chunks that have not been written are left empty, to be read as zero.
+ *
+ *   @param dset Signal dataset, checked by can_read_signal_chunks
+ *   @param nsample Length of signal
+ *   @param chunks [in/out] Chunk size and filters of dataset, to which the
+ *   chunks are added
+ *
+ *   @returns true on success
+ **/
+static bool read_signal_chunks(hid_t dset, size_t nsample, struct signal_chunks *chunks) {
+#if !H5_VERSION_GE(1, 10, 2)
+    (void)dset;
+    (void)nsample;
+    (void)chunks;
+    return false;
+#else
+    const size_t nchunk = (nsample + chunks->chunk_size - 1) / chunks->chunk_size;
+    chunks->nchunk = nchunk;
+    chunks->filter_mask = calloc(nchunk, sizeof(uint32_t));
+    chunks->nbyte = calloc(nchunk, sizeof(size_t));
+    chunks->data = calloc(nchunk, sizeof(unsigned char *));
+    RETURN_NULL_IF(NULL == chunks->filter_mask || NULL == chunks->nbyte
+                   || NULL == chunks->data, false);
+
+    for (size_t i = 0; i < nchunk; i++) {
+        const hsize_t offset = i * chunks->chunk_size;
+        hsize_t nbyte = 0;
+        RETURN_NULL_IF(H5Dget_chunk_storage_size(dset, &offset, &nbyte) < 0, false);
+        if (0 == nbyte) {
+            continue;
+        }
+        chunks->data[i] = malloc(nbyte);
+        RETURN_NULL_IF(NULL == chunks->data[i], false);
+        chunks->nbyte[i] = nbyte;
+        RETURN_NULL_IF(H5Dread_chunk(dset, H5P_DEFAULT, &offset, chunks->filter_mask + i,
+                                     chunks->data[i]) < 0, false);
+    }
+    return true;
+#endif
+}
+
+/**  Decompress chunks of signal
+ *
+ *   Filters are undone in the reverse of the order they were applied when
+ *   the chunk was written.
+ *
+ *   @param chunks Chunks read by read_signal_chunks
+ *   @param raw [out] Signal, initialised to zero
+ *   @param nsample Length of signal
+ *
+ *   @returns true on success
+ **/
+static bool decompress_signal_chunks(const struct signal_chunks *chunks, int16_t * raw,
+                                     size_t nsample) {
+    const size_t chunk_nbyte = chunks->chunk_size * sizeof(int16_t);
+    unsigned char *buf = malloc(chunk_nbyte);
+    unsigned char *tmp = malloc(chunk_nbyte);
+    bool ok = (NULL != buf && NULL != tmp);
+
+    for (size_t i = 0; ok && i < chunks->nchunk; i++) {
+        if (NULL == chunks->data[i]) {
+            continue;
+        }
+        const unsigned char *in = chunks->data[i];
+        size_t nbyte = chunks->nbyte[i];
+        for (size_t f = chunks->nfilter; ok && f > 0; f--) {
+            if (chunks->filter_mask[i] & (1u << (f - 1))) {
+                //  Filter was skipped when chunk was written
+                continue;
+            }
+            unsigned char *out = (in == tmp) ? buf : tmp;
+            if (H5Z_FILTER_DEFLATE == chunks->filter[f - 1]) {
+                uLongf nout = chunk_nbyte;
+                ok = (Z_OK == uncompress(out, &nout, in, nbyte));
+                nbyte = nout;
+            } else {
+                //  Shuffle: low bytes of every sample, then high bytes
+                const size_t n = nbyte / sizeof(int16_t);
+                ok = (nbyte == n * sizeof(int16_t));
+                for (size_t j = 0; ok && j < n; j++) {
+                    out[2 * j] = in[j];
+                    out[2 * j + 1] = in[n + j];
+                }
+            }
+            in = out;
+        }
+        ok = ok && (chunk_nbyte == nbyte);
+        if (ok) {
+            const size_t start = i * chunks->chunk_size;
+            const size_t n = (nsample - start < chunks->chunk_size) ? (nsample - start)
+                                                                   : chunks->chunk_size;
+            memcpy(raw + start, in, n * sizeof(int16_t));
+        }
+    }
+
+    free(tmp);
+    free(buf);
+    return ok;
+}
+
+/**  Read raw signal of a read in an open fast5 file as stored
+ *
+ *   The signal is read as int16 DAQ values, which is how it is stored, so
+ *   HDF5 need not convert it, along with the scaling to pA.  Signal that is
+ *   compressed by gzip is read as stored and decompressed without holding
+ *   the HDF5 lock, so many threads may decompress at once.  Thread safe.
+ *
+ *   @param f5 Open fast5 file
+ *   @param idx Index of read in file
+ *
+ *   @returns Table of raw signal.  The signal is NULL on failure.
+ **/
+daq_table read_daq_from_fast5(const struct fast5_file *f5, size_t idx) {
+    daq_table daqtbl = { 0, 0, 0, NAN, NAN, NAN, NULL };
+    RETURN_NULL_IF(NULL == f5, daqtbl);
+    if (idx >= f5->nread) {
+        warnx("No read %zu in fast5 file, which has %zu reads.", idx, f5->nread);
+        return daqtbl;
+    }
+
+    const char *group = f5->read_group[idx];
+    char *signal_path =
+        concat_string(group, f5->multiread ? "/Raw/Signal" : "/Signal");
+    RETURN_NULL_IF(NULL == signal_path, daqtbl);
+
+    struct signal_chunks chunks = { 0 };
+    bool chunked = false;
+    pthread_mutex_lock(&hdf5_lock);
+    hid_t dset = H5Dopen(f5->hdf5file, signal_path, H5P_DEFAULT);
     if (dset < 0) {
         warnx("Failed to open dataset '%s' to read raw signal from.",
               signal_path);
@@ -105,41 +673,584 @@ raw_table read_raw(const char *filename, bool scale_to_pA) {
     }
     hsize_t nsample;
     H5Sget_simple_extent_dims(space, &nsample, NULL);
-    float *rawptr = calloc(nsample, sizeof(float));
-    herr_t status =
-        H5Dread(dset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, rawptr);
+    int16_t *rawptr = calloc(nsample, sizeof(int16_t));
+    chunked = can_read_signal_chunks(dset, &chunks);
+    herr_t status = -1;
+    if (NULL != rawptr) {
+        status = chunked ? (read_signal_chunks(dset, nsample, &chunks) ? 0 : -1)
+                         : H5Dread(dset, H5T_NATIVE_INT16, H5S_ALL, H5S_ALL, H5P_DEFAULT, rawptr);
+    }
     if (status < 0) {
         free(rawptr);
+        chunked = false;
         warnx("Failed to read raw data from dataset %s.", signal_path);
         goto cleanup4;
     }
-    rawtbl = (raw_table) {
-    nsample, 0, nsample, rawptr};
 
-    if (scale_to_pA) {
-        const fast5_raw_scaling scaling = get_raw_scaling(hdf5file);
-        const float raw_unit = scaling.range / scaling.digitisation;
-        for (size_t i = 0; i < nsample; i++) {
-            rawptr[i] = (rawptr[i] + scaling.offset) * raw_unit;
-        }
-    }
+    char *scaling_path = f5->multiread ? concat_string(group, "/channel_id")
+                                       : copy_string("/UniqueGlobalKey/channel_id");
+    const fast5_raw_scaling scaling = get_raw_scaling(f5->hdf5file, scaling_path);
+    free(scaling_path);
+    daqtbl = (daq_table) {
+    nsample, 0, nsample, scaling.offset, scaling.range, scaling.digitisation, rawptr};
 
  cleanup4:
     H5Sclose(space);
  cleanup3:
     H5Dclose(dset);
  cleanup2:
+    pthread_mutex_unlock(&hdf5_lock);
+
+    if (chunked && !decompress_signal_chunks(&chunks, daqtbl.raw, daqtbl.n)) {
+        warnx("Failed to decompress raw data from dataset %s.", signal_path);
+        free(daqtbl.raw);
+        daqtbl = (daq_table) { 0, 0, 0, NAN, NAN, NAN, NULL };
+    }
+    free_signal_chunks(&chunks);
     free(signal_path);
- cleanup1:
-    H5Fclose(hdf5file);
 
+    return daqtbl;
+}
+
+/**  Read raw signal of a read in an open fast5 file
+ *
+ *   @param f5 Open fast5 file
+ *   @param idx Index of read in file
+ *   @param scale_to_pA Whether to scale signal from ADC values to pA
+ *
+ *   @returns Table of raw signal.  The signal is NULL on failure.
+ **/
+raw_table read_raw_from_fast5(const struct fast5_file *f5, size_t idx,
+                              bool scale_to_pA) {
+    daq_table dt = read_daq_from_fast5(f5, idx);
+    if (NULL == dt.raw) {
+        return (raw_table) {0, 0, 0, NULL};
+    }
+    raw_table rawtbl = raw_table_from_daq(dt, scale_to_pA);
+    free(dt.raw);
     return rawtbl;
 }
 
-void write_annotated_events(hid_t hdf5file, const char *readname,
-                            const event_table et, hsize_t chunk_size,
-                            int compression_level) {
-    assert(compression_level >= 0 && compression_level <= 9);
+/**  Index of read in an open fast5 file
+ *
+ *   @param f5 Open fast5 file
+ *   @param read_id ID of read
+ *
+ *   @returns Index of read or -1 if the file does not contain the read
+ **/
+ssize_t fast5_read_index(const struct fast5_file *f5, const char *read_id) {
+    RETURN_NULL_IF(NULL == f5, -1);
+    RETURN_NULL_IF(NULL == read_id, -1);
+    for (size_t i = 0; i < f5->nread; i++) {
+        if (0 == strcmp(read_id, f5->read_id[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**  Read raw signal of a read, given by ID, in an open fast5 file
+ *
+ *   @param f5 Open fast5 file
+ *   @param read_id ID of read
+ *   @param scale_to_pA Whether to scale signal from ADC values to pA
+ *
+ *   @returns Table of raw signal.  The signal is NULL on failure.
+ **/
+raw_table read_raw_by_id(const struct fast5_file *f5, const char *read_id,
+                         bool scale_to_pA) {
+    const ssize_t idx = fast5_read_index(f5, read_id);
+    if (idx < 0) {
+        warnx("Read %s not found.", (NULL != read_id) ? read_id : "(null)");
+        return (raw_table) {0, 0, 0, NULL};
+    }
+    return read_raw_from_fast5(f5, idx, scale_to_pA);
+}
+
+/**  Read raw signal of first read in a fast5 file
+ *
+ *   @param filename Name of fast5 file
+ *   @param scale_to_pA Whether to scale signal from ADC values to pA
+ *
+ *   @returns Table of raw signal.  The signal is NULL on failure.
+ **/
+raw_table read_raw(const char *filename, bool scale_to_pA) {
+    assert(NULL != filename);
+    struct fast5_file *f5 = open_fast5_file(filename);
+    RETURN_NULL_IF(NULL == f5, ((raw_table) {0, 0, 0, NULL}));
+    raw_table rawtbl = read_raw_from_fast5(f5, 0, scale_to_pA);
+    f5 = free_fast5_file(f5);
+    return rawtbl;
+}
+
+/**  Read raw signal, as stored, of first read in a fast5 file
+ *
+ *   @param filename Name of fast5 file
+ *
+ *   @returns Table of raw signal.  The signal is NULL on failure.
+ **/
+daq_table read_daq(const char *filename) {
+    assert(NULL != filename);
+    struct fast5_file *f5 = open_fast5_file(filename);
+    RETURN_NULL_IF(NULL == f5, ((daq_table) {0, 0, 0, NAN, NAN, NAN, NULL}));
+    daq_table daqtbl = read_daq_from_fast5(f5, 0);
+    f5 = free_fast5_file(f5);
+    return daqtbl;
+}
+
+/**  Walk the reads of the fast5 files found from paths given on command line
+ *
+ *   Each path is a fast5 file, a scrappie signal file, a tar archive of fast5
+ *   files, a glob pattern or a directory, in which case all fast5 files in
+ *   the directory and its subdirectories are found.  Paths listed in the
+ *   file path_list, if set, follow those given.  Each file is opened once
+ *   and all its reads returned in turn before the next file is opened.
+ *
+ *   @param paths NULL terminated array of paths
+ *
+ *   @returns Reader or NULL on failure
+ **/
+struct fast5_reader *make_fast5_reader(char *const *paths) {
+    RETURN_NULL_IF(NULL == paths, NULL);
+    struct fast5_reader *reader = calloc(1, sizeof(struct fast5_reader));
+    RETURN_NULL_IF(NULL == reader, NULL);
+    reader->paths = paths;
+    return reader;
+}
+
+//  Free stream of reader, adding its I/O to that of the reader
+static void close_reader_stream(struct fast5_reader *reader) {
+    if (NULL != reader->stream) {
+        reader->io_nbyte += reader->stream->nbyte;
+        reader->io_time += reader->stream->time;
+        reader->io_uring = reader->stream->batch->use_uring;
+        reader->stream = free_signal_file_stream(reader->stream);
+    }
+}
+
+//  Release file being read.  Reads claimed from a file read out of an
+// archive may still be being read, so the image of the file, in the buffer
+// of the archive, passes to the file if any are.
+static void close_reader_file(struct fast5_reader *reader) {
+    if (NULL != reader->file && NULL != reader->tar) {
+        pthread_mutex_lock(&hdf5_lock);
+        if (reader->file->nref > 1) {
+            reader->file->image = take_tar_buffer(reader->tar);
+        }
+        pthread_mutex_unlock(&hdf5_lock);
+    }
+    reader->file = free_fast5_file(reader->file);
+}
+
+/*  Directory being walked, open while its entries are read, and the
+ *  directory it was found in.
+ */
+struct fast5_dir {
+    DIR *dirp;
+    char *path;
+    struct fast5_dir *parent;
+};
+
+//  Start walking directory, inside any being walked
+static bool push_fast5_dir(struct fast5_reader *reader, const char *path) {
+    struct fast5_dir *dir = calloc(1, sizeof(struct fast5_dir));
+    RETURN_NULL_IF(NULL == dir, false);
+    dir->dirp = opendir(path);
+    dir->path = copy_string(path);
+    if (NULL == dir->dirp || NULL == dir->path) {
+        warnx("Failed to read directory %s.", path);
+        if (NULL != dir->dirp) {
+            closedir(dir->dirp);
+        }
+        free(dir->path);
+        free(dir);
+        return false;
+    }
+    dir->parent = reader->dir;
+    reader->dir = dir;
+    return true;
+}
+
+//  Finish walking innermost directory
+static void pop_fast5_dir(struct fast5_reader *reader) {
+    struct fast5_dir *dir = reader->dir;
+    reader->dir = dir->parent;
+    closedir(dir->dirp);
+    free(dir->path);
+    free(dir);
+}
+
+static bool has_suffix(const char *name, const char *suffix) {
+    const size_t len = strlen(name);
+    const size_t suffix_len = strlen(suffix);
+    return len >= suffix_len && 0 == strcmp(name + len - suffix_len, suffix);
+}
+
+static bool is_directory(const char *path) {
+    struct stat st;
+    return 0 == stat(path, &st) && S_ISDIR(st.st_mode);
+}
+
+/**  Next fast5 file found by walking directories
+ *
+ *   Entries are taken one at a time, in the order of the directory, so the
+ *   first files are found without listing the rest.  Subdirectories are
+ *   walked as they are found, except those reached by symbolic links, which
+ *   could loop; links to files are followed.  The type of each entry is
+ *   taken from the directory where the file system gives it, so files are
+ *   only stat'ed when it does not.
+ *
+ *   @returns Path of file, to be freed by caller, or NULL when all
+ *   directories have been walked
+ **/
+static char *next_walk_file(struct fast5_reader *reader) {
+    while (NULL != reader->dir) {
+        struct dirent *entry = readdir(reader->dir->dirp);
+        if (NULL == entry) {
+            if (NULL == reader->dir->parent && 0 == reader->nfound) {
+                warnx("No fast5 files found in directory \"%s\".", reader->dir->path);
+            }
+            pop_fast5_dir(reader);
+            continue;
+        }
+        const char *name = entry->d_name;
+        if (0 == strcmp(name, ".") || 0 == strcmp(name, "..")) {
+            continue;
+        }
+        const bool maybe_fast5 = has_suffix(name, ".fast5");
+        const unsigned char type = entry->d_type;
+        if (DT_REG == type && !maybe_fast5) {
+            continue;
+        }
+
+        char *dirpath = concat_string(reader->dir->path, "/");
+        char *path = (NULL != dirpath) ? concat_string(dirpath, name) : NULL;
+        free(dirpath);
+        if (NULL == path) {
+            continue;
+        }
+        struct stat st;
+        const bool known = (DT_REG == type || DT_DIR == type);
+        if (!known && 0 != lstat(path, &st)) {
+            free(path);
+            continue;
+        }
+        if (DT_DIR == type || (!known && S_ISDIR(st.st_mode))) {
+            (void)push_fast5_dir(reader, path);
+        } else if (maybe_fast5 && (DT_REG == type || (0 == stat(path, &st) && S_ISREG(st.st_mode)))) {
+            reader->nfound += 1;
+            return path;
+        }
+        free(path);
+    }
+    return NULL;
+}
+
+/**  Next path from the command line or the list of paths
+ *
+ *   The list is read a line at a time, as paths are needed.  Empty lines
+ *   are skipped.
+ *
+ *   @returns Path, valid until the next call, or NULL when all paths have
+ *   been taken
+ **/
+static const char *next_input_path(struct fast5_reader *reader) {
+    if (NULL != reader->paths[reader->next_path]) {
+        reader->next_path += 1;
+        return reader->paths[reader->next_path - 1];
+    }
+    if (NULL == reader->path_list || reader->path_list_done) {
+        return NULL;
+    }
+    if (NULL == reader->path_list_fh) {
+        const bool use_stdin = (0 == strcmp(reader->path_list, "-"));
+        reader->path_list_fh = use_stdin ? stdin : fopen(reader->path_list, "r");
+        if (NULL == reader->path_list_fh) {
+            warnx("Failed to open list of paths %s for reading.", reader->path_list);
+            reader->path_list_done = true;
+            return NULL;
+        }
+    }
+    while (true) {
+        ssize_t len = getline(&reader->line, &reader->line_capacity, reader->path_list_fh);
+        if (len < 0) {
+            if (stdin != reader->path_list_fh) {
+                fclose(reader->path_list_fh);
+            }
+            reader->path_list_fh = NULL;
+            reader->path_list_done = true;
+            return NULL;
+        }
+        while (len > 0 && ('\n' == reader->line[len - 1] || '\r' == reader->line[len - 1])) {
+            len -= 1;
+        }
+        reader->line[len] = '\0';
+        if (len > 0) {
+            return reader->line;
+        }
+    }
+}
+
+/**  Free reader, closing any open file
+ *
+ *   @returns NULL
+ **/
+struct fast5_reader *free_fast5_reader(struct fast5_reader *reader) {
+    if (NULL == reader) {
+        return NULL;
+    }
+    close_reader_stream(reader);
+    close_reader_file(reader);
+    reader->signal = free_signal_file(reader->signal);
+    reader->tar = free_tar_reader(reader->tar);
+    free(reader->filename);
+    if (reader->have_glob) {
+        globfree(&reader->globbuf);
+    }
+    while (NULL != reader->dir) {
+        pop_fast5_dir(reader);
+    }
+    if (NULL != reader->path_list_fh && stdin != reader->path_list_fh) {
+        fclose(reader->path_list_fh);
+    }
+    free(reader->line);
+    free(reader);
+    return NULL;
+}
+
+/**  Find files matching a path that is not a directory
+ *
+ *   @returns true if any files were found
+ **/
+static bool glob_fast5_path(const char *path, glob_t * globbuf) {
+    int globret = glob(path, GLOB_NOSORT, NULL, globbuf);
+    if (0 != globret) {
+        if (GLOB_NOMATCH == globret) {
+            warnx("File or directory \"%s\" does not exist or no fast5 files found.", path);
+        }
+        globfree(globbuf);
+        return false;
+    }
+    return true;
+}
+
+/**  Claim next read, leaving the signal of reads of fast5 files to be read
+ *
+ *   Reads are named by the base name of their file for single read files and
+ *   by their read ID for multi-read and signal files.  Signal files are read
+ *   by a stream, with io_depth reads in flight, when io_depth is non-zero,
+ *   and fast5 files of at most max_image_size bytes are read whole into
+ *   memory when opened.  Fast5 files in tar archives are read one after
+ *   another, as the archive is read, and opened from memory; their reads are
+ *   named as if the files had been extracted.  Reads that cannot be read are
+ *   skipped with a warning.
+ *
+ *   Claiming a read of a fast5 file only takes a reference to its file, so
+ *   is quick, and the signal, whose decompression is most of the cost of
+ *   reading, is read by finish_fast5_read.  Callers sharing a reader between
+ *   threads need only hold a lock around this call.  Not thread safe.
+ *
+ *   @param reader Reader
+ *   @param claim [out] Read claimed, to be passed to finish_fast5_read
+ *
+ *   @returns true if a read was claimed, false when all reads have been read
+ **/
+bool claim_fast5_read(struct fast5_reader *reader, struct fast5_read_claim *claim) {
+    RETURN_NULL_IF(NULL == reader, false);
+    RETURN_NULL_IF(NULL == claim, false);
+
+    while (true) {
+        if (NULL != reader->file && reader->next_read < reader->file->nread) {
+            const size_t idx = reader->next_read;
+            reader->next_read += 1;
+            char *name = NULL;
+            if (reader->file->multiread) {
+                name = copy_string(reader->file->read_id[idx]);
+            } else {
+                //  basename may modify its argument
+                char *filename = copy_string(reader->filename);
+                name = (NULL != filename) ? copy_string(basename(filename)) : NULL;
+                free(filename);
+            }
+            if (NULL == name) {
+                continue;
+            }
+            const daq_table unread = { 0, 0, 0, NAN, NAN, NAN, NULL };
+            *claim = (struct fast5_read_claim) {retain_fast5_file(reader->file), idx,
+                                                {name, unread}};
+            return true;
+        }
+
+        if (NULL != reader->signal && reader->next_read < reader->signal->nread) {
+            size_t idx = reader->next_read;
+            daq_table dt;
+            if (NULL != reader->stream) {
+                if (!next_signal_file_stream(reader->stream, &idx, &dt)) {
+                    reader->next_read = reader->signal->nread;
+                    continue;
+                }
+            } else {
+                dt = read_daq_from_signal_file(reader->signal, idx);
+            }
+            reader->next_read = idx + 1;
+            const char *read_id = signal_file_read_id(reader->signal, idx);
+            char *name = (NULL != read_id) ? copy_string(read_id) : NULL;
+            if (NULL == dt.raw || NULL == name) {
+                warnx("Failed to read read %zu from %s", idx, reader->filename);
+                free(dt.raw);
+                free(name);
+                continue;
+            }
+            *claim = (struct fast5_read_claim) {NULL, idx, {name, dt}};
+            return true;
+        }
+
+        close_reader_stream(reader);
+        close_reader_file(reader);
+        reader->signal = free_signal_file(reader->signal);
+        free(reader->filename);
+        reader->filename = NULL;
+
+        if (NULL != reader->tar) {
+            //  Time includes reading the file out of the archive
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            struct tar_member member;
+            if (!next_tar_member(reader->tar, ".fast5", &member)) {
+                reader->tar = free_tar_reader(reader->tar);
+                continue;
+            }
+            if (0 == member.size) {
+                //  An empty member cannot be a fast5 file and has no image to open
+                warnx("Skipping empty file %s in archive.", member.name);
+                free(member.name);
+                continue;
+            }
+            reader->file = open_fast5_file_image(member.name, member.data, member.size);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            reader->nfile_open += 1;
+            reader->nfile_archive += 1;
+            reader->open_time += (t1.tv_sec - t0.tv_sec) + 1e-9 * (t1.tv_nsec - t0.tv_nsec);
+            reader->filename = member.name;
+            reader->next_read = 0;
+            continue;
+        }
+
+        char *walk_filename = next_walk_file(reader);
+        const char *filename = walk_filename;
+        if (NULL == filename && reader->have_glob && reader->next_file < reader->globbuf.gl_pathc) {
+            filename = reader->globbuf.gl_pathv[reader->next_file];
+            reader->next_file += 1;
+            //  Patterns may match directories, which are walked in turn
+            if (is_directory(filename)) {
+                (void)push_fast5_dir(reader, filename);
+                continue;
+            }
+        }
+        if (NULL != filename) {
+            if (is_tar_filename(filename)) {
+                reader->tar = open_tar_reader(filename);
+                free(walk_filename);
+                continue;
+            }
+            if (is_signal_file(filename)) {
+                reader->signal = open_signal_file(filename);
+                if (NULL != reader->signal && reader->io_depth > 0) {
+                    //  Falls back to the memory map if the stream cannot be made
+                    reader->stream = make_signal_file_stream(reader->signal, reader->io_depth, true);
+                }
+            } else {
+                struct timespec t0, t1;
+                clock_gettime(CLOCK_MONOTONIC, &t0);
+                reader->file = (reader->max_image_size > 0)
+                    ? open_fast5_file_in_memory(filename, reader->max_image_size)
+                    : open_fast5_file(filename);
+                clock_gettime(CLOCK_MONOTONIC, &t1);
+                reader->nfile_open += 1;
+                reader->open_time += (t1.tv_sec - t0.tv_sec) + 1e-9 * (t1.tv_nsec - t0.tv_nsec);
+            }
+            reader->filename = (NULL != walk_filename) ? walk_filename : copy_string(filename);
+            reader->next_read = 0;
+            continue;
+        }
+
+        if (reader->have_glob) {
+            globfree(&reader->globbuf);
+            reader->have_glob = false;
+        }
+        const char *path = next_input_path(reader);
+        if (NULL == path) {
+            return false;
+        }
+        reader->nfound = 0;
+        if (is_directory(path)) {
+            (void)push_fast5_dir(reader, path);
+        } else {
+            reader->have_glob = glob_fast5_path(path, &reader->globbuf);
+            reader->next_file = 0;
+        }
+    }
+}
+
+/**  Read signal of claimed read
+ *
+ *   The signal of a read of a fast5 file is read, with the HDF5 lock held
+ *   only while reading it as stored, and the claim's reference to its file
+ *   released.  Thread safe.
+ *
+ *   @param claim Read claimed by claim_fast5_read
+ *   @param read [out] Name and raw signal, as stored, of read, both to be
+ *   freed by caller
+ *
+ *   @returns true if the read was returned, false if it could not be read
+ **/
+bool finish_fast5_read(struct fast5_read_claim *claim, struct fast5_read *read) {
+    RETURN_NULL_IF(NULL == claim, false);
+    RETURN_NULL_IF(NULL == read, false);
+
+    if (NULL != claim->file) {
+        claim->read.dt = read_daq_from_fast5(claim->file, claim->idx);
+        claim->file = free_fast5_file(claim->file);
+        if (NULL == claim->read.dt.raw) {
+            warnx("Failed to read %s", claim->read.name);
+            free(claim->read.name);
+            claim->read.name = NULL;
+            return false;
+        }
+    }
+    *read = claim->read;
+    claim->read = (struct fast5_read) {0};
+    return true;
+}
+
+/**  Read next read
+ *
+ *   Reads are claimed and read in turn, as by claim_fast5_read and
+ *   finish_fast5_read.  Not thread safe: callers in parallel regions should
+ *   take reads inside a critical section.
+ *
+ *   @param reader Reader
+ *   @param read [out] Name and raw signal, as stored, of read, both to be
+ *   freed by caller
+ *
+ *   @returns true if a read was returned, false when all reads have been read
+ **/
+bool next_fast5_read(struct fast5_reader *reader, struct fast5_read *read) {
+    RETURN_NULL_IF(NULL == reader, false);
+    RETURN_NULL_IF(NULL == read, false);
+
+    struct fast5_read_claim claim;
+    while (claim_fast5_read(reader, &claim)) {
+        if (finish_fast5_read(&claim, read)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void write_annotated_events_locked(hid_t hdf5file, const char *readname,
+                                          const event_table et, hsize_t chunk_size,
+                                          int compression_level) {
 
     // Memory representation
     hid_t memtype = H5Tcreate(H5T_COMPOUND, sizeof(event_t));
@@ -220,8 +1331,165 @@ void write_annotated_events(hid_t hdf5file, const char *readname,
     H5Tclose(memtype);
 }
 
+void write_annotated_events(hid_t hdf5file, const char *readname,
+                            const event_table et, hsize_t chunk_size,
+                            int compression_level) {
+    assert(compression_level >= 0 && compression_level <= 9);
+    pthread_mutex_lock(&hdf5_lock);
+    write_annotated_events_locked(hdf5file, readname, et, chunk_size, compression_level);
+    pthread_mutex_unlock(&hdf5_lock);
+}
+
+static bool write_uint64_attribute(hid_t obj, const char *attribute, uint64_t val) {
+    hid_t space = H5Screate(H5S_SCALAR);
+    RETURN_NULL_IF(space < 0, false);
+    hid_t attr = H5Acreate(obj, attribute, H5T_STD_U64LE, space, H5P_DEFAULT, H5P_DEFAULT);
+    herr_t status = -1;
+    if (attr >= 0) {
+        status = H5Awrite(attr, H5T_NATIVE_UINT64, &val);
+        H5Aclose(attr);
+    }
+    H5Sclose(space);
+    return status >= 0;
+}
+
+static bool write_float_attribute(hid_t obj, const char *attribute, float val) {
+    hid_t space = H5Screate(H5S_SCALAR);
+    RETURN_NULL_IF(space < 0, false);
+    hid_t attr = H5Acreate(obj, attribute, H5T_IEEE_F32LE, space, H5P_DEFAULT, H5P_DEFAULT);
+    herr_t status = -1;
+    if (attr >= 0) {
+        status = H5Awrite(attr, H5T_NATIVE_FLOAT, &val);
+        H5Aclose(attr);
+    }
+    H5Sclose(space);
+    return status >= 0;
+}
+
+static uint64_t read_uint64_attribute(hid_t obj, const char *attribute) {
+    uint64_t val = 0;
+    hid_t attr = H5Aopen(obj, attribute, H5P_DEFAULT);
+    if (attr >= 0) {
+        H5Aread(attr, H5T_NATIVE_UINT64, &val);
+        H5Aclose(attr);
+    }
+    return val;
+}
+
+/**  Write raw signal of read to HDF5 file
+ *
+ *   The signal from start to end is encoded by the delta-varint codec and
+ *   written as a dataset of bytes, named after the read, with the number of
+ *   samples, encoding and scaling as attributes.  When the compression level
+ *   is positive, the encoded signal is further compressed by gzip, in chunks
+ *   of at most chunk_size bytes.
+ *
+ *   @param hdf5file File to write to
+ *   @param readname Name of read
+ *   @param dt Raw signal, as stored, of read
+ *   @param chunk_size Size of chunks of compressed dataset, in bytes
+ *   @param compression_level Gzip compression level, 0 for none
+ **/
 void write_annotated_raw(hid_t hdf5file, const char *readname,
-                         const raw_table rt, hsize_t chunk_size,
+                         const daq_table dt, hsize_t chunk_size,
                          int compression_level) {
-    return;
+    RETURN_NULL_IF(NULL == readname, );
+    RETURN_NULL_IF(NULL == dt.raw, );
+    const size_t nsample = dt.end - dt.start;
+    uint8_t *enc = malloc(delta_varint_bound(nsample));
+    RETURN_NULL_IF(NULL == enc, );
+    const hsize_t nbyte = encode_delta_varint(dt.raw + dt.start, nsample, enc);
+
+    pthread_mutex_lock(&hdf5_lock);
+    bool ok = false;
+    hid_t space = H5Screate_simple(1, &nbyte, NULL);
+    //  Chunks may be no larger than the dataset, which must not be empty
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    if (dcpl >= 0 && compression_level > 0 && chunk_size > 0 && nbyte > 0) {
+        const hsize_t chunk = (chunk_size < nbyte) ? chunk_size : nbyte;
+        if (H5Pset_chunk(dcpl, 1, &chunk) < 0 || H5Pset_deflate(dcpl, compression_level) < 0) {
+            H5Pclose(dcpl);
+            dcpl = -1;
+        }
+    }
+    if (space >= 0 && dcpl >= 0) {
+        hid_t dset = H5Dcreate(hdf5file, readname, H5T_STD_U8LE, space, H5P_DEFAULT,
+                               dcpl, H5P_DEFAULT);
+        if (dset >= 0) {
+            ok = H5Dwrite(dset, H5T_NATIVE_UINT8, H5S_ALL, H5S_ALL, H5P_DEFAULT, enc) >= 0;
+            ok = ok && write_uint64_attribute(dset, "nsample", nsample);
+            ok = ok && write_uint64_attribute(dset, "encoding", SIGNAL_ENCODING_DELTA_VARINT);
+            ok = ok && write_float_attribute(dset, "offset", dt.offset);
+            ok = ok && write_float_attribute(dset, "range", dt.range);
+            ok = ok && write_float_attribute(dset, "digitisation", dt.digitisation);
+            H5Dclose(dset);
+        }
+    }
+    if (dcpl >= 0) {
+        H5Pclose(dcpl);
+    }
+    if (space >= 0) {
+        H5Sclose(space);
+    }
+    pthread_mutex_unlock(&hdf5_lock);
+    if (!ok) {
+        warnx("Failed to write raw signal of %s %s:%d.", readname, __FILE__, __LINE__);
+    }
+
+    free(enc);
+}
+
+/**  Read raw signal of read written by write_annotated_raw
+ *
+ *   @param hdf5file File to read from
+ *   @param readname Name of read
+ *
+ *   @returns Table of raw signal.  The signal is NULL on failure.
+ **/
+daq_table read_annotated_raw(hid_t hdf5file, const char *readname) {
+    daq_table daqtbl = { 0, 0, 0, NAN, NAN, NAN, NULL };
+    RETURN_NULL_IF(NULL == readname, daqtbl);
+
+    uint8_t *enc = NULL;
+    hsize_t nbyte = 0;
+    uint64_t nsample = 0;
+    uint64_t encoding = 0;
+    fast5_raw_scaling scaling = { NAN, NAN, NAN, NAN };
+    pthread_mutex_lock(&hdf5_lock);
+    hid_t dset = H5Dopen(hdf5file, readname, H5P_DEFAULT);
+    if (dset >= 0) {
+        hid_t space = H5Dget_space(dset);
+        if (space >= 0 && 1 == H5Sget_simple_extent_ndims(space)) {
+            H5Sget_simple_extent_dims(space, &nbyte, NULL);
+            enc = malloc(nbyte + 1);
+            if (NULL != enc
+                && H5Dread(dset, H5T_NATIVE_UINT8, H5S_ALL, H5S_ALL, H5P_DEFAULT, enc) < 0) {
+                free(enc);
+                enc = NULL;
+            }
+        }
+        if (space >= 0) {
+            H5Sclose(space);
+        }
+        nsample = read_uint64_attribute(dset, "nsample");
+        encoding = read_uint64_attribute(dset, "encoding");
+        scaling.offset = read_float_attribute(dset, "offset");
+        scaling.range = read_float_attribute(dset, "range");
+        scaling.digitisation = read_float_attribute(dset, "digitisation");
+        H5Dclose(dset);
+    }
+    pthread_mutex_unlock(&hdf5_lock);
+
+    int16_t *raw = (NULL != enc) ? malloc((nsample + 1) * sizeof(int16_t)) : NULL;
+    if (NULL != raw && SIGNAL_ENCODING_DELTA_VARINT == encoding
+        && decode_delta_varint(enc, nbyte, raw, nsample)) {
+        daqtbl = (daq_table) {
+        nsample, 0, nsample, scaling.offset, scaling.range, scaling.digitisation, raw};
+    } else {
+        warnx("Failed to read raw signal of %s.", readname);
+        free(raw);
+    }
+    free(enc);
+
+    return daqtbl;
 }
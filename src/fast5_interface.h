@@ -2,17 +2,123 @@
 #ifndef EVENTS_H
 #    define EVENTS_H
 
+#    include <glob.h>
 #    include <hdf5.h>
 #    include <stdbool.h>
+#    include <sys/types.h>
 #    include "scrappie_structures.h"
+#    include "signal_file.h"
+#    include "tar_reader.h"
 
+/*  Fast5 file held open while its reads are read.  Single read files have
+ *  one read, under /Raw/Reads/, and multi-read files a group /read_<read_id>
+ *  for each read.
+ */
+struct fast5_file {
+    hid_t hdf5file;
+    bool multiread;
+    size_t nread;
+    //  Path of group for each read and its read ID
+    char **read_group;
+    char **read_id;
+    //  References held to file, which is closed when the last is released,
+    // and image it was opened from that it owns, if any
+    size_t nref;
+    void *image;
+};
+
+struct fast5_file *open_fast5_file(const char *filename);
+struct fast5_file *open_fast5_file_in_memory(const char *filename, size_t max_size);
+struct fast5_file *open_fast5_file_image(const char *name, const void *image, size_t size);
+struct fast5_file *retain_fast5_file(struct fast5_file *f5);
+struct fast5_file *free_fast5_file(struct fast5_file *f5);
+daq_table read_daq_from_fast5(const struct fast5_file *f5, size_t idx);
+raw_table read_raw_from_fast5(const struct fast5_file *f5, size_t idx,
+                              bool scale_to_pA);
+ssize_t fast5_read_index(const struct fast5_file *f5, const char *read_id);
+raw_table read_raw_by_id(const struct fast5_file *f5, const char *read_id,
+                         bool scale_to_pA);
 raw_table read_raw(const char *filename, bool scale_to_pA);
+daq_table read_daq(const char *filename);
+
+/*  Reads of all the fast5 files found from the paths given on the command
+ *  line, returned one read at a time so callers can schedule work per read.
+ *  Scrappie signal files and tar archives of fast5 files may be given in
+ *  place of fast5 files.  Files are found as they are needed, so reading
+ *  starts at once however many there are.  Only one file is open at a time.
+ */
+struct fast5_dir;
+
+struct fast5_reader {
+    char *const *paths;
+    size_t next_path;
+    //  File listing further paths, one per line, "-" for stdin, or NULL.
+    // Set before the first read.
+    const char *path_list;
+    FILE *path_list_fh;
+    bool path_list_done;
+    char *line;
+    size_t line_capacity;
+    glob_t globbuf;
+    bool have_glob;
+    size_t next_file;
+    //  Directories being walked, innermost first, and files found in the
+    // walk of the current path
+    struct fast5_dir *dir;
+    size_t nfound;
+    struct fast5_file *file;
+    struct signal_file *signal;
+    //  Archive whose fast5 files are being read, if any
+    struct tar_reader *tar;
+    char *filename;
+    size_t next_read;
+    //  Reads of a signal file kept in flight by a stream, or 0 to read signal
+    // files through their memory map.  Set before the first read.
+    size_t io_depth;
+    struct signal_file_stream *stream;
+    //  Bytes of signal read by streams, seconds spent reading them and
+    // whether they were read by io_uring
+    size_t io_nbyte;
+    double io_time;
+    bool io_uring;
+    //  Size in bytes of largest fast5 file read whole into memory when
+    // opened, or 0 to open files in place.  Set before the first read.
+    size_t max_image_size;
+    //  Fast5 files opened, those of them read out of archives, and seconds
+    // spent opening them
+    size_t nfile_open;
+    size_t nfile_archive;
+    double open_time;
+};
+
+struct fast5_read {
+    char *name;
+    daq_table dt;
+};
+
+/*  Read claimed from a reader whose signal is yet to be read, so that it can
+ *  be read outside of any lock held around the reader.  Claims of reads of
+ *  fast5 files hold a reference to their file; reads of signal files are
+ *  read as they are claimed, so file is NULL.
+ */
+struct fast5_read_claim {
+    struct fast5_file *file;
+    size_t idx;
+    struct fast5_read read;
+};
+
+struct fast5_reader *make_fast5_reader(char *const *paths);
+struct fast5_reader *free_fast5_reader(struct fast5_reader *reader);
+bool claim_fast5_read(struct fast5_reader *reader, struct fast5_read_claim *claim);
+bool finish_fast5_read(struct fast5_read_claim *claim, struct fast5_read *read);
+bool next_fast5_read(struct fast5_reader *reader, struct fast5_read *read);
 
 void write_annotated_events(hid_t hdf5file, const char *readname,
                             const event_table ev, hsize_t chunk_size,
                             int compression_level);
 void write_annotated_raw(hid_t hdf5file, const char *readname,
-                         const raw_table rt, hsize_t chunk_size,
+                         const daq_table dt, hsize_t chunk_size,
                          int compression_level);
+daq_table read_annotated_raw(hid_t hdf5file, const char *readname);
 
 #endif                          /* EVENTS_H */
@@ -0,0 +1,343 @@
+#define _DEFAULT_SOURCE 1
+#include <err.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "io_batch.h"
+#include "scrappie_stdlib.h"
+
+#ifdef HAVE_IO_URING
+#    include <linux/io_uring.h>
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#endif
+
+//  Longest single read.  Reads of io_uring are at most 32 bits long, and
+// longer requests carry on from where the previous read stopped.
+#define IO_BATCH_MAX_READ ((size_t)1 << 30)
+
+static size_t request_length(const struct io_request *req) {
+    const size_t remaining = req->nbyte - req->nread;
+    return (remaining < IO_BATCH_MAX_READ) ? remaining : IO_BATCH_MAX_READ;
+}
+
+//  Read request by pread until it is complete, the end of the file is reached
+// or reading fails
+static void pread_request(int fd, struct io_request *req) {
+    while ((size_t)req->nread < req->nbyte) {
+        const ssize_t ret = pread(fd, (char *)req->buf + req->nread, request_length(req),
+                                  req->offset + req->nread);
+        if (ret < 0 && EINTR == errno) {
+            continue;
+        }
+        if (ret < 0) {
+            req->nread = -errno;
+            return;
+        }
+        if (0 == ret) {
+            return;
+        }
+        req->nread += ret;
+    }
+}
+
+
+#ifdef HAVE_IO_URING
+static void teardown_uring(struct io_batch *batch) {
+    if (NULL != batch->sqes) {
+        munmap(batch->sqes, batch->sqes_size);
+    }
+    if (NULL != batch->cq_map && batch->cq_map != batch->sq_map) {
+        munmap(batch->cq_map, batch->cq_map_size);
+    }
+    if (NULL != batch->sq_map) {
+        munmap(batch->sq_map, batch->sq_map_size);
+    }
+    if (batch->ring_fd >= 0) {
+        close(batch->ring_fd);
+    }
+    batch->sqes = batch->cq_map = batch->sq_map = NULL;
+    batch->ring_fd = -1;
+}
+
+//  Map memory shared with the kernel, giving NULL on failure
+static void *map_ring(int ring_fd, size_t size, off_t offset) {
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+    return (MAP_FAILED == map) ? NULL : map;
+}
+
+/**  Set up io_uring for batch
+ *
+ *   Failure is expected where io_uring is not permitted, so is not warned of.
+ *
+ *   @returns true on success
+ **/
+static bool setup_uring(struct io_batch *batch) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    batch->ring_fd = (int)syscall(__NR_io_uring_setup, (unsigned)batch->depth, &params);
+    if (batch->ring_fd < 0) {
+        return false;
+    }
+
+    batch->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    batch->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    batch->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        //  Both rings share a single mapping
+        if (batch->cq_map_size > batch->sq_map_size) {
+            batch->sq_map_size = batch->cq_map_size;
+        }
+        batch->sq_map = map_ring(batch->ring_fd, batch->sq_map_size, IORING_OFF_SQ_RING);
+        batch->cq_map = batch->sq_map;
+    } else {
+        batch->sq_map = map_ring(batch->ring_fd, batch->sq_map_size, IORING_OFF_SQ_RING);
+        batch->cq_map = map_ring(batch->ring_fd, batch->cq_map_size, IORING_OFF_CQ_RING);
+    }
+    batch->sqes = map_ring(batch->ring_fd, batch->sqes_size, IORING_OFF_SQES);
+    if (NULL == batch->sq_map || NULL == batch->cq_map || NULL == batch->sqes) {
+        teardown_uring(batch);
+        return false;
+    }
+
+    unsigned char *sq = batch->sq_map;
+    unsigned char *cq = batch->cq_map;
+    batch->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    batch->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    batch->sq_array = (unsigned *)(sq + params.sq_off.array);
+    batch->cq_head = (unsigned *)(cq + params.cq_off.head);
+    batch->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    batch->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    batch->cqes = cq + params.cq_off.cqes;
+    return true;
+}
+
+/**  Queue read of the remainder of request on the submission ring
+ *
+ *   There is always room on the ring, since it has at least depth entries.
+ **/
+static void queue_request(struct io_batch *batch, size_t slot) {
+    const struct io_request *req = batch->request + slot;
+    //  Only this thread writes the tail
+    const unsigned tail = *batch->sq_tail;
+    const unsigned idx = tail & *batch->sq_mask;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *)batch->sqes + idx;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = batch->fd;
+    sqe->off = req->offset + req->nread;
+    sqe->addr = (uintptr_t) ((char *)req->buf + req->nread);
+    sqe->len = request_length(req);
+    sqe->user_data = slot;
+    batch->sq_array[idx] = idx;
+    __atomic_store_n(batch->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    batch->nqueued += 1;
+    batch->ninring += 1;
+}
+
+/**  Submit queued requests and, optionally, wait for a completion
+ *
+ *   @returns true on success
+ **/
+static bool enter_uring(struct io_batch *batch, bool wait) {
+    while (true) {
+        const int ret = (int)syscall(__NR_io_uring_enter, batch->ring_fd, batch->nqueued,
+                                     wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (ret >= 0) {
+            batch->nqueued -= ret;
+            return true;
+        }
+        if (EINTR != errno) {
+            warnx("Failed to submit reads to io_uring: %s", strerror(errno));
+            return false;
+        }
+    }
+}
+
+/**  Take completions from the completion ring
+ *
+ *   Requests that are complete, or failed, are moved to the stack of those
+ *   done.  Requests that read short are queued again for the remainder,
+ *   unless the end of the file was reached.
+ **/
+static void reap_uring(struct io_batch *batch) {
+    unsigned head = *batch->cq_head;
+    const unsigned tail = __atomic_load_n(batch->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *cqe = (const struct io_uring_cqe *)batch->cqes
+            + (head & *batch->cq_mask);
+        const size_t slot = cqe->user_data;
+        const int res = cqe->res;
+        struct io_request *req = batch->request + slot;
+        batch->ninring -= 1;
+
+        if (-EINVAL == res && 0 == req->nread) {
+            //  Kernel predates reads by io_uring, so read this and later requests by pread
+            batch->use_uring = false;
+            pread_request(batch->fd, req);
+        } else if (res < 0) {
+            req->nread = res;
+        } else {
+            req->nread += res;
+            if (res > 0 && (size_t)req->nread < req->nbyte) {
+                queue_request(batch, slot);
+                continue;
+            }
+        }
+        batch->done_slot[batch->ndone++] = slot;
+    }
+    __atomic_store_n(batch->cq_head, head, __ATOMIC_RELEASE);
+}
+#endif
+
+
+/**  Create batch of reads from file
+ *
+ *   @param fd File descriptor of file to read from, which remains owned by
+ *   the caller
+ *   @param depth Maximum number of reads in flight at once
+ *   @param use_uring Whether to read by io_uring, if it is available
+ *
+ *   @returns Batch or NULL on failure
+ **/
+struct io_batch *make_io_batch(int fd, size_t depth, bool use_uring) {
+    RETURN_NULL_IF(fd < 0, NULL);
+    RETURN_NULL_IF(0 == depth, NULL);
+    struct io_batch *batch = calloc(1, sizeof(struct io_batch));
+    RETURN_NULL_IF(NULL == batch, NULL);
+    batch->fd = fd;
+    batch->depth = depth;
+    batch->ring_fd = -1;
+    batch->request = calloc(depth, sizeof(struct io_request));
+    batch->free_slot = calloc(depth, sizeof(size_t));
+    batch->done_slot = calloc(depth, sizeof(size_t));
+    if (NULL == batch->request || NULL == batch->free_slot || NULL == batch->done_slot) {
+        return free_io_batch(batch);
+    }
+    for (size_t i = 0; i < depth; i++) {
+        batch->free_slot[i] = depth - 1 - i;
+    }
+    batch->nfree = depth;
+
+#ifdef HAVE_IO_URING
+    batch->use_uring = use_uring && setup_uring(batch);
+#endif
+    return batch;
+}
+
+/**  Free batch
+ *
+ *   Waits for reads still in flight, so their buffers may be freed once the
+ *   batch has been.
+ *
+ *   @returns NULL
+ **/
+struct io_batch *free_io_batch(struct io_batch *batch) {
+    if (NULL == batch) {
+        return NULL;
+    }
+#ifdef HAVE_IO_URING
+    while (batch->ninring > 0 && enter_uring(batch, true)) {
+        reap_uring(batch);
+    }
+    teardown_uring(batch);
+#endif
+    free(batch->done_slot);
+    free(batch->free_slot);
+    free(batch->request);
+    free(batch);
+    return NULL;
+}
+
+/**  Submit read
+ *
+ *   With io_uring, the read is queued until the batch is next flushed or
+ *   waited on; otherwise it is read immediately.
+ *
+ *   @param batch Batch
+ *   @param buf [out] Buffer to read into, of at least nbyte bytes, which
+ *   must not be freed until the read has been waited for
+ *   @param nbyte Number of bytes to read
+ *   @param offset Offset in file to read from
+ *   @param tag Tag identifying read, returned when it completes
+ *
+ *   @returns true on success, false if depth reads are already in flight
+ **/
+bool io_batch_submit(struct io_batch *batch, void *buf, size_t nbyte, uint64_t offset,
+                     uint64_t tag) {
+    RETURN_NULL_IF(NULL == batch, false);
+    RETURN_NULL_IF(NULL == buf && nbyte > 0, false);
+    if (0 == batch->nfree) {
+        return false;
+    }
+
+    const size_t slot = batch->free_slot[--batch->nfree];
+    batch->request[slot] = (struct io_request) {buf, nbyte, offset, 0, tag};
+#ifdef HAVE_IO_URING
+    if (batch->use_uring && nbyte > 0) {
+        queue_request(batch, slot);
+        return true;
+    }
+#endif
+    pread_request(batch->fd, batch->request + slot);
+    batch->done_slot[batch->ndone++] = slot;
+    return true;
+}
+
+/**  Submit reads queued, without waiting for any to complete
+ *
+ *   @returns true on success
+ **/
+bool io_batch_flush(struct io_batch *batch) {
+    RETURN_NULL_IF(NULL == batch, false);
+#ifdef HAVE_IO_URING
+    if (batch->nqueued > 0) {
+        return enter_uring(batch, false);
+    }
+#endif
+    return true;
+}
+
+/**  Wait for a read to complete
+ *
+ *   Reads queued are submitted first.  Reads complete in any order.
+ *
+ *   @param batch Batch
+ *   @param tag [out] Tag of read
+ *   @param nread [out] Number of bytes read, fewer than requested if the end
+ *   of the file was reached, or negative errno if reading failed
+ *
+ *   @returns true if a read completed, false if no reads are in flight or
+ *   waiting failed
+ **/
+bool io_batch_wait(struct io_batch *batch, uint64_t * tag, ssize_t * nread) {
+    RETURN_NULL_IF(NULL == batch, false);
+    RETURN_NULL_IF(NULL == tag, false);
+    RETURN_NULL_IF(NULL == nread, false);
+
+#ifdef HAVE_IO_URING
+    while (0 == batch->ndone && batch->ninring > 0) {
+        reap_uring(batch);
+        if (0 == batch->ndone && !enter_uring(batch, true)) {
+            return false;
+        }
+    }
+#endif
+    if (0 == batch->ndone) {
+        return false;
+    }
+
+    const size_t slot = batch->done_slot[--batch->ndone];
+    *tag = batch->request[slot].tag;
+    *nread = batch->request[slot].nread;
+    batch->free_slot[batch->nfree++] = slot;
+    return true;
+}
+
+/**  Number of reads submitted but not yet waited for
+ **/
+size_t io_batch_inflight(const struct io_batch *batch) {
+    RETURN_NULL_IF(NULL == batch, 0);
+    return batch->depth - batch->nfree;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#ifndef IO_BATCH_H
+#    define IO_BATCH_H
+
+#    include <stdbool.h>
+#    include <stddef.h>
+#    include <stdint.h>
+#    include <sys/types.h>
+
+/*  Batch of positional reads from a file, many in flight at once.
+ *
+ *  Reads are queued by io_batch_submit and handed to the kernel together,
+ *  by a single io_uring_enter, the next time io_batch_flush or io_batch_wait
+ *  is called, so a deep queue of reads costs few system calls.  Where
+ *  io_uring is unavailable, at build time or when the kernel refuses to set
+ *  up a ring, each read is made by pread as it is submitted.
+ */
+
+struct io_request {
+    void *buf;
+    size_t nbyte;
+    uint64_t offset;
+    //  Bytes read so far, or negative errno on failure
+    ssize_t nread;
+    uint64_t tag;
+};
+
+struct io_batch {
+    int fd;
+    size_t depth;
+    bool use_uring;
+    //  Requests, with stack of those free and of those complete but not yet
+    // waited for.  The two stacks share no slot, so each needs depth entries.
+    struct io_request *request;
+    size_t *free_slot;
+    size_t nfree;
+    size_t *done_slot;
+    size_t ndone;
+    //  Rings shared with the kernel, when io_uring is used, number of
+    // requests queued on the submission ring but not yet submitted and number
+    // of requests whose completion has yet to be taken from the rings
+    int ring_fd;
+    void *sq_map;
+    size_t sq_map_size;
+    void *cq_map;
+    size_t cq_map_size;
+    void *sqes;
+    size_t sqes_size;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    void *cqes;
+    unsigned nqueued;
+    size_t ninring;
+};
+
+struct io_batch *make_io_batch(int fd, size_t depth, bool use_uring);
+struct io_batch *free_io_batch(struct io_batch *batch);
+bool io_batch_submit(struct io_batch *batch, void *buf, size_t nbyte, uint64_t offset,
+                     uint64_t tag);
+bool io_batch_flush(struct io_batch *batch);
+bool io_batch_wait(struct io_batch *batch, uint64_t * tag, ssize_t * nread);
+size_t io_batch_inflight(const struct io_batch *batch);
+
+#endif                          /* IO_BATCH_H */
@@ -5,21 +5,43 @@
 #endif
 #include <math.h>
 #include "layers.h"
+#include "precision.h"
+#include "specialised_kernels.h"
 #include "scrappie_stdlib.h"
 #include "util.h"
 
+//  Vectors of a column exponentiated at once by the unfloored log-softmax
+#define LOGSOFTMAX_BUFFER 64
+
+/**  Weights with their converted versions resolved
+ *
+ *  Recurrent layers resolve their weights once, so the kernels applied at
+ *  each step need not search the registry of converted weights.  Weights
+ *  already resolved, as by a network graph when its layers are built, are
+ *  returned as they are.
+ *
+ *  @param W Weights
+ *  @param header [out] Storage for copy of header of W
+ *  @param converted [out] Storage for converted versions of W
+ *
+ *  @returns W, or header pointing to converted
+ **/
+static const_scrappie_matrix resolved_weights(const_scrappie_matrix W, _Mat * header,
+                                              struct scrappie_weights * converted) {
+    if (NULL != W->converted) {
+        return W;
+    }
+    *header = resolve_weights(W, converted);
+    return header;
+}
+
 /**  Apply tanh to a matrix element-wise
  *  @param C Matrix
  *
  **/
 void tanh_activation_inplace(scrappie_matrix C) {
     RETURN_NULL_IF(NULL == C, );
-    for (int c = 0; c < C->nc; ++c) {
-        const size_t offset = c * C->nrq;
-        for (int r = 0; r < C->nrq; ++r) {
-            C->data.v[offset + r] = TANHFV(C->data.v[offset + r]);
-        }
-    }
+    tanh_arrayf(C->data.f, C->nrq * 4 * C->nc);
     (void)validate_scrappie_matrix(C, -1.0, 1.0, 0.0, true, __FILE__, __LINE__);
 }
 
@@ -29,12 +51,7 @@ void tanh_activation_inplace(scrappie_matrix C) {
  **/
 void exp_activation_inplace(scrappie_matrix C) {
     RETURN_NULL_IF(NULL == C, );
-    for (int c = 0; c < C->nc; ++c) {
-        const size_t offset = c * C->nrq;
-        for (int r = 0; r < C->nrq; ++r) {
-            C->data.v[offset + r] = EXPFV(C->data.v[offset + r]);
-        }
-    }
+    exp_arrayf(C->data.f, C->nrq * 4 * C->nc);
     (void)validate_scrappie_matrix(C, 0.0, INFINITY, 1.0, true, __FILE__,
                                    __LINE__);
 }
@@ -45,12 +62,7 @@ void exp_activation_inplace(scrappie_matrix C) {
  **/
 void log_activation_inplace(scrappie_matrix C) {
     RETURN_NULL_IF(NULL == C, );
-    for (int c = 0; c < C->nc; ++c) {
-        const size_t offset = c * C->nrq;
-        for (int r = 0; r < C->nrq; ++r) {
-            C->data.v[offset + r] = LOGFV(C->data.v[offset + r]);
-        }
-    }
+    log_arrayf(C->data.f, C->nrq * 4 * C->nc);
 }
 
 /**  Apply ELU activation function to a matrix element-wise
@@ -59,12 +71,7 @@ void log_activation_inplace(scrappie_matrix C) {
  **/
 void elu_activation_inplace(scrappie_matrix C) {
     RETURN_NULL_IF(NULL == C, );
-    for (int c = 0; c < C->nc; ++c) {
-        const size_t offset = c * C->nrq;
-        for (int r = 0; r < C->nrq; ++r) {
-            C->data.v[offset + r] = ELUFV(C->data.v[offset + r]);
-        }
-    }
+    elu_arrayf(C->data.f, C->nrq * 4 * C->nc);
 }
 
 /** Apply robost log activation
@@ -87,10 +94,10 @@ void robustlog_activation_inplace(scrappie_matrix C, float min_prob) {
     for (int i = 0; i < nblock; i++) {
         const size_t offset = i * C->nrq;
         for (int r = 0; r < C->nrq; r++) {
-            C->data.v[offset + r] =
-                LOGFV(mpv + mpvm1 * C->data.v[offset + r]);
+            C->data.v[offset + r] = mpv + mpvm1 * C->data.v[offset + r];
         }
     }
+    log_arrayf(C->data.f, C->nrq * 4 * nblock);
 }
 
 
@@ -144,6 +151,38 @@ scrappie_matrix window(const_scrappie_matrix input, int w, int stride) {
     return output;
 }
 
+/**  Convolution using int8 weights
+ *
+ *   Each window of the input is gathered, zero padded at the edges, and
+ *   multiplied by the filters.
+ *
+ *   @param X Input matrix
+ *   @param qW Quantised filters, [winlen * X->nrq * 4, nfilter]
+ *   @param winlen Length of window
+ *   @param stride Stride of convolution
+ *   @param C Output matrix, containing bias on entry
+ **/
+static void qconvolution(const_scrappie_matrix X, const_scrappie_qmatrix qW,
+                         int winlen, int stride, scrappie_matrix C) {
+    const int padL = (winlen - 1) / 2;
+    const size_t ldX = X->nrq * 4;
+    assert(winlen * ldX == qW->nr);
+    float window[qW->nr];
+
+    for (int i = 0; i < C->nc; i++) {
+        const int start = i * stride - padL;
+        for (int w = 0; w < winlen; w++) {
+            const int col = start + w;
+            if (col >= 0 && col < X->nc) {
+                memcpy(window + w * ldX, X->data.f + col * ldX, ldX * sizeof(float));
+            } else {
+                memset(window + w * ldX, 0, ldX * sizeof(float));
+            }
+        }
+        qgemv(qW, window, C->data.f + i * C->nrq * 4);
+    }
+}
+
 /**  Convolution of the input data
  *  @param X Input data matrix (features x nobs)
  *  @param W Filter matrix (winlen * features x nfilter)
@@ -171,8 +210,19 @@ scrappie_matrix convolution(const_scrappie_matrix X, const_scrappie_matrix W,
     const int padL = (winlen - 1) / 2;
     const int padR = winlen / 2;
     const int ncolC = iceil(X->nc, stride);
+    //  Filters are small, so 16 bit filters are widened once per call
+    scrappie_matrix Wwide = NULL;
+    const_scrappie_hmatrix hW = get_half_weights(W);
+    if (NULL != hW) {
+        Wwide = widen_scrappie_hmatrix(hW);
+        RETURN_NULL_IF(NULL == Wwide, NULL);
+        W = Wwide;
+    }
     C = remake_scrappie_matrix(C, nfilter, ncolC);
-    RETURN_NULL_IF(NULL == C, NULL);
+    if (NULL == C) {
+        Wwide = free_scrappie_matrix(Wwide);
+        return NULL;
+    }
 
     // Matrix strides
     const int ldC = C->nrq * 4;
@@ -185,10 +235,22 @@ scrappie_matrix convolution(const_scrappie_matrix X, const_scrappie_matrix W,
         memcpy(C->data.v + i * C->nrq, b->data.v, C->nrq * sizeof(__m128));
     }
 
+    const_scrappie_qmatrix qW = get_int8_weights(W);
+    if (NULL != qW) {
+        qconvolution(X, qW, winlen, stride, C);
+        return C;
+    }
+
+    const_scrappie_pmatrix pW = get_packed_weights(W);
+
     // Left-hand side edge case where only part of the filter covers the input
     for (int w = 0; w < padL; w += stride) {
         const int offsetW = ldFeature * (padL - w);
         const int ncol = w / stride;
+        if (NULL != pW) {
+            pgemv(pW, offsetW, W->nr - offsetW, X->data.f, C->data.f + ldC * ncol);
+            continue;
+        }
         cblas_sgemv(CblasColMajor, CblasTrans, W->nr - offsetW, W->nc,
                     1.0, W->data.f + offsetW, ldW,
                     X->data.f, 1, 1.0, C->data.f + ldC * ncol, 1);
@@ -216,6 +278,14 @@ scrappie_matrix convolution(const_scrappie_matrix X, const_scrappie_matrix W,
         //
         const int ncol_processed = ifloor(X->nc - shiftX_L - w, nstepX);
         const int initial_col = ifloor(w, stride);
+        if (NULL != pW) {
+            if (ncol_processed > 0) {
+                pgemm(pW, 0, W->nr, X->data.f + ldX * w + offsetX_L,
+                      ldX * nstepX, ncol_processed,
+                      C->data.f + ldC * initial_col + offsetC_L, ldC * nstepC);
+            }
+            continue;
+        }
         cblas_sgemm(CblasColMajor, CblasTrans, CblasNoTrans, W->nc,
                     ncol_processed, W->nr, 1.0, W->data.f, ldW,
                     X->data.f + ldX * w + offsetX_L, ldX * nstepX, 1.0,
@@ -233,11 +303,17 @@ scrappie_matrix convolution(const_scrappie_matrix X, const_scrappie_matrix W,
     const int startR = stride - (padL + X->nc - winlen) % stride - 1;
     for (int w = startR; w < padR; w += stride) {
         const int offsetW = ldFeature * (w + 1);
+        if (NULL != pW) {
+            pgemv(pW, 0, W->nr - offsetW, X->data.f + offsetX_R + ldX * w,
+                  C->data.f + offsetC_R + ldC * (w / stride));
+            continue;
+        }
         cblas_sgemv(CblasColMajor, CblasTrans, W->nr - offsetW, W->nc, 1.0,
                     W->data.f, ldW,
                     X->data.f + offsetX_R + ldX * w, 1, 1.0,
                     C->data.f + offsetC_R + ldC * (w / stride), 1);
     }
+    Wwide = free_scrappie_matrix(Wwide);
 
     assert(validate_scrappie_matrix
            (C, NAN, NAN, 0.0, true, __FILE__, __LINE__));
@@ -329,6 +405,110 @@ scrappie_matrix softmax(const_scrappie_matrix X, const_scrappie_matrix W,
     return C;
 }
 
+/**  Apply robust log-softmax to each column of a matrix
+ *
+ *  Equivalent to exp_activation_inplace, row_normalise_inplace and then
+ *  robustlog_activation_inplace but works column by column so that each column
+ *  is only brought into cache once.  Within a column, the maximum is found and
+ *  then the log-sum-exp is accumulated before the final floored
+ *  log-probabilities are written back.
+ *
+ *  When min_prob is zero, the result is the plain log-softmax and no
+ *  exponentiation or logarithm of individual elements is stored.  Both cases
+ *  use the exponential and logarithm of the current approximation level.
+ *
+ *  @param C Matrix
+ *  @param min_prob  Minimum probability
+ **/
+void logsoftmax_activation_inplace(scrappie_matrix C, float min_prob) {
+    assert(min_prob >= 0.0);
+    assert(min_prob <= 1.0);
+    RETURN_NULL_IF(NULL == C, );
+
+    const int nrq = C->nrq;
+    //  Mask out padding in final vector of each column
+    const int npad = nrq * 4 - C->nr;
+    const __m128 padmask = _mm_cmpgt_ps(_mm_set_ps(npad >= 1, npad >= 2, npad >= 3, 0),
+                                        _mm_setzero_ps());
+    const __m128 neginf = _mm_set1_ps(-INFINITY);
+    const __m128 mpv = _mm_set1_ps(min_prob);
+    const __m128 mpvm1 = _mm_set1_ps(1.0f - min_prob);
+    const bool floored = (min_prob > 0.0f);
+
+    for (int c = 0; c < C->nc; c++) {
+        __m128 * col = C->data.v + c * nrq;
+
+        __m128 vmax = _mm_or_ps(_mm_and_ps(padmask, neginf),
+                                _mm_andnot_ps(padmask, col[nrq - 1]));
+        for (int r = 0; r < nrq - 1; r++) {
+            vmax = _mm_max_ps(vmax, col[r]);
+        }
+        const __m128 cmax = _mm_set1_ps(hmaxfv(vmax));
+
+        __m128 vsum = _mm_setzero_ps();
+        if (floored) {
+            for (int r = 0; r < nrq; r++) {
+                col[r] -= cmax;
+            }
+            exp_arrayf((float *)col, nrq * 4);
+            for (int r = 0; r < nrq - 1; r++) {
+                vsum += col[r];
+            }
+            vsum += _mm_andnot_ps(padmask, col[nrq - 1]);
+
+            const __m128 scale = mpvm1 / _mm_set1_ps(hsumfv(vsum));
+            for (int r = 0; r < nrq; r++) {
+                col[r] = mpv + scale * col[r];
+            }
+            log_arrayf((float *)col, nrq * 4);
+        } else {
+            //  Exponentials are summed from a small buffer so the column is kept
+            __m128 e[LOGSOFTMAX_BUFFER];
+            for (int r0 = 0; r0 < nrq; r0 += LOGSOFTMAX_BUFFER) {
+                const int n = (nrq - r0 < LOGSOFTMAX_BUFFER) ? (nrq - r0) : LOGSOFTMAX_BUFFER;
+                for (int r = 0; r < n; r++) {
+                    e[r] = col[r0 + r] - cmax;
+                }
+                exp_arrayf((float *)e, n * 4);
+                for (int r = 0; r < n; r++) {
+                    vsum += (r0 + r < nrq - 1) ? e[r] : _mm_andnot_ps(padmask, e[r]);
+                }
+            }
+            float lsum = hsumfv(vsum);
+            log_arrayf(&lsum, 1);
+            const __m128 lse = cmax + _mm_set1_ps(lsum);
+            for (int r = 0; r < nrq; r++) {
+                col[r] -= lse;
+            }
+        }
+    }
+}
+
+/**  Affine map followed by a robust log-softmax
+ *
+ *  Fused replacement for softmax followed by robustlog_activation_inplace.
+ *
+ *  @param X Input matrix
+ *  @param W Weight matrix
+ *  @param b Bias vector
+ *  @param min_prob  Minimum probability
+ *  @param C Matrix for output or NULL
+ *
+ *  @return Matrix of (floored) log-probabilities
+ **/
+scrappie_matrix logsoftmax(const_scrappie_matrix X, const_scrappie_matrix W,
+                           const_scrappie_matrix b, float min_prob,
+                           scrappie_matrix C) {
+    C = affine_map(X, W, b, C);
+    RETURN_NULL_IF(NULL == C, NULL);
+
+    logsoftmax_activation_inplace(C, min_prob);
+
+    assert(validate_scrappie_matrix
+           (C, NAN, NAN, NAN, true, __FILE__, __LINE__));
+    return C;
+}
+
 scrappie_matrix feedforward2_tanh(const_scrappie_matrix Xf,
                                   const_scrappie_matrix Xb,
                                   const_scrappie_matrix Wf,
@@ -358,13 +538,23 @@ scrappie_matrix gru_forward(const_scrappie_matrix X, const_scrappie_matrix sW,
     assert(sW->nc == 2 * size);
     assert(sW2->nc == size);
 
+    //  Converted weights are found once rather than at every step
+    _Mat sWh, sW2h;
+    struct scrappie_weights sWc, sW2c;
+    sW = resolved_weights(sW, &sWh, &sWc);
+    sW2 = resolved_weights(sW2, &sW2h, &sW2c);
+
+    //  Output given by caller, which may be a view of memory it owns
+    const scrappie_matrix ostate_in = ostate;
     ostate = remake_scrappie_matrix(ostate, size, bsize);
     RETURN_NULL_IF(NULL == ostate, NULL);
 
     scrappie_matrix tmp = make_scrappie_matrix(3 * size, 1);
     if(NULL == tmp){
         //  Memory allocation falled, clean-up and return
-        free(ostate);
+        if (ostate != ostate_in) {
+            free_scrappie_matrix(ostate);
+        }
         return NULL;
     }
 
@@ -406,13 +596,23 @@ scrappie_matrix gru_backward(const_scrappie_matrix X, const_scrappie_matrix sW,
     assert(sW->nc == 2 * size);
     assert(sW2->nc == size);
 
+    //  Converted weights are found once rather than at every step
+    _Mat sWh, sW2h;
+    struct scrappie_weights sWc, sW2c;
+    sW = resolved_weights(sW, &sWh, &sWc);
+    sW2 = resolved_weights(sW2, &sW2h, &sW2c);
+
+    //  Output given by caller, which may be a view of memory it owns
+    const scrappie_matrix ostate_in = ostate;
     ostate = remake_scrappie_matrix(ostate, size, bsize);
     RETURN_NULL_IF(NULL == ostate, NULL);
 
     scrappie_matrix tmp = make_scrappie_matrix(3 * size, 1);
     if(NULL == tmp){
         //  Memory allocation falled, clean-up and return
-        free(ostate);
+        if (ostate != ostate_in) {
+            free_scrappie_matrix(ostate);
+        }
         return NULL;
     }
 
@@ -442,6 +642,205 @@ scrappie_matrix gru_backward(const_scrappie_matrix X, const_scrappie_matrix sW,
     return ostate;
 }
 
+/**  Forward GRU layer with time-tiled input projection
+ *
+ *  Equivalent to gru_forward(feedforward_linear(X, iW, b, NULL), sW, sW2, ostate)
+ *  but the input projection is computed for blocks of `tile` columns just
+ *  before the recurrence reaches them, while the block is still in cache.  A
+ *  single tile buffer is reused so the full [3 * size, nblock] matrix of
+ *  projected inputs is never stored.
+ *
+ *  @param X Input to layer [nfeature, nblock]
+ *  @param iW Input weights [nfeature, 3 * size]
+ *  @param b Bias [3 * size]
+ *  @param sW Recurrent weights for gates [size, 2 * size]
+ *  @param sW2 Recurrent weights for hidden state [size, size]
+ *  @param tile Number of columns per tile. If not positive, a single tile
+ *  covering the whole input is used.
+ *  @param ostate Matrix for output or NULL
+ *
+ *  @returns Output of layer [size, nblock]
+ **/
+scrappie_matrix gru_forward_tiled(const_scrappie_matrix X, const_scrappie_matrix iW,
+                                  const_scrappie_matrix b, const_scrappie_matrix sW,
+                                  const_scrappie_matrix sW2, int tile,
+                                  scrappie_matrix ostate) {
+    RETURN_NULL_IF(NULL == X, NULL);
+    assert(NULL != iW);
+    assert(NULL != b);
+    assert(NULL != sW);
+    assert(NULL != sW2);
+
+    const int bsize = X->nc;
+    const int size = sW2->nc;
+    assert(iW->nr == X->nr);
+    assert(iW->nc == 3 * size);
+    assert(sW->nr == size);
+    assert(sW2->nr == size);
+    assert(sW->nc == 2 * size);
+    assert(sW2->nc == size);
+    if (tile <= 0 || tile > bsize) {
+        tile = bsize;
+    }
+
+    //  Converted weights are found once rather than for every tile or step
+    _Mat iWh, sWh, sW2h;
+    struct scrappie_weights iWc, sWc, sW2c;
+    iW = resolved_weights(iW, &iWh, &iWc);
+    sW = resolved_weights(sW, &sWh, &sWc);
+    sW2 = resolved_weights(sW2, &sW2h, &sW2c);
+
+    //  Output given by caller, which may be a view of memory it owns
+    const scrappie_matrix ostate_in = ostate;
+    ostate = remake_scrappie_matrix(ostate, size, bsize);
+    RETURN_NULL_IF(NULL == ostate, NULL);
+
+    scrappie_matrix xtile = make_scrappie_matrix(3 * size, tile);
+    scrappie_matrix tmp = make_scrappie_matrix(3 * size, 1);
+    scrappie_matrix zero = make_scrappie_matrix(size, 1);
+    if (NULL == xtile || NULL == tmp || NULL == zero) {
+        //  Memory allocation failed, clean-up and return
+        free_scrappie_matrix(zero);
+        free_scrappie_matrix(tmp);
+        free_scrappie_matrix(xtile);
+        if (ostate != ostate_in) {
+            free_scrappie_matrix(ostate);
+        }
+        return NULL;
+    }
+
+    _Mat xIn, xProj, xCol, sCol1, sCol2;
+    xIn = *X;
+    xProj = *xtile;
+    xCol = *xtile;
+    sCol1 = *ostate;
+    sCol2 = *ostate;
+    xCol.nc = sCol1.nc = sCol2.nc = 1;
+    bool ok = true;
+    for (int t0 = 0; t0 < bsize; t0 += tile) {
+        //  Project next tile of input
+        xIn.nc = xProj.nc = (bsize - t0 < tile) ? (bsize - t0) : tile;
+        xIn.data.v = X->data.v + t0 * X->nrq;
+        ok = (NULL != affine_map(&xIn, iW, b, &xProj));
+        if (!ok) {
+            break;
+        }
+
+        for (int i = 0; i < xProj.nc; i++) {
+            const int t = t0 + i;
+            xCol.data.v = xProj.data.v + i * xProj.nrq;
+            sCol1.data.v = (0 == t) ? zero->data.v : ostate->data.v + (t - 1) * ostate->nrq;
+            sCol2.data.v = ostate->data.v + t * ostate->nrq;
+            gru_step(&xCol, &sCol1, sW, sW2, tmp, &sCol2);
+        }
+    }
+
+    zero = free_scrappie_matrix(zero);
+    tmp = free_scrappie_matrix(tmp);
+    xtile = free_scrappie_matrix(xtile);
+    if (!ok) {
+        return (ostate != ostate_in) ? free_scrappie_matrix(ostate) : NULL;
+    }
+
+    assert(validate_scrappie_matrix
+           (ostate, -1.0, 1.0, 0.0, true, __FILE__, __LINE__));
+    return ostate;
+}
+
+/**  Backward GRU layer with time-tiled input projection
+ *
+ *  As gru_forward_tiled but the recurrence, and so the tiles, run from the
+ *  end of the input to the beginning.
+ *
+ *  @see gru_forward_tiled
+ **/
+scrappie_matrix gru_backward_tiled(const_scrappie_matrix X, const_scrappie_matrix iW,
+                                   const_scrappie_matrix b, const_scrappie_matrix sW,
+                                   const_scrappie_matrix sW2, int tile,
+                                   scrappie_matrix ostate) {
+    RETURN_NULL_IF(NULL == X, NULL);
+    assert(NULL != iW);
+    assert(NULL != b);
+    assert(NULL != sW);
+    assert(NULL != sW2);
+
+    const int bsize = X->nc;
+    const int size = sW2->nc;
+    assert(iW->nr == X->nr);
+    assert(iW->nc == 3 * size);
+    assert(sW->nr == size);
+    assert(sW2->nr == size);
+    assert(sW->nc == 2 * size);
+    assert(sW2->nc == size);
+    if (tile <= 0 || tile > bsize) {
+        tile = bsize;
+    }
+
+    //  Converted weights are found once rather than for every tile or step
+    _Mat iWh, sWh, sW2h;
+    struct scrappie_weights iWc, sWc, sW2c;
+    iW = resolved_weights(iW, &iWh, &iWc);
+    sW = resolved_weights(sW, &sWh, &sWc);
+    sW2 = resolved_weights(sW2, &sW2h, &sW2c);
+
+    //  Output given by caller, which may be a view of memory it owns
+    const scrappie_matrix ostate_in = ostate;
+    ostate = remake_scrappie_matrix(ostate, size, bsize);
+    RETURN_NULL_IF(NULL == ostate, NULL);
+
+    scrappie_matrix xtile = make_scrappie_matrix(3 * size, tile);
+    scrappie_matrix tmp = make_scrappie_matrix(3 * size, 1);
+    scrappie_matrix zero = make_scrappie_matrix(size, 1);
+    if (NULL == xtile || NULL == tmp || NULL == zero) {
+        //  Memory allocation failed, clean-up and return
+        free_scrappie_matrix(zero);
+        free_scrappie_matrix(tmp);
+        free_scrappie_matrix(xtile);
+        if (ostate != ostate_in) {
+            free_scrappie_matrix(ostate);
+        }
+        return NULL;
+    }
+
+    _Mat xIn, xProj, xCol, sCol1, sCol2;
+    xIn = *X;
+    xProj = *xtile;
+    xCol = *xtile;
+    sCol1 = *ostate;
+    sCol2 = *ostate;
+    xCol.nc = sCol1.nc = sCol2.nc = 1;
+    bool ok = true;
+    for (int t1 = bsize; t1 > 0; t1 -= tile) {
+        //  Project previous tile of input
+        const int t0 = (t1 > tile) ? (t1 - tile) : 0;
+        xIn.nc = xProj.nc = t1 - t0;
+        xIn.data.v = X->data.v + t0 * X->nrq;
+        ok = (NULL != affine_map(&xIn, iW, b, &xProj));
+        if (!ok) {
+            break;
+        }
+
+        for (int i = xProj.nc - 1; i >= 0; i--) {
+            const int t = t0 + i;
+            xCol.data.v = xProj.data.v + i * xProj.nrq;
+            sCol1.data.v = (bsize - 1 == t) ? zero->data.v : ostate->data.v + (t + 1) * ostate->nrq;
+            sCol2.data.v = ostate->data.v + t * ostate->nrq;
+            gru_step(&xCol, &sCol1, sW, sW2, tmp, &sCol2);
+        }
+    }
+
+    zero = free_scrappie_matrix(zero);
+    tmp = free_scrappie_matrix(tmp);
+    xtile = free_scrappie_matrix(xtile);
+    if (!ok) {
+        return (ostate != ostate_in) ? free_scrappie_matrix(ostate) : NULL;
+    }
+
+    assert(validate_scrappie_matrix
+           (ostate, -1.0, 1.0, 0.0, true, __FILE__, __LINE__));
+    return ostate;
+}
+
 void gru_step(const_scrappie_matrix x, const_scrappie_matrix istate,
               const_scrappie_matrix sW, const_scrappie_matrix sW2,
               scrappie_matrix xF, scrappie_matrix ostate) {
@@ -470,16 +869,36 @@ void gru_step(const_scrappie_matrix x, const_scrappie_matrix istate,
     assert(size == ostate->nr);
 
 
+    //  Whole step specialised to size of layer, when weights are packed
+    const_scrappie_pmatrix psW = get_packed_weights(sW);
+    const_scrappie_pmatrix psW2 = get_packed_weights(sW2);
+    const gru_step_kernel kernel = (NULL != psW && NULL != psW2) ? psW2->step_kernel : NULL;
+    if (NULL != kernel) {
+        kernel(x->data.f, istate->data.f, psW->data, psW2->data, xF->data.f, ostate->data.f);
+        return;
+    }
+
     // Copy input vector = iW x + b to temporary vector
     memcpy(xF->data.v, x->data.v, x->nrq * sizeof(__m128));
     /*  Add sW * istate to first 2 * size elts of xF
      *  then apply gate function to get r and z
      */
-    cblas_sgemv(CblasColMajor, CblasTrans, sW->nr, sW->nc, 1.0, sW->data.f,
-                sW->nrq * 4, istate->data.f, 1, 1.0, xF->data.f, 1);
-    for (int i = 0; i < (sizeq +sizeq); i++) {
-        xF->data.v[i] = LOGISTICFV(xF->data.v[i]);
+    const_scrappie_qmatrix qsW = get_int8_weights(sW);
+    const_scrappie_hmatrix hsW = get_half_weights(sW);
+    const_scrappie_smatrix ssW = get_sparse_weights(sW);
+    if (NULL != qsW) {
+        qgemv(qsW, istate->data.f, xF->data.f);
+    } else if (NULL != hsW) {
+        hgemv(hsW, istate->data.f, xF->data.f);
+    } else if (NULL != ssW) {
+        sgemv(ssW, istate->data.f, xF->data.f);
+    } else if (NULL != psW) {
+        pgemv(psW, 0, size, istate->data.f, xF->data.f);
+    } else {
+        cblas_sgemv(CblasColMajor, CblasTrans, sW->nr, sW->nc, 1.0, sW->data.f,
+                    sW->nrq * 4, istate->data.f, 1, 1.0, xF->data.f, 1);
     }
+    logistic_arrayf(xF->data.f, size + size);
 
     const __m128 *z = xF->data.v;
     __m128 *r = xF->data.v + sizeq;
@@ -487,11 +906,22 @@ void gru_step(const_scrappie_matrix x, const_scrappie_matrix istate,
     for (int i = 0; i < sizeq; i++) {
         r[i] *= istate->data.v[i];
     }
-    cblas_sgemv(CblasColMajor, CblasTrans, sW2->nr, sW2->nc, 1.0, sW2->data.f,
-                sW2->nrq * 4, (float *)r, 1, 1.0, (float *)hbar, 1);
-    for (int i = 0; i < sizeq; i++) {
-        hbar[i] = TANHFV(hbar[i]);
+    const_scrappie_qmatrix qsW2 = get_int8_weights(sW2);
+    const_scrappie_hmatrix hsW2 = get_half_weights(sW2);
+    const_scrappie_smatrix ssW2 = get_sparse_weights(sW2);
+    if (NULL != qsW2) {
+        qgemv(qsW2, (float *)r, (float *)hbar);
+    } else if (NULL != hsW2) {
+        hgemv(hsW2, (float *)r, (float *)hbar);
+    } else if (NULL != ssW2) {
+        sgemv(ssW2, (float *)r, (float *)hbar);
+    } else if (NULL != psW2) {
+        pgemv(psW2, 0, size, (float *)r, (float *)hbar);
+    } else {
+        cblas_sgemv(CblasColMajor, CblasTrans, sW2->nr, sW2->nc, 1.0, sW2->data.f,
+                    sW2->nrq * 4, (float *)r, 1, 1.0, (float *)hbar, 1);
     }
+    tanh_arrayf((float *)hbar, size);
 
     const __m128 ones = _mm_set1_ps(1.0f);
     for (int i = 0; i < sizeq ; i++) {
@@ -512,16 +942,22 @@ scrappie_matrix lstm_forward(const_scrappie_matrix Xaffine,
     assert(p->nr == 3 * size);
     assert(sW->nc == 4 * size);
 
+    //  Converted weights are found once rather than at every step
+    _Mat sWh;
+    struct scrappie_weights sWc;
+    sW = resolved_weights(sW, &sWh, &sWc);
+
+    //  Output given by caller, which may be a view of memory it owns
+    const scrappie_matrix output_in = output;
     output = remake_scrappie_matrix(output, size, bsize);
     RETURN_NULL_IF(NULL == output, NULL);
 
-    scrappie_matrix tmp = make_scrappie_matrix(4 * size, 1);
     scrappie_matrix state = make_scrappie_matrix(size, 1);
-    if(NULL == tmp || NULL == state){
+    if(NULL == state){
         //  Memory allocation falled, clean-up and return
-        free(state);
-        free(tmp);
-        free(output);
+        if (output != output_in) {
+            free_scrappie_matrix(output);
+        }
         return NULL;
     }
 
@@ -534,16 +970,15 @@ scrappie_matrix lstm_forward(const_scrappie_matrix Xaffine,
     xCol.nc = sCol1.nc = sCol2.nc = 1;
     sCol1.data.v = output->data.v + output->nrq;
     sCol2.data.v = output->data.v;
-    lstm_step(&xCol, &sCol1, sW, p, tmp, state, &sCol2);
+    lstm_step(&xCol, &sCol1, sW, p, state, &sCol2);
     for (int i = 1; i < bsize; i++) {
         xCol.data.v = Xaffine->data.v + i * Xaffine->nrq;
         sCol1.data.v = output->data.v + (i - 1) * output->nrq;
         sCol2.data.v = output->data.v + i * output->nrq;
-        lstm_step(&xCol, &sCol1, sW, p, tmp, state, &sCol2);
+        lstm_step(&xCol, &sCol1, sW, p, state, &sCol2);
     }
 
     state = free_scrappie_matrix(state);
-    state = free_scrappie_matrix(tmp);
 
     assert(validate_scrappie_matrix
            (output, -1.0, 1.0, 0.0, true, __FILE__, __LINE__));
@@ -563,16 +998,22 @@ scrappie_matrix lstm_backward(const_scrappie_matrix Xaffine,
     assert(sW->nc == 4 * size);
     assert(p->nr == 3 * size);
 
+    //  Converted weights are found once rather than at every step
+    _Mat sWh;
+    struct scrappie_weights sWc;
+    sW = resolved_weights(sW, &sWh, &sWc);
+
+    //  Output given by caller, which may be a view of memory it owns
+    const scrappie_matrix output_in = output;
     output = remake_scrappie_matrix(output, size, bsize);
     RETURN_NULL_IF(NULL == output, NULL);
 
-    scrappie_matrix tmp = make_scrappie_matrix(4 * size, 1);
     scrappie_matrix state = make_scrappie_matrix(size, 1);
-    if(NULL == tmp || NULL == state){
+    if(NULL == state){
         //  Memory allocation falled, clean-up and return
-        free(state);
-        free(tmp);
-        free(output);
+        if (output != output_in) {
+            free_scrappie_matrix(output);
+        }
         return NULL;
     }
 
@@ -586,80 +1027,139 @@ scrappie_matrix lstm_backward(const_scrappie_matrix Xaffine,
     xCol.data.v = Xaffine->data.v + (bsize - 1) * Xaffine->nrq;
     sCol1.data.v = output->data.v;
     sCol2.data.v = output->data.v + (bsize - 1) * output->nrq;
-    lstm_step(&xCol, &sCol1, sW, p, tmp, state, &sCol2);
+    lstm_step(&xCol, &sCol1, sW, p, state, &sCol2);
     for (int i = 1; i < bsize; i++) {
         const int index = bsize - i - 1;
         xCol.data.v = Xaffine->data.v + index * Xaffine->nrq;
         sCol1.data.v = output->data.v + (index + 1) * output->nrq;
         sCol2.data.v = output->data.v + index * output->nrq;
-        lstm_step(&xCol, &sCol1, sW, p, tmp, state, &sCol2);
+        lstm_step(&xCol, &sCol1, sW, p, state, &sCol2);
     }
 
     state = free_scrappie_matrix(state);
-    tmp = free_scrappie_matrix(tmp);
 
     assert(validate_scrappie_matrix
            (output, -1.0, 1.0, 0.0, true, __FILE__, __LINE__));
     return output;
 }
 
+/**  Dot product of a vector with four consecutive columns of a matrix
+ *
+ *  @param W First of the four columns
+ *  @param ldW Stride between columns of W, in vectors
+ *  @param x Vector
+ *  @param nrq Length of x, in vectors
+ *
+ *  @returns Vector containing the four dot products
+ **/
+static inline __m128 dot4_columns(const __m128 * W, size_t ldW,
+                                  const __m128 * x, size_t nrq) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    __m128 acc3 = _mm_setzero_ps();
+    for (size_t k = 0; k < nrq; k++) {
+        acc0 += W[k] * x[k];
+        acc1 += W[ldW + k] * x[k];
+        acc2 += W[2 * ldW + k] * x[k];
+        acc3 += W[3 * ldW + k] * x[k];
+    }
+    return _mm_hadd_ps(_mm_hadd_ps(acc0, acc1), _mm_hadd_ps(acc2, acc3));
+}
+
 void lstm_step(const_scrappie_matrix xAffine, const_scrappie_matrix out_prev,
                const_scrappie_matrix sW, const_scrappie_matrix peep,
-               scrappie_matrix xF, scrappie_matrix state,
-               scrappie_matrix output) {
+               scrappie_matrix state, scrappie_matrix output) {
     /* Perform a single LSTM step
-     * xAffine  is [isize] (== iW x + b, where x is the input to the LSTM layer)
+     * xAffine  is [4 * size] (== iW x + b, where x is the input to the LSTM layer)
      * out_prev is [size]
      * sW       is [size, 4 * size]
-     * peep     is [4 * size]
-     * xF       is [4 * size]
+     * peep     is [3 * size]
      * state    is [size]
      * output   is [size]
+     *
+     * The gates for each block of four units are accumulated in registers,
+     * reading the corresponding columns of sW directly rather than forming
+     * sW' * out_prev in a temporary vector, so sW is streamed once per step.
+     * The gate activations are then applied to all units at once, so they
+     * run at the full vector width of the machine.  When sW has been packed,
+     * the gates are instead accumulated onto xAffine panel by panel.
      */
     assert(NULL != xAffine);
     assert(NULL != out_prev);
     assert(NULL != sW);
     assert(NULL != peep);
-    assert(NULL != xF);
     assert(NULL != state);
     assert(NULL != output);
-    const int size = state->nr;
+    const size_t size = state->nr;
     assert(xAffine->nr == 4 * size);
     assert(size == out_prev->nr);
     assert(size == sW->nr);
     assert(4 * size == sW->nc);
     assert(3 * size == peep->nr);
-    assert(4 * size == xF->nr);
     assert(size == output->nr);
-
-    // Copy input vector = iW x + b to temporary vector
-    memcpy(xF->data.v, xAffine->data.v, xAffine->nrq * sizeof(__m128));
-    //  + sW' * xprev
-    cblas_sgemv(CblasColMajor, CblasTrans, sW->nr, sW->nc, 1.0, sW->data.f,
-                sW->nrq * 4, out_prev->data.f, 1, 1.0, xF->data.f, 1);
+    assert(1 == xAffine->nc);
+    assert(1 == out_prev->nc);
+    assert(1 == state->nc);
+    assert(1 == output->nc);
+    //  Output is updated while out_prev is still being read
+    assert(out_prev->data.v != output->data.v);
 
     assert(size % 4 == 0);  // Vectorisation assumes size divisible by 4
-    const int sizeq = size / 4;
-    for (int i = 0; i < sizeq; i++) {
-        // Forget gate
-        __m128 forget = LOGISTICFV(xF->data.v[2 * sizeq + i]
-                                   + state->data.v[i] * peep->data.v[sizeq + i])
-            * state->data.v[i];
-        // Update gate
-        __m128 update = LOGISTICFV(xF->data.v[sizeq + i]
-                                   + state->data.v[i] * peep->data.v[i])
-            * TANHFV(xF->data.v[i]);
-        state->data.v[i] = _mm_add_ps(forget, update);
-        // Output gate
-        output->data.v[i] = LOGISTICFV(xF->data.v[3 * sizeq + i]
-                                       +
-                                       state->data.v[i] * peep->data.v[2 *
-                                                                       sizeq +
-                                                                       i])
-            * TANHFV(state->data.v[i]);
+    const size_t sizeq = size / 4;
+    const size_t ldW = sW->nrq;
+    const __m128 * pupdate = peep->data.v;
+    const __m128 * pforget = peep->data.v + sizeq;
+    const __m128 * poutput = peep->data.v + 2 * sizeq;
+    const_scrappie_pmatrix psW = get_packed_weights(sW);
+    const __m128 * h = out_prev->data.v;
+
+    //  Gates for cell, update, forget and output, in that order
+    __m128 gate[4 * sizeq];
+    memcpy(gate, xAffine->data.v, 4 * sizeq * sizeof(__m128));
+    __m128 * cell = gate;
+    __m128 * update = cell + sizeq;
+    __m128 * forget = cell + 2 * sizeq;
+    __m128 * outgate = cell + 3 * sizeq;
+
+    if (NULL != psW) {
+        pgemm(psW, 0, size, out_prev->data.f, out_prev->nrq * 4, 1, (float *)gate,
+              4 * size);
+    } else {
+        for (size_t i = 0; i < sizeq; i++) {
+            //  Columns of sW for this block of units, for each gate
+            const __m128 * Wcell = sW->data.v + 4 * i * ldW;
+            const __m128 * Wupdate = Wcell + size * ldW;
+            const __m128 * Wforget = Wupdate + size * ldW;
+            const __m128 * Woutput = Wforget + size * ldW;
+            cell[i] += dot4_columns(Wcell, ldW, h, ldW);
+            update[i] += dot4_columns(Wupdate, ldW, h, ldW);
+            forget[i] += dot4_columns(Wforget, ldW, h, ldW);
+            outgate[i] += dot4_columns(Woutput, ldW, h, ldW);
+        }
     }
-}
 
+    __m128 * c = state->data.v;
+    __m128 * out = output->data.v;
+    for (size_t i = 0; i < sizeq; i++) {
+        update[i] += c[i] * pupdate[i];
+        forget[i] += c[i] * pforget[i];
+    }
+    tanh_arrayf((float *)cell, size);
+    //  Update and forget gates are contiguous
+    logistic_arrayf((float *)update, size + size);
+
+    for (size_t i = 0; i < sizeq; i++) {
+        c[i] = forget[i] * c[i] + update[i] * cell[i];
+        outgate[i] += c[i] * poutput[i];
+        out[i] = c[i];
+    }
+    logistic_arrayf((float *)outgate, size);
+    tanh_arrayf((float *)out, size);
+    for (size_t i = 0; i < sizeq; i++) {
+        out[i] *= outgate[i];
+    }
+}
 
 float crf_partition_function(const_scrappie_matrix C){
     RETURN_NULL_IF(NULL == C, NAN);
@@ -9,6 +9,7 @@ void exp_activation_inplace(scrappie_matrix C);
 void log_activation_inplace(scrappie_matrix C);
 void elu_activation_inplace(scrappie_matrix C);
 void robustlog_activation_inplace(scrappie_matrix C, float min_prob);
+void logsoftmax_activation_inplace(scrappie_matrix C, float min_prob);
 
 scrappie_matrix embedding(int const * index, size_t n, const_scrappie_matrix E,
                           scrappie_matrix C);
@@ -30,6 +31,9 @@ scrappie_matrix residual(const_scrappie_matrix X, const_scrappie_matrix fX,
 void residual_inplace(const_scrappie_matrix X, scrappie_matrix fX);
 scrappie_matrix softmax(const_scrappie_matrix X, const_scrappie_matrix W,
                         const_scrappie_matrix b, scrappie_matrix C);
+scrappie_matrix logsoftmax(const_scrappie_matrix X, const_scrappie_matrix W,
+                           const_scrappie_matrix b, float min_prob,
+                           scrappie_matrix C);
 
 scrappie_matrix feedforward2_tanh(const_scrappie_matrix Xf,
                                   const_scrappie_matrix Xb,
@@ -41,6 +45,14 @@ scrappie_matrix gru_forward(const_scrappie_matrix X, const_scrappie_matrix sW,
                             const_scrappie_matrix sW2, scrappie_matrix res);
 scrappie_matrix gru_backward(const_scrappie_matrix X, const_scrappie_matrix sW,
                              const_scrappie_matrix sW2, scrappie_matrix res);
+scrappie_matrix gru_forward_tiled(const_scrappie_matrix X, const_scrappie_matrix iW,
+                                  const_scrappie_matrix b, const_scrappie_matrix sW,
+                                  const_scrappie_matrix sW2, int tile,
+                                  scrappie_matrix ostate);
+scrappie_matrix gru_backward_tiled(const_scrappie_matrix X, const_scrappie_matrix iW,
+                                   const_scrappie_matrix b, const_scrappie_matrix sW,
+                                   const_scrappie_matrix sW2, int tile,
+                                   scrappie_matrix ostate);
 void gru_step(const_scrappie_matrix x, const_scrappie_matrix istate,
               const_scrappie_matrix sW, const_scrappie_matrix sW2,
               scrappie_matrix xF, scrappie_matrix ostate);
@@ -50,8 +62,7 @@ scrappie_matrix lstm_forward(const_scrappie_matrix X, const_scrappie_matrix sW,
 scrappie_matrix lstm_backward(const_scrappie_matrix X, const_scrappie_matrix sW,
                               const_scrappie_matrix p, scrappie_matrix output);
 void lstm_step(const_scrappie_matrix x, const_scrappie_matrix out_prev,
-               const_scrappie_matrix sW,
-               const_scrappie_matrix peep, scrappie_matrix xF,
+               const_scrappie_matrix sW, const_scrappie_matrix peep,
                scrappie_matrix state, scrappie_matrix output);
 
 
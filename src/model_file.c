@@ -0,0 +1,175 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "model_file.h"
+#include "scrappie_stdlib.h"
+
+_Static_assert(sizeof(struct model_file_entry) == 72, "Model file directory entry should be packed");
+
+//  Size of header preceding the directory
+static const size_t model_file_header_size = 16;
+
+
+/**  Open and map a binary model file
+ *
+ *   The file is mapped read-only and its directory checked; matrix data is
+ *   not read until used.
+ *
+ *   @param filename Name of model file
+ *
+ *   @returns Model file, to be closed with close_model_file, or NULL on failure
+ **/
+scrappie_model_file open_model_file(const char * filename){
+    RETURN_NULL_IF(NULL == filename, NULL);
+
+    const int fd = open(filename, O_RDONLY);
+    if(-1 == fd){
+        warnx("Failed to open model file \"%s\".", filename);
+        return NULL;
+    }
+    struct stat st;
+    if(0 != fstat(fd, &st) || st.st_size < model_file_header_size){
+        warnx("Model file \"%s\" is too short.", filename);
+        close(fd);
+        return NULL;
+    }
+    const size_t size = st.st_size;
+    void * map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    //  Mapping remains valid after the descriptor is closed
+    close(fd);
+    if(MAP_FAILED == map){
+        warnx("Failed to map model file \"%s\".", filename);
+        return NULL;
+    }
+
+    const char * base = map;
+    uint32_t version = 0;
+    uint32_t nmatrix = 0;
+    memcpy(&version, base + 8, sizeof(uint32_t));
+    memcpy(&nmatrix, base + 12, sizeof(uint32_t));
+    if(0 != memcmp(base, MODEL_FILE_MAGIC, 8) || MODEL_FILE_VERSION != version
+       || size < model_file_header_size + nmatrix * sizeof(struct model_file_entry)){
+        warnx("\"%s\" is not a version %d scrappie model file.", filename, MODEL_FILE_VERSION);
+        munmap(map, size);
+        return NULL;
+    }
+
+    scrappie_model_file model = calloc(1, sizeof(*model));
+    if(NULL != model){
+        model->names = calloc(nmatrix, sizeof(*model->names));
+        model->matrices = calloc(nmatrix, sizeof(*model->matrices));
+    }
+    if(NULL == model || NULL == model->names || NULL == model->matrices){
+        warnx("Error allocating memory in %s.\n", __func__);
+        munmap(map, size);
+        if(NULL != model){
+            free(model->matrices);
+            free(model->names);
+            free(model);
+        }
+        return NULL;
+    }
+    model->map = map;
+    model->size = size;
+    model->nmatrix = nmatrix;
+
+    for(size_t i=0 ; i < nmatrix ; i++){
+        struct model_file_entry entry;
+        memcpy(&entry, base + model_file_header_size + i * sizeof(entry), sizeof(entry));
+        const size_t nelt = (size_t)entry.nrq * 4 * entry.nc;
+        if(0 != entry.name[MODEL_FILE_NAMELEN - 1] || entry.nrq != (entry.nr + 3) / 4
+           || 0 != entry.offset % MODEL_FILE_ALIGN || entry.offset > size
+           || nelt > (size - entry.offset) / sizeof(float)){
+            warnx("Entry %zu of model file \"%s\" is corrupt.", i, filename);
+            return close_model_file(model);
+        }
+        memcpy(model->names[i], entry.name, MODEL_FILE_NAMELEN);
+        model->matrices[i] = (_Mat){
+            .nr = entry.nr,
+            .nrq = entry.nrq,
+            .nc = entry.nc,
+            .data.f = (float *)(base + entry.offset)
+        };
+    }
+
+    return model;
+}
+
+
+/**  Unmap and free a model file
+ *
+ *   Any matrices bound to the file become invalid.
+ *
+ *   @param model Model file to close
+ *
+ *   @returns NULL
+ **/
+scrappie_model_file close_model_file(scrappie_model_file model){
+    if(NULL != model){
+        munmap(model->map, model->size);
+        free(model->matrices);
+        free(model->names);
+    }
+    free(model);
+    return NULL;
+}
+
+
+/**  Find matrix in model file
+ *
+ *   @param model Model file
+ *   @param name Name of matrix
+ *
+ *   @returns Matrix, whose data is valid until the file is closed, or NULL
+ *   if not found.
+ **/
+const_scrappie_matrix model_file_matrix(const scrappie_model_file model, const char * name){
+    RETURN_NULL_IF(NULL == model, NULL);
+    RETURN_NULL_IF(NULL == name, NULL);
+    for(size_t i=0 ; i < model->nmatrix ; i++){
+        if(0 == strcmp(model->names[i], name)){
+            return model->matrices + i;
+        }
+    }
+    return NULL;
+}
+
+
+/**  Rebind parameters of a model to the data in a model file
+ *
+ *   Every parameter must be present in the file with the same shape as the
+ *   compiled-in parameter; otherwise nothing is changed.  Not thread safe;
+ *   should be called before basecalling starts.  The file must remain open
+ *   while the parameters are in use.
+ *
+ *   @param params Parameters of model
+ *   @param nparam Number of parameters
+ *   @param model Model file
+ *
+ *   @returns true if the parameters were rebound
+ **/
+bool bind_model_parameters(const struct model_parameter * params, size_t nparam,
+                           const scrappie_model_file model){
+    RETURN_NULL_IF(NULL == params, false);
+    RETURN_NULL_IF(NULL == model, false);
+
+    for(size_t i=0 ; i < nparam ; i++){
+        const_scrappie_matrix mat = model_file_matrix(model, params[i].name);
+        if(NULL == mat){
+            warnx("Parameter \"%s\" not found in model file.", params[i].name);
+            return false;
+        }
+        if(mat->nr != params[i].mat->nr || mat->nc != params[i].mat->nc){
+            warnx("Parameter \"%s\" in model file has shape %u x %u but %u x %u expected.",
+                  params[i].name, mat->nr, mat->nc, params[i].mat->nr, params[i].mat->nc);
+            return false;
+        }
+    }
+
+    for(size_t i=0 ; i < nparam ; i++){
+        *params[i].mat = *model_file_matrix(model, params[i].name);
+    }
+    return true;
+}
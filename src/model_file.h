@@ -0,0 +1,66 @@
+#pragma once
+#ifndef MODEL_FILE_H
+#    define MODEL_FILE_H
+
+#    include <stdbool.h>
+#    include <stddef.h>
+#    include <stdint.h>
+#    include "scrappie_matrix.h"
+
+/*  Binary model files
+ *
+ *  A model file contains a header, a directory of named matrices and the
+ *  data of each matrix.  All integers are little endian.
+ *
+ *    header     char magic[8] = "SCRPMODL", uint32 version, uint32 nmatrix
+ *    directory  nmatrix entries of struct model_file_entry
+ *    data       each matrix column-major as floats, with the rows of each
+ *               column padded with zeros to nrq * 4 elements and the start
+ *               of each matrix aligned to MODEL_FILE_ALIGN bytes.
+ *
+ *  Files are mapped read-only into memory and the matrices refer directly
+ *  to the mapped data, so pages are read lazily and shared between all
+ *  threads and processes using the same file.  Files are written by
+ *  misc/header_to_model.py.
+ */
+#    define MODEL_FILE_MAGIC "SCRPMODL"
+#    define MODEL_FILE_VERSION 1
+#    define MODEL_FILE_ALIGN 64
+#    define MODEL_FILE_NAMELEN 48
+
+struct model_file_entry {
+    char name[MODEL_FILE_NAMELEN];
+    uint32_t nr;
+    uint32_t nrq;
+    uint32_t nc;
+    uint32_t reserved;
+    uint64_t offset;
+};
+
+typedef struct {
+    void * map;
+    size_t size;
+    size_t nmatrix;
+    char (*names)[MODEL_FILE_NAMELEN];
+    _Mat * matrices;
+} _ModelFile;
+
+typedef _ModelFile *scrappie_model_file;
+
+scrappie_model_file open_model_file(const char * filename);
+scrappie_model_file close_model_file(scrappie_model_file model);
+const_scrappie_matrix model_file_matrix(const scrappie_model_file model, const char * name);
+
+
+/*  Named parameter of a compiled-in model, which may be rebound to the
+ *  data of a model file.
+ */
+struct model_parameter {
+    const char * name;
+    _Mat * mat;
+};
+
+bool bind_model_parameters(const struct model_parameter * params, size_t nparam,
+                           const scrappie_model_file model);
+
+#endif                          /* MODEL_FILE_H */
@@ -0,0 +1,220 @@
+/*  Kernels specialised to the shapes of the weights of the shipped models.
+ *  Generated by misc/specialise_kernels.py, CMake target specialised_kernels, from
+ *    nanonet_events.h
+ *    raw_20170901_r94_4kHz_450bps_0b70da4.h
+ *    rgr_20170901_r94_4kHz_450bps_9739958.h
+ *    rgrgr-elu_20170914_r94_4kHz_450bps_162c18e.h
+ *    rgrgr-tanh_20170914_r95_6kHz_450bps_dd7382a.h
+ *    rnnrf-elu_20171121_r94_4kHz_450bps_c2b6803.h
+ *    squiggle_dna_test.h
+ *  Do not edit.
+ */
+#pragma once
+#ifndef SPECIALISED_KERNELS_MODELS_H
+#define SPECIALISED_KERNELS_MODELS_H
+
+static void pgemm_3x4(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 3 * PMAT_PANEL, 3, 1, 4, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_12x384(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 12 * PMAT_PANEL, 12, 48, 384, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_27x32(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 27 * PMAT_PANEL, 27, 4, 32, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_32x288(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 32 * PMAT_PANEL, 32, 36, 288, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_41x32(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 41 * PMAT_PANEL, 41, 4, 32, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_41x96(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 41 * PMAT_PANEL, 41, 12, 96, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_41x112(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 41 * PMAT_PANEL, 41, 14, 112, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_41x128(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 41 * PMAT_PANEL, 41, 16, 128, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_73x96(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 73 * PMAT_PANEL, 73, 12, 96, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_96x96(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 96 * PMAT_PANEL, 96, 12, 96, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_96x128(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 96 * PMAT_PANEL, 96, 16, 128, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_96x192(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 96 * PMAT_PANEL, 96, 24, 192, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_96x288(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 96 * PMAT_PANEL, 96, 36, 288, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_96x384(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 96 * PMAT_PANEL, 96, 48, 384, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_96x1025(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 96 * PMAT_PANEL, 96, 129, 1025, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_112x25(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 112 * PMAT_PANEL, 112, 4, 25, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_112x112(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 112 * PMAT_PANEL, 112, 14, 112, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_112x224(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 112 * PMAT_PANEL, 112, 28, 224, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_112x336(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 112 * PMAT_PANEL, 112, 42, 336, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_112x432(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 112 * PMAT_PANEL, 112, 54, 432, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_112x1025(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 112 * PMAT_PANEL, 112, 129, 1025, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_128x288(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 128 * PMAT_PANEL, 128, 36, 288, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_128x336(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 128 * PMAT_PANEL, 128, 42, 336, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_128x384(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 128 * PMAT_PANEL, 128, 48, 384, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_128x1025(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 128 * PMAT_PANEL, 128, 129, 1025, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_144x144(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 144 * PMAT_PANEL, 144, 18, 144, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_144x288(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 144 * PMAT_PANEL, 144, 36, 288, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_144x336(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 144 * PMAT_PANEL, 144, 42, 336, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_224x3(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 224 * PMAT_PANEL, 224, 1, 3, X, ldX, ncol, C, ldC);
+}
+
+static void pgemm_224x32(const float * W, const float * X, size_t ldX, size_t ncol,
+                            float * C, size_t ldC){
+    pgemm_panels(W, 224 * PMAT_PANEL, 224, 4, 32, X, ldX, ncol, C, ldC);
+}
+
+static void gru_step_96(const float * x, const float * istate, const float * sW,
+                          const float * sW2, float * xF, float * ostate){
+    gru_step_panels(96, x, istate, sW, sW2, xF, ostate);
+}
+
+static void gru_step_112(const float * x, const float * istate, const float * sW,
+                          const float * sW2, float * xF, float * ostate){
+    gru_step_panels(112, x, istate, sW, sW2, xF, ostate);
+}
+
+static void gru_step_144(const float * x, const float * istate, const float * sW,
+                          const float * sW2, float * xF, float * ostate){
+    gru_step_panels(144, x, istate, sW, sW2, xF, ostate);
+}
+
+static const struct pgemm_specialisation pgemm_specialisations[] = {
+    {3, 4, pgemm_3x4},
+    {12, 384, pgemm_12x384},
+    {27, 32, pgemm_27x32},
+    {32, 288, pgemm_32x288},
+    {41, 32, pgemm_41x32},
+    {41, 96, pgemm_41x96},
+    {41, 112, pgemm_41x112},
+    {41, 128, pgemm_41x128},
+    {73, 96, pgemm_73x96},
+    {96, 96, pgemm_96x96},
+    {96, 128, pgemm_96x128},
+    {96, 192, pgemm_96x192},
+    {96, 288, pgemm_96x288},
+    {96, 384, pgemm_96x384},
+    {96, 1025, pgemm_96x1025},
+    {112, 25, pgemm_112x25},
+    {112, 112, pgemm_112x112},
+    {112, 224, pgemm_112x224},
+    {112, 336, pgemm_112x336},
+    {112, 432, pgemm_112x432},
+    {112, 1025, pgemm_112x1025},
+    {128, 288, pgemm_128x288},
+    {128, 336, pgemm_128x336},
+    {128, 384, pgemm_128x384},
+    {128, 1025, pgemm_128x1025},
+    {144, 144, pgemm_144x144},
+    {144, 288, pgemm_144x288},
+    {144, 336, pgemm_144x336},
+    {224, 3, pgemm_224x3},
+    {224, 32, pgemm_224x32}
+};
+
+static const struct gru_step_specialisation gru_step_specialisations[] = {
+    {96, gru_step_96},
+    {112, gru_step_112},
+    {144, gru_step_144}
+};
+
+#endif /* SPECIALISED_KERNELS_MODELS_H */
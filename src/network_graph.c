@@ -0,0 +1,744 @@
+#include <time.h>
+
+#include "layers.h"
+#include "network_graph.h"
+#include "precision.h"
+#include "scrappie_stdlib.h"
+#include "util.h"
+
+static bool network_timing = false;
+
+/*  Memory used by the calling thread to run a network: a plan for the
+ *  network and the slabs it places intermediate outputs in.  Slabs only
+ *  grow, so once the longest input has been seen no further memory is
+ *  allocated for intermediates.
+ */
+struct network_workspace {
+    const struct network_layer * layers;
+    size_t nlayer;
+    struct network_plan * plan;
+    float ** slab;
+    size_t * capacity;
+    //  Matrix header for each layer whose output is placed in a slab
+    _Mat * view;
+    //  Layers with their weights resolved to their converted versions,
+    //  refreshed when the generation of the registry changes
+    struct network_layer * resolved;
+    _Mat * weight;
+    struct scrappie_weights * converted;
+    unsigned int generation;
+};
+//  Weights of each layer that may have converted versions: W, W2, sW and sW2
+#define NETWORK_LAYER_NWEIGHT 4
+static _Thread_local struct network_workspace * workspace = NULL;
+
+
+const char * layer_type_string(const enum layer_type type){
+    switch(type){
+    case LAYER_CONVOLUTION:
+        return "convolution";
+    case LAYER_FEEDFORWARD_LINEAR:
+        return "feedforward_linear";
+    case LAYER_FEEDFORWARD_TANH:
+        return "feedforward_tanh";
+    case LAYER_FEEDFORWARD2_TANH:
+        return "feedforward2_tanh";
+    case LAYER_GRU_FORWARD:
+        return "gru_forward";
+    case LAYER_GRU_BACKWARD:
+        return "gru_backward";
+    case LAYER_LSTM_FORWARD:
+        return "lstm_forward";
+    case LAYER_LSTM_BACKWARD:
+        return "lstm_backward";
+    case LAYER_TANH:
+        return "tanh";
+    case LAYER_ELU:
+        return "elu";
+    case LAYER_RESIDUAL:
+        return "residual";
+    case LAYER_SOFTMAX:
+        return "softmax";
+    case LAYER_GLOBALNORM:
+        return "globalnorm";
+    case LAYER_INVALID:
+        errx(EXIT_FAILURE, "Invalid layer type %s:%d", __FILE__, __LINE__);
+    default:
+        errx(EXIT_FAILURE, "Scrappie enum failure -- report bug\n");
+    }
+
+    return NULL;
+}
+
+
+static inline bool has_second_input(const struct network_layer * layer){
+    return LAYER_FEEDFORWARD2_TANH == layer->type || LAYER_RESIDUAL == layer->type;
+}
+
+static inline bool is_elementwise(const struct network_layer * layer){
+    return LAYER_TANH == layer->type || LAYER_ELU == layer->type || LAYER_RESIDUAL == layer->type;
+}
+
+
+/**  Check description of network is well formed
+ *
+ *   Every layer must take its inputs from the network input or from earlier
+ *   layers and have the parameters its type requires.
+ *
+ *   @param net Network
+ *
+ *   @returns true if well formed
+ **/
+bool validate_network_graph(const struct network_graph * net){
+    RETURN_NULL_IF(NULL == net, false);
+    if(0 == net->nlayer || NULL == net->layers){
+        warnx("Network %s has no layers.", net->name);
+        return false;
+    }
+
+    for(int i=0 ; i < net->nlayer ; i++){
+        const struct network_layer * layer = net->layers + i;
+        bool ok = (layer->type >= 0 && layer->type < LAYER_INVALID)
+                  && layer->input >= NETWORK_INPUT && layer->input < i;
+        if(ok && has_second_input(layer)){
+            ok = layer->input2 >= NETWORK_INPUT && layer->input2 < i;
+        }
+        if(ok){
+            switch(layer->type){
+            case LAYER_CONVOLUTION:
+                ok = NULL != layer->W && NULL != layer->b && NULL != layer->stride;
+                break;
+            case LAYER_FEEDFORWARD_LINEAR:
+            case LAYER_FEEDFORWARD_TANH:
+            case LAYER_SOFTMAX:
+            case LAYER_GLOBALNORM:
+                ok = NULL != layer->W && NULL != layer->b;
+                break;
+            case LAYER_FEEDFORWARD2_TANH:
+                ok = NULL != layer->W && NULL != layer->W2 && NULL != layer->b;
+                break;
+            case LAYER_GRU_FORWARD:
+            case LAYER_GRU_BACKWARD:
+                ok = NULL != layer->W && NULL != layer->b && NULL != layer->sW && NULL != layer->sW2;
+                break;
+            case LAYER_LSTM_FORWARD:
+            case LAYER_LSTM_BACKWARD:
+                ok = NULL != layer->sW && NULL != layer->p;
+                break;
+            default:
+                break;
+            }
+        }
+        if(!ok){
+            warnx("Layer %d of network %s is malformed.", i, net->name);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**  Apply a layer that creates a new output
+ *
+ *   @param layer Layer to apply
+ *   @param X Input
+ *   @param X2 Second input, for layers which take two
+ *   @param min_prob Minimum bound on probabilities, for softmax
+ *   @param return_log Whether softmax should return log-probabilities
+ *   @param gru_tile Blocks per tile of the input projection of GRU layers
+ *   @param C Matrix whose memory may be reused for output, or NULL
+ *
+ *   @returns Output of layer
+ **/
+static scrappie_matrix apply_layer(const struct network_layer * layer, const_scrappie_matrix X,
+                                   const_scrappie_matrix X2, float min_prob, bool return_log,
+                                   int gru_tile, scrappie_matrix C){
+    switch(layer->type){
+    case LAYER_CONVOLUTION:
+        return convolution(X, layer->W, layer->b, *layer->stride, C);
+    case LAYER_FEEDFORWARD_LINEAR:
+        return feedforward_linear(X, layer->W, layer->b, C);
+    case LAYER_FEEDFORWARD_TANH:
+        return feedforward_tanh(X, layer->W, layer->b, C);
+    case LAYER_FEEDFORWARD2_TANH:
+        return feedforward2_tanh(X, X2, layer->W, layer->W2, layer->b, C);
+    case LAYER_GRU_FORWARD:
+        return gru_forward_tiled(X, layer->W, layer->b, layer->sW, layer->sW2, gru_tile, C);
+    case LAYER_GRU_BACKWARD:
+        return gru_backward_tiled(X, layer->W, layer->b, layer->sW, layer->sW2, gru_tile, C);
+    case LAYER_LSTM_FORWARD:
+        return lstm_forward(X, layer->sW, layer->p, C);
+    case LAYER_LSTM_BACKWARD:
+        return lstm_backward(X, layer->sW, layer->p, C);
+    case LAYER_SOFTMAX:
+        return return_log ? logsoftmax(X, layer->W, layer->b, min_prob, C)
+                          : softmax(X, layer->W, layer->b, C);
+    case LAYER_GLOBALNORM:
+        return globalnorm(X, layer->W, layer->b, C);
+    default:
+        errx(EXIT_FAILURE, "Layer %s is not applied by %s", layer_type_string(layer->type), __func__);
+    }
+    return NULL;
+}
+
+
+/**  Apply an element-wise layer in place
+ *
+ *   @param layer Layer to apply
+ *   @param C Matrix to update, containing the first input
+ *   @param X2 Second input, for residual layers
+ **/
+static void apply_layer_inplace(const struct network_layer * layer, scrappie_matrix C,
+                                const_scrappie_matrix X2){
+    switch(layer->type){
+    case LAYER_TANH:
+        tanh_activation_inplace(C);
+        break;
+    case LAYER_ELU:
+        elu_activation_inplace(C);
+        break;
+    case LAYER_RESIDUAL:
+        residual_inplace(X2, C);
+        break;
+    default:
+        errx(EXIT_FAILURE, "Layer %s is not applied by %s", layer_type_string(layer->type), __func__);
+    }
+}
+
+
+/**  Find last layer to consume the output of each layer
+ *
+ *   A layer whose output is not consumed is its own last consumer.
+ *
+ *   @param net Network
+ *   @param last_use Array [nlayer] to write to
+ **/
+static void find_last_use(const struct network_graph * net, int * last_use){
+    for(int i=0 ; i < net->nlayer ; i++){
+        last_use[i] = i;
+        const struct network_layer * layer = net->layers + i;
+        if(layer->input >= 0){
+            last_use[layer->input] = i;
+        }
+        if(has_second_input(layer) && layer->input2 >= 0){
+            last_use[layer->input2] = i;
+        }
+    }
+}
+
+
+//  Whether layer i is applied in place, taking over the output of its input
+static inline bool is_inplace(const struct network_graph * net, int i, const int * last_use){
+    const struct network_layer * layer = net->layers + i;
+    return is_elementwise(layer) && layer->input >= 0 && i == last_use[layer->input];
+}
+
+
+/**  Shape of output of a layer
+ *
+ *   @param layer Layer
+ *   @param nr Number of rows of input
+ *   @param nc Number of columns of input
+ *   @param onr [out] Number of rows of output
+ *   @param onc [out] Number of columns of output
+ **/
+static void layer_output_shape(const struct network_layer * layer, int nr, int nc, int * onr, int * onc){
+    *onr = nr;
+    *onc = nc;
+    switch(layer->type){
+    case LAYER_CONVOLUTION:
+        *onr = layer->W->nc;
+        *onc = iceil(nc, *layer->stride);
+        break;
+    case LAYER_FEEDFORWARD_LINEAR:
+    case LAYER_FEEDFORWARD_TANH:
+    case LAYER_FEEDFORWARD2_TANH:
+    case LAYER_SOFTMAX:
+    case LAYER_GLOBALNORM:
+        *onr = layer->W->nc;
+        break;
+    case LAYER_GRU_FORWARD:
+    case LAYER_GRU_BACKWARD:
+        *onr = layer->sW2->nc;
+        break;
+    case LAYER_LSTM_FORWARD:
+    case LAYER_LSTM_BACKWARD:
+        *onr = layer->sW->nr;
+        break;
+    case LAYER_TANH:
+    case LAYER_ELU:
+    case LAYER_RESIDUAL:
+        break;
+    default:
+        errx(EXIT_FAILURE, "Scrappie enum failure -- report bug\n");
+    }
+}
+
+
+//  Number of floats used by matrix of given shape, including padding
+static inline size_t matrix_nfloat(int nr, int nc){
+    return 4 * (size_t)iceil(nr, 4) * nc;
+}
+
+
+/**  Make memory plan for running network on input of a given shape
+ *
+ *   @param net Network
+ *   @param nr Number of rows of input
+ *   @param nc Number of columns of input
+ *
+ *   @returns Plan, to be freed with free_network_plan, or NULL on failure
+ **/
+struct network_plan * make_network_plan(const struct network_graph * net, int nr, int nc){
+    RETURN_NULL_IF(!validate_network_graph(net), NULL);
+
+    struct network_plan * plan = calloc(1, sizeof(*plan));
+    RETURN_NULL_IF(NULL == plan, NULL);
+    plan->net = net;
+    plan->nr = calloc(net->nlayer, sizeof(int));
+    plan->nc = calloc(net->nlayer, sizeof(int));
+    plan->slab = calloc(net->nlayer, sizeof(int));
+    plan->slab_size = calloc(net->nlayer, sizeof(size_t));
+    if(NULL == plan->nr || NULL == plan->nc || NULL == plan->slab || NULL == plan->slab_size
+       || !update_network_plan(plan, nr, nc)){
+        return free_network_plan(plan);
+    }
+
+    return plan;
+}
+
+
+/**  Remake memory plan for input of a different shape
+ *
+ *   Layers are placed in the same slabs whatever the shape of the input,
+ *   only the size of the slabs changes.  No memory is allocated.
+ *
+ *   The output of each layer is placed, in order, into the free slab whose
+ *   size fits it most tightly.  If no free slab is large enough, the largest
+ *   free slab is grown or, if none are free, a new slab is started.  Slabs
+ *   are freed after the last consumer of their contents has run, so an output
+ *   is never placed in the same slab as the inputs of its layer.
+ *
+ *   @param plan Plan to update
+ *   @param nr Number of rows of input
+ *   @param nc Number of columns of input
+ *
+ *   @returns true on success
+ **/
+bool update_network_plan(struct network_plan * plan, int nr, int nc){
+    RETURN_NULL_IF(NULL == plan, false);
+    if(nr <= 0 || nc <= 0){
+        //  Input with no blocks, such as a read too short to call
+        return false;
+    }
+    const struct network_graph * net = plan->net;
+    const int nlayer = net->nlayer;
+    plan->input_nr = nr;
+    plan->input_nc = nc;
+
+    int last_use[nlayer];
+    find_last_use(net, last_use);
+
+    //  Output of each layer belongs to a buffer, which may be shared by a
+    //  chain of in-place layers.  Buffer is live until its last consumer.
+    int owner[nlayer];
+    int buffer_end[nlayer];
+    for(int i=0 ; i < nlayer ; i++){
+        const struct network_layer * layer = net->layers + i;
+        const int inr = (NETWORK_INPUT == layer->input) ? nr : plan->nr[layer->input];
+        const int inc = (NETWORK_INPUT == layer->input) ? nc : plan->nc[layer->input];
+        layer_output_shape(layer, inr, inc, plan->nr + i, plan->nc + i);
+        owner[i] = is_inplace(net, i, last_use) ? owner[layer->input] : i;
+        buffer_end[owner[i]] = last_use[i];
+    }
+
+    //  Slab holding each buffer, or NETWORK_NO_SLAB when buffer is not in use
+    int slab_buffer[nlayer];
+    plan->nslab = 0;
+    const int final_buffer = owner[nlayer - 1];
+    for(int i=0 ; i < nlayer ; i++){
+        plan->slab[i] = NETWORK_NO_SLAB;
+        if(final_buffer == owner[i]){
+            //  Output is returned to caller
+        } else if(owner[i] != i){
+            plan->slab[i] = plan->slab[owner[i]];
+        } else {
+            const size_t need = matrix_nfloat(plan->nr[i], plan->nc[i]);
+            int best = NETWORK_NO_SLAB;
+            for(int s=0 ; s < plan->nslab ; s++){
+                if(NETWORK_NO_SLAB != slab_buffer[s]){
+                    continue;
+                }
+                if(NETWORK_NO_SLAB == best){
+                    best = s;
+                    continue;
+                }
+                const bool fits = plan->slab_size[s] >= need;
+                const bool best_fits = plan->slab_size[best] >= need;
+                if(fits ? (!best_fits || plan->slab_size[s] < plan->slab_size[best])
+                        : (!best_fits && plan->slab_size[s] > plan->slab_size[best])){
+                    best = s;
+                }
+            }
+            if(NETWORK_NO_SLAB == best){
+                best = plan->nslab++;
+                plan->slab_size[best] = 0;
+            }
+            if(plan->slab_size[best] < need){
+                plan->slab_size[best] = need;
+            }
+            slab_buffer[best] = i;
+            plan->slab[i] = best;
+        }
+
+        //  Release slabs whose last consumer was this layer
+        for(int s=0 ; s < plan->nslab ; s++){
+            if(NETWORK_NO_SLAB != slab_buffer[s] && i == buffer_end[slab_buffer[s]]){
+                slab_buffer[s] = NETWORK_NO_SLAB;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+struct network_plan * free_network_plan(struct network_plan * plan){
+    if(NULL != plan){
+        free(plan->slab_size);
+        free(plan->slab);
+        free(plan->nc);
+        free(plan->nr);
+        free(plan);
+    }
+    return NULL;
+}
+
+
+/**  Memory used by slabs of plan
+ *
+ *   @param plan Plan
+ *
+ *   @returns Peak memory used by intermediate outputs, in bytes
+ **/
+size_t network_plan_bytes(const struct network_plan * plan){
+    RETURN_NULL_IF(NULL == plan, 0);
+    size_t nfloat = 0;
+    for(int s=0 ; s < plan->nslab ; s++){
+        nfloat += plan->slab_size[s];
+    }
+    return nfloat * sizeof(float);
+}
+
+
+/**  Memory used by intermediate outputs if each were allocated separately
+ *
+ *   @param plan Plan
+ *
+ *   @returns Memory, in bytes
+ **/
+size_t network_unplanned_bytes(const struct network_plan * plan){
+    RETURN_NULL_IF(NULL == plan, 0);
+    size_t nfloat = 0;
+    for(int i=0 ; i < plan->net->nlayer ; i++){
+        if(NETWORK_NO_SLAB != plan->slab[i]){
+            nfloat += matrix_nfloat(plan->nr[i], plan->nc[i]);
+        }
+    }
+    return nfloat * sizeof(float);
+}
+
+
+/**  Print memory plan
+ *
+ *   @param fp File to write to
+ *   @param plan Plan
+ *
+ *   @returns Number of characters written or negative on failure
+ **/
+int fprintf_network_plan(FILE * fp, const struct network_plan * plan){
+    RETURN_NULL_IF(NULL == fp, -1);
+    RETURN_NULL_IF(NULL == plan, -1);
+    const struct network_graph * net = plan->net;
+
+    int nchar = fprintf(fp, "# Memory plan of network %s for input of %d x %d\n%-6s %-20s %-6s %-8s %s\n",
+                        net->name, plan->input_nr, plan->input_nc, "layer", "type", "rows", "columns", "slab");
+    for(size_t i=0 ; i < net->nlayer ; i++){
+        nchar += fprintf(fp, "%-6zu %-20s %-6d %-8d ", i, layer_type_string(net->layers[i].type),
+                         plan->nr[i], plan->nc[i]);
+        nchar += (NETWORK_NO_SLAB == plan->slab[i]) ? fprintf(fp, "output\n")
+                                                    : fprintf(fp, "%d\n", plan->slab[i]);
+    }
+    for(int s=0 ; s < plan->nslab ; s++){
+        nchar += fprintf(fp, "# Slab %d  %zu bytes\n", s, plan->slab_size[s] * sizeof(float));
+    }
+    const size_t nbyte = network_plan_bytes(plan);
+    nchar += fprintf(fp, "# Peak memory %zu bytes (%.1f bytes per sample), %zu bytes if unplanned\n",
+                     nbyte, (double)nbyte / plan->input_nc, network_unplanned_bytes(plan));
+    return nchar;
+}
+
+
+static void free_workspace(struct network_workspace * ws){
+    if(NULL == ws){
+        return;
+    }
+    if(NULL != ws->slab){
+        for(size_t s=0 ; s < ws->nlayer ; s++){
+            free(ws->slab[s]);
+        }
+    }
+    free(ws->converted);
+    free(ws->weight);
+    free(ws->resolved);
+    free(ws->view);
+    free(ws->capacity);
+    free(ws->slab);
+    free_network_plan(ws->plan);
+    free(ws);
+}
+
+
+/**  Free memory used by calling thread to run networks
+ *
+ *   The workspace refers to the last network run, so should be freed before
+ *   a network that is not static goes out of scope.
+ **/
+void free_network_workspace(void){
+    free_workspace(workspace);
+    workspace = NULL;
+}
+
+
+/**  Resolve weights of layers of network to their converted versions
+ *
+ *   The registry of converted weights is searched once here, rather than
+ *   by the kernels of each layer as they are applied.
+ *
+ *   @param ws Workspace to store resolved layers in
+ *   @param net Network
+ **/
+static void resolve_workspace_layers(struct network_workspace * ws, const struct network_graph * net){
+    for(size_t i=0 ; i < net->nlayer ; i++){
+        struct network_layer * layer = ws->resolved + i;
+        *layer = net->layers[i];
+        const _Mat ** weights[NETWORK_LAYER_NWEIGHT] = {&layer->W, &layer->W2, &layer->sW, &layer->sW2};
+        for(int j=0 ; j < NETWORK_LAYER_NWEIGHT ; j++){
+            if(NULL != *weights[j]){
+                const size_t k = i * NETWORK_LAYER_NWEIGHT + j;
+                ws->weight[k] = resolve_weights(*weights[j], ws->converted + k);
+                *weights[j] = ws->weight + k;
+            }
+        }
+    }
+    ws->generation = weight_registry_generation();
+}
+
+
+/**  Workspace of calling thread for running network on input
+ *
+ *   @param net Network
+ *   @param input Input to network
+ *
+ *   @returns Workspace whose slabs are large enough for input, or NULL on failure
+ **/
+static struct network_workspace * get_workspace(const struct network_graph * net, const_scrappie_matrix input){
+    if(NULL != workspace && (workspace->plan->net != net || workspace->layers != net->layers)){
+        free_network_workspace();
+    }
+    if(NULL == workspace){
+        struct network_workspace * ws = calloc(1, sizeof(*ws));
+        RETURN_NULL_IF(NULL == ws, NULL);
+        ws->layers = net->layers;
+        ws->nlayer = net->nlayer;
+        ws->plan = make_network_plan(net, input->nr, input->nc);
+        ws->slab = calloc(net->nlayer, sizeof(float *));
+        ws->capacity = calloc(net->nlayer, sizeof(size_t));
+        ws->view = calloc(net->nlayer, sizeof(_Mat));
+        ws->resolved = calloc(net->nlayer, sizeof(struct network_layer));
+        ws->weight = calloc(net->nlayer * NETWORK_LAYER_NWEIGHT, sizeof(_Mat));
+        ws->converted = calloc(net->nlayer * NETWORK_LAYER_NWEIGHT, sizeof(struct scrappie_weights));
+        if(NULL == ws->plan || NULL == ws->slab || NULL == ws->capacity || NULL == ws->view
+           || NULL == ws->resolved || NULL == ws->weight || NULL == ws->converted){
+            free_workspace(ws);
+            return NULL;
+        }
+        resolve_workspace_layers(ws, net);
+        workspace = ws;
+    } else if(!update_network_plan(workspace->plan, input->nr, input->nc)){
+        return NULL;
+    }
+
+    struct network_workspace * ws = workspace;
+    if(ws->generation != weight_registry_generation()){
+        resolve_workspace_layers(ws, net);
+    }
+    for(int s=0 ; s < ws->plan->nslab ; s++){
+        if(ws->capacity[s] < ws->plan->slab_size[s]){
+            free(ws->slab[s]);
+            ws->capacity[s] = 0;
+            ws->slab[s] = aligned_alloc(16, ws->plan->slab_size[s] * sizeof(float));
+            if(NULL == ws->slab[s]){
+                warnx("Error allocating memory in %s.\n", __func__);
+                return NULL;
+            }
+            ws->capacity[s] = ws->plan->slab_size[s];
+        }
+    }
+
+    return ws;
+}
+
+
+/**  Run network
+ *
+ *   Intermediate outputs are placed in the slabs of the calling thread's
+ *   workspace, so no memory is allocated for them once an input at least
+ *   as long has been run.
+ *
+ *   @param net Network
+ *   @param input Input to network
+ *   @param min_prob Minimum bound on probabilities, for softmax
+ *   @param return_log Whether softmax should return log-probabilities
+ *
+ *   @returns Output of final layer, to be freed by caller, or NULL on failure
+ **/
+scrappie_matrix run_network_graph(const struct network_graph * net, const_scrappie_matrix input,
+                                  float min_prob, bool return_log){
+    RETURN_NULL_IF(NULL == input, NULL);
+    assert(validate_network_graph(net));
+    const int nlayer = net->nlayer;
+
+    struct network_workspace * ws = get_workspace(net, input);
+    RETURN_NULL_IF(NULL == ws, NULL);
+    const struct network_plan * plan = ws->plan;
+    const int gru_tile = (net->gru_tile > 0) ? net->gru_tile : NETWORK_GRU_TILE;
+
+    int last_use[nlayer];
+    find_last_use(net, last_use);
+
+    scrappie_matrix output[nlayer];
+    for(int i=0 ; i < nlayer ; i++){
+        output[i] = NULL;
+    }
+    bool ok = true;
+
+    for(int i=0 ; i < nlayer && ok ; i++){
+        const struct network_layer * layer = ws->resolved + i;
+        const_scrappie_matrix X = (NETWORK_INPUT == layer->input) ? input : output[layer->input];
+        const_scrappie_matrix X2 = NULL;
+        if(has_second_input(layer)){
+            X2 = (NETWORK_INPUT == layer->input2) ? input : output[layer->input2];
+        }
+
+        struct timespec t0, t1;
+        if(network_timing){
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+        }
+
+        //  Matrix for output, placed in slab when plan has one
+        scrappie_matrix C = NULL;
+        if(NETWORK_NO_SLAB != plan->slab[i] && !is_inplace(net, i, last_use)){
+            C = ws->view + i;
+            C->nr = plan->nr[i];
+            C->nrq = iceil(plan->nr[i], 4);
+            C->nc = plan->nc[i];
+            C->data.f = ws->slab[plan->slab[i]];
+        }
+
+        if(is_inplace(net, i, last_use)){
+            //  Input has no other consumer; take it over
+            output[i] = output[layer->input];
+            output[layer->input] = NULL;
+        } else if(is_elementwise(layer)){
+            if(NULL == C){
+                output[i] = copy_scrappie_matrix(X);
+            } else {
+                memcpy(C->data.f, X->data.f, sizeof(__m128) * X->nrq * X->nc);
+                output[i] = C;
+            }
+        } else {
+            output[i] = apply_layer(layer, X, X2, min_prob, return_log, gru_tile, C);
+            assert(NULL == C || NULL == output[i] || C == output[i]);
+        }
+        if(NULL != output[i] && is_elementwise(layer)){
+            apply_layer_inplace(layer, output[i], X2);
+        }
+        ok = (NULL != output[i]);
+
+        if(network_timing){
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            const double dt = (t1.tv_sec - t0.tv_sec) + 1e-9 * (t1.tv_nsec - t0.tv_nsec);
+            #pragma omp atomic
+            net->timing[i] += dt;
+        }
+
+        //  Inputs whose last consumer has now run are no longer needed.
+        //  Their memory belongs to the workspace.
+        const int release[2] = {layer->input, has_second_input(layer) ? layer->input2 : NETWORK_INPUT};
+        for(int j=0 ; j < 2 ; j++){
+            const int k = release[j];
+            if(k >= 0 && i == last_use[k]){
+                output[k] = NULL;
+            }
+        }
+    }
+
+    if(!ok){
+        //  Only outputs not placed in a slab need freeing
+        for(int i=0 ; i < nlayer ; i++){
+            if(NETWORK_NO_SLAB == plan->slab[i]){
+                output[i] = free_scrappie_matrix(output[i]);
+            }
+        }
+        return NULL;
+    }
+
+    return output[nlayer - 1];
+}
+
+
+/**  Enable or disable timing of each layer
+ *
+ *   Not thread safe; should be called before networks are run.
+ *
+ *   @param enable Whether to time layers
+ **/
+void set_network_timing(bool enable){
+    network_timing = enable;
+}
+
+void reset_network_timing(const struct network_graph * net){
+    RETURN_NULL_IF(NULL == net, );
+    for(size_t i=0 ; i < net->nlayer ; i++){
+        net->timing[i] = 0.0;
+    }
+}
+
+
+/**  Print time spent in each layer of network
+ *
+ *   @param fp File to write to
+ *   @param net Network
+ *
+ *   @returns Number of characters written or negative on failure
+ **/
+int fprintf_network_timing(FILE * fp, const struct network_graph * net){
+    RETURN_NULL_IF(NULL == fp, -1);
+    RETURN_NULL_IF(NULL == net, -1);
+
+    double total = 0.0;
+    for(size_t i=0 ; i < net->nlayer ; i++){
+        total += net->timing[i];
+    }
+
+    int nchar = fprintf(fp, "# Time in each layer of network %s\n%-6s %-20s %-6s %-10s %s\n",
+                        net->name, "layer", "type", "input", "time(s)", "percent");
+    for(size_t i=0 ; i < net->nlayer ; i++){
+        const struct network_layer * layer = net->layers + i;
+        nchar += fprintf(fp, "%-6zu %-20s %-6d %-10.3f %.1f\n", i, layer_type_string(layer->type),
+                         layer->input, net->timing[i],
+                         (total > 0.0) ? 100.0 * net->timing[i] / total : 0.0);
+    }
+    return nchar;
+}
@@ -0,0 +1,148 @@
+#pragma once
+#ifndef NETWORK_GRAPH_H
+#    define NETWORK_GRAPH_H
+
+#    include <stdbool.h>
+#    include <stdio.h>
+#    include "scrappie_matrix.h"
+
+/*  Declarative description of a network as a list of layers.
+ *
+ *  Each layer takes its input from the network input or from the output
+ *  of an earlier layer.  The executor, run_network_graph, applies the
+ *  layers in order and owns all intermediate matrices: the output of a
+ *  layer is released as soon as its last consumer has run and its memory
+ *  is reused for later outputs, and element-wise layers (activations and
+ *  residual connections) are applied in place when their input has no
+ *  other consumer.  The output of the final layer is returned.
+ *
+ *  Intermediate outputs are placed according to a memory plan (see
+ *  struct network_plan) into slabs owned by the calling thread, which grow
+ *  to fit the longest input seen and are then reused without allocation.
+ */
+enum layer_type {
+    LAYER_CONVOLUTION = 0,
+    LAYER_FEEDFORWARD_LINEAR,
+    LAYER_FEEDFORWARD_TANH,
+    LAYER_FEEDFORWARD2_TANH,
+    LAYER_GRU_FORWARD,
+    LAYER_GRU_BACKWARD,
+    LAYER_LSTM_FORWARD,
+    LAYER_LSTM_BACKWARD,
+    LAYER_TANH,
+    LAYER_ELU,
+    LAYER_RESIDUAL,
+    LAYER_SOFTMAX,
+    LAYER_GLOBALNORM,
+    LAYER_INVALID
+};
+
+const char * layer_type_string(const enum layer_type type);
+
+//  Index of input referring to the input of the network
+#    define NETWORK_INPUT -1
+
+/*  Parameters used by each type of layer
+ *
+ *    convolution          W, b, stride
+ *    feedforward_*        W, b
+ *    feedforward2_tanh    W (forward input), W2 (backward input), b
+ *    gru_*                W (input weights), b, sW, sW2
+ *    lstm_*               sW, p; input is the affine transform of the data
+ *    residual             adds output of input2 to that of input
+ *    softmax              W, b; log-probabilities if requested when run
+ *    globalnorm           W, b
+ */
+struct network_layer {
+    enum layer_type type;
+    int input;
+    int input2;
+    const _Mat * W;
+    const _Mat * W2;
+    const _Mat * b;
+    const _Mat * sW;
+    const _Mat * sW2;
+    const _Mat * p;
+    const int * stride;
+};
+
+//  Number of blocks whose GRU input projection is computed at once, unless a
+// network gives its own.  The projection for a tile should fit comfortably
+// into L2 cache.
+#    define NETWORK_GRU_TILE 64
+
+struct network_graph {
+    const char * name;
+    size_t nlayer;
+    const struct network_layer * layers;
+    //  Accumulated time for each layer, when timing is enabled
+    double * timing;
+    //  Blocks per tile of the input projection of GRU layers, or 0 for
+    // NETWORK_GRU_TILE
+    int gru_tile;
+};
+
+//  Helpers for writing layers
+#    define CONVOLUTION_LAYER(IN, MW, MB, STRIDE) \
+    {.type = LAYER_CONVOLUTION, .input = (IN), .W = (MW), .b = (MB), .stride = (STRIDE)}
+#    define FEEDFORWARD_LAYER(TYPE, IN, MW, MB) \
+    {.type = (TYPE), .input = (IN), .W = (MW), .b = (MB)}
+#    define FEEDFORWARD2_LAYER(INF, INB, MWF, MWB, MB) \
+    {.type = LAYER_FEEDFORWARD2_TANH, .input = (INF), .input2 = (INB), .W = (MWF), .W2 = (MWB), .b = (MB)}
+#    define GRU_LAYER(TYPE, IN, MIW, MB, MSW, MSW2) \
+    {.type = (TYPE), .input = (IN), .W = (MIW), .b = (MB), .sW = (MSW), .sW2 = (MSW2)}
+#    define LSTM_LAYER(TYPE, IN, MSW, MP) \
+    {.type = (TYPE), .input = (IN), .sW = (MSW), .p = (MP)}
+#    define ACTIVATION_LAYER(TYPE, IN) \
+    {.type = (TYPE), .input = (IN)}
+#    define RESIDUAL_LAYER(IN, IN2) \
+    {.type = LAYER_RESIDUAL, .input = (IN), .input2 = (IN2)}
+
+//  Size of layer list
+#    define NLAYER(LAYERS) (sizeof(LAYERS) / sizeof(LAYERS[0]))
+
+/*  Memory plan for the intermediate outputs of a network
+ *
+ *  The output of each layer is live from the layer that creates it until
+ *  its last consumer has run; element-wise layers applied in place extend
+ *  the lifetime of their input rather than creating a new output.  Live
+ *  outputs are assigned to a small number of slabs, each sized to the
+ *  largest output placed in it, so that outputs whose lifetimes do not
+ *  overlap share memory.  The output of the final layer is returned to the
+ *  caller and is not placed in a slab.
+ */
+//  Slab of an output which is not placed in a slab
+#    define NETWORK_NO_SLAB -1
+
+struct network_plan {
+    const struct network_graph * net;
+    //  Shape of input the plan was made for
+    int input_nr;
+    int input_nc;
+    //  Shape of output of each layer and slab it is placed in
+    int * nr;
+    int * nc;
+    int * slab;
+    //  Number of slabs and size of each slab, in floats
+    int nslab;
+    size_t * slab_size;
+};
+
+bool validate_network_graph(const struct network_graph * net);
+
+struct network_plan * make_network_plan(const struct network_graph * net, int nr, int nc);
+bool update_network_plan(struct network_plan * plan, int nr, int nc);
+struct network_plan * free_network_plan(struct network_plan * plan);
+size_t network_plan_bytes(const struct network_plan * plan);
+size_t network_unplanned_bytes(const struct network_plan * plan);
+int fprintf_network_plan(FILE * fp, const struct network_plan * plan);
+void free_network_workspace(void);
+
+scrappie_matrix run_network_graph(const struct network_graph * net, const_scrappie_matrix input,
+                                  float min_prob, bool return_log);
+
+void set_network_timing(bool enable);
+void reset_network_timing(const struct network_graph * net);
+int fprintf_network_timing(FILE * fp, const struct network_graph * net);
+
+#endif                          /* NETWORK_GRAPH_H */
@@ -1,17 +1,18 @@
 #include "layers.h"
+#include "model_file.h"
 #include "models/nanonet_events.h"
 #include "models/raw_20170901_r94_4kHz_450bps_0b70da4.h"
 #include "models/rgr_20170901_r94_4kHz_450bps_9739958.h"
 #include "models/rgrgr-elu_20170914_r94_4kHz_450bps_162c18e.h"
 #include "models/rgrgr-tanh_20170914_r95_6kHz_450bps_dd7382a.h"
 #include "models/rnnrf-elu_20171121_r94_4kHz_450bps_c2b6803.h"
+#include "network_graph.h"
 #include "networks.h"
 #include "nnfeatures.h"
 #include "scrappie_stdlib.h"
 
 #include "models/squiggle_dna_test.h"
 
-
 // Forward declarations of raw posterior probability functions
 scrappie_matrix nanonet_raw_posterior(const raw_table signal, float min_prob, bool return_log);
 scrappie_matrix nanonet_rgr_posterior(const raw_table signal, float min_prob, bool return_log);
@@ -82,7 +83,432 @@ posterior_function_ptr get_posterior_function(const enum raw_model_type model){
     return NULL;
 }
 
+//  Parameters of each model, by name, for loading from model files
+#define MODEL_PARAMETER(NAME) {#NAME, &_ ## NAME}
+static const struct model_parameter events_parameters[] = {
+    MODEL_PARAMETER(lstmF1_iW), MODEL_PARAMETER(lstmF1_sW), MODEL_PARAMETER(lstmF1_b),
+    MODEL_PARAMETER(lstmF1_p), MODEL_PARAMETER(lstmB1_iW), MODEL_PARAMETER(lstmB1_sW),
+    MODEL_PARAMETER(lstmB1_b), MODEL_PARAMETER(lstmB1_p), MODEL_PARAMETER(FF1_Wf),
+    MODEL_PARAMETER(FF1_Wb), MODEL_PARAMETER(FF1_b), MODEL_PARAMETER(lstmF2_iW),
+    MODEL_PARAMETER(lstmF2_sW), MODEL_PARAMETER(lstmF2_b), MODEL_PARAMETER(lstmF2_p),
+    MODEL_PARAMETER(lstmB2_iW), MODEL_PARAMETER(lstmB2_sW), MODEL_PARAMETER(lstmB2_b),
+    MODEL_PARAMETER(lstmB2_p), MODEL_PARAMETER(FF2_Wf), MODEL_PARAMETER(FF2_Wb),
+    MODEL_PARAMETER(FF2_b), MODEL_PARAMETER(FF3_W), MODEL_PARAMETER(FF3_b)
+};
+static const struct model_parameter raw_parameters[] = {
+    MODEL_PARAMETER(conv_raw_W), MODEL_PARAMETER(conv_raw_b), MODEL_PARAMETER(gruF1_raw_iW),
+    MODEL_PARAMETER(gruF1_raw_sW), MODEL_PARAMETER(gruF1_raw_sW2), MODEL_PARAMETER(gruF1_raw_b),
+    MODEL_PARAMETER(gruB1_raw_iW), MODEL_PARAMETER(gruB1_raw_sW),
+    MODEL_PARAMETER(gruB1_raw_sW2), MODEL_PARAMETER(gruB1_raw_b), MODEL_PARAMETER(FF1_raw_Wf),
+    MODEL_PARAMETER(FF1_raw_Wb), MODEL_PARAMETER(FF1_raw_b), MODEL_PARAMETER(gruF2_raw_iW),
+    MODEL_PARAMETER(gruF2_raw_sW), MODEL_PARAMETER(gruF2_raw_sW2), MODEL_PARAMETER(gruF2_raw_b),
+    MODEL_PARAMETER(gruB2_raw_iW), MODEL_PARAMETER(gruB2_raw_sW),
+    MODEL_PARAMETER(gruB2_raw_sW2), MODEL_PARAMETER(gruB2_raw_b), MODEL_PARAMETER(FF2_raw_Wf),
+    MODEL_PARAMETER(FF2_raw_Wb), MODEL_PARAMETER(FF2_raw_b), MODEL_PARAMETER(FF3_raw_W),
+    MODEL_PARAMETER(FF3_raw_b)
+};
+static const struct model_parameter rgr_parameters[] = {
+    MODEL_PARAMETER(conv_rgr_W), MODEL_PARAMETER(conv_rgr_b), MODEL_PARAMETER(gruB1_rgr_iW),
+    MODEL_PARAMETER(gruB1_rgr_sW), MODEL_PARAMETER(gruB1_rgr_sW2), MODEL_PARAMETER(gruB1_rgr_b),
+    MODEL_PARAMETER(gruF2_rgr_iW), MODEL_PARAMETER(gruF2_rgr_sW),
+    MODEL_PARAMETER(gruF2_rgr_sW2), MODEL_PARAMETER(gruF2_rgr_b), MODEL_PARAMETER(gruB3_rgr_iW),
+    MODEL_PARAMETER(gruB3_rgr_sW), MODEL_PARAMETER(gruB3_rgr_sW2), MODEL_PARAMETER(gruB3_rgr_b),
+    MODEL_PARAMETER(FF_rgr_W), MODEL_PARAMETER(FF_rgr_b)
+};
+static const struct model_parameter rgrgr_r94_parameters[] = {
+    MODEL_PARAMETER(conv_rgrgr_r94_W), MODEL_PARAMETER(conv_rgrgr_r94_b),
+    MODEL_PARAMETER(gruB1_rgrgr_r94_iW), MODEL_PARAMETER(gruB1_rgrgr_r94_sW),
+    MODEL_PARAMETER(gruB1_rgrgr_r94_sW2), MODEL_PARAMETER(gruB1_rgrgr_r94_b),
+    MODEL_PARAMETER(gruF2_rgrgr_r94_iW), MODEL_PARAMETER(gruF2_rgrgr_r94_sW),
+    MODEL_PARAMETER(gruF2_rgrgr_r94_sW2), MODEL_PARAMETER(gruF2_rgrgr_r94_b),
+    MODEL_PARAMETER(gruB3_rgrgr_r94_iW), MODEL_PARAMETER(gruB3_rgrgr_r94_sW),
+    MODEL_PARAMETER(gruB3_rgrgr_r94_sW2), MODEL_PARAMETER(gruB3_rgrgr_r94_b),
+    MODEL_PARAMETER(gruF4_rgrgr_r94_iW), MODEL_PARAMETER(gruF4_rgrgr_r94_sW),
+    MODEL_PARAMETER(gruF4_rgrgr_r94_sW2), MODEL_PARAMETER(gruF4_rgrgr_r94_b),
+    MODEL_PARAMETER(gruB5_rgrgr_r94_iW), MODEL_PARAMETER(gruB5_rgrgr_r94_sW),
+    MODEL_PARAMETER(gruB5_rgrgr_r94_sW2), MODEL_PARAMETER(gruB5_rgrgr_r94_b),
+    MODEL_PARAMETER(FF_rgrgr_r94_W), MODEL_PARAMETER(FF_rgrgr_r94_b)
+};
+static const struct model_parameter rgrgr_r95_parameters[] = {
+    MODEL_PARAMETER(conv_rgrgr_r95_W), MODEL_PARAMETER(conv_rgrgr_r95_b),
+    MODEL_PARAMETER(gruB1_rgrgr_r95_iW), MODEL_PARAMETER(gruB1_rgrgr_r95_sW),
+    MODEL_PARAMETER(gruB1_rgrgr_r95_sW2), MODEL_PARAMETER(gruB1_rgrgr_r95_b),
+    MODEL_PARAMETER(gruF2_rgrgr_r95_iW), MODEL_PARAMETER(gruF2_rgrgr_r95_sW),
+    MODEL_PARAMETER(gruF2_rgrgr_r95_sW2), MODEL_PARAMETER(gruF2_rgrgr_r95_b),
+    MODEL_PARAMETER(gruB3_rgrgr_r95_iW), MODEL_PARAMETER(gruB3_rgrgr_r95_sW),
+    MODEL_PARAMETER(gruB3_rgrgr_r95_sW2), MODEL_PARAMETER(gruB3_rgrgr_r95_b),
+    MODEL_PARAMETER(gruF4_rgrgr_r95_iW), MODEL_PARAMETER(gruF4_rgrgr_r95_sW),
+    MODEL_PARAMETER(gruF4_rgrgr_r95_sW2), MODEL_PARAMETER(gruF4_rgrgr_r95_b),
+    MODEL_PARAMETER(gruB5_rgrgr_r95_iW), MODEL_PARAMETER(gruB5_rgrgr_r95_sW),
+    MODEL_PARAMETER(gruB5_rgrgr_r95_sW2), MODEL_PARAMETER(gruB5_rgrgr_r95_b),
+    MODEL_PARAMETER(FF_rgrgr_r95_W), MODEL_PARAMETER(FF_rgrgr_r95_b)
+};
+static const struct model_parameter rnnrf_r94_parameters[] = {
+    MODEL_PARAMETER(conv_rnnrf_r94_W), MODEL_PARAMETER(conv_rnnrf_r94_b),
+    MODEL_PARAMETER(gruB1_rnnrf_r94_iW), MODEL_PARAMETER(gruB1_rnnrf_r94_sW),
+    MODEL_PARAMETER(gruB1_rnnrf_r94_sW2), MODEL_PARAMETER(gruB1_rnnrf_r94_b),
+    MODEL_PARAMETER(gruF2_rnnrf_r94_iW), MODEL_PARAMETER(gruF2_rnnrf_r94_sW),
+    MODEL_PARAMETER(gruF2_rnnrf_r94_sW2), MODEL_PARAMETER(gruF2_rnnrf_r94_b),
+    MODEL_PARAMETER(gruB3_rnnrf_r94_iW), MODEL_PARAMETER(gruB3_rnnrf_r94_sW),
+    MODEL_PARAMETER(gruB3_rnnrf_r94_sW2), MODEL_PARAMETER(gruB3_rnnrf_r94_b),
+    MODEL_PARAMETER(gruF4_rnnrf_r94_iW), MODEL_PARAMETER(gruF4_rnnrf_r94_sW),
+    MODEL_PARAMETER(gruF4_rnnrf_r94_sW2), MODEL_PARAMETER(gruF4_rnnrf_r94_b),
+    MODEL_PARAMETER(gruB5_rnnrf_r94_iW), MODEL_PARAMETER(gruB5_rnnrf_r94_sW),
+    MODEL_PARAMETER(gruB5_rnnrf_r94_sW2), MODEL_PARAMETER(gruB5_rnnrf_r94_b),
+    MODEL_PARAMETER(FF_rnnrf_r94_W), MODEL_PARAMETER(FF_rnnrf_r94_b)
+};
+
+//  Weight matrices of each model that may be stored at reduced precision or packed
+static _Mat * const events_weights[] = {
+    &_lstmF1_iW, &_lstmF1_sW, &_lstmB1_iW, &_lstmB1_sW, &_FF1_Wf, &_FF1_Wb, &_lstmF2_iW,
+    &_lstmF2_sW, &_lstmB2_iW, &_lstmB2_sW, &_FF2_Wf, &_FF2_Wb, &_FF3_W
+};
+static _Mat * const raw_weights[] = {
+    &_conv_raw_W, &_gruF1_raw_iW, &_gruF1_raw_sW, &_gruF1_raw_sW2, &_gruB1_raw_iW,
+    &_gruB1_raw_sW, &_gruB1_raw_sW2, &_FF1_raw_Wf, &_FF1_raw_Wb, &_gruF2_raw_iW,
+    &_gruF2_raw_sW, &_gruF2_raw_sW2, &_gruB2_raw_iW, &_gruB2_raw_sW, &_gruB2_raw_sW2,
+    &_FF2_raw_Wf, &_FF2_raw_Wb, &_FF3_raw_W
+};
+static _Mat * const rgr_weights[] = {
+    &_conv_rgr_W, &_gruB1_rgr_iW, &_gruB1_rgr_sW, &_gruB1_rgr_sW2, &_gruF2_rgr_iW,
+    &_gruF2_rgr_sW, &_gruF2_rgr_sW2, &_gruB3_rgr_iW, &_gruB3_rgr_sW, &_gruB3_rgr_sW2,
+    &_FF_rgr_W
+};
+static _Mat * const rgrgr_r94_weights[] = {
+    &_conv_rgrgr_r94_W, &_gruB1_rgrgr_r94_iW, &_gruB1_rgrgr_r94_sW, &_gruB1_rgrgr_r94_sW2,
+    &_gruF2_rgrgr_r94_iW, &_gruF2_rgrgr_r94_sW, &_gruF2_rgrgr_r94_sW2, &_gruB3_rgrgr_r94_iW,
+    &_gruB3_rgrgr_r94_sW, &_gruB3_rgrgr_r94_sW2, &_gruF4_rgrgr_r94_iW, &_gruF4_rgrgr_r94_sW,
+    &_gruF4_rgrgr_r94_sW2, &_gruB5_rgrgr_r94_iW, &_gruB5_rgrgr_r94_sW,
+    &_gruB5_rgrgr_r94_sW2, &_FF_rgrgr_r94_W
+};
+static _Mat * const rgrgr_r95_weights[] = {
+    &_conv_rgrgr_r95_W, &_gruB1_rgrgr_r95_iW, &_gruB1_rgrgr_r95_sW, &_gruB1_rgrgr_r95_sW2,
+    &_gruF2_rgrgr_r95_iW, &_gruF2_rgrgr_r95_sW, &_gruF2_rgrgr_r95_sW2, &_gruB3_rgrgr_r95_iW,
+    &_gruB3_rgrgr_r95_sW, &_gruB3_rgrgr_r95_sW2, &_gruF4_rgrgr_r95_iW, &_gruF4_rgrgr_r95_sW,
+    &_gruF4_rgrgr_r95_sW2, &_gruB5_rgrgr_r95_iW, &_gruB5_rgrgr_r95_sW,
+    &_gruB5_rgrgr_r95_sW2, &_FF_rgrgr_r95_W
+};
+static _Mat * const rnnrf_r94_weights[] = {
+    &_conv_rnnrf_r94_W, &_gruB1_rnnrf_r94_iW, &_gruB1_rnnrf_r94_sW, &_gruB1_rnnrf_r94_sW2,
+    &_gruF2_rnnrf_r94_iW, &_gruF2_rnnrf_r94_sW, &_gruF2_rnnrf_r94_sW2, &_gruB3_rnnrf_r94_iW,
+    &_gruB3_rnnrf_r94_sW, &_gruB3_rnnrf_r94_sW2, &_gruF4_rnnrf_r94_iW, &_gruF4_rnnrf_r94_sW,
+    &_gruF4_rnnrf_r94_sW2, &_gruB5_rnnrf_r94_iW, &_gruB5_rnnrf_r94_sW,
+    &_gruB5_rnnrf_r94_sW2, &_FF_rnnrf_r94_W
+};
+
+//  Recurrent and output weights of each raw model, which may be pruned
+static _Mat * const raw_sparse_weights[] = {
+    &_gruF1_raw_sW, &_gruF1_raw_sW2, &_gruB1_raw_sW, &_gruB1_raw_sW2, &_gruF2_raw_sW,
+    &_gruF2_raw_sW2, &_gruB2_raw_sW, &_gruB2_raw_sW2, &_FF3_raw_W
+};
+static _Mat * const rgr_sparse_weights[] = {
+    &_gruB1_rgr_sW, &_gruB1_rgr_sW2, &_gruF2_rgr_sW, &_gruF2_rgr_sW2, &_gruB3_rgr_sW,
+    &_gruB3_rgr_sW2, &_FF_rgr_W
+};
+static _Mat * const rgrgr_r94_sparse_weights[] = {
+    &_gruB1_rgrgr_r94_sW, &_gruB1_rgrgr_r94_sW2, &_gruF2_rgrgr_r94_sW, &_gruF2_rgrgr_r94_sW2,
+    &_gruB3_rgrgr_r94_sW, &_gruB3_rgrgr_r94_sW2, &_gruF4_rgrgr_r94_sW, &_gruF4_rgrgr_r94_sW2,
+    &_gruB5_rgrgr_r94_sW, &_gruB5_rgrgr_r94_sW2, &_FF_rgrgr_r94_W
+};
+static _Mat * const rgrgr_r95_sparse_weights[] = {
+    &_gruB1_rgrgr_r95_sW, &_gruB1_rgrgr_r95_sW2, &_gruF2_rgrgr_r95_sW, &_gruF2_rgrgr_r95_sW2,
+    &_gruB3_rgrgr_r95_sW, &_gruB3_rgrgr_r95_sW2, &_gruF4_rgrgr_r95_sW, &_gruF4_rgrgr_r95_sW2,
+    &_gruB5_rgrgr_r95_sW, &_gruB5_rgrgr_r95_sW2, &_FF_rgrgr_r95_W
+};
+static _Mat * const rnnrf_r94_sparse_weights[] = {
+    &_gruB1_rnnrf_r94_sW, &_gruB1_rnnrf_r94_sW2, &_gruF2_rnnrf_r94_sW, &_gruF2_rnnrf_r94_sW2,
+    &_gruB3_rnnrf_r94_sW, &_gruB3_rnnrf_r94_sW2, &_gruF4_rnnrf_r94_sW, &_gruF4_rnnrf_r94_sW2,
+    &_gruB5_rnnrf_r94_sW, &_gruB5_rnnrf_r94_sW2, &_FF_rnnrf_r94_W
+};
+
+/**  Set precision of weights for raw model
+ *
+ *   Converts the weights of the model, replacing any previously converted
+ *   weights.  Not thread safe; should be called before basecalling starts.
+ *
+ *   @param model Raw model
+ *   @param precision Precision of weights
+ *
+ *   @returns true on success
+ **/
+bool set_raw_model_precision(const enum raw_model_type model, const enum scrappie_precision precision){
+    switch(model){
+    case SCRAPPIE_MODEL_RAW:
+        return set_weight_precision(raw_weights, sizeof(raw_weights) / sizeof(raw_weights[0]), precision);
+    case SCRAPPIE_MODEL_RGR:
+        return set_weight_precision(rgr_weights, sizeof(rgr_weights) / sizeof(rgr_weights[0]), precision);
+    case SCRAPPIE_MODEL_RGRGR_R94:
+        return set_weight_precision(rgrgr_r94_weights, sizeof(rgrgr_r94_weights) / sizeof(rgrgr_r94_weights[0]), precision);
+    case SCRAPPIE_MODEL_RGRGR_R95:
+        return set_weight_precision(rgrgr_r95_weights, sizeof(rgrgr_r95_weights) / sizeof(rgrgr_r95_weights[0]), precision);
+    case SCRAPPIE_MODEL_RNNRF_R94:
+        return set_weight_precision(rnnrf_r94_weights, sizeof(rnnrf_r94_weights) / sizeof(rnnrf_r94_weights[0]), precision);
+    case SCRAPPIE_MODEL_INVALID:
+        errx(EXIT_FAILURE, "Invalid scrappie model %s:%d", __FILE__, __LINE__);
+    default:
+        errx(EXIT_FAILURE, "Scrappie enum failure -- report bug\n");
+    }
+
+    return false;
+}
+
+/**  Prune recurrent and output weights of raw model
+ *
+ *   The remaining weights of the model are packed at single precision.  Not
+ *   thread safe; should be called before basecalling starts.
+ *
+ *   @param model Raw model
+ *   @param sparsity Fraction of blocks of each matrix to drop
+ *
+ *   @returns true on success
+ **/
+bool set_raw_model_sparsity(const enum raw_model_type model, float sparsity){
+    RETURN_NULL_IF(!set_raw_model_precision(model, SCRAPPIE_PRECISION_FLOAT32), false);
+    switch(model){
+    case SCRAPPIE_MODEL_RAW:
+        return set_weight_sparsity(raw_sparse_weights, sizeof(raw_sparse_weights) / sizeof(raw_sparse_weights[0]), sparsity);
+    case SCRAPPIE_MODEL_RGR:
+        return set_weight_sparsity(rgr_sparse_weights, sizeof(rgr_sparse_weights) / sizeof(rgr_sparse_weights[0]), sparsity);
+    case SCRAPPIE_MODEL_RGRGR_R94:
+        return set_weight_sparsity(rgrgr_r94_sparse_weights, sizeof(rgrgr_r94_sparse_weights) / sizeof(rgrgr_r94_sparse_weights[0]), sparsity);
+    case SCRAPPIE_MODEL_RGRGR_R95:
+        return set_weight_sparsity(rgrgr_r95_sparse_weights, sizeof(rgrgr_r95_sparse_weights) / sizeof(rgrgr_r95_sparse_weights[0]), sparsity);
+    case SCRAPPIE_MODEL_RNNRF_R94:
+        return set_weight_sparsity(rnnrf_r94_sparse_weights, sizeof(rnnrf_r94_sparse_weights) / sizeof(rnnrf_r94_sparse_weights[0]), sparsity);
+    case SCRAPPIE_MODEL_INVALID:
+        errx(EXIT_FAILURE, "Invalid scrappie model %s:%d", __FILE__, __LINE__);
+    default:
+        errx(EXIT_FAILURE, "Scrappie enum failure -- report bug\n");
+    }
+
+    return false;
+}
+
+/**  Set precision of weights for events model
+ *
+ *   @param precision Precision of weights
+ *
+ *   @returns true on success
+ **/
+bool set_events_model_precision(const enum scrappie_precision precision){
+    return set_weight_precision(events_weights, sizeof(events_weights) / sizeof(events_weights[0]), precision);
+}
+
+
+//  Model files currently bound to the parameters of each model
+static scrappie_model_file raw_model_files[SCRAPPIE_MODEL_INVALID] = {NULL};
+static scrappie_model_file events_model_file = NULL;
+
+/**  Bind parameters of a model to a model file, replacing any file
+ *   previously bound
+ *
+ *   @param params Parameters of model
+ *   @param nparam Number of parameters
+ *   @param filename Name of model file
+ *   @param bound Model file currently bound, updated on success
+ *
+ *   @returns true on success.  On failure the model is unchanged.
+ **/
+static bool load_model_file(const struct model_parameter * params, size_t nparam,
+                            const char * filename, scrappie_model_file * bound){
+    scrappie_model_file model = open_model_file(filename);
+    RETURN_NULL_IF(NULL == model, false);
+    if(!bind_model_parameters(params, nparam, model)){
+        warnx("Model file \"%s\" does not match model.", filename);
+        model = close_model_file(model);
+        return false;
+    }
+    close_model_file(*bound);
+    *bound = model;
+    return true;
+}
+
+/**  Load parameters of raw model from a model file
+ *
+ *   The weights of the compiled-in model are replaced by those mapped from
+ *   the file.  Not thread safe; should be called before basecalling starts
+ *   and before set_raw_model_precision.
+ *
+ *   @param model Raw model
+ *   @param filename Name of model file
+ *
+ *   @returns true on success
+ **/
+bool load_raw_model_file(const enum raw_model_type model, const char * filename){
+    RETURN_NULL_IF(NULL == filename, false);
+    //  Converted weights refer to the parameters being replaced
+    RETURN_NULL_IF(!set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32), false);
+
+    switch(model){
+    case SCRAPPIE_MODEL_RAW:
+        return load_model_file(raw_parameters, sizeof(raw_parameters) / sizeof(raw_parameters[0]),
+                               filename, raw_model_files + model);
+    case SCRAPPIE_MODEL_RGR:
+        return load_model_file(rgr_parameters, sizeof(rgr_parameters) / sizeof(rgr_parameters[0]),
+                               filename, raw_model_files + model);
+    case SCRAPPIE_MODEL_RGRGR_R94:
+        return load_model_file(rgrgr_r94_parameters, sizeof(rgrgr_r94_parameters) / sizeof(rgrgr_r94_parameters[0]),
+                               filename, raw_model_files + model);
+    case SCRAPPIE_MODEL_RGRGR_R95:
+        return load_model_file(rgrgr_r95_parameters, sizeof(rgrgr_r95_parameters) / sizeof(rgrgr_r95_parameters[0]),
+                               filename, raw_model_files + model);
+    case SCRAPPIE_MODEL_RNNRF_R94:
+        return load_model_file(rnnrf_r94_parameters, sizeof(rnnrf_r94_parameters) / sizeof(rnnrf_r94_parameters[0]),
+                               filename, raw_model_files + model);
+    case SCRAPPIE_MODEL_INVALID:
+        errx(EXIT_FAILURE, "Invalid scrappie model %s:%d", __FILE__, __LINE__);
+    default:
+        errx(EXIT_FAILURE, "Scrappie enum failure -- report bug\n");
+    }
+
+    return false;
+}
+
+/**  Load parameters of events model from a model file
+ *
+ *   Not thread safe; should be called before basecalling starts and before
+ *   set_events_model_precision.
+ *
+ *   @param filename Name of model file
+ *
+ *   @returns true on success
+ **/
+bool load_events_model_file(const char * filename){
+    RETURN_NULL_IF(NULL == filename, false);
+    RETURN_NULL_IF(!set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32), false);
+    return load_model_file(events_parameters, sizeof(events_parameters) / sizeof(events_parameters[0]),
+                           filename, &events_model_file);
+}
+
+
+
+//  Network descriptions.  Indices refer to the output of earlier layers.
+static const int events_stride = 1;
+static const struct network_layer events_layers[] = {
+    //  The LSTM input weights act on a window of three events, which is a
+    //  convolution with unit stride
+    CONVOLUTION_LAYER(NETWORK_INPUT, &_lstmF1_iW, &_lstmF1_b, &events_stride),
+    CONVOLUTION_LAYER(NETWORK_INPUT, &_lstmB1_iW, &_lstmB1_b, &events_stride),
+    LSTM_LAYER(LAYER_LSTM_FORWARD, 0, &_lstmF1_sW, &_lstmF1_p),
+    LSTM_LAYER(LAYER_LSTM_BACKWARD, 1, &_lstmB1_sW, &_lstmB1_p),
+    FEEDFORWARD2_LAYER(2, 3, &_FF1_Wf, &_FF1_Wb, &_FF1_b),
+    FEEDFORWARD_LAYER(LAYER_FEEDFORWARD_LINEAR, 4, &_lstmF2_iW, &_lstmF2_b),
+    FEEDFORWARD_LAYER(LAYER_FEEDFORWARD_LINEAR, 4, &_lstmB2_iW, &_lstmB2_b),
+    LSTM_LAYER(LAYER_LSTM_FORWARD, 5, &_lstmF2_sW, &_lstmF2_p),
+    LSTM_LAYER(LAYER_LSTM_BACKWARD, 6, &_lstmB2_sW, &_lstmB2_p),
+    FEEDFORWARD2_LAYER(7, 8, &_FF2_Wf, &_FF2_Wb, &_FF2_b),
+    FEEDFORWARD_LAYER(LAYER_SOFTMAX, 9, &_FF3_W, &_FF3_b)
+};
+static const struct network_layer raw_layers[] = {
+    CONVOLUTION_LAYER(NETWORK_INPUT, &_conv_raw_W, &_conv_raw_b, &conv_raw_stride),
+    ACTIVATION_LAYER(LAYER_TANH, 0),
+    GRU_LAYER(LAYER_GRU_FORWARD, 1, &_gruF1_raw_iW, &_gruF1_raw_b, &_gruF1_raw_sW, &_gruF1_raw_sW2),
+    GRU_LAYER(LAYER_GRU_BACKWARD, 1, &_gruB1_raw_iW, &_gruB1_raw_b, &_gruB1_raw_sW, &_gruB1_raw_sW2),
+    FEEDFORWARD2_LAYER(2, 3, &_FF1_raw_Wf, &_FF1_raw_Wb, &_FF1_raw_b),
+    GRU_LAYER(LAYER_GRU_FORWARD, 4, &_gruF2_raw_iW, &_gruF2_raw_b, &_gruF2_raw_sW, &_gruF2_raw_sW2),
+    GRU_LAYER(LAYER_GRU_BACKWARD, 4, &_gruB2_raw_iW, &_gruB2_raw_b, &_gruB2_raw_sW, &_gruB2_raw_sW2),
+    FEEDFORWARD2_LAYER(5, 6, &_FF2_raw_Wf, &_FF2_raw_Wb, &_FF2_raw_b),
+    FEEDFORWARD_LAYER(LAYER_SOFTMAX, 7, &_FF3_raw_W, &_FF3_raw_b)
+};
+static const struct network_layer rgr_layers[] = {
+    CONVOLUTION_LAYER(NETWORK_INPUT, &_conv_rgr_W, &_conv_rgr_b, &conv_rgr_stride),
+    ACTIVATION_LAYER(LAYER_ELU, 0),
+    GRU_LAYER(LAYER_GRU_BACKWARD, 1, &_gruB1_rgr_iW, &_gruB1_rgr_b, &_gruB1_rgr_sW, &_gruB1_rgr_sW2),
+    GRU_LAYER(LAYER_GRU_FORWARD, 2, &_gruF2_rgr_iW, &_gruF2_rgr_b, &_gruF2_rgr_sW, &_gruF2_rgr_sW2),
+    GRU_LAYER(LAYER_GRU_BACKWARD, 3, &_gruB3_rgr_iW, &_gruB3_rgr_b, &_gruB3_rgr_sW, &_gruB3_rgr_sW2),
+    FEEDFORWARD_LAYER(LAYER_SOFTMAX, 4, &_FF_rgr_W, &_FF_rgr_b)
+};
+#define RGRGR_LAYERS(NAME, ACTIVATION) { \
+    CONVOLUTION_LAYER(NETWORK_INPUT, &_conv_ ## NAME ## _W, &_conv_ ## NAME ## _b, &conv_ ## NAME ## _stride), \
+    ACTIVATION_LAYER(ACTIVATION, 0), \
+    GRU_LAYER(LAYER_GRU_BACKWARD, 1, &_gruB1_ ## NAME ## _iW, &_gruB1_ ## NAME ## _b, &_gruB1_ ## NAME ## _sW, &_gruB1_ ## NAME ## _sW2), \
+    GRU_LAYER(LAYER_GRU_FORWARD, 2, &_gruF2_ ## NAME ## _iW, &_gruF2_ ## NAME ## _b, &_gruF2_ ## NAME ## _sW, &_gruF2_ ## NAME ## _sW2), \
+    GRU_LAYER(LAYER_GRU_BACKWARD, 3, &_gruB3_ ## NAME ## _iW, &_gruB3_ ## NAME ## _b, &_gruB3_ ## NAME ## _sW, &_gruB3_ ## NAME ## _sW2), \
+    GRU_LAYER(LAYER_GRU_FORWARD, 4, &_gruF4_ ## NAME ## _iW, &_gruF4_ ## NAME ## _b, &_gruF4_ ## NAME ## _sW, &_gruF4_ ## NAME ## _sW2), \
+    GRU_LAYER(LAYER_GRU_BACKWARD, 5, &_gruB5_ ## NAME ## _iW, &_gruB5_ ## NAME ## _b, &_gruB5_ ## NAME ## _sW, &_gruB5_ ## NAME ## _sW2), \
+    FEEDFORWARD_LAYER(LAYER_SOFTMAX, 6, &_FF_ ## NAME ## _W, &_FF_ ## NAME ## _b) \
+}
+static const struct network_layer rgrgr_r94_layers[] = RGRGR_LAYERS(rgrgr_r94, LAYER_ELU);
+static const struct network_layer rgrgr_r95_layers[] = RGRGR_LAYERS(rgrgr_r95, LAYER_TANH);
+//  Each GRU layer is wrapped in a residual connection
+static const struct network_layer rnnrf_r94_layers[] = {
+    CONVOLUTION_LAYER(NETWORK_INPUT, &_conv_rnnrf_r94_W, &_conv_rnnrf_r94_b, &conv_rnnrf_r94_stride),
+    ACTIVATION_LAYER(LAYER_ELU, 0),
+    GRU_LAYER(LAYER_GRU_BACKWARD, 1, &_gruB1_rnnrf_r94_iW, &_gruB1_rnnrf_r94_b, &_gruB1_rnnrf_r94_sW, &_gruB1_rnnrf_r94_sW2),
+    RESIDUAL_LAYER(2, 1),
+    GRU_LAYER(LAYER_GRU_FORWARD, 3, &_gruF2_rnnrf_r94_iW, &_gruF2_rnnrf_r94_b, &_gruF2_rnnrf_r94_sW, &_gruF2_rnnrf_r94_sW2),
+    RESIDUAL_LAYER(4, 3),
+    GRU_LAYER(LAYER_GRU_BACKWARD, 5, &_gruB3_rnnrf_r94_iW, &_gruB3_rnnrf_r94_b, &_gruB3_rnnrf_r94_sW, &_gruB3_rnnrf_r94_sW2),
+    RESIDUAL_LAYER(6, 5),
+    GRU_LAYER(LAYER_GRU_FORWARD, 7, &_gruF4_rnnrf_r94_iW, &_gruF4_rnnrf_r94_b, &_gruF4_rnnrf_r94_sW, &_gruF4_rnnrf_r94_sW2),
+    RESIDUAL_LAYER(8, 7),
+    GRU_LAYER(LAYER_GRU_BACKWARD, 9, &_gruB5_rnnrf_r94_iW, &_gruB5_rnnrf_r94_b, &_gruB5_rnnrf_r94_sW, &_gruB5_rnnrf_r94_sW2),
+    RESIDUAL_LAYER(10, 9),
+    FEEDFORWARD_LAYER(LAYER_GLOBALNORM, 11, &_FF_rnnrf_r94_W, &_FF_rnnrf_r94_b)
+};
+//  Sequence embedding is applied before the network; convolutions 2 to 5 are
+//  wrapped in residual layers
+static const struct network_layer squiggle_layers[] = {
+    CONVOLUTION_LAYER(NETWORK_INPUT, &_conv1_squiggle_dna_W, &_conv1_squiggle_dna_b, &conv1_squiggle_dna_stride),
+    ACTIVATION_LAYER(LAYER_TANH, 0),
+    CONVOLUTION_LAYER(1, &_conv2_squiggle_dna_W, &_conv2_squiggle_dna_b, &conv2_squiggle_dna_stride),
+    ACTIVATION_LAYER(LAYER_TANH, 2),
+    RESIDUAL_LAYER(3, 1),
+    CONVOLUTION_LAYER(4, &_conv3_squiggle_dna_W, &_conv3_squiggle_dna_b, &conv3_squiggle_dna_stride),
+    ACTIVATION_LAYER(LAYER_TANH, 5),
+    RESIDUAL_LAYER(6, 4),
+    CONVOLUTION_LAYER(7, &_conv4_squiggle_dna_W, &_conv4_squiggle_dna_b, &conv4_squiggle_dna_stride),
+    ACTIVATION_LAYER(LAYER_TANH, 8),
+    RESIDUAL_LAYER(9, 7),
+    CONVOLUTION_LAYER(10, &_conv5_squiggle_dna_W, &_conv5_squiggle_dna_b, &conv5_squiggle_dna_stride),
+    ACTIVATION_LAYER(LAYER_TANH, 11),
+    RESIDUAL_LAYER(12, 10),
+    CONVOLUTION_LAYER(13, &_conv6_squiggle_dna_W, &_conv6_squiggle_dna_b, &conv6_squiggle_dna_stride)
+};
+
+#define NETWORK_GRAPH(NAME, STR) \
+    static double NAME ## _timing[NLAYER(NAME ## _layers)]; \
+    static const struct network_graph NAME ## _network = { \
+        .name = STR, .nlayer = NLAYER(NAME ## _layers), .layers = NAME ## _layers, .timing = NAME ## _timing}
+NETWORK_GRAPH(events, "events");
+NETWORK_GRAPH(raw, "raw_r94");
+NETWORK_GRAPH(rgr, "rgr_r94");
+NETWORK_GRAPH(rgrgr_r94, "rgrgr_r94");
+NETWORK_GRAPH(rgrgr_r95, "rgrgr_r95");
+NETWORK_GRAPH(rnnrf_r94, "rnnrf_r94");
+NETWORK_GRAPH(squiggle, "squiggle_dna");
+
+
+/**  Description of network for raw model
+ *
+ *   @param model Raw model
+ *
+ *   @returns Network
+ **/
+const struct network_graph * get_raw_network(const enum raw_model_type model){
+    switch(model){
+    case SCRAPPIE_MODEL_RAW:
+        return &raw_network;
+    case SCRAPPIE_MODEL_RGR:
+        return &rgr_network;
+    case SCRAPPIE_MODEL_RGRGR_R94:
+        return &rgrgr_r94_network;
+    case SCRAPPIE_MODEL_RGRGR_R95:
+        return &rgrgr_r95_network;
+    case SCRAPPIE_MODEL_RNNRF_R94:
+        return &rnnrf_r94_network;
+    case SCRAPPIE_MODEL_INVALID:
+        errx(EXIT_FAILURE, "Invalid scrappie model %s:%d", __FILE__, __LINE__);
+    default:
+        errx(EXIT_FAILURE, "Scrappie enum failure -- report bug\n");
+    }
+
+    return NULL;
+}
 
+const struct network_graph * get_events_network(void){
+    return &events_network;
+}
 
 
 scrappie_matrix nanonet_posterior(const event_table events, float min_prob,
@@ -91,230 +517,88 @@ scrappie_matrix nanonet_posterior(const event_table events, float min_prob,
     RETURN_NULL_IF(0 == events.n, NULL);
     RETURN_NULL_IF(NULL == events.event, NULL);
 
-    const int WINLEN = 3;
-
-    //  Make features
     scrappie_matrix features = nanonet_features_from_events(events, true);
-    scrappie_matrix feature3 = window(features, WINLEN, 1);
+    RETURN_NULL_IF(NULL == features, NULL);
+    scrappie_matrix post = run_network_graph(&events_network, features, min_prob, return_log);
     features = free_scrappie_matrix(features);
 
-    // Initial transformation of input for LSTM layer
-    scrappie_matrix lstmXf =
-        feedforward_linear(feature3, lstmF1_iW, lstmF1_b, NULL);
-    scrappie_matrix lstmXb =
-        feedforward_linear(feature3, lstmB1_iW, lstmB1_b, NULL);
-    feature3 = free_scrappie_matrix(feature3);
-    scrappie_matrix lstmF = lstm_forward(lstmXf, lstmF1_sW, lstmF1_p, NULL);
-    scrappie_matrix lstmB = lstm_backward(lstmXb, lstmB1_sW, lstmB1_p, NULL);
-
-    //  Combine LSTM output
-    scrappie_matrix lstmFF =
-        feedforward2_tanh(lstmF, lstmB, FF1_Wf, FF1_Wb, FF1_b, NULL);
-
-    lstmXf = feedforward_linear(lstmFF, lstmF2_iW, lstmF2_b, lstmXf);
-    lstmXb = feedforward_linear(lstmFF, lstmB2_iW, lstmB2_b, lstmXb);
-    lstmF = lstm_forward(lstmXf, lstmF2_sW, lstmF2_p, lstmF);
-    lstmXf = free_scrappie_matrix(lstmXf);
-    lstmB = lstm_backward(lstmXb, lstmB2_sW, lstmB2_p, lstmB);
-    lstmXb = free_scrappie_matrix(lstmXb);
-
-    // Combine LSTM output
-    lstmFF = feedforward2_tanh(lstmF, lstmB, FF2_Wf, FF2_Wb, FF2_b, lstmFF);
-    lstmF = free_scrappie_matrix(lstmF);
-    lstmB = free_scrappie_matrix(lstmB);
-
-    scrappie_matrix post = softmax(lstmFF, FF3_W, FF3_b, NULL);
-    lstmFF = free_scrappie_matrix(lstmFF);
-    RETURN_NULL_IF(NULL == post, NULL);
-
-    if (return_log) {
-        robustlog_activation_inplace(post, min_prob);
-    }
-
     return post;
 }
 
-scrappie_matrix nanonet_raw_posterior(const raw_table signal, float min_prob,
-                                      bool return_log) {
+/**  Run network for raw model on signal
+ *
+ *   @param net Network
+ *   @param signal Signal
+ *   @param min_prob Minimum bound on probabilities
+ *   @param return_log Whether to return log-probabilities
+ *
+ *   @returns Output of network
+ **/
+static scrappie_matrix raw_network_posterior(const struct network_graph * net, const raw_table signal,
+                                             float min_prob, bool return_log) {
     assert(min_prob >= 0.0 && min_prob <= 1.0);
     RETURN_NULL_IF(0 == signal.n, NULL);
     RETURN_NULL_IF(NULL == signal.raw, NULL);
 
     scrappie_matrix raw_mat = nanonet_features_from_raw(signal);
-    scrappie_matrix conv = convolution(raw_mat, conv_raw_W, conv_raw_b, conv_raw_stride, NULL);
-    tanh_activation_inplace(conv);
+    RETURN_NULL_IF(NULL == raw_mat, NULL);
+    scrappie_matrix post = run_network_graph(net, raw_mat, min_prob, return_log);
     raw_mat = free_scrappie_matrix(raw_mat);
 
-    //  First GRU layer
-    scrappie_matrix gruF1in = feedforward_linear(conv, gruF1_raw_iW, gruF1_raw_b, NULL);
-    scrappie_matrix gruB1in = feedforward_linear(conv, gruB1_raw_iW, gruB1_raw_b, NULL);
-    conv = free_scrappie_matrix(conv);
-
-    scrappie_matrix gruF = gru_forward(gruF1in, gruF1_raw_sW, gruF1_raw_sW2, NULL);
-    gruF1in = free_scrappie_matrix(gruF1in);
-    scrappie_matrix gruB = gru_backward(gruB1in, gruB1_raw_sW, gruB1_raw_sW2, NULL);
-    gruB1in = free_scrappie_matrix(gruB1in);
-
-    //  Combine with feed forward layer
-    scrappie_matrix gruFF =
-        feedforward2_tanh(gruF, gruB, FF1_raw_Wf, FF1_raw_Wb, FF1_raw_b, NULL);
-
-    //  Second GRU layer
-    scrappie_matrix gruF2in = feedforward_linear(gruFF, gruF2_raw_iW, gruF2_raw_b, NULL);
-    scrappie_matrix gruB2in = feedforward_linear(gruFF, gruB2_raw_iW, gruB2_raw_b, NULL);
-    gruFF = free_scrappie_matrix(gruFF);
-    gruF = gru_forward(gruF2in, gruF2_raw_sW, gruF2_raw_sW2, gruF);
-    gruF2in = free_scrappie_matrix(gruF2in);
-    gruB = gru_backward(gruB2in, gruB2_raw_sW, gruB2_raw_sW2, gruB);
-    gruB2in = free_scrappie_matrix(gruB2in);
-
-
-    //  Combine with feed forward layer
-    gruFF =
-        feedforward2_tanh(gruF, gruB, FF2_raw_Wf, FF2_raw_Wb, FF2_raw_b, gruFF);
-    gruF = free_scrappie_matrix(gruF);
-    gruB = free_scrappie_matrix(gruB);
-
-    scrappie_matrix post = softmax(gruFF, FF3_raw_W, FF3_raw_b, NULL);
-    gruFF = free_scrappie_matrix(gruFF);
-    RETURN_NULL_IF(NULL == post, NULL);
-
-    if (return_log) {
-        robustlog_activation_inplace(post, min_prob);
-    }
-
     return post;
 }
 
-scrappie_matrix nanonet_rgr_posterior(const raw_table signal, float min_prob,
-                                      bool return_log) {
+/**  Posterior of raw model from signal stored as DAQ values
+ *
+ *   The trimmed signal is normalised as it is converted to features, so
+ *   the signal need not be scaled to pA or normalised beforehand.
+ *
+ *   @param model Raw model
+ *   @param signal Trimmed signal
+ *   @param min_prob Minimum bound on probabilities
+ *   @param return_log Whether to return log-probabilities
+ *
+ *   @returns Output of network
+ **/
+scrappie_matrix daq_posterior(const enum raw_model_type model, const daq_table signal,
+                              float min_prob, bool return_log) {
     assert(min_prob >= 0.0 && min_prob <= 1.0);
-    RETURN_NULL_IF(0 == signal.n, NULL);
-    RETURN_NULL_IF(NULL == signal.raw, NULL);
+    assert(SCRAPPIE_MODEL_RNNRF_R94 != model || return_log);
+    const struct network_graph * net = get_raw_network(model);
+    RETURN_NULL_IF(NULL == net, NULL);
 
-    scrappie_matrix raw_mat = nanonet_features_from_raw(signal);
-    scrappie_matrix conv =
-        convolution(raw_mat, conv_rgr_W, conv_rgr_b, conv_rgr_stride, NULL);
-    elu_activation_inplace(conv);
+    scrappie_matrix raw_mat = nanonet_features_from_daq(signal);
+    RETURN_NULL_IF(NULL == raw_mat, NULL);
+    scrappie_matrix post = run_network_graph(net, raw_mat, min_prob, return_log);
     raw_mat = free_scrappie_matrix(raw_mat);
-    //  First GRU layer
-    scrappie_matrix gruB1in = feedforward_linear(conv, gruB1_rgr_iW, gruB1_rgr_b, NULL);
-    conv = free_scrappie_matrix(conv);
-    scrappie_matrix gruB1 = gru_backward(gruB1in, gruB1_rgr_sW, gruB1_rgr_sW2, NULL);
-    gruB1in = free_scrappie_matrix(gruB1in);
-    //  Second GRU layer
-    scrappie_matrix gruF2in = feedforward_linear(gruB1, gruF2_rgr_iW, gruF2_rgr_b, NULL);
-    gruB1 = free_scrappie_matrix(gruB1);
-    scrappie_matrix gruF2 = gru_forward(gruF2in, gruF2_rgr_sW, gruF2_rgr_sW2, NULL);
-    gruF2in = free_scrappie_matrix(gruF2in);
-    //  Third GRU layer
-    scrappie_matrix gruB3in = feedforward_linear(gruF2, gruB3_rgr_iW, gruB3_rgr_b, NULL);
-    gruF2 = free_scrappie_matrix(gruF2);
-    scrappie_matrix gruB3 = gru_backward(gruB3in, gruB3_rgr_sW, gruB3_rgr_sW2, NULL);
-    gruB3in = free_scrappie_matrix(gruB3in);
-
-    scrappie_matrix post = softmax(gruB3, FF_rgr_W, FF_rgr_b, NULL);
-    gruB3 = free_scrappie_matrix(gruB3);
-
-    if (return_log) {
-        robustlog_activation_inplace(post, min_prob);
-    }
 
     return post;
 }
 
-scrappie_matrix nanonet_rgrgr_r94_posterior(const raw_table signal, float min_prob,
+scrappie_matrix nanonet_raw_posterior(const raw_table signal, float min_prob,
                                       bool return_log) {
-    assert(min_prob >= 0.0 && min_prob <= 1.0);
-    RETURN_NULL_IF(0 == signal.n, NULL);
-    RETURN_NULL_IF(NULL == signal.raw, NULL);
+    return raw_network_posterior(&raw_network, signal, min_prob, return_log);
+}
 
-    scrappie_matrix raw_mat = nanonet_features_from_raw(signal);
-    scrappie_matrix conv =
-        convolution(raw_mat, conv_rgrgr_r94_W, conv_rgrgr_r94_b, conv_rgrgr_r94_stride, NULL);
-    elu_activation_inplace(conv);
-    raw_mat = free_scrappie_matrix(raw_mat);
-    //  First GRU layer
-    scrappie_matrix gruB1in = feedforward_linear(conv, gruB1_rgrgr_r94_iW, gruB1_rgrgr_r94_b, NULL);
-    conv = free_scrappie_matrix(conv);
-    scrappie_matrix gruB1 = gru_backward(gruB1in, gruB1_rgrgr_r94_sW, gruB1_rgrgr_r94_sW2, NULL);
-    gruB1in = free_scrappie_matrix(gruB1in);
-    //  Second GRU layer
-    scrappie_matrix gruF2in = feedforward_linear(gruB1, gruF2_rgrgr_r94_iW, gruF2_rgrgr_r94_b, NULL);
-    gruB1 = free_scrappie_matrix(gruB1);
-    scrappie_matrix gruF2 = gru_forward(gruF2in, gruF2_rgrgr_r94_sW, gruF2_rgrgr_r94_sW2, NULL);
-    gruF2in = free_scrappie_matrix(gruF2in);
-    //  Third GRU layer
-    scrappie_matrix gruB3in = feedforward_linear(gruF2, gruB3_rgrgr_r94_iW, gruB3_rgrgr_r94_b, NULL);
-    gruF2 = free_scrappie_matrix(gruF2);
-    scrappie_matrix gruB3 = gru_backward(gruB3in, gruB3_rgrgr_r94_sW, gruB3_rgrgr_r94_sW2, NULL);
-    gruB3in = free_scrappie_matrix(gruB3in);
-    //  Fourth GRU layer
-    scrappie_matrix gruF4in = feedforward_linear(gruB3, gruF4_rgrgr_r94_iW, gruF4_rgrgr_r94_b, NULL);
-    gruB3 = free_scrappie_matrix(gruB3);
-    scrappie_matrix gruF4 = gru_forward(gruF4in, gruF4_rgrgr_r94_sW, gruF4_rgrgr_r94_sW2, NULL);
-    gruF4in = free_scrappie_matrix(gruF4in);
-    //  Fifth GRU layer
-    scrappie_matrix gruB5in = feedforward_linear(gruF4, gruB5_rgrgr_r94_iW, gruB5_rgrgr_r94_b, NULL);
-    gruF4 = free_scrappie_matrix(gruF4);
-    scrappie_matrix gruB5 = gru_backward(gruB5in, gruB5_rgrgr_r94_sW, gruB5_rgrgr_r94_sW2, NULL);
-    gruB5in = free_scrappie_matrix(gruB5in);
-
-    scrappie_matrix post = softmax(gruB5, FF_rgrgr_r94_W, FF_rgrgr_r94_b, NULL);
-    gruB5 = free_scrappie_matrix(gruB5);
-
-    if (return_log) {
-        robustlog_activation_inplace(post, min_prob);
-    }
+scrappie_matrix nanonet_rgr_posterior(const raw_table signal, float min_prob,
+                                      bool return_log) {
+    return raw_network_posterior(&rgr_network, signal, min_prob, return_log);
+}
 
-    return post;
+scrappie_matrix nanonet_rgrgr_r94_posterior(const raw_table signal, float min_prob,
+                                            bool return_log) {
+    return raw_network_posterior(&rgrgr_r94_network, signal, min_prob, return_log);
 }
 
 scrappie_matrix nanonet_rgrgr_r95_posterior(const raw_table signal, float min_prob,
-                                      bool return_log) {
-    assert(min_prob >= 0.0 && min_prob <= 1.0);
-    RETURN_NULL_IF(0 == signal.n, NULL);
-    RETURN_NULL_IF(NULL == signal.raw, NULL);
-
-    scrappie_matrix raw_mat = nanonet_features_from_raw(signal);
-    scrappie_matrix conv =
-        convolution(raw_mat, conv_rgrgr_r95_W, conv_rgrgr_r95_b, conv_rgrgr_r95_stride, NULL);
-    tanh_activation_inplace(conv);
-    raw_mat = free_scrappie_matrix(raw_mat);
-    //  First GRU layer
-    scrappie_matrix gruB1in = feedforward_linear(conv, gruB1_rgrgr_r95_iW, gruB1_rgrgr_r95_b, NULL);
-    conv = free_scrappie_matrix(conv);
-    scrappie_matrix gruB1 = gru_backward(gruB1in, gruB1_rgrgr_r95_sW, gruB1_rgrgr_r95_sW2, NULL);
-    gruB1in = free_scrappie_matrix(gruB1in);
-    //  Second GRU layer
-    scrappie_matrix gruF2in = feedforward_linear(gruB1, gruF2_rgrgr_r95_iW, gruF2_rgrgr_r95_b, NULL);
-    gruB1 = free_scrappie_matrix(gruB1);
-    scrappie_matrix gruF2 = gru_forward(gruF2in, gruF2_rgrgr_r95_sW, gruF2_rgrgr_r95_sW2, NULL);
-    gruF2in = free_scrappie_matrix(gruF2in);
-    //  Third GRU layer
-    scrappie_matrix gruB3in = feedforward_linear(gruF2, gruB3_rgrgr_r95_iW, gruB3_rgrgr_r95_b, NULL);
-    gruF2 = free_scrappie_matrix(gruF2);
-    scrappie_matrix gruB3 = gru_backward(gruB3in, gruB3_rgrgr_r95_sW, gruB3_rgrgr_r95_sW2, NULL);
-    gruB3in = free_scrappie_matrix(gruB3in);
-    //  Fourth GRU layer
-    scrappie_matrix gruF4in = feedforward_linear(gruB3, gruF4_rgrgr_r95_iW, gruF4_rgrgr_r95_b, NULL);
-    gruB3 = free_scrappie_matrix(gruB3);
-    scrappie_matrix gruF4 = gru_forward(gruF4in, gruF4_rgrgr_r95_sW, gruF4_rgrgr_r95_sW2, NULL);
-    gruF4in = free_scrappie_matrix(gruF4in);
-    //  Fifth GRU layer
-    scrappie_matrix gruB5in = feedforward_linear(gruF4, gruB5_rgrgr_r95_iW, gruB5_rgrgr_r95_b, NULL);
-    gruF4 = free_scrappie_matrix(gruF4);
-    scrappie_matrix gruB5 = gru_backward(gruB5in, gruB5_rgrgr_r95_sW, gruB5_rgrgr_r95_sW2, NULL);
-    gruB5in = free_scrappie_matrix(gruB5in);
-
-    scrappie_matrix post = softmax(gruB5, FF_rgrgr_r95_W, FF_rgrgr_r95_b, NULL);
-    gruB5 = free_scrappie_matrix(gruB5);
-
-    if (return_log) {
-        robustlog_activation_inplace(post, min_prob);
-    }
+                                            bool return_log) {
+    return raw_network_posterior(&rgrgr_r95_network, signal, min_prob, return_log);
+}
 
-    return post;
+scrappie_matrix nanonet_rnnrf_r94_transitions(const raw_table signal, float min_prob,
+                                              bool return_log) {
+    assert(return_log);  // Returning non-log transformed not supported
+    return raw_network_posterior(&rnnrf_r94_network, signal, min_prob, return_log);
 }
 
 
@@ -322,104 +606,20 @@ scrappie_matrix dna_squiggle(int const * sequence, size_t n, bool transform_unit
     RETURN_NULL_IF(NULL == sequence, NULL);
 
     scrappie_matrix seq_embedding = embedding(sequence, n, embed_squiggle_dna_W, NULL);
-    scrappie_matrix conv1 = convolution(seq_embedding, conv1_squiggle_dna_W, conv1_squiggle_dna_b,
-                                        conv1_squiggle_dna_stride, NULL);
+    RETURN_NULL_IF(NULL == seq_embedding, NULL);
+    scrappie_matrix squiggle = run_network_graph(&squiggle_network, seq_embedding, 0.0f, false);
     seq_embedding = free_scrappie_matrix(seq_embedding);
-    tanh_activation_inplace(conv1);
-
-    // Convolution 2, wrapped in residual layer
-    scrappie_matrix conv2 = convolution(conv1, conv2_squiggle_dna_W, conv2_squiggle_dna_b,
-                                        conv2_squiggle_dna_stride, NULL);
-    tanh_activation_inplace(conv2);
-    residual_inplace(conv1, conv2);
-    conv1 = free_scrappie_matrix(conv1);
-
-    // Convolution 3, wrapped in residual layer
-    scrappie_matrix conv3 = convolution(conv2, conv3_squiggle_dna_W, conv3_squiggle_dna_b,
-                                        conv3_squiggle_dna_stride, NULL);
-    tanh_activation_inplace(conv3);
-    residual_inplace(conv2, conv3);
-    conv2 = free_scrappie_matrix(conv2);
-
-    // Convolution 4, wrapped in residual layer
-    scrappie_matrix conv4 = convolution(conv3, conv4_squiggle_dna_W, conv4_squiggle_dna_b,
-                                        conv4_squiggle_dna_stride, NULL);
-    tanh_activation_inplace(conv4);
-    residual_inplace(conv3, conv4);
-    conv3 = free_scrappie_matrix(conv3);
-
-    // Convolution 4, wrapped in residual layer
-    scrappie_matrix conv5 = convolution(conv4, conv5_squiggle_dna_W, conv5_squiggle_dna_b,
-                                        conv5_squiggle_dna_stride, NULL);
-    tanh_activation_inplace(conv5);
-    residual_inplace(conv4, conv5);
-    conv4 = free_scrappie_matrix(conv4);
-
-    scrappie_matrix conv6 = convolution(conv5, conv6_squiggle_dna_W, conv6_squiggle_dna_b,
-                                        conv6_squiggle_dna_stride, NULL);
-    conv5 = free_scrappie_matrix(conv5);
-
-    RETURN_NULL_IF(NULL == conv6, NULL);
+    RETURN_NULL_IF(NULL == squiggle, NULL);
 
     if(transform_units){
-        for(size_t c=0 ; c < conv6->nc ; c++){
-            size_t offset = c * conv6->nrq * 4;
+        for(size_t c=0 ; c < squiggle->nc ; c++){
+            size_t offset = c * squiggle->nrq * 4;
             //  Convert logsd to sd
-            conv6->data.f[offset + 1] = expf(conv6->data.f[offset + 1]);
+            squiggle->data.f[offset + 1] = expf(squiggle->data.f[offset + 1]);
             //  Convert transformed dwell into expected samples
-            conv6->data.f[offset + 2] = expf(-conv6->data.f[offset + 2]);
+            squiggle->data.f[offset + 2] = expf(-squiggle->data.f[offset + 2]);
         }
     }
 
-    return conv6;
-}
-
-
-scrappie_matrix nanonet_rnnrf_r94_transitions(const raw_table signal, float min_prob,
-                                              bool return_log) {
-    assert(return_log);  // Returning non-log transformed not supported
-    assert(min_prob >= 0.0 && min_prob <= 1.0);
-    RETURN_NULL_IF(0 == signal.n, NULL);
-    RETURN_NULL_IF(NULL == signal.raw, NULL);
-
-    scrappie_matrix raw_mat = nanonet_features_from_raw(signal);
-    scrappie_matrix conv =
-        convolution(raw_mat, conv_rnnrf_r94_W, conv_rnnrf_r94_b, conv_rnnrf_r94_stride, NULL);
-    elu_activation_inplace(conv);
-    raw_mat = free_scrappie_matrix(raw_mat);
-    //  First GRU layer
-    scrappie_matrix gruB1in = feedforward_linear(conv, gruB1_rnnrf_r94_iW, gruB1_rnnrf_r94_b, NULL);
-    scrappie_matrix gruB1 = gru_backward(gruB1in, gruB1_rnnrf_r94_sW, gruB1_rnnrf_r94_sW2, NULL);
-    residual_inplace(conv, gruB1);
-    conv = free_scrappie_matrix(conv);
-    gruB1in = free_scrappie_matrix(gruB1in);
-    //  Second GRU layer
-    scrappie_matrix gruF2in = feedforward_linear(gruB1, gruF2_rnnrf_r94_iW, gruF2_rnnrf_r94_b, NULL);
-    scrappie_matrix gruF2 = gru_forward(gruF2in, gruF2_rnnrf_r94_sW, gruF2_rnnrf_r94_sW2, NULL);
-    residual_inplace(gruB1, gruF2);
-    gruB1 = free_scrappie_matrix(gruB1);
-    gruF2in = free_scrappie_matrix(gruF2in);
-    //  Third GRU layer
-    scrappie_matrix gruB3in = feedforward_linear(gruF2, gruB3_rnnrf_r94_iW, gruB3_rnnrf_r94_b, NULL);
-    scrappie_matrix gruB3 = gru_backward(gruB3in, gruB3_rnnrf_r94_sW, gruB3_rnnrf_r94_sW2, NULL);
-    residual_inplace(gruF2, gruB3);
-    gruF2 = free_scrappie_matrix(gruF2);
-    gruB3in = free_scrappie_matrix(gruB3in);
-    //  Fourth GRU layer
-    scrappie_matrix gruF4in = feedforward_linear(gruB3, gruF4_rnnrf_r94_iW, gruF4_rnnrf_r94_b, NULL);
-    scrappie_matrix gruF4 = gru_forward(gruF4in, gruF4_rnnrf_r94_sW, gruF4_rnnrf_r94_sW2, NULL);
-    residual_inplace(gruB3, gruF4);
-    gruB3 = free_scrappie_matrix(gruB3);
-    gruF4in = free_scrappie_matrix(gruF4in);
-    //  Fifth GRU layer
-    scrappie_matrix gruB5in = feedforward_linear(gruF4, gruB5_rnnrf_r94_iW, gruB5_rnnrf_r94_b, NULL);
-    scrappie_matrix gruB5 = gru_backward(gruB5in, gruB5_rnnrf_r94_sW, gruB5_rnnrf_r94_sW2, NULL);
-    residual_inplace(gruF4, gruB5);
-    gruF4 = free_scrappie_matrix(gruF4);
-    gruB5in = free_scrappie_matrix(gruB5in);
-
-    scrappie_matrix trans = globalnorm(gruB5, FF_rnnrf_r94_W, FF_rnnrf_r94_b, NULL);
-    gruB5 = free_scrappie_matrix(gruB5);
-
-    return trans;
+    return squiggle;
 }
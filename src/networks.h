@@ -2,6 +2,8 @@
 #ifndef NETWORKS_H
 #    define NETWORKS_H
 #    include <stdbool.h>
+#    include "network_graph.h"
+#    include "precision.h"
 #    include "scrappie_matrix.h"
 #    include "scrappie_structures.h"
 
@@ -18,6 +20,15 @@ typedef scrappie_matrix (*posterior_function_ptr)(const raw_table, float, bool);
 enum raw_model_type get_raw_model(const char * modelstr);
 const char * raw_model_string(const enum raw_model_type model);
 posterior_function_ptr get_posterior_function(const enum raw_model_type model);
+scrappie_matrix daq_posterior(const enum raw_model_type model, const daq_table signal,
+                              float min_prob, bool return_log);
+bool set_raw_model_precision(const enum raw_model_type model, const enum scrappie_precision precision);
+bool set_raw_model_sparsity(const enum raw_model_type model, float sparsity);
+bool load_raw_model_file(const enum raw_model_type model, const char * filename);
+bool set_events_model_precision(const enum scrappie_precision precision);
+bool load_events_model_file(const char * filename);
+const struct network_graph * get_raw_network(const enum raw_model_type model);
+const struct network_graph * get_events_network(void);
 
 
 //  Events posterior.  Other models via factory function
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include "nnfeatures.h"
 #include "scrappie_stdlib.h"
+#include "util.h"
 
 /** Studentise features
  *
@@ -108,3 +109,53 @@ scrappie_matrix nanonet_features_from_raw(const raw_table signal) {
     }
     return sigmat;
 }
+
+/**  Normalised features from raw signal stored as DAQ values
+ *
+ *  The trimmed signal is normalised by its median and MAD, found from the
+ *  DAQ values, and written into the feature matrix in one pass.  Scaling to
+ *  pA is an affine map, which normalisation removes, so is never applied.
+ *  Equivalent to nanonet_features_from_raw of the signal in pA after
+ *  medmad_normalise_array, up to rounding.
+ *
+ *  @param signal Raw signal
+ *
+ *  @returns Matrix of features, one column per sample of trimmed signal
+ **/
+scrappie_matrix nanonet_features_from_daq(const daq_table signal) {
+    RETURN_NULL_IF(0 == signal.n, NULL);
+    RETURN_NULL_IF(NULL == signal.raw, NULL);
+    RETURN_NULL_IF(signal.end <= signal.start, NULL);
+    const size_t nsample = signal.end - signal.start;
+    const int16_t *x = signal.raw + signal.start;
+
+    float med, mad;
+    RETURN_NULL_IF(!medmad_int16(x, nsample, &med, &mad), NULL);
+    scrappie_matrix sigmat = make_scrappie_matrix(1, nsample);
+    RETURN_NULL_IF(NULL == sigmat, NULL);
+    if (1 == nsample) {
+        sigmat->data.v[0] = _mm_setzero_ps();
+        return sigmat;
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 vmed = _mm_set1_ps(med);
+    const __m128 vmad = _mm_set1_ps(mad);
+    size_t i = 0;
+    for (; i + 4 <= nsample; i += 4) {
+        //  Sign extend four samples to 32 bits
+        const __m128i xi = _mm_loadl_epi64((const __m128i *)(x + i));
+        const __m128i xi32 = _mm_srai_epi32(_mm_unpacklo_epi16(xi, xi), 16);
+        const __m128 v = (_mm_cvtepi32_ps(xi32) - vmed) / vmad;
+        // Each sample is a column of the matrix, padded with zeros
+        sigmat->data.v[i] = _mm_move_ss(zero, v);
+        sigmat->data.v[i + 1] = _mm_move_ss(zero, _mm_shuffle_ps(v, v, 1));
+        sigmat->data.v[i + 2] = _mm_move_ss(zero, _mm_shuffle_ps(v, v, 2));
+        sigmat->data.v[i + 3] = _mm_move_ss(zero, _mm_shuffle_ps(v, v, 3));
+    }
+    for (; i < nsample; i++) {
+        sigmat->data.v[i] = _mm_set_ss((x[i] - med) / mad);
+    }
+
+    return sigmat;
+}
@@ -8,5 +8,6 @@
 scrappie_matrix nanonet_features_from_events(const event_table evtbl,
                                              bool normalise);
 scrappie_matrix nanonet_features_from_raw(const raw_table signal);
+scrappie_matrix nanonet_features_from_daq(const daq_table signal);
 
 #endif                          /* FEATURES_H */
@@ -0,0 +1,260 @@
+#pragma once
+#ifndef PACKED_KERNELS_H
+#    define PACKED_KERNELS_H
+
+#    include <immintrin.h>
+#    include <stddef.h>
+#    include <string.h>
+#    include "precision.h"
+#    include "util.h"
+
+/*  Kernels for weights packed into panels (see _pMat).  The kernels are
+ *  written once, here, with every size as an argument.  The generic
+ *  kernels in precision.c call them with sizes known only at run time;
+ *  the kernels generated for the shapes of the shipped models call them
+ *  with constant sizes, so the compiler can fix the trip counts of every
+ *  loop.
+ */
+
+/*  Packed kernels work on a row of a panel at a time, held in one AVX
+ *  vector or in a pair of SSE vectors.
+ */
+#if defined(__AVX__) && defined(__FMA__)
+typedef __m256 pvec;
+static inline pvec pvec_zero(void){ return _mm256_setzero_ps(); }
+static inline pvec pvec_set1(float x){ return _mm256_set1_ps(x); }
+static inline pvec pvec_load(const float * p){ return _mm256_load_ps(p); }
+static inline pvec pvec_loadu(const float * p){ return _mm256_loadu_ps(p); }
+static inline void pvec_storeu(float * p, pvec a){ _mm256_storeu_ps(p, a); }
+static inline pvec pvec_add(pvec a, pvec b){ return _mm256_add_ps(a, b); }
+static inline pvec pvec_fmadd(pvec a, pvec b, pvec c){ return _mm256_fmadd_ps(a, b, c); }
+#else
+typedef struct {
+    __m128 lo, hi;
+} pvec;
+static inline pvec pvec_zero(void){ return (pvec){_mm_setzero_ps(), _mm_setzero_ps()}; }
+static inline pvec pvec_set1(float x){ return (pvec){_mm_set1_ps(x), _mm_set1_ps(x)}; }
+static inline pvec pvec_load(const float * p){ return (pvec){_mm_load_ps(p), _mm_load_ps(p + 4)}; }
+static inline pvec pvec_loadu(const float * p){ return (pvec){_mm_loadu_ps(p), _mm_loadu_ps(p + 4)}; }
+static inline void pvec_storeu(float * p, pvec a){ _mm_storeu_ps(p, a.lo); _mm_storeu_ps(p + 4, a.hi); }
+static inline pvec pvec_add(pvec a, pvec b){ return (pvec){a.lo + b.lo, a.hi + b.hi}; }
+static inline pvec pvec_fmadd(pvec a, pvec b, pvec c){ return (pvec){a.lo * b.lo + c.lo, a.hi * b.hi + c.hi}; }
+#endif
+
+
+//  Add accumulated panel to the first n elements of y
+static inline void pvec_accumulate(float * y, pvec acc, size_t n){
+    if(PMAT_PANEL == n){
+        pvec_storeu(y, pvec_add(pvec_loadu(y), acc));
+        return;
+    }
+    float res[PMAT_PANEL];
+    pvec_storeu(res, acc);
+    for(size_t j=0 ; j < n ; j++){
+        y[j] += res[j];
+    }
+}
+
+//  Number of columns of a matrix with nc columns in panel p
+static inline size_t panel_ncol(size_t nc, size_t p){
+    const size_t c = p * PMAT_PANEL;
+    return (nc - c < PMAT_PANEL) ? (nc - c) : PMAT_PANEL;
+}
+
+/**  Accumulate product of a block of rows of a transposed packed matrix and
+ *   a vector
+ *
+ *   y += W^t x.  Four panels are accumulated at once, the rows alternating
+ *   between two sets of accumulators so that the dependency chains are
+ *   short.
+ *
+ *   @param W Packed data, offset to the first row used
+ *   @param ldp Stride between panels
+ *   @param nk Number of rows of W to use
+ *   @param npanel Number of panels
+ *   @param nc Number of columns of W
+ *   @param x Vector [nk]
+ *   @param y Vector [nc], updated in place
+ **/
+static inline __attribute__ ((__always_inline__))
+void pgemv_panels(const float * W, size_t ldp, size_t nk, size_t npanel, size_t nc,
+                  const float * x, float * y){
+    const size_t npanel4 = npanel - npanel % 4;
+    for(size_t p=0 ; p < npanel4 ; p += 4){
+        const float * W0 = W + p * ldp;
+        const float * W1 = W0 + ldp;
+        const float * W2 = W1 + ldp;
+        const float * W3 = W2 + ldp;
+        pvec a0 = pvec_zero(), a1 = pvec_zero(), a2 = pvec_zero(), a3 = pvec_zero();
+        pvec b0 = pvec_zero(), b1 = pvec_zero(), b2 = pvec_zero(), b3 = pvec_zero();
+        size_t k = 0;
+        for( ; k + 2 <= nk ; k += 2){
+            const size_t o = k * PMAT_PANEL;
+            const pvec x0 = pvec_set1(x[k]);
+            const pvec x1 = pvec_set1(x[k + 1]);
+            a0 = pvec_fmadd(x0, pvec_load(W0 + o), a0);
+            a1 = pvec_fmadd(x0, pvec_load(W1 + o), a1);
+            a2 = pvec_fmadd(x0, pvec_load(W2 + o), a2);
+            a3 = pvec_fmadd(x0, pvec_load(W3 + o), a3);
+            b0 = pvec_fmadd(x1, pvec_load(W0 + o + PMAT_PANEL), b0);
+            b1 = pvec_fmadd(x1, pvec_load(W1 + o + PMAT_PANEL), b1);
+            b2 = pvec_fmadd(x1, pvec_load(W2 + o + PMAT_PANEL), b2);
+            b3 = pvec_fmadd(x1, pvec_load(W3 + o + PMAT_PANEL), b3);
+        }
+        if(k < nk){
+            const size_t o = k * PMAT_PANEL;
+            const pvec x0 = pvec_set1(x[k]);
+            a0 = pvec_fmadd(x0, pvec_load(W0 + o), a0);
+            a1 = pvec_fmadd(x0, pvec_load(W1 + o), a1);
+            a2 = pvec_fmadd(x0, pvec_load(W2 + o), a2);
+            a3 = pvec_fmadd(x0, pvec_load(W3 + o), a3);
+        }
+        float * yp = y + p * PMAT_PANEL;
+        pvec_accumulate(yp, pvec_add(a0, b0), PMAT_PANEL);
+        pvec_accumulate(yp + PMAT_PANEL, pvec_add(a1, b1), PMAT_PANEL);
+        pvec_accumulate(yp + 2 * PMAT_PANEL, pvec_add(a2, b2), PMAT_PANEL);
+        pvec_accumulate(yp + 3 * PMAT_PANEL, pvec_add(a3, b3), panel_ncol(nc, p + 3));
+    }
+    for(size_t p=npanel4 ; p < npanel ; p++){
+        const float * W0 = W + p * ldp;
+        pvec a0 = pvec_zero(), b0 = pvec_zero();
+        size_t k = 0;
+        for( ; k + 2 <= nk ; k += 2){
+            const size_t o = k * PMAT_PANEL;
+            a0 = pvec_fmadd(pvec_set1(x[k]), pvec_load(W0 + o), a0);
+            b0 = pvec_fmadd(pvec_set1(x[k + 1]), pvec_load(W0 + o + PMAT_PANEL), b0);
+        }
+        if(k < nk){
+            a0 = pvec_fmadd(pvec_set1(x[k]), pvec_load(W0 + k * PMAT_PANEL), a0);
+        }
+        pvec_accumulate(y + p * PMAT_PANEL, pvec_add(a0, b0), panel_ncol(nc, p));
+    }
+}
+
+
+/**  Accumulate product of a block of rows of a transposed packed matrix and
+ *   a matrix
+ *
+ *   C += W^t X.  Columns of X are taken four at a time against pairs of
+ *   panels, so each row of a panel loaded is used four times.
+ *
+ *   @param W Packed data, offset to the first row used
+ *   @param ldp Stride between panels
+ *   @param nk Number of rows of W to use
+ *   @param npanel Number of panels
+ *   @param nc Number of columns of W
+ *   @param X Input matrix [nk, ncol], columns ldX apart
+ *   @param ldX Stride between columns of X
+ *   @param ncol Number of columns of X
+ *   @param C Output matrix [nc, ncol], columns ldC apart, updated in place
+ *   @param ldC Stride between columns of C
+ **/
+static inline __attribute__ ((__always_inline__))
+void pgemm_panels(const float * W, size_t ldp, size_t nk, size_t npanel, size_t nc,
+                  const float * X, size_t ldX, size_t ncol, float * C, size_t ldC){
+    size_t j = 0;
+    for( ; j + 4 <= ncol ; j += 4){
+        const float * x0 = X + j * ldX;
+        const float * x1 = x0 + ldX;
+        const float * x2 = x1 + ldX;
+        const float * x3 = x2 + ldX;
+        float * c0 = C + j * ldC;
+        float * c1 = c0 + ldC;
+        float * c2 = c1 + ldC;
+        float * c3 = c2 + ldC;
+
+        const size_t npanel2 = npanel - npanel % 2;
+        for(size_t p=0 ; p < npanel2 ; p += 2){
+            const float * Wa = W + p * ldp;
+            const float * Wb = Wa + ldp;
+            pvec a0 = pvec_zero(), a1 = pvec_zero(), a2 = pvec_zero(), a3 = pvec_zero();
+            pvec b0 = pvec_zero(), b1 = pvec_zero(), b2 = pvec_zero(), b3 = pvec_zero();
+            for(size_t k=0 ; k < nk ; k++){
+                const pvec wa = pvec_load(Wa + k * PMAT_PANEL);
+                const pvec wb = pvec_load(Wb + k * PMAT_PANEL);
+                pvec xk = pvec_set1(x0[k]);
+                a0 = pvec_fmadd(xk, wa, a0);
+                b0 = pvec_fmadd(xk, wb, b0);
+                xk = pvec_set1(x1[k]);
+                a1 = pvec_fmadd(xk, wa, a1);
+                b1 = pvec_fmadd(xk, wb, b1);
+                xk = pvec_set1(x2[k]);
+                a2 = pvec_fmadd(xk, wa, a2);
+                b2 = pvec_fmadd(xk, wb, b2);
+                xk = pvec_set1(x3[k]);
+                a3 = pvec_fmadd(xk, wa, a3);
+                b3 = pvec_fmadd(xk, wb, b3);
+            }
+            const size_t ca = p * PMAT_PANEL;
+            const size_t cb = ca + PMAT_PANEL;
+            const size_t nb = panel_ncol(nc, p + 1);
+            pvec_accumulate(c0 + ca, a0, PMAT_PANEL);
+            pvec_accumulate(c1 + ca, a1, PMAT_PANEL);
+            pvec_accumulate(c2 + ca, a2, PMAT_PANEL);
+            pvec_accumulate(c3 + ca, a3, PMAT_PANEL);
+            pvec_accumulate(c0 + cb, b0, nb);
+            pvec_accumulate(c1 + cb, b1, nb);
+            pvec_accumulate(c2 + cb, b2, nb);
+            pvec_accumulate(c3 + cb, b3, nb);
+        }
+        if(npanel2 < npanel){
+            const size_t p = npanel2;
+            const float * Wa = W + p * ldp;
+            pvec a0 = pvec_zero(), a1 = pvec_zero(), a2 = pvec_zero(), a3 = pvec_zero();
+            for(size_t k=0 ; k < nk ; k++){
+                const pvec wa = pvec_load(Wa + k * PMAT_PANEL);
+                a0 = pvec_fmadd(pvec_set1(x0[k]), wa, a0);
+                a1 = pvec_fmadd(pvec_set1(x1[k]), wa, a1);
+                a2 = pvec_fmadd(pvec_set1(x2[k]), wa, a2);
+                a3 = pvec_fmadd(pvec_set1(x3[k]), wa, a3);
+            }
+            const size_t ca = p * PMAT_PANEL;
+            const size_t na = panel_ncol(nc, p);
+            pvec_accumulate(c0 + ca, a0, na);
+            pvec_accumulate(c1 + ca, a1, na);
+            pvec_accumulate(c2 + ca, a2, na);
+            pvec_accumulate(c3 + ca, a3, na);
+        }
+    }
+    for( ; j < ncol ; j++){
+        pgemv_panels(W, ldp, nk, npanel, nc, X + j * ldX, C + j * ldC);
+    }
+}
+
+
+/**  Single step of a GRU layer with packed recurrent weights
+ *
+ *   As gru_step, on arrays.  The order of operations is the same so results
+ *   are identical for the same packed weights.
+ *
+ *   @param size Number of units
+ *   @param x Input, after affine transform [3 * size]
+ *   @param istate Previous state [size]
+ *   @param sW Packed data of recurrent weights for update and reset gates [size, 2 * size]
+ *   @param sW2 Packed data of recurrent weights for candidate state [size, size]
+ *   @param xF Workspace [3 * size]
+ *   @param ostate Output state [size]
+ **/
+static inline __attribute__ ((__always_inline__))
+void gru_step_panels(size_t size, const float * x, const float * istate, const float * sW,
+                     const float * sW2, float * xF, float * ostate){
+    const size_t ldp = size * PMAT_PANEL;
+    memcpy(xF, x, 3 * size * sizeof(float));
+    pgemv_panels(sW, ldp, size, (2 * size + PMAT_PANEL - 1) / PMAT_PANEL, 2 * size, istate, xF);
+    logistic_arrayf(xF, size + size);
+
+    const float * z = xF;
+    float * r = xF + size;
+    float * hbar = xF + size + size;
+    for(size_t i=0 ; i < size ; i++){
+        r[i] *= istate[i];
+    }
+    pgemv_panels(sW2, ldp, size, (size + PMAT_PANEL - 1) / PMAT_PANEL, size, r, hbar);
+    tanh_arrayf(hbar, size);
+
+    for(size_t i=0 ; i < size ; i++){
+        ostate[i] = z[i] * istate[i] + (1.0f - z[i]) * hbar[i];
+    }
+}
+
+#endif                          /* PACKED_KERNELS_H */
@@ -0,0 +1,1156 @@
+#ifdef __APPLE__
+#    include <Accelerate/Accelerate.h>
+#else
+#    include <cblas.h>
+#endif
+#include <math.h>
+#include "packed_kernels.h"
+#include "precision.h"
+#include "specialised_kernels.h"
+#include "scrappie_stdlib.h"
+
+
+enum scrappie_precision get_scrappie_precision(const char * precisionstr){
+    if(0 == strcmp(precisionstr, "float32")){
+        return SCRAPPIE_PRECISION_FLOAT32;
+    }
+    if(0 == strcmp(precisionstr, "int8")){
+        return SCRAPPIE_PRECISION_INT8;
+    }
+    if(0 == strcmp(precisionstr, "float16")){
+        return SCRAPPIE_PRECISION_FLOAT16;
+    }
+    if(0 == strcmp(precisionstr, "bfloat16")){
+        return SCRAPPIE_PRECISION_BFLOAT16;
+    }
+    return SCRAPPIE_PRECISION_INVALID;
+}
+
+const char * scrappie_precision_string(const enum scrappie_precision precision){
+    switch(precision){
+    case SCRAPPIE_PRECISION_FLOAT32:
+        return "float32";
+    case SCRAPPIE_PRECISION_INT8:
+        return "int8";
+    case SCRAPPIE_PRECISION_FLOAT16:
+        return "float16";
+    case SCRAPPIE_PRECISION_BFLOAT16:
+        return "bfloat16";
+    case SCRAPPIE_PRECISION_INVALID:
+        errx(EXIT_FAILURE, "Invalid precision %s:%d", __FILE__, __LINE__);
+    default:
+        errx(EXIT_FAILURE, "Scrappie enum failure -- report bug\n");
+    }
+
+    return NULL;
+}
+
+
+/**  Quantise a vector to int8
+ *
+ *   Symmetric quantisation, x ~ scale * q with q in [-127, 127].
+ *
+ *   @param x Vector to quantise [n]
+ *   @param n Length of x
+ *   @param q Output [nq].  Elements beyond n are set to zero.
+ *   @param nq Length of q, a multiple of 16 no smaller than n
+ *
+ *   @returns scale
+ **/
+static float quantise_vector(const float * x, size_t n, int8_t * q, size_t nq){
+    assert(nq >= n);
+    assert(0 == nq % 16);
+    float xmax = 0.0f;
+    for(size_t i=0 ; i < n ; i++){
+        xmax = fmaxf(xmax, fabsf(x[i]));
+    }
+    if(0.0f == xmax){
+        memset(q, 0, nq);
+        return 0.0f;
+    }
+
+    const __m128 inv = _mm_set1_ps(127.0f / xmax);
+    size_t i = 0;
+    for( ; i + 16 <= n ; i += 16){
+        const __m128i q0 = _mm_cvtps_epi32(_mm_loadu_ps(x + i) * inv);
+        const __m128i q1 = _mm_cvtps_epi32(_mm_loadu_ps(x + i + 4) * inv);
+        const __m128i q2 = _mm_cvtps_epi32(_mm_loadu_ps(x + i + 8) * inv);
+        const __m128i q3 = _mm_cvtps_epi32(_mm_loadu_ps(x + i + 12) * inv);
+        _mm_storeu_si128((__m128i *)(q + i),
+                         _mm_packs_epi16(_mm_packs_epi32(q0, q1), _mm_packs_epi32(q2, q3)));
+    }
+    for( ; i < n ; i++){
+        q[i] = (int8_t)lrintf(x[i] * (127.0f / xmax));
+    }
+    memset(q + n, 0, nq - n);
+
+    return xmax / 127.0f;
+}
+
+
+/**  Dot products of an int8 vector with four int8 columns
+ *
+ *   Products of signed bytes are formed with the unsigned by signed multiply
+ *   instructions by moving the sign of x onto the weights.  Since both
+ *   operands lie in [-127, 127], the pairwise sums of the multiply cannot
+ *   saturate.
+ *
+ *   @param x Vector [QMAT_BLOCK * nrb]
+ *   @param W First column of weights
+ *   @param ldW Stride between columns of W
+ *   @param nrb Number of blocks of QMAT_BLOCK elements
+ *
+ *   @returns Vector containing the four dot products
+ **/
+static inline __m128i dot4_int8(const int8_t * x, const int8_t * W, size_t ldW, size_t nrb){
+#if defined(__AVX512BW__)
+    __m512i acc[4] = {_mm512_setzero_si512(), _mm512_setzero_si512(),
+                      _mm512_setzero_si512(), _mm512_setzero_si512()};
+#    if ! defined(__AVX512VNNI__)
+    const __m512i ones = _mm512_set1_epi16(1);
+#    endif
+    for(size_t i=0 ; i < nrb ; i++){
+        const __m512i xv = _mm512_load_si512((const void *)(x + i * QMAT_BLOCK));
+        const __m512i xabs = _mm512_abs_epi8(xv);
+        const __mmask64 neg = _mm512_movepi8_mask(xv);
+        for(int j=0 ; j < 4 ; j++){
+            __m512i w = _mm512_load_si512((const void *)(W + j * ldW + i * QMAT_BLOCK));
+            w = _mm512_mask_sub_epi8(w, neg, _mm512_setzero_si512(), w);
+#    if defined(__AVX512VNNI__)
+            acc[j] = _mm512_dpbusd_epi32(acc[j], xabs, w);
+#    else
+            acc[j] = _mm512_add_epi32(acc[j], _mm512_madd_epi16(_mm512_maddubs_epi16(xabs, w), ones));
+#    endif
+        }
+    }
+    return _mm_setr_epi32(_mm512_reduce_add_epi32(acc[0]), _mm512_reduce_add_epi32(acc[1]),
+                          _mm512_reduce_add_epi32(acc[2]), _mm512_reduce_add_epi32(acc[3]));
+#elif defined(__AVX2__)
+    __m256i acc[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(),
+                      _mm256_setzero_si256(), _mm256_setzero_si256()};
+    const __m256i ones = _mm256_set1_epi16(1);
+    for(size_t i=0 ; i < nrb * QMAT_BLOCK ; i += 32){
+        const __m256i xv = _mm256_load_si256((const __m256i *)(x + i));
+        const __m256i xabs = _mm256_abs_epi8(xv);
+        for(int j=0 ; j < 4 ; j++){
+            const __m256i w = _mm256_sign_epi8(_mm256_load_si256((const __m256i *)(W + j * ldW + i)), xv);
+            acc[j] = _mm256_add_epi32(acc[j], _mm256_madd_epi16(_mm256_maddubs_epi16(xabs, w), ones));
+        }
+    }
+    __m128i sum[4];
+    for(int j=0 ; j < 4 ; j++){
+        sum[j] = _mm_add_epi32(_mm256_castsi256_si128(acc[j]), _mm256_extracti128_si256(acc[j], 1));
+    }
+    return _mm_hadd_epi32(_mm_hadd_epi32(sum[0], sum[1]), _mm_hadd_epi32(sum[2], sum[3]));
+#else
+    __m128i acc[4] = {_mm_setzero_si128(), _mm_setzero_si128(),
+                      _mm_setzero_si128(), _mm_setzero_si128()};
+    const __m128i ones = _mm_set1_epi16(1);
+    for(size_t i=0 ; i < nrb * QMAT_BLOCK ; i += 16){
+        const __m128i xv = _mm_load_si128((const __m128i *)(x + i));
+        const __m128i xabs = _mm_abs_epi8(xv);
+        for(int j=0 ; j < 4 ; j++){
+            const __m128i w = _mm_sign_epi8(_mm_load_si128((const __m128i *)(W + j * ldW + i)), xv);
+            acc[j] = _mm_add_epi32(acc[j], _mm_madd_epi16(_mm_maddubs_epi16(xabs, w), ones));
+        }
+    }
+    return _mm_hadd_epi32(_mm_hadd_epi32(acc[0], acc[1]), _mm_hadd_epi32(acc[2], acc[3]));
+#endif
+}
+
+
+scrappie_qmatrix make_scrappie_qmatrix(const_scrappie_matrix W){
+    RETURN_NULL_IF(NULL == W, NULL);
+    const size_t nr = W->nrq * 4;
+    const size_t nrb = (nr + QMAT_BLOCK - 1) / QMAT_BLOCK;
+    //  Columns are processed in groups of four; pad with zero columns
+    const size_t ncpad = 4 * ((W->nc + 3) / 4);
+
+    scrappie_qmatrix mat = malloc(sizeof(*mat));
+    RETURN_NULL_IF(NULL == mat, NULL);
+    mat->nr = nr;
+    mat->nrb = nrb;
+    mat->nc = W->nc;
+    mat->scale = calloc(ncpad, sizeof(float));
+    mat->data = aligned_alloc(QMAT_BLOCK, nrb * QMAT_BLOCK * ncpad);
+    if(NULL == mat->scale || NULL == mat->data){
+        warnx("Error allocating memory in %s.\n", __func__);
+        return free_scrappie_qmatrix(mat);
+    }
+    memset(mat->data, 0, nrb * QMAT_BLOCK * ncpad);
+
+    for(size_t c=0 ; c < W->nc ; c++){
+        mat->scale[c] = quantise_vector(W->data.f + c * nr, nr,
+                                        mat->data + c * nrb * QMAT_BLOCK, nrb * QMAT_BLOCK);
+    }
+
+    return mat;
+}
+
+scrappie_qmatrix free_scrappie_qmatrix(scrappie_qmatrix mat){
+    if(NULL != mat){
+        free(mat->data);
+        free(mat->scale);
+    }
+    free(mat);
+    return NULL;
+}
+
+
+/**  Accumulate product of transposed int8 matrix and a vector
+ *
+ *   y += W^t x where x is quantised on entry.
+ *
+ *   @param qW Quantised matrix [nr, nc]
+ *   @param x Vector [nr]
+ *   @param y Vector [nc], updated in place
+ **/
+void qgemv(const_scrappie_qmatrix qW, const float * x, float * y){
+    assert(NULL != qW);
+    assert(NULL != x);
+    assert(NULL != y);
+    const size_t ldW = qW->nrb * QMAT_BLOCK;
+    int8_t xq[ldW] __attribute__ ((aligned(QMAT_BLOCK)));
+    const float xscale = quantise_vector(x, qW->nr, xq, ldW);
+    if(0.0f == xscale){
+        return;
+    }
+
+    const __m128 vxscale = _mm_set1_ps(xscale);
+    size_t c = 0;
+    for( ; c + 4 <= qW->nc ; c += 4){
+        const __m128i dot = dot4_int8(xq, qW->data + c * ldW, ldW, qW->nrb);
+        const __m128 res = _mm_cvtepi32_ps(dot) * _mm_loadu_ps(qW->scale + c) * vxscale;
+        _mm_storeu_ps(y + c, _mm_loadu_ps(y + c) + res);
+    }
+    if(c < qW->nc){
+        //  Final partial group of columns, padded with zeros
+        float res[4];
+        const __m128i dot = dot4_int8(xq, qW->data + c * ldW, ldW, qW->nrb);
+        _mm_storeu_ps(res, _mm_cvtepi32_ps(dot) * _mm_loadu_ps(qW->scale + c) * vxscale);
+        for(size_t j=0 ; c + j < qW->nc ; j++){
+            y[c + j] += res[j];
+        }
+    }
+}
+
+
+/**  Accumulate product of transposed int8 matrix and a matrix
+ *
+ *   C += W^t X, with each column of X quantised separately.  Bias should
+ *   already have been copied into C.
+ *
+ *   @param X Input matrix [nr, nc]
+ *   @param qW Quantised matrix [nr, nk]
+ *   @param C Output matrix [nk, nc], updated in place
+ **/
+void qaffine_map(const_scrappie_matrix X, const_scrappie_qmatrix qW, scrappie_matrix C){
+    assert(NULL != X);
+    assert(NULL != qW);
+    assert(NULL != C);
+    assert(X->nrq * 4 == qW->nr);
+    assert(C->nr == qW->nc);
+    assert(C->nc == X->nc);
+    for(size_t c=0 ; c < X->nc ; c++){
+        qgemv(qW, X->data.f + c * X->nrq * 4, C->data.f + c * C->nrq * 4);
+    }
+}
+
+/*  Conversion between float and 16 bit formats.  Both round to nearest,
+ *  ties to even.  Values out of range of float16 become infinite.
+ */
+static inline uint16_t float_to_float16(float x){
+#if defined(__F16C__)
+    return _cvtss_sh(x, _MM_FROUND_TO_NEAREST_INT);
+#else
+    union {float f; uint32_t u;} v = {.f = x};
+    const uint16_t sign = (v.u >> 16) & 0x8000;
+    v.u &= 0x7fffffff;
+    if(v.u >= 0x7f800000){
+        //  Infinity or NaN
+        return sign | 0x7c00 | ((v.u > 0x7f800000) ? 0x200 : 0);
+    }
+    if(v.u >= 0x477ff000){
+        //  Rounds to a value too large for float16
+        return sign | 0x7c00;
+    }
+    if(v.u < 0x38800000){
+        //  Subnormal float16; add magic number to align the mantissa and
+        //  let the floating point unit do the rounding.
+        union {float f; uint32_t u;} m = {.u = v.u};
+        m.f += 0.5f;
+        return sign | (uint16_t)(m.u - 0x3f000000);
+    }
+    const uint32_t odd = (v.u >> 13) & 1;
+    v.u += 0xc8000fff + odd;
+    return sign | (uint16_t)(v.u >> 13);
+#endif
+}
+
+static inline float float16_to_float(uint16_t h){
+#if defined(__F16C__)
+    return _cvtsh_ss(h);
+#else
+    const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    const uint32_t expo = (h >> 10) & 0x1f;
+    const uint32_t mant = h & 0x3ff;
+    union {float f; uint32_t u;} v;
+    if(0 == expo){
+        //  Zero or subnormal
+        v.f = ldexpf((float)mant, -24);
+        v.u |= sign;
+    } else if(0x1f == expo){
+        v.u = sign | 0x7f800000 | (mant << 13);
+    } else {
+        v.u = sign | ((expo + 112) << 23) | (mant << 13);
+    }
+    return v.f;
+#endif
+}
+
+static inline uint16_t float_to_bfloat16(float x){
+    union {float f; uint32_t u;} v = {.f = x};
+    if((v.u & 0x7fffffff) > 0x7f800000){
+        //  NaN; keep quiet
+        return (v.u >> 16) | 0x40;
+    }
+    v.u += 0x7fff + ((v.u >> 16) & 1);
+    return v.u >> 16;
+}
+
+static inline float bfloat16_to_float(uint16_t h){
+    union {float f; uint32_t u;} v = {.u = (uint32_t)h << 16};
+    return v.f;
+}
+
+
+scrappie_hmatrix make_scrappie_hmatrix(const_scrappie_matrix W, enum scrappie_precision precision){
+    RETURN_NULL_IF(NULL == W, NULL);
+    assert(SCRAPPIE_PRECISION_FLOAT16 == precision || SCRAPPIE_PRECISION_BFLOAT16 == precision);
+    const size_t nr = W->nrq * 4;
+    const size_t ldh = HMAT_BLOCK * ((nr + HMAT_BLOCK - 1) / HMAT_BLOCK);
+    //  Columns are processed in groups of four; pad with zero columns
+    const size_t ncpad = 4 * ((W->nc + 3) / 4);
+
+    scrappie_hmatrix mat = malloc(sizeof(*mat));
+    RETURN_NULL_IF(NULL == mat, NULL);
+    mat->nr = nr;
+    mat->ldh = ldh;
+    mat->nc = W->nc;
+    mat->precision = precision;
+    mat->data = aligned_alloc(64, ldh * ncpad * sizeof(uint16_t));
+    if(NULL == mat->data){
+        warnx("Error allocating memory in %s.\n", __func__);
+        return free_scrappie_hmatrix(mat);
+    }
+    memset(mat->data, 0, ldh * ncpad * sizeof(uint16_t));
+
+    const bool bf16 = (SCRAPPIE_PRECISION_BFLOAT16 == precision);
+    for(size_t c=0 ; c < W->nc ; c++){
+        for(size_t r=0 ; r < nr ; r++){
+            const float w = W->data.f[c * nr + r];
+            mat->data[c * ldh + r] = bf16 ? float_to_bfloat16(w) : float_to_float16(w);
+        }
+    }
+
+    return mat;
+}
+
+scrappie_hmatrix free_scrappie_hmatrix(scrappie_hmatrix mat){
+    if(NULL != mat){
+        free(mat->data);
+    }
+    free(mat);
+    return NULL;
+}
+
+
+/*  Widening loads of 16 bit elements.  The float16 loads use F16C where
+ *  available; bfloat16 is widened by shifting into the upper half of each
+ *  32 bit lane.
+ */
+static inline __m128 load4_float16(const uint16_t * p){
+#if defined(__F16C__)
+    return _mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)p));
+#else
+    return _mm_setr_ps(float16_to_float(p[0]), float16_to_float(p[1]),
+                       float16_to_float(p[2]), float16_to_float(p[3]));
+#endif
+}
+
+static inline __m128 load4_bfloat16(const uint16_t * p){
+    return _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(),
+                                               _mm_loadl_epi64((const __m128i *)p)));
+}
+
+#if defined(__AVX512F__)
+static inline __m512 load16_float16(const uint16_t * p){
+    return _mm512_cvtph_ps(_mm256_load_si256((const __m256i *)p));
+}
+
+static inline __m512 load16_bfloat16(const uint16_t * p){
+    return _mm512_castsi512_ps(_mm512_slli_epi32(
+        _mm512_cvtepu16_epi32(_mm256_load_si256((const __m256i *)p)), 16));
+}
+#elif defined(__AVX2__) && defined(__F16C__) && defined(__FMA__)
+static inline __m256 load8_float16(const uint16_t * p){
+    return _mm256_cvtph_ps(_mm_load_si128((const __m128i *)p));
+}
+
+static inline __m256 load8_bfloat16(const uint16_t * p){
+    return _mm256_castsi256_ps(_mm256_slli_epi32(
+        _mm256_cvtepu16_epi32(_mm_load_si128((const __m128i *)p)), 16));
+}
+#endif
+
+
+/*  Dot products of a float vector with four 16 bit columns, widening each
+ *  block of weights as it is loaded.  x and the columns are ldh long.
+ */
+#if defined(__AVX512F__)
+#    define _HDOT4_FUNCTION(TYPE)                                               \
+    static inline __m128 hdot4_ ## TYPE(const float * x, const uint16_t * W, size_t ldh){ \
+        __m512 acc[4] = {_mm512_setzero_ps(), _mm512_setzero_ps(),               \
+                         _mm512_setzero_ps(), _mm512_setzero_ps()};              \
+        for(size_t i=0 ; i < ldh ; i += 16){                                     \
+            const __m512 xv = _mm512_load_ps(x + i);                             \
+            for(int j=0 ; j < 4 ; j++){                                          \
+                acc[j] = _mm512_fmadd_ps(load16_ ## TYPE(W + j * ldh + i), xv, acc[j]); \
+            }                                                                    \
+        }                                                                        \
+        return _mm_setr_ps(_mm512_reduce_add_ps(acc[0]), _mm512_reduce_add_ps(acc[1]), \
+                           _mm512_reduce_add_ps(acc[2]), _mm512_reduce_add_ps(acc[3])); \
+    }
+#elif defined(__AVX2__) && defined(__F16C__) && defined(__FMA__)
+#    define _HDOT4_FUNCTION(TYPE)                                               \
+    static inline __m128 hdot4_ ## TYPE(const float * x, const uint16_t * W, size_t ldh){ \
+        __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(),               \
+                         _mm256_setzero_ps(), _mm256_setzero_ps()};              \
+        for(size_t i=0 ; i < ldh ; i += 8){                                      \
+            const __m256 xv = _mm256_load_ps(x + i);                             \
+            for(int j=0 ; j < 4 ; j++){                                          \
+                acc[j] = _mm256_fmadd_ps(load8_ ## TYPE(W + j * ldh + i), xv, acc[j]); \
+            }                                                                    \
+        }                                                                        \
+        __m128 sum[4];                                                           \
+        for(int j=0 ; j < 4 ; j++){                                              \
+            sum[j] = _mm256_castps256_ps128(acc[j]) + _mm256_extractf128_ps(acc[j], 1); \
+        }                                                                        \
+        return _mm_hadd_ps(_mm_hadd_ps(sum[0], sum[1]), _mm_hadd_ps(sum[2], sum[3])); \
+    }
+#else
+#    define _HDOT4_FUNCTION(TYPE)                                               \
+    static inline __m128 hdot4_ ## TYPE(const float * x, const uint16_t * W, size_t ldh){ \
+        __m128 acc[4] = {_mm_setzero_ps(), _mm_setzero_ps(),                     \
+                         _mm_setzero_ps(), _mm_setzero_ps()};                    \
+        for(size_t i=0 ; i < ldh ; i += 4){                                      \
+            const __m128 xv = _mm_load_ps(x + i);                                \
+            for(int j=0 ; j < 4 ; j++){                                          \
+                acc[j] += load4_ ## TYPE(W + j * ldh + i) * xv;                  \
+            }                                                                    \
+        }                                                                        \
+        _MM_TRANSPOSE4_PS(acc[0], acc[1], acc[2], acc[3]);                       \
+        return acc[0] + acc[1] + acc[2] + acc[3];                                \
+    }
+#endif
+
+_HDOT4_FUNCTION(float16)
+_HDOT4_FUNCTION(bfloat16)
+
+
+/**  Accumulate product of transposed 16 bit matrix and a vector
+ *
+ *   y += W^t x, with W widened to float as it is read.
+ *
+ *   @param hW 16 bit matrix [nr, nc]
+ *   @param x Vector [nr]
+ *   @param y Vector [nc], updated in place
+ **/
+void hgemv(const_scrappie_hmatrix hW, const float * x, float * y){
+    assert(NULL != hW);
+    assert(NULL != x);
+    assert(NULL != y);
+    const size_t ldh = hW->ldh;
+    float xpad[ldh] __attribute__ ((aligned(64)));
+    memcpy(xpad, x, hW->nr * sizeof(float));
+    memset(xpad + hW->nr, 0, (ldh - hW->nr) * sizeof(float));
+
+    const bool bf16 = (SCRAPPIE_PRECISION_BFLOAT16 == hW->precision);
+    for(size_t c=0 ; c < hW->nc ; c += 4){
+        const uint16_t * W = hW->data + c * ldh;
+        const __m128 dot = bf16 ? hdot4_bfloat16(xpad, W, ldh) : hdot4_float16(xpad, W, ldh);
+        if(c + 4 <= hW->nc){
+            _mm_storeu_ps(y + c, _mm_loadu_ps(y + c) + dot);
+        } else {
+            //  Final partial group of columns, padded with zeros
+            float res[4];
+            _mm_storeu_ps(res, dot);
+            for(size_t j=0 ; c + j < hW->nc ; j++){
+                y[c + j] += res[j];
+            }
+        }
+    }
+}
+
+
+/**  Widen columns of 16 bit matrix to float
+ *
+ *   @param hW 16 bit matrix [nr, nc]
+ *   @param c0 First column to widen
+ *   @param nc Number of columns to widen
+ *   @param W Output, nc columns of length hW->ldh
+ **/
+static void widen_columns(const_scrappie_hmatrix hW, size_t c0, size_t nc, float * W){
+    const size_t n = nc * hW->ldh;
+    const uint16_t * h = hW->data + c0 * hW->ldh;
+    if(SCRAPPIE_PRECISION_BFLOAT16 == hW->precision){
+        for(size_t i=0 ; i < n ; i += 4){
+            _mm_store_ps(W + i, load4_bfloat16(h + i));
+        }
+    } else {
+        for(size_t i=0 ; i < n ; i += 4){
+            _mm_store_ps(W + i, load4_float16(h + i));
+        }
+    }
+}
+
+
+//  Number of columns of a 16 bit matrix widened at once by haffine_map
+#define HMAT_PANEL 32
+
+/**  Accumulate product of transposed 16 bit matrix and a matrix
+ *
+ *   C += W^t X.  Panels of columns of W are widened into a small buffer,
+ *   which stays in cache, and multiplied using BLAS.  Bias should already
+ *   have been copied into C.
+ *
+ *   @param X Input matrix [nr, nc]
+ *   @param hW 16 bit matrix [nr, nk]
+ *   @param C Output matrix [nk, nc], updated in place
+ *
+ *   @returns true on success, false if the buffer could not be allocated
+ **/
+bool haffine_map(const_scrappie_matrix X, const_scrappie_hmatrix hW, scrappie_matrix C){
+    assert(NULL != X);
+    assert(NULL != hW);
+    assert(NULL != C);
+    assert(X->nrq * 4 == hW->nr);
+    assert(C->nr == hW->nc);
+    assert(C->nc == X->nc);
+
+    float * panel = aligned_alloc(64, HMAT_PANEL * hW->ldh * sizeof(float));
+    if(NULL == panel){
+        warnx("Error allocating memory in %s.\n", __func__);
+        return false;
+    }
+    for(size_t c=0 ; c < hW->nc ; c += HMAT_PANEL){
+        const size_t nc = (c + HMAT_PANEL <= hW->nc) ? HMAT_PANEL : (hW->nc - c);
+        widen_columns(hW, c, nc, panel);
+        cblas_sgemm(CblasColMajor, CblasTrans, CblasNoTrans, nc, X->nc, hW->nr,
+                    1.0, panel, hW->ldh, X->data.f, X->nrq * 4, 1.0,
+                    C->data.f + c, C->nrq * 4);
+    }
+    free(panel);
+    return true;
+}
+
+
+/**  Widen a 16 bit matrix to float
+ *
+ *   @param hW 16 bit matrix
+ *
+ *   @returns Float matrix, to be freed by caller, or NULL on failure
+ **/
+scrappie_matrix widen_scrappie_hmatrix(const_scrappie_hmatrix hW){
+    RETURN_NULL_IF(NULL == hW, NULL);
+    scrappie_matrix W = make_scrappie_matrix(hW->nr, hW->nc);
+    RETURN_NULL_IF(NULL == W, NULL);
+    const bool bf16 = (SCRAPPIE_PRECISION_BFLOAT16 == hW->precision);
+    for(size_t c=0 ; c < hW->nc ; c++){
+        for(size_t r=0 ; r < hW->nr ; r++){
+            const uint16_t h = hW->data[c * hW->ldh + r];
+            W->data.f[c * hW->nr + r] = bf16 ? bfloat16_to_float(h) : float16_to_float(h);
+        }
+    }
+    return W;
+}
+
+
+scrappie_pmatrix make_scrappie_pmatrix(const_scrappie_matrix W){
+    RETURN_NULL_IF(NULL == W, NULL);
+    const size_t npanel = (W->nc + PMAT_PANEL - 1) / PMAT_PANEL;
+    const size_t nbyte = npanel * W->nr * PMAT_PANEL * sizeof(float);
+
+    scrappie_pmatrix mat = malloc(sizeof(*mat));
+    RETURN_NULL_IF(NULL == mat, NULL);
+    mat->nr = W->nr;
+    mat->nc = W->nc;
+    mat->npanel = npanel;
+    mat->kernel = get_pgemm_kernel(W->nr, W->nc);
+    mat->step_kernel = (W->nr == W->nc) ? get_gru_step_kernel(W->nr) : NULL;
+    mat->data = aligned_alloc(PMAT_PANEL * sizeof(float), nbyte);
+    if(NULL == mat->data){
+        warnx("Error allocating memory in %s.\n", __func__);
+        return free_scrappie_pmatrix(mat);
+    }
+    memset(mat->data, 0, nbyte);
+
+    const size_t ldW = W->nrq * 4;
+    for(size_t c=0 ; c < W->nc ; c++){
+        float * panel = mat->data + (c / PMAT_PANEL) * W->nr * PMAT_PANEL + c % PMAT_PANEL;
+        for(size_t r=0 ; r < W->nr ; r++){
+            panel[r * PMAT_PANEL] = W->data.f[c * ldW + r];
+        }
+    }
+
+    return mat;
+}
+
+scrappie_pmatrix free_scrappie_pmatrix(scrappie_pmatrix mat){
+    if(NULL != mat){
+        free(mat->data);
+    }
+    free(mat);
+    return NULL;
+}
+
+
+/**  Accumulate product of a block of rows of a transposed packed matrix and
+ *   a vector
+ *
+ *   y += W[k0:k0+nk, ]^t x.  The kernel specialised to the shape of W is used
+ *   when there is one and all rows are used.
+ *
+ *   @param pW Packed matrix [nr, nc]
+ *   @param k0 First row of W to use
+ *   @param nk Number of rows of W to use
+ *   @param x Vector [nk]
+ *   @param y Vector [nc], updated in place
+ **/
+void pgemv(const_scrappie_pmatrix pW, size_t k0, size_t nk, const float * x, float * y){
+    assert(NULL != pW);
+    assert(NULL != x);
+    assert(NULL != y);
+    assert(k0 + nk <= pW->nr);
+    if(NULL != pW->kernel && 0 == k0 && pW->nr == nk){
+        pW->kernel(pW->data, x, 0, 1, y, 0);
+        return;
+    }
+    pgemv_panels(pW->data + k0 * PMAT_PANEL, (size_t)pW->nr * PMAT_PANEL, nk, pW->npanel,
+                 pW->nc, x, y);
+}
+
+
+/**  Accumulate product of a block of rows of a transposed packed matrix and
+ *   a matrix
+ *
+ *   C += W[k0:k0+nk, ]^t X.  The kernel specialised to the shape of W is used
+ *   when there is one and all rows are used.
+ *
+ *   @param pW Packed matrix [nr, nc]
+ *   @param k0 First row of W to use
+ *   @param nk Number of rows of W to use
+ *   @param X Input matrix [nk, ncol], columns ldX apart
+ *   @param ldX Stride between columns of X
+ *   @param ncol Number of columns of X
+ *   @param C Output matrix [nc, ncol], columns ldC apart, updated in place
+ *   @param ldC Stride between columns of C
+ **/
+void pgemm(const_scrappie_pmatrix pW, size_t k0, size_t nk, const float * X, size_t ldX,
+           size_t ncol, float * C, size_t ldC){
+    assert(NULL != pW);
+    assert(NULL != X);
+    assert(NULL != C);
+    assert(k0 + nk <= pW->nr);
+    if(NULL != pW->kernel && 0 == k0 && pW->nr == nk){
+        pW->kernel(pW->data, X, ldX, ncol, C, ldC);
+        return;
+    }
+    pgemm_panels(pW->data + k0 * PMAT_PANEL, (size_t)pW->nr * PMAT_PANEL, nk, pW->npanel,
+                 pW->nc, X, ldX, ncol, C, ldC);
+}
+
+
+/**  Accumulate product of transposed packed matrix and a matrix
+ *
+ *   C += W^t X.  Bias should already have been copied into C.
+ *
+ *   @param X Input matrix [nr, nc]
+ *   @param pW Packed matrix [nr, nk]
+ *   @param C Output matrix [nk, nc], updated in place
+ **/
+void paffine_map(const_scrappie_matrix X, const_scrappie_pmatrix pW, scrappie_matrix C){
+    assert(NULL != X);
+    assert(NULL != pW);
+    assert(NULL != C);
+    assert(X->nr == pW->nr);
+    assert(C->nr == pW->nc);
+    assert(C->nc == X->nc);
+    pgemm(pW, 0, pW->nr, X->data.f, X->nrq * 4, X->nc, C->data.f, C->nrq * 4);
+}
+
+
+
+//  Norm of a block of a matrix, with its index, for ordering blocks when pruning
+struct block_norm {
+    float norm;
+    size_t index;
+};
+
+static int block_norm_cmp(const void * a, const void * b){
+    const float na = ((const struct block_norm *)a)->norm;
+    const float nb = ((const struct block_norm *)b)->norm;
+    return (na > nb) - (na < nb);
+}
+
+/**  Prune matrix to blocks
+ *
+ *   Blocks of SMAT_BLOCK rows by PMAT_PANEL columns are ranked by the mean
+ *   square of the elements they hold, so blocks cut short at the edges of
+ *   the matrix are not favoured for dropping by their size, and the smallest
+ *   floor(sparsity * nblock) are dropped.  Blocks of a final panel narrower
+ *   than PMAT_PANEL are never dropped: for output layers, it holds only the
+ *   column for staying, on which every call depends.
+ *
+ *   @param W Matrix [nr, nc]
+ *   @param sparsity Fraction of blocks to drop, in [0, 1]
+ *
+ *   @returns Pruned matrix or NULL on failure
+ **/
+scrappie_smatrix make_scrappie_smatrix(const_scrappie_matrix W, float sparsity){
+    RETURN_NULL_IF(NULL == W, NULL);
+    assert(sparsity >= 0.0f && sparsity <= 1.0f);
+    const size_t ldW = W->nrq * 4;
+    const size_t nrblock = (W->nr + SMAT_BLOCK - 1) / SMAT_BLOCK;
+    const size_t npanel = (W->nc + PMAT_PANEL - 1) / PMAT_PANEL;
+    const size_t nblock = nrblock * npanel;
+
+    //  Blocks are indexed panel by panel, rows fastest
+    struct block_norm * norms = calloc(nblock, sizeof(*norms));
+    bool * keep = calloc(nblock, sizeof(*keep));
+    if(NULL == norms || NULL == keep){
+        free(keep);
+        free(norms);
+        warnx("Error allocating memory in %s.\n", __func__);
+        return NULL;
+    }
+    //  Only blocks of whole panels are candidates for dropping
+    const size_t ncandidate = (W->nc / PMAT_PANEL) * nrblock;
+    for(size_t i=0 ; i < ncandidate ; i++){
+        const size_t r0 = (i % nrblock) * SMAT_BLOCK;
+        const size_t c0 = (i / nrblock) * PMAT_PANEL;
+        const size_t r1 = (r0 + SMAT_BLOCK < W->nr) ? r0 + SMAT_BLOCK : W->nr;
+        float sumsq = 0.0f;
+        for(size_t c=c0 ; c < c0 + PMAT_PANEL ; c++){
+            for(size_t r=r0 ; r < r1 ; r++){
+                const float w = W->data.f[c * ldW + r];
+                sumsq += w * w;
+            }
+        }
+        norms[i] = (struct block_norm){sumsq / ((r1 - r0) * PMAT_PANEL), i};
+    }
+    for(size_t i=0 ; i < nblock ; i++){
+        keep[i] = true;
+    }
+    qsort(norms, ncandidate, sizeof(*norms), block_norm_cmp);
+    const size_t nprune_wanted = (size_t)(sparsity * nblock);
+    const size_t nprune = (nprune_wanted < ncandidate) ? nprune_wanted : ncandidate;
+    for(size_t i=0 ; i < nprune ; i++){
+        keep[norms[i].index] = false;
+    }
+    free(norms);
+
+    scrappie_smatrix mat = calloc(1, sizeof(*mat));
+    if(NULL == mat){
+        free(keep);
+        return NULL;
+    }
+    mat->nr = W->nr;
+    mat->nc = W->nc;
+    mat->npanel = npanel;
+    mat->nblock = nblock - nprune;
+    //  At least one block is allocated, so an empty matrix is still valid
+    const size_t nalloc = (mat->nblock > 0) ? mat->nblock : 1;
+    const size_t nbyte = nalloc * SMAT_BLOCK * PMAT_PANEL * sizeof(float);
+    mat->panel_start = calloc(npanel + 1, sizeof(*mat->panel_start));
+    mat->block_row = calloc(nalloc, sizeof(*mat->block_row));
+    mat->data = aligned_alloc(PMAT_PANEL * sizeof(float), nbyte);
+    if(NULL == mat->panel_start || NULL == mat->block_row || NULL == mat->data){
+        free(keep);
+        warnx("Error allocating memory in %s.\n", __func__);
+        return free_scrappie_smatrix(mat);
+    }
+    memset(mat->data, 0, nbyte);
+
+    size_t b = 0;
+    for(size_t i=0 ; i < nblock ; i++){
+        const size_t p = i / nrblock;
+        if(0 == i % nrblock){
+            mat->panel_start[p] = b;
+        }
+        if(!keep[i]){
+            continue;
+        }
+        const size_t r0 = (i % nrblock) * SMAT_BLOCK;
+        float * block = mat->data + b * SMAT_BLOCK * PMAT_PANEL;
+        for(size_t j=0 ; j < PMAT_PANEL && p * PMAT_PANEL + j < W->nc ; j++){
+            const float * col = W->data.f + (p * PMAT_PANEL + j) * ldW;
+            for(size_t r=0 ; r < SMAT_BLOCK && r0 + r < W->nr ; r++){
+                block[r * PMAT_PANEL + j] = col[r0 + r];
+            }
+        }
+        mat->block_row[b] = r0;
+        b += 1;
+    }
+    mat->panel_start[npanel] = b;
+    assert(b == mat->nblock);
+    free(keep);
+
+    return mat;
+}
+
+scrappie_smatrix free_scrappie_smatrix(scrappie_smatrix mat){
+    if(NULL != mat){
+        free(mat->data);
+        free(mat->block_row);
+        free(mat->panel_start);
+    }
+    free(mat);
+    return NULL;
+}
+
+
+/**  Accumulate product of transposed pruned matrix and a matrix
+ *
+ *   C += W^t X, skipping dropped blocks.  Columns of X are taken four at a
+ *   time so each row of a block loaded is used four times.
+ *
+ *   @param sW Pruned matrix [nr, nc]
+ *   @param X Input matrix [nr, ncol], columns ldX apart
+ *   @param ldX Stride between columns of X
+ *   @param ncol Number of columns of X
+ *   @param C Output matrix [nc, ncol], columns ldC apart, updated in place
+ *   @param ldC Stride between columns of C
+ **/
+static void sgemm(const_scrappie_smatrix sW, const float * X, size_t ldX, size_t ncol,
+                  float * C, size_t ldC){
+    size_t j = 0;
+    for( ; j + 4 <= ncol ; j += 4){
+        const float * x0 = X + j * ldX;
+        const float * x1 = x0 + ldX;
+        const float * x2 = x1 + ldX;
+        const float * x3 = x2 + ldX;
+        for(size_t p=0 ; p < sW->npanel ; p++){
+            //  Even and odd rows of each block are accumulated separately
+            pvec a0 = pvec_zero(), a1 = pvec_zero(), a2 = pvec_zero(), a3 = pvec_zero();
+            pvec b0 = pvec_zero(), b1 = pvec_zero(), b2 = pvec_zero(), b3 = pvec_zero();
+            for(size_t b=sW->panel_start[p] ; b < sW->panel_start[p + 1] ; b++){
+                const float * Wb = sW->data + b * SMAT_BLOCK * PMAT_PANEL;
+                const size_t r0 = sW->block_row[b];
+                const size_t nrow = (sW->nr - r0 < SMAT_BLOCK) ? (sW->nr - r0) : SMAT_BLOCK;
+                size_t r = 0;
+                for( ; r + 2 <= nrow ; r += 2){
+                    const pvec w = pvec_load(Wb + r * PMAT_PANEL);
+                    const pvec v = pvec_load(Wb + (r + 1) * PMAT_PANEL);
+                    a0 = pvec_fmadd(pvec_set1(x0[r0 + r]), w, a0);
+                    a1 = pvec_fmadd(pvec_set1(x1[r0 + r]), w, a1);
+                    a2 = pvec_fmadd(pvec_set1(x2[r0 + r]), w, a2);
+                    a3 = pvec_fmadd(pvec_set1(x3[r0 + r]), w, a3);
+                    b0 = pvec_fmadd(pvec_set1(x0[r0 + r + 1]), v, b0);
+                    b1 = pvec_fmadd(pvec_set1(x1[r0 + r + 1]), v, b1);
+                    b2 = pvec_fmadd(pvec_set1(x2[r0 + r + 1]), v, b2);
+                    b3 = pvec_fmadd(pvec_set1(x3[r0 + r + 1]), v, b3);
+                }
+                if(r < nrow){
+                    const pvec w = pvec_load(Wb + r * PMAT_PANEL);
+                    a0 = pvec_fmadd(pvec_set1(x0[r0 + r]), w, a0);
+                    a1 = pvec_fmadd(pvec_set1(x1[r0 + r]), w, a1);
+                    a2 = pvec_fmadd(pvec_set1(x2[r0 + r]), w, a2);
+                    a3 = pvec_fmadd(pvec_set1(x3[r0 + r]), w, a3);
+                }
+            }
+            const size_t c = p * PMAT_PANEL;
+            const size_t n = panel_ncol(sW->nc, p);
+            float * c0 = C + j * ldC + c;
+            pvec_accumulate(c0, pvec_add(a0, b0), n);
+            pvec_accumulate(c0 + ldC, pvec_add(a1, b1), n);
+            pvec_accumulate(c0 + 2 * ldC, pvec_add(a2, b2), n);
+            pvec_accumulate(c0 + 3 * ldC, pvec_add(a3, b3), n);
+        }
+    }
+    for( ; j < ncol ; j++){
+        sgemv(sW, X + j * ldX, C + j * ldC);
+    }
+}
+
+
+/**  Accumulate product of transposed pruned matrix and a vector
+ *
+ *   y += W^t x, skipping dropped blocks.  Each row of a block has its own
+ *   accumulator so that the dependency chains are short.
+ *
+ *   @param sW Pruned matrix [nr, nc]
+ *   @param x Vector [nr]
+ *   @param y Vector [nc], updated in place
+ **/
+void sgemv(const_scrappie_smatrix sW, const float * x, float * y){
+    assert(NULL != sW);
+    assert(NULL != x);
+    assert(NULL != y);
+    for(size_t p=0 ; p < sW->npanel ; p++){
+        pvec acc[SMAT_BLOCK];
+        for(size_t r=0 ; r < SMAT_BLOCK ; r++){
+            acc[r] = pvec_zero();
+        }
+        for(size_t b=sW->panel_start[p] ; b < sW->panel_start[p + 1] ; b++){
+            const float * Wb = sW->data + b * SMAT_BLOCK * PMAT_PANEL;
+            const float * xb = x + sW->block_row[b];
+            const size_t nrow = sW->nr - sW->block_row[b];
+            if(nrow >= SMAT_BLOCK){
+                for(size_t r=0 ; r < SMAT_BLOCK ; r++){
+                    acc[r] = pvec_fmadd(pvec_set1(xb[r]), pvec_load(Wb + r * PMAT_PANEL), acc[r]);
+                }
+            } else {
+                for(size_t r=0 ; r < nrow ; r++){
+                    acc[r] = pvec_fmadd(pvec_set1(xb[r]), pvec_load(Wb + r * PMAT_PANEL), acc[r]);
+                }
+            }
+        }
+        for(size_t r=1 ; r < SMAT_BLOCK ; r++){
+            acc[0] = pvec_add(acc[0], acc[r]);
+        }
+        pvec_accumulate(y + p * PMAT_PANEL, acc[0], panel_ncol(sW->nc, p));
+    }
+}
+
+
+/**  Accumulate product of transposed pruned matrix and a matrix
+ *
+ *   C += W^t X.  Bias should already have been copied into C.
+ *
+ *   @param X Input matrix [nr, nc]
+ *   @param sW Pruned matrix [nr, nk]
+ *   @param C Output matrix [nk, nc], updated in place
+ **/
+void saffine_map(const_scrappie_matrix X, const_scrappie_smatrix sW, scrappie_matrix C){
+    assert(NULL != X);
+    assert(NULL != sW);
+    assert(NULL != C);
+    assert(X->nr == sW->nr);
+    assert(C->nr == sW->nc);
+    assert(C->nc == X->nc);
+    sgemm(sW, X->data.f, X->nrq * 4, X->nc, C->data.f, C->nrq * 4);
+}
+
+//  Registry of converted weights
+static struct {
+    const _Mat * W;
+    scrappie_qmatrix qW;
+    scrappie_hmatrix hW;
+    scrappie_pmatrix pW;
+    scrappie_smatrix sW;
+} * weight_registry = NULL;
+static size_t weight_registry_n = 0;
+//  Changed whenever the registry is, so resolved weights can be refreshed
+static unsigned int weight_generation = 0;
+
+static void clear_weight_registry(void){
+    weight_generation += 1;
+    for(size_t i=0 ; i < weight_registry_n ; i++){
+        weight_registry[i].qW = free_scrappie_qmatrix(weight_registry[i].qW);
+        weight_registry[i].hW = free_scrappie_hmatrix(weight_registry[i].hW);
+        weight_registry[i].pW = free_scrappie_pmatrix(weight_registry[i].pW);
+        weight_registry[i].sW = free_scrappie_smatrix(weight_registry[i].sW);
+    }
+    free(weight_registry);
+    weight_registry = NULL;
+    weight_registry_n = 0;
+}
+
+/**  Set precision of weights
+ *
+ *   Converts each matrix to the requested precision, or packs it when the
+ *   precision is float32, and registers the result, replacing any previously
+ *   converted weights.  Calling with no matrices just clears the registry.
+ *   Not thread safe; should be called before any parallel work is started.
+ *
+ *   The matrices converted are left as they are, so their memory is held
+ *   alongside the converted copies.  Model weights are compiled in or mapped
+ *   from a model file, so are backed by a file and may be dropped by the
+ *   system once only the copies are read; layers without a reduced
+ *   precision kernel read them, and they let the precision be changed
+ *   without reloading the model.
+ *
+ *   @param W Array of weight matrices
+ *   @param nW Number of matrices
+ *   @param precision Precision to use
+ *
+ *   @returns true on success.  On failure all weights are left as float.
+ **/
+bool set_weight_precision(_Mat * const * W, size_t nW, enum scrappie_precision precision){
+    clear_weight_registry();
+    if(0 == nW){
+        return true;
+    }
+    RETURN_NULL_IF(NULL == W, false);
+    assert(precision < SCRAPPIE_PRECISION_INVALID);
+
+    weight_registry = calloc(nW, sizeof(*weight_registry));
+    RETURN_NULL_IF(NULL == weight_registry, false);
+    for(size_t i=0 ; i < nW ; i++){
+        weight_registry[i].W = W[i];
+        weight_registry_n = i + 1;
+        if(SCRAPPIE_PRECISION_FLOAT32 == precision){
+            weight_registry[i].pW = make_scrappie_pmatrix(W[i]);
+        } else if(SCRAPPIE_PRECISION_INT8 == precision){
+            weight_registry[i].qW = make_scrappie_qmatrix(W[i]);
+        } else {
+            weight_registry[i].hW = make_scrappie_hmatrix(W[i], precision);
+        }
+        if(NULL == weight_registry[i].qW && NULL == weight_registry[i].hW
+           && NULL == weight_registry[i].pW){
+            clear_weight_registry();
+            return false;
+        }
+    }
+    return true;
+}
+
+/**  Prune weights to blocks
+ *
+ *   Prunes each matrix and registers the result, replacing any converted or
+ *   packed version of it.  Other registered weights are kept, so the
+ *   remaining weights of a model can be packed by set_weight_precision
+ *   first.  Not thread safe; should be called before any parallel work is
+ *   started.
+ *
+ *   @param W Array of weight matrices
+ *   @param nW Number of matrices
+ *   @param sparsity Fraction of blocks of each matrix to drop
+ *
+ *   @returns true on success.  On failure all weights are left as float.
+ **/
+bool set_weight_sparsity(_Mat * const * W, size_t nW, float sparsity){
+    RETURN_NULL_IF(NULL == W && nW > 0, false);
+    weight_generation += 1;
+    for(size_t i=0 ; i < nW ; i++){
+        size_t idx = 0;
+        while(idx < weight_registry_n && W[i] != weight_registry[idx].W){
+            idx++;
+        }
+        if(weight_registry_n == idx){
+            void * registry = realloc(weight_registry, (weight_registry_n + 1) * sizeof(*weight_registry));
+            if(NULL == registry){
+                clear_weight_registry();
+                return false;
+            }
+            weight_registry = registry;
+            memset(weight_registry + idx, 0, sizeof(*weight_registry));
+            weight_registry[idx].W = W[i];
+            weight_registry_n += 1;
+        }
+        weight_registry[idx].qW = free_scrappie_qmatrix(weight_registry[idx].qW);
+        weight_registry[idx].hW = free_scrappie_hmatrix(weight_registry[idx].hW);
+        weight_registry[idx].pW = free_scrappie_pmatrix(weight_registry[idx].pW);
+        weight_registry[idx].sW = free_scrappie_smatrix(weight_registry[idx].sW);
+        weight_registry[idx].sW = make_scrappie_smatrix(W[i], sparsity);
+        if(NULL == weight_registry[idx].sW){
+            clear_weight_registry();
+            return false;
+        }
+    }
+    return true;
+}
+
+/**  Generation of the registry of converted weights
+ *
+ *   @returns Number that changes whenever weights are converted or the
+ *   registry cleared, so weights resolved earlier are out of date
+ **/
+unsigned int weight_registry_generation(void){
+    return weight_generation;
+}
+
+//  Entry of registry for weight matrix, or NULL if it has none
+static const struct scrappie_weights * find_weights(const_scrappie_matrix W, struct scrappie_weights * found){
+    for(size_t i=0 ; i < weight_registry_n ; i++){
+        if(W == weight_registry[i].W){
+            *found = (struct scrappie_weights){weight_registry[i].qW, weight_registry[i].hW,
+                                               weight_registry[i].pW, weight_registry[i].sW};
+            return found;
+        }
+    }
+    return NULL;
+}
+
+/**  Resolve converted versions of weight matrix
+ *
+ *   Searches the registry once, so that kernels given the copy returned
+ *   need not.  The copy is valid until weights are next converted, when
+ *   weight_registry_generation changes.
+ *
+ *   @param W Weight matrix
+ *   @param converted [out] Converted versions of W, which must outlive the copy
+ *
+ *   @returns Copy of header of W, pointing to converted
+ **/
+_Mat resolve_weights(const_scrappie_matrix W, struct scrappie_weights * converted){
+    assert(NULL != W);
+    assert(NULL != converted);
+    if(NULL == find_weights(W, converted)){
+        *converted = (struct scrappie_weights){NULL, NULL, NULL, NULL};
+    }
+    _Mat header = *W;
+    header.converted = converted;
+    return header;
+}
+
+//  Converted versions of weight matrix, resolved or looked up
+static struct scrappie_weights lookup_weights(const_scrappie_matrix W){
+    struct scrappie_weights found = {NULL, NULL, NULL, NULL};
+    if(NULL != W->converted){
+        return *W->converted;
+    }
+    (void)find_weights(W, &found);
+    return found;
+}
+
+/**  Find int8 version of weight matrix
+ *
+ *   @param W Weight matrix
+ *
+ *   @returns Quantised matrix or NULL if W has not been converted
+ **/
+const_scrappie_qmatrix get_int8_weights(const_scrappie_matrix W){
+    return lookup_weights(W).qW;
+}
+
+/**  Find 16 bit version of weight matrix
+ *
+ *   @param W Weight matrix
+ *
+ *   @returns 16 bit matrix or NULL if W has not been converted
+ **/
+const_scrappie_hmatrix get_half_weights(const_scrappie_matrix W){
+    return lookup_weights(W).hW;
+}
+
+/**  Find packed version of weight matrix
+ *
+ *   @param W Weight matrix
+ *
+ *   @returns Packed matrix or NULL if W has not been packed
+ **/
+const_scrappie_pmatrix get_packed_weights(const_scrappie_matrix W){
+    return lookup_weights(W).pW;
+}
+
+/**  Find pruned version of weight matrix
+ *
+ *   @param W Weight matrix
+ *
+ *   @returns Pruned matrix or NULL if W has not been pruned
+ **/
+const_scrappie_smatrix get_sparse_weights(const_scrappie_matrix W){
+    return lookup_weights(W).sW;
+}
@@ -0,0 +1,160 @@
+#pragma once
+#ifndef PRECISION_H
+#    define PRECISION_H
+
+#    include <stdbool.h>
+#    include <stdint.h>
+#    include "scrappie_matrix.h"
+
+/*  Reduced precision, packed and pruned storage of model weights.
+ *
+ *  Weights are converted once, when a model is prepared, and registered
+ *  against the float matrix they were converted from.  Layers resolve each
+ *  weight matrix once, as they are built, and use the reduced precision or
+ *  packed kernels when a converted version exists, falling back to BLAS
+ *  otherwise.  Single precision weights are packed into panels, and
+ *  may additionally be pruned to blocks.
+ */
+enum scrappie_precision {
+    SCRAPPIE_PRECISION_FLOAT32 = 0,
+    SCRAPPIE_PRECISION_INT8,
+    SCRAPPIE_PRECISION_FLOAT16,
+    SCRAPPIE_PRECISION_BFLOAT16,
+    SCRAPPIE_PRECISION_INVALID
+};
+static const int scrappie_nprecision = 4;
+
+enum scrappie_precision get_scrappie_precision(const char * precisionstr);
+const char * scrappie_precision_string(const enum scrappie_precision precision);
+
+
+/*  Int8 matrix with one scale per column.  Column j of the original
+ *  matrix is approximately scale[j] * data[:, j].  The rows are padded
+ *  with zeros to a multiple of 64.
+ */
+typedef struct {
+    unsigned int nr, nrb, nc;
+    float * scale;
+    int8_t * data;
+} _qMat;
+
+typedef _qMat *scrappie_qmatrix;
+typedef _qMat const *const_scrappie_qmatrix;
+
+//  Number of int8 elements in each block of rows
+#    define QMAT_BLOCK 64
+
+scrappie_qmatrix make_scrappie_qmatrix(const_scrappie_matrix W);
+scrappie_qmatrix free_scrappie_qmatrix(scrappie_qmatrix mat);
+void qgemv(const_scrappie_qmatrix qW, const float * x, float * y);
+void qaffine_map(const_scrappie_matrix X, const_scrappie_qmatrix qW, scrappie_matrix C);
+
+
+/*  Float16 or bfloat16 matrix.  Columns are stored ldh apart, the rows
+ *  being padded with zeros to a multiple of 16.
+ */
+typedef struct {
+    unsigned int nr, ldh, nc;
+    enum scrappie_precision precision;
+    uint16_t * data;
+} _hMat;
+
+typedef _hMat *scrappie_hmatrix;
+typedef _hMat const *const_scrappie_hmatrix;
+
+//  Number of 16 bit elements in each block of rows
+#    define HMAT_BLOCK 16
+
+scrappie_hmatrix make_scrappie_hmatrix(const_scrappie_matrix W, enum scrappie_precision precision);
+scrappie_hmatrix free_scrappie_hmatrix(scrappie_hmatrix mat);
+scrappie_matrix widen_scrappie_hmatrix(const_scrappie_hmatrix hW);
+void hgemv(const_scrappie_hmatrix hW, const float * x, float * y);
+bool haffine_map(const_scrappie_matrix X, const_scrappie_hmatrix hW, scrappie_matrix C);
+
+/*  Float matrix packed into panels of PMAT_PANEL columns.  Within a panel
+ *  the weights of each row are contiguous, so W^t x is accumulated one row
+ *  at a time with aligned loads and no horizontal sums.  The final panel
+ *  is padded with zero columns.
+ */
+/*  Kernel for C += W^t X specialised to the shape of a packed matrix.
+ *  Arguments are the packed data, X, the stride of X, the number of columns
+ *  of X, C and the stride of C.
+ */
+typedef void (*pgemm_kernel)(const float *, const float *, size_t, size_t, float *, size_t);
+
+/*  Single GRU step with packed recurrent weights.  Arguments are as
+ *  gru_step_panels in packed_kernels.h, without the size.
+ */
+typedef void (*gru_step_kernel)(const float *, const float *, const float *, const float *,
+                                float *, float *);
+
+typedef struct {
+    unsigned int nr, nc, npanel;
+    float * data;
+    //  Kernel specialised to shape of matrix, or NULL
+    pgemm_kernel kernel;
+    //  GRU step specialised to size of square recurrent matrix, or NULL
+    gru_step_kernel step_kernel;
+} _pMat;
+
+typedef _pMat *scrappie_pmatrix;
+typedef _pMat const *const_scrappie_pmatrix;
+
+//  Number of columns in each panel
+#    define PMAT_PANEL 8
+
+scrappie_pmatrix make_scrappie_pmatrix(const_scrappie_matrix W);
+scrappie_pmatrix free_scrappie_pmatrix(scrappie_pmatrix mat);
+void pgemv(const_scrappie_pmatrix pW, size_t k0, size_t nk, const float * x, float * y);
+void pgemm(const_scrappie_pmatrix pW, size_t k0, size_t nk, const float * X, size_t ldX,
+           size_t ncol, float * C, size_t ldC);
+void paffine_map(const_scrappie_matrix X, const_scrappie_pmatrix pW, scrappie_matrix C);
+
+/*  Float matrix pruned to blocks of SMAT_BLOCK rows by PMAT_PANEL columns.
+ *  The blocks of smallest mean square weight, other than those of a final
+ *  partial panel, are dropped and the remainder stored, panel by panel, each block row by row as in _pMat, so products
+ *  skip the dropped blocks entirely.
+ */
+typedef struct {
+    unsigned int nr, nc, npanel, nblock;
+    //  Index of first block of each panel, with a final entry of nblock
+    unsigned int * panel_start;
+    //  First row of W covered by each block
+    unsigned int * block_row;
+    float * data;
+} _sMat;
+
+typedef _sMat *scrappie_smatrix;
+typedef _sMat const *const_scrappie_smatrix;
+
+//  Number of rows in each block
+#    define SMAT_BLOCK 8
+
+scrappie_smatrix make_scrappie_smatrix(const_scrappie_matrix W, float sparsity);
+scrappie_smatrix free_scrappie_smatrix(scrappie_smatrix mat);
+void sgemv(const_scrappie_smatrix sW, const float * x, float * y);
+void saffine_map(const_scrappie_matrix X, const_scrappie_smatrix sW, scrappie_matrix C);
+
+/*  Converted versions of a weight matrix, each NULL if the weights have not
+ *  been converted to it.  Resolved from the registry once, as a layer is
+ *  built, and stored with the layer; the copy of the header of the weights
+ *  stored alongside points to them, so the kernels applied at each step
+ *  find them without searching the registry.
+ */
+struct scrappie_weights {
+    const_scrappie_qmatrix qW;
+    const_scrappie_hmatrix hW;
+    const_scrappie_pmatrix pW;
+    const_scrappie_smatrix sW;
+};
+
+bool set_weight_precision(_Mat * const * W, size_t nW, enum scrappie_precision precision);
+bool set_weight_sparsity(_Mat * const * W, size_t nW, float sparsity);
+unsigned int weight_registry_generation(void);
+_Mat resolve_weights(const_scrappie_matrix W, struct scrappie_weights * converted);
+const_scrappie_qmatrix get_int8_weights(const_scrappie_matrix W);
+const_scrappie_hmatrix get_half_weights(const_scrappie_matrix W);
+const_scrappie_pmatrix get_packed_weights(const_scrappie_matrix W);
+const_scrappie_smatrix get_sparse_weights(const_scrappie_matrix W);
+
+#endif                          /* PRECISION_H */
@@ -0,0 +1,291 @@
+#include <assert.h>
+#include <err.h>
+#include <time.h>
+
+#include "read_pipeline.h"
+#include "scrappie_common.h"
+#include "scrappie_stdlib.h"
+
+static double elapsed(const struct timespec *t0, const struct timespec *t1) {
+    return (t1->tv_sec - t0->tv_sec) + 1e-9 * (t1->tv_nsec - t0->tv_nsec);
+}
+
+static void free_read(struct fast5_read *read) {
+    free(read->dt.raw);
+    free(read->name);
+    *read = (struct fast5_read) {0};
+}
+
+/**  Body of reader thread
+ *
+ *   Reads are claimed from the reader holding the reader lock, then read and
+ *   trimmed outside of it, so threads decompress signal in parallel, and
+ *   placed on the queue, waiting while the queue is full.  Reads that cannot
+ *   be read or trimmed are dropped with a warning.
+ *
+ *   @param arg Pipeline
+ *
+ *   @returns NULL
+ **/
+static void *read_pipeline_thread(void *arg) {
+    struct read_pipeline *pipeline = arg;
+
+    while (true) {
+        struct timespec t0, t1, t2;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+
+        struct fast5_read_claim claim;
+        bool have_read = false;
+        pthread_mutex_lock(&pipeline->reader_lock);
+        if (!pipeline->stop && (pipeline->limit <= 0 || pipeline->nstarted < pipeline->limit)) {
+            have_read = claim_fast5_read(pipeline->reader, &claim);
+            pipeline->nstarted += have_read ? 1 : 0;
+        }
+        pthread_mutex_unlock(&pipeline->reader_lock);
+        if (!have_read) {
+            break;
+        }
+
+        struct fast5_read read = {0};
+        if (!finish_fast5_read(&claim, &read)) {
+            //  Read does not count towards the limit
+            pthread_mutex_lock(&pipeline->reader_lock);
+            pipeline->nstarted -= 1;
+            pthread_mutex_unlock(&pipeline->reader_lock);
+            continue;
+        }
+
+        if (pipeline->trim_reads) {
+            const struct read_trim *trim = &pipeline->trim;
+            read.dt = trim_and_segment_daq(read.dt, trim->trim_start, trim->trim_end,
+                                           trim->varseg_chunk, trim->varseg_thresh);
+            if (NULL == read.dt.raw) {
+                warnx("No basecall returned for %s", read.name);
+                free_read(&read);
+                continue;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        pthread_mutex_lock(&pipeline->queue_lock);
+        while (pipeline->count == pipeline->depth && !pipeline->stop) {
+            pthread_cond_wait(&pipeline->not_full, &pipeline->queue_lock);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        pipeline->read_time += elapsed(&t0, &t1);
+        pipeline->reader_wait += elapsed(&t1, &t2);
+        if (pipeline->stop) {
+            pthread_mutex_unlock(&pipeline->queue_lock);
+            free_read(&read);
+            break;
+        }
+        const size_t tail = (pipeline->head + pipeline->count) % pipeline->depth;
+        pipeline->queue[tail] = read;
+        pipeline->count += 1;
+        pthread_cond_signal(&pipeline->not_empty);
+        pthread_mutex_unlock(&pipeline->queue_lock);
+    }
+
+    pthread_mutex_lock(&pipeline->queue_lock);
+    pipeline->nreader_active -= 1;
+    pthread_cond_broadcast(&pipeline->not_empty);
+    pthread_mutex_unlock(&pipeline->queue_lock);
+
+    return NULL;
+}
+
+/**  Start pipeline reading reads of fast5 files
+ *
+ *   @param paths NULL terminated array of paths, as for make_fast5_reader
+ *   @param path_list File listing further paths, one per line, "-" for
+ *   stdin, or NULL
+ *   @param nreader Number of reader threads
+ *   @param depth Maximum number of reads read ahead
+ *   @param io_depth Reads of signal files kept in flight, or 0 to read signal
+ *   files through their memory map
+ *   @param max_image_size Size in bytes of largest fast5 file read whole into
+ *   memory when opened, or 0 to open files in place
+ *   @param trim Parameters for trimming reads, or NULL to leave reads untrimmed
+ *   @param limit Maximum number of reads to read (0 is unlimited)
+ *
+ *   @returns Pipeline or NULL on failure
+ **/
+struct read_pipeline *make_read_pipeline(char *const *paths, const char *path_list,
+                                         int nreader, size_t depth, size_t io_depth,
+                                         size_t max_image_size,
+                                         const struct read_trim *trim, int limit) {
+    RETURN_NULL_IF(NULL == paths, NULL);
+    RETURN_NULL_IF(nreader < 1, NULL);
+    RETURN_NULL_IF(0 == depth, NULL);
+
+    struct read_pipeline *pipeline = calloc(1, sizeof(struct read_pipeline));
+    RETURN_NULL_IF(NULL == pipeline, NULL);
+    pipeline->reader = make_fast5_reader(paths);
+    pipeline->queue = calloc(depth, sizeof(struct fast5_read));
+    pipeline->threads = calloc(nreader, sizeof(pthread_t));
+    if (NULL == pipeline->reader || NULL == pipeline->queue || NULL == pipeline->threads) {
+        pipeline->reader = free_fast5_reader(pipeline->reader);
+        free(pipeline->queue);
+        free(pipeline->threads);
+        free(pipeline);
+        return NULL;
+    }
+    pipeline->reader->path_list = path_list;
+    pipeline->reader->io_depth = io_depth;
+    pipeline->reader->max_image_size = max_image_size;
+    pipeline->trim_reads = (NULL != trim);
+    if (NULL != trim) {
+        pipeline->trim = *trim;
+    }
+    pipeline->limit = limit;
+    pipeline->depth = depth;
+    pthread_mutex_init(&pipeline->reader_lock, NULL);
+    pthread_mutex_init(&pipeline->queue_lock, NULL);
+    pthread_cond_init(&pipeline->not_empty, NULL);
+    pthread_cond_init(&pipeline->not_full, NULL);
+
+    pthread_mutex_lock(&pipeline->queue_lock);
+    for (int i = 0; i < nreader; i++) {
+        if (0 != pthread_create(pipeline->threads + i, NULL, read_pipeline_thread, pipeline)) {
+            warnx("Failed to start reader thread %d", i);
+            break;
+        }
+        pipeline->nreader += 1;
+        pipeline->nreader_active += 1;
+    }
+    pthread_mutex_unlock(&pipeline->queue_lock);
+
+    if (0 == pipeline->nreader) {
+        return free_read_pipeline(pipeline);
+    }
+
+    return pipeline;
+}
+
+/**  Stop pipeline and free it
+ *
+ *   Reader threads are stopped, if they are still reading, and any reads
+ *   left on the queue freed.
+ *
+ *   @returns NULL
+ **/
+struct read_pipeline *free_read_pipeline(struct read_pipeline *pipeline) {
+    if (NULL == pipeline) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pipeline->reader_lock);
+    pthread_mutex_lock(&pipeline->queue_lock);
+    pipeline->stop = true;
+    pthread_cond_broadcast(&pipeline->not_full);
+    pthread_mutex_unlock(&pipeline->queue_lock);
+    pthread_mutex_unlock(&pipeline->reader_lock);
+    for (int i = 0; i < pipeline->nreader; i++) {
+        pthread_join(pipeline->threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < pipeline->count; i++) {
+        free_read(pipeline->queue + (pipeline->head + i) % pipeline->depth);
+    }
+    pthread_cond_destroy(&pipeline->not_full);
+    pthread_cond_destroy(&pipeline->not_empty);
+    pthread_mutex_destroy(&pipeline->queue_lock);
+    pthread_mutex_destroy(&pipeline->reader_lock);
+    pipeline->reader = free_fast5_reader(pipeline->reader);
+    free(pipeline->threads);
+    free(pipeline->queue);
+    free(pipeline);
+
+    return NULL;
+}
+
+/**  Take next read from pipeline
+ *
+ *   Waits until a read is ready or all readers have finished.  Thread safe.
+ *
+ *   @param pipeline Pipeline
+ *   @param read [out] Name and trimmed signal of read, both to be freed by caller
+ *
+ *   @returns true if a read was returned, false when all reads have been read
+ **/
+bool next_pipeline_read(struct read_pipeline *pipeline, struct fast5_read *read) {
+    RETURN_NULL_IF(NULL == pipeline, false);
+    RETURN_NULL_IF(NULL == read, false);
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_mutex_lock(&pipeline->queue_lock);
+    while (0 == pipeline->count && pipeline->nreader_active > 0) {
+        pthread_cond_wait(&pipeline->not_empty, &pipeline->queue_lock);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    pipeline->compute_wait += elapsed(&t0, &t1);
+
+    const bool have_read = (pipeline->count > 0);
+    if (have_read) {
+        *read = pipeline->queue[pipeline->head];
+        pipeline->queue[pipeline->head] = (struct fast5_read) {0};
+        pipeline->head = (pipeline->head + 1) % pipeline->depth;
+        pipeline->count -= 1;
+        pipeline->nread += 1;
+        pthread_cond_signal(&pipeline->not_full);
+    }
+    pthread_mutex_unlock(&pipeline->queue_lock);
+
+    return have_read;
+}
+
+/**  Print time spent reading reads and waiting for them
+ *
+ *   Time reading includes opening files, decompression and trimming.  Time
+ *   waiting by compute threads is I/O that was not hidden by reading ahead.
+ *   The time taken to open each fast5 file, including reading it into memory
+ *   or out of an archive if it was, and the rate at which the signal of
+ *   signal files read by a stream was read are also printed.
+ *
+ *   @param fp File to print to
+ *   @param pipeline Pipeline
+ *
+ *   @returns Number of characters printed, or negative on failure
+ **/
+int fprintf_read_pipeline_timing(FILE * fp, const struct read_pipeline *pipeline) {
+    RETURN_NULL_IF(NULL == fp, -1);
+    RETURN_NULL_IF(NULL == pipeline, -1);
+    int ret = fprintf(fp, "I/O: %zu reads by %d readers, queue depth %zu\n"
+                      "%-24s %9s\n%-24s %9.3f\n%-24s %9.3f\n%-24s %9.3f\n",
+                      pipeline->nread, pipeline->nreader, pipeline->depth,
+                      "stage", "time(s)",
+                      "reading", pipeline->read_time,
+                      "readers waiting", pipeline->reader_wait,
+                      "compute waiting", pipeline->compute_wait);
+
+    //  Include stream of signal file still open
+    const struct fast5_reader *reader = pipeline->reader;
+    size_t io_nbyte = reader->io_nbyte;
+    double io_time = reader->io_time;
+    bool io_uring = reader->io_uring;
+    if (NULL != reader->stream) {
+        io_nbyte += reader->stream->nbyte;
+        io_time += reader->stream->time;
+        io_uring = reader->stream->batch->use_uring;
+    }
+    if (ret >= 0 && reader->nfile_open > 0) {
+        //  Files read out of archives are always opened in memory
+        const bool in_memory = (reader->max_image_size > 0
+                                || reader->nfile_archive == reader->nfile_open);
+        const int ret2 = fprintf(fp, "Fast5 files: %zu opened %s, %zu from archives, in %.3f s "
+                                 "(%.3f ms each)\n", reader->nfile_open,
+                                 in_memory ? "in memory" : "in place", reader->nfile_archive,
+                                 reader->open_time,
+                                 1e3 * reader->open_time / reader->nfile_open);
+        ret = (ret2 >= 0) ? ret + ret2 : ret2;
+    }
+    if (ret >= 0 && io_nbyte > 0) {
+        const int ret2 = fprintf(fp, "Signal files: %.3f MB read by %s, %zu in flight, in %.3f s "
+                                 "(%.1f MB/s)\n", 1e-6 * io_nbyte,
+                                 io_uring ? "io_uring" : "pread", reader->io_depth, io_time,
+                                 (io_time > 0.0) ? 1e-6 * io_nbyte / io_time : 0.0);
+        ret = (ret2 >= 0) ? ret + ret2 : ret2;
+    }
+    return ret;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef READ_PIPELINE_H
+#    define READ_PIPELINE_H
+
+#    include <pthread.h>
+#    include <stdbool.h>
+#    include <stdio.h>
+#    include "fast5_interface.h"
+
+/*  Pipeline reading reads ahead of the threads that call them.
+ *
+ *  Dedicated reader threads take reads from a fast5_reader, trim them and
+ *  place them on a bounded queue.  Compute threads take ready reads from the
+ *  queue, so only wait for I/O when the readers have fallen behind.  Readers
+ *  wait when the queue is full, bounding the memory of reads read ahead.
+ */
+
+//  Parameters for trimming reads, as for trim_and_segment_daq
+struct read_trim {
+    int trim_start;
+    int trim_end;
+    int varseg_chunk;
+    float varseg_thresh;
+};
+
+struct read_pipeline {
+    struct fast5_reader *reader;
+    bool trim_reads;
+    struct read_trim trim;
+    //  Maximum number of reads to take from reader (0 is unlimited) and number taken
+    int limit;
+    int nstarted;
+    //  Ring buffer of reads ready to call
+    struct fast5_read *queue;
+    size_t depth;
+    size_t head;
+    size_t count;
+    //  Reader threads and number still reading
+    pthread_t *threads;
+    int nreader;
+    int nreader_active;
+    bool stop;
+    pthread_mutex_t reader_lock;
+    pthread_mutex_t queue_lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    //  Reads passed to compute threads, and seconds spent by readers reading
+    // and trimming, by readers waiting for space on the queue and by compute
+    // threads waiting for reads
+    size_t nread;
+    double read_time;
+    double reader_wait;
+    double compute_wait;
+};
+
+struct read_pipeline *make_read_pipeline(char *const *paths, const char *path_list,
+                                         int nreader, size_t depth, size_t io_depth,
+                                         size_t max_image_size,
+                                         const struct read_trim *trim, int limit);
+struct read_pipeline *free_read_pipeline(struct read_pipeline *pipeline);
+bool next_pipeline_read(struct read_pipeline *pipeline, struct fast5_read *read);
+int fprintf_read_pipeline_timing(FILE * fp, const struct read_pipeline *pipeline);
+
+#endif                          /* READ_PIPELINE_H */
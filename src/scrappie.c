@@ -37,6 +37,12 @@ int main(int argc, char *argv[]) {
     case SCRAPPIE_MODE_SQUIGGLE:
         ret = main_squiggle(argc - 1, argv + 1);
         break;
+    case SCRAPPIE_MODE_APPROX:
+        ret = main_approx(argc - 1, argv + 1);
+        break;
+    case SCRAPPIE_MODE_CONVERT:
+        ret = main_convert(argc - 1, argv + 1);
+        break;
     default:
         ret = EXIT_FAILURE;
         warnx("Unrecognised subcommand %s\n", argv[1]);
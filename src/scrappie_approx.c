@@ -0,0 +1,405 @@
+#include <libgen.h>
+#include <math.h>
+#include <stdio.h>
+#include <strings.h>
+#include <time.h>
+
+#include "decode.h"
+#include "fast5_interface.h"
+#include "networks.h"
+#include "scrappie_common.h"
+#include "scrappie_licence.h"
+#include "scrappie_stdlib.h"
+#include "util.h"
+
+// Doesn't play nice with other headers, include last
+#include <argp.h>
+
+
+extern const char *argp_program_version;
+extern const char *argp_program_bug_address;
+static char doc[] = "Scrappie approx -- report accuracy of math approximations\v"
+    "The error of each array function is measured against double precision libm "
+    "over a grid of points.  If fast5 files are given, each is also basecalled "
+    "at every approximation level, with int8, float16 and bfloat16 weights, and with "
+    "5%, 10%, 25% and 50% of the blocks of the recurrent and output weights pruned, and the "
+    "identity of the basecall relative to the exact level and the time taken are reported.";
+static char args_doc[] = "[fast5 ...]";
+static struct argp_option options[] = {
+    {"model", 5, "name", 0, "Raw model to use: \"raw_r94\", \"rgr_r94\", \"rgrgr_r94\", \"rgrgr_r95\", \"rnnrf_r94\""},
+    {"npoint", 'n', "npoint", 0, "Number of points at which to evaluate each function"},
+    {"limit", 'l', "nreads", 0, "Maximum number of reads to call (0 is unlimited)"},
+    {"min_prob", 'm', "probability", 0, "Minimum bound on probability of match"},
+    {"trim", 't', "start:end", 0, "Number of samples to trim, as start:end"},
+    {"licence", 10, 0, 0, "Print licensing information"},
+    {"license", 11, 0, OPTION_ALIAS, "Print licensing information"},
+    {0}
+};
+
+struct arguments {
+    enum raw_model_type model_type;
+    int npoint;
+    int limit;
+    float min_prob;
+    int trim_start;
+    int trim_end;
+    char ** files;
+};
+
+static struct arguments args = {
+    .model_type = SCRAPPIE_MODEL_RGRGR_R94,
+    .npoint = 1000000,
+    .limit = 0,
+    .min_prob = 1e-5f,
+    .trim_start = 200,
+    .trim_end = 10,
+    .files = NULL
+};
+
+static error_t parse_arg(int key, char * arg, struct  argp_state * state){
+    int ret = 0;
+    char * next_tok = NULL;
+    switch(key){
+    case 5:
+        args.model_type = get_raw_model(arg);
+        if(SCRAPPIE_MODEL_INVALID == args.model_type){
+            errx(EXIT_FAILURE, "Invalid model name \"%s\"", arg);
+        }
+        break;
+    case 'n':
+        args.npoint = atoi(arg);
+        assert(args.npoint > 1);
+        break;
+    case 'l':
+        args.limit = atoi(arg);
+        assert(args.limit > 0);
+        break;
+    case 'm':
+        args.min_prob = atof(arg);
+        assert(isfinite(args.min_prob) && args.min_prob >= 0.0);
+        break;
+    case 't':
+        args.trim_start = atoi(strtok(arg, ":"));
+        next_tok = strtok(NULL, ":");
+        if(NULL != next_tok){
+            args.trim_end = atoi(next_tok);
+        } else {
+            args.trim_end = args.trim_start;
+        }
+        assert(args.trim_start >= 0);
+        assert(args.trim_end >= 0);
+        break;
+    case 10:
+    case 11:
+        ret = fputs(scrappie_licence_text, stdout);
+        exit((EOF != ret) ? EXIT_SUCCESS : EXIT_FAILURE);
+        break;
+
+    case ARGP_KEY_ARG:
+        args.files = &state->argv[state->next - 1];
+        state->next = state->argc;
+        break;
+
+    default:
+        return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+
+static struct argp argp = {options, parse_arg, args_doc, doc};
+
+
+static double logistic_ref(double x){
+    return 1.0 / (1.0 + exp(-x));
+}
+
+static double elu_ref(double x){
+    return (x >= 0.0) ? x : expm1(x);
+}
+
+//  Functions to report on, with reference implementation and domain
+static const struct {
+    const char * name;
+    double (*ref)(double);
+    double lower;
+    double upper;
+    bool relative;
+} report_functions[] = {
+    {"exp", exp, -20.0, 20.0, true},
+    {"log", log, 1e-6, 100.0, false},
+    {"logistic", logistic_ref, -20.0, 20.0, false},
+    {"tanh", tanh, -10.0, 10.0, false},
+    {"elu", elu_ref, -10.0, 10.0, false}
+};
+static const int nreport_functions = sizeof(report_functions) / sizeof(report_functions[0]);
+
+
+static void (*select_function(const struct math_functions * funcs, int i))(float *, size_t){
+    switch(i){
+    case 0:
+        return funcs->exp;
+    case 1:
+        return funcs->log;
+    case 2:
+        return funcs->logistic;
+    case 3:
+        return funcs->tanh;
+    case 4:
+        return funcs->elu;
+    default:
+        errx(EXIT_FAILURE, "Scrappie enum failure -- report bug\n");
+    }
+    return NULL;
+}
+
+
+/**  Print maximum and RMS error of each function at each approximation level
+ *
+ *   Exponential errors are relative, since its range spans many orders of
+ *   magnitude; all others are absolute.
+ *
+ *   @param fp File to write report to
+ *   @param npoint Number of points at which to evaluate each function
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+static int fprintf_error_report(FILE * fp, int npoint){
+    float * x = calloc(npoint, sizeof(float));
+    RETURN_NULL_IF(NULL == x, 1);
+
+    fprintf(fp, "%-12s %-9s %-9s %-12s %-12s %s\n", "level", "function", "error",
+            "max", "rms", "time(ns/elt)");
+    for(enum math_approx approx=0 ; approx < math_napprox ; approx++){
+        const struct math_functions * funcs = get_math_functions(approx);
+        for(int f=0 ; f < nreport_functions ; f++){
+            const double lower = report_functions[f].lower;
+            const double delta = (report_functions[f].upper - lower) / (npoint - 1);
+            for(int i=0 ; i < npoint ; i++){
+                x[i] = lower + delta * i;
+            }
+
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            select_function(funcs, f)(x, npoint);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            const double nsec = 1e9 * (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec);
+
+            double maxerr = 0.0;
+            double sumsq = 0.0;
+            for(int i=0 ; i < npoint ; i++){
+                //  Reference evaluated at input as represented in single precision
+                const double xi = (float)(lower + delta * i);
+                const double ref = report_functions[f].ref(xi);
+                double err = fabs((double)x[i] - ref);
+                if(report_functions[f].relative){
+                    err /= fabs(ref);
+                }
+                maxerr = fmax(maxerr, err);
+                sumsq += err * err;
+            }
+
+            fprintf(fp, "%-12s %-9s %-9s %-12.4e %-12.4e %.2f\n", math_approx_string(approx),
+                    report_functions[f].name, report_functions[f].relative ? "relative" : "absolute",
+                    maxerr, sqrt(sumsq / npoint), nsec / npoint);
+        }
+    }
+
+    free(x);
+    return 0;
+}
+
+
+/**  Basecall a read with the current approximation level
+ *
+ *   @param filename Name of fast5 file
+ *
+ *   @returns Basecall, to be freed by caller, or NULL on failure
+ **/
+static char * basecall_raw(const char * filename){
+    RETURN_NULL_IF(NULL == filename, NULL);
+
+    daq_table dt = read_daq(filename);
+    RETURN_NULL_IF(NULL == dt.raw, NULL);
+    dt = trim_and_segment_daq(dt, args.trim_start, args.trim_end, 100, 0.0f);
+    RETURN_NULL_IF(NULL == dt.raw, NULL);
+
+    scrappie_matrix post = daq_posterior(args.model_type, dt, args.min_prob, true);
+    free(dt.raw);
+    RETURN_NULL_IF(NULL == post, NULL);
+
+    const int nblock = post->nc;
+    int * path = calloc(nblock + 1, sizeof(int));
+    int * pos = calloc(nblock + 1, sizeof(int));
+    char * basecall = NULL;
+    if(NULL != path && NULL != pos){
+        if(SCRAPPIE_MODEL_RNNRF_R94 != args.model_type){
+            (void)decode_transducer(post, 0.0f, 0.0f, 2.0f, path, false);
+            basecall = overlapper(path, nblock + 1, post->nr - 1, pos);
+        } else {
+            (void)decode_crf(post, path);
+            basecall = crfpath_to_basecall(path, nblock, pos);
+        }
+    }
+
+    free(pos);
+    free(path);
+    post = free_scrappie_matrix(post);
+    return basecall;
+}
+
+
+/**  Identity between two sequences
+ *
+ *   One minus the edit distance between the sequences, divided by the length
+ *   of the longer.
+ *
+ *   @param seq1 First sequence
+ *   @param seq2 Second sequence
+ *
+ *   @returns identity in [0, 1] or NAN on failure
+ **/
+static double sequence_identity(const char * seq1, const char * seq2){
+    RETURN_NULL_IF(NULL == seq1, NAN);
+    RETURN_NULL_IF(NULL == seq2, NAN);
+    const size_t n1 = strlen(seq1);
+    const size_t n2 = strlen(seq2);
+    if(0 == n1 && 0 == n2){
+        return 1.0;
+    }
+
+    size_t * prev = calloc(n2 + 1, sizeof(size_t));
+    size_t * curr = calloc(n2 + 1, sizeof(size_t));
+    if(NULL == prev || NULL == curr){
+        free(curr);
+        free(prev);
+        return NAN;
+    }
+    for(size_t j=0 ; j <= n2 ; j++){
+        prev[j] = j;
+    }
+    for(size_t i=1 ; i <= n1 ; i++){
+        curr[0] = i;
+        for(size_t j=1 ; j <= n2 ; j++){
+            const size_t sub = prev[j - 1] + (seq1[i - 1] != seq2[j - 1]);
+            const size_t indel = 1 + ((prev[j] < curr[j - 1]) ? prev[j] : curr[j - 1]);
+            curr[j] = (sub < indel) ? sub : indel;
+        }
+        size_t * tmp = prev;
+        prev = curr;
+        curr = tmp;
+    }
+    const double dist = prev[n2];
+
+    free(curr);
+    free(prev);
+    return 1.0 - dist / ((n1 > n2) ? n1 : n2);
+}
+
+
+//  Configurations basecalls are compared over: each approximation level with
+//  float weights, the default level with each reduced precision, then the
+//  default level with recurrent and output weights pruned to each sparsity.
+#define NPRECISION_CONFIG (MATH_APPROX_INVALID + SCRAPPIE_PRECISION_INVALID - 1)
+#define NSPARSITY 4
+#define NCONFIG (NPRECISION_CONFIG + NSPARSITY)
+static const int nconfig = NCONFIG;
+static const float sparsity_level[NSPARSITY] = {0.05f, 0.1f, 0.25f, 0.5f};
+static const char * sparsity_string[NSPARSITY] = {"sparse05", "sparse10", "sparse25", "sparse50"};
+
+static const char * config_string(int config){
+    if(config >= NPRECISION_CONFIG){
+        return sparsity_string[config - NPRECISION_CONFIG];
+    }
+    return (config < math_napprox) ? math_approx_string(config)
+                                   : scrappie_precision_string(config - math_napprox + 1);
+}
+
+static bool set_config(int config){
+    if(config < math_napprox){
+        set_math_approx(config);
+        return set_raw_model_precision(args.model_type, SCRAPPIE_PRECISION_FLOAT32);
+    }
+    set_math_approx(MATH_APPROX_POLYNOMIAL);
+    if(config >= NPRECISION_CONFIG){
+        return set_raw_model_sparsity(args.model_type, sparsity_level[config - NPRECISION_CONFIG]);
+    }
+    return set_raw_model_precision(args.model_type, config - math_napprox + 1);
+}
+
+
+/**  Print effect of approximation level, weight precision and pruning on basecalls
+ *
+ *   Each read is called at every approximation level, with each reduced
+ *   precision of weights and at each sparsity, and compared to the call made
+ *   using the exact functions.
+ *
+ *   @param fp File to write report to
+ *   @param files NULL terminated list of fast5 files
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+static int fprintf_identity_report(FILE * fp, char ** files){
+    double sum_identity[NCONFIG] = {0.0};
+    double sum_time[NCONFIG] = {0.0};
+    int nread = 0;
+
+    fprintf(fp, "\n%-24s %-12s %-9s %s\n", "read", "level", "length", "identity");
+    for(int fn=0 ; NULL != files[fn] ; fn++){
+        if(args.limit > 0 && nread >= args.limit){
+            break;
+        }
+        char * basecall[NCONFIG] = {NULL};
+        bool ok = true;
+        for(int config=0 ; config < nconfig ; config++){
+            if(!set_config(config)){
+                ok = false;
+                continue;
+            }
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            basecall[config] = basecall_raw(files[fn]);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            sum_time[config] += (t1.tv_sec - t0.tv_sec) + 1e-9 * (t1.tv_nsec - t0.tv_nsec);
+            ok = ok && (NULL != basecall[config]);
+        }
+
+        if(ok){
+            for(int config=0 ; config < nconfig ; config++){
+                const double identity = sequence_identity(basecall[MATH_APPROX_EXACT], basecall[config]);
+                sum_identity[config] += identity;
+                fprintf(fp, "%-24s %-12s %-9zu %.6f\n", basename(files[fn]), config_string(config),
+                        strlen(basecall[config]), identity);
+            }
+            nread += 1;
+        } else {
+            warnx("No basecall returned for %s", files[fn]);
+        }
+
+        for(int config=0 ; config < nconfig ; config++){
+            free(basecall[config]);
+        }
+    }
+    (void)set_config(MATH_APPROX_POLYNOMIAL);
+    RETURN_NULL_IF(0 == nread, 1);
+
+    fprintf(fp, "\n%-12s %-14s %s\n", "level", "mean_identity", "time(s)");
+    for(int config=0 ; config < nconfig ; config++){
+        fprintf(fp, "%-12s %-14.6f %.3f\n", config_string(config),
+                sum_identity[config] / nread, sum_time[config]);
+    }
+
+    return 0;
+}
+
+
+int main_approx(int argc, char * argv[]){
+    argp_parse(&argp, argc, argv, 0, 0, NULL);
+
+    int ret = fprintf_error_report(stdout, args.npoint);
+    if(0 == ret && NULL != args.files){
+        ret = fprintf_identity_report(stdout, args.files);
+    }
+
+    return (0 == ret) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
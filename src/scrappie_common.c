@@ -2,6 +2,9 @@
 #include "scrappie_stdlib.h"
 #include "util.h"
 
+static void trim_chunks_by_mad(float *madarr, size_t nchunk, size_t chunk_size, float perc,
+                               size_t *start, size_t *end);
+
 raw_table trim_and_segment_raw(raw_table rt, int trim_start, int trim_end, int varseg_chunk, float varseg_thresh) {
     RETURN_NULL_IF(NULL == rt.raw, (raw_table){0});
 
@@ -45,11 +48,28 @@ raw_table trim_raw_by_mad(raw_table rt, int chunk_size, float perc) {
     // Truncation of end to be consistent with Sloika
     rt.end = nchunk * chunk_size;
 
-    float *madarr = malloc(nchunk * sizeof(float));
+    float *madarr = calloc(nchunk, sizeof(float));
     RETURN_NULL_IF(NULL == madarr, (raw_table){0});
     for (size_t i = 0; i < nchunk; i++) {
         madarr[i] = madf(rt.raw + rt.start + i * chunk_size, chunk_size, NULL);
     }
+    trim_chunks_by_mad(madarr, nchunk, chunk_size, perc, &rt.start, &rt.end);
+    free(madarr);
+
+    return rt;
+}
+
+/**  Trim signal by thresholding the MAD of chunks
+ *
+ *  @param madarr MAD of each chunk.  Overwritten.
+ *  @param nchunk Number of chunks
+ *  @param chunk_size Size of chunks
+ *  @param perc The quantile to be calculated to use for threshholding
+ *  @param start [in/out] Start of signal
+ *  @param end [in/out] End of signal
+ **/
+static void trim_chunks_by_mad(float *madarr, size_t nchunk, size_t chunk_size, float perc,
+                               size_t *start, size_t *end) {
     quantilef(madarr, nchunk, &perc, 1);
 
     const float thresh = perc;
@@ -57,17 +77,95 @@ raw_table trim_raw_by_mad(raw_table rt, int chunk_size, float perc) {
         if (madarr[i] > thresh) {
             break;
         }
-        rt.start += chunk_size;
+        *start += chunk_size;
     }
     for (size_t i = nchunk; i > 0; i--) {
         if (madarr[i - 1] > thresh) {
             break;
         }
-        rt.end -= chunk_size;
+        *end -= chunk_size;
     }
-    assert(rt.end > rt.start);
+    assert(*end > *start);
+}
+
+/**  Simple segmentation of a raw read, stored as DAQ values, by thresholding the MAD
+ *
+ *  As trim_raw_by_mad.  Scaling to pA does not change which chunks are
+ *  trimmed so the MAD is found from the DAQ values directly.
+ *
+ *  @param dt Structure containing raw signal
+ *  @param chunk_size Size of non-overlapping chunks
+ *  @param perc  The quantile to be calculated to use for threshholding
+ *
+ *  @return A range structure containing new start and end for read
+ **/
+daq_table trim_daq_by_mad(daq_table dt, int chunk_size, float perc) {
+    assert(chunk_size > 1);
+    assert(perc >= 0.0 && perc <= 1.0);
+
+    const size_t nsample = dt.end - dt.start;
+    const size_t nchunk = nsample / chunk_size;
+    // Truncation of end to be consistent with Sloika
+    dt.end = nchunk * chunk_size;
 
+    float *madarr = calloc(nchunk, sizeof(float));
+    RETURN_NULL_IF(NULL == madarr, (daq_table){0});
+    for (size_t i = 0; i < nchunk; i++) {
+        float med;
+        if (!medmad_int16(dt.raw + dt.start + i * chunk_size, chunk_size, &med, madarr + i)) {
+            free(madarr);
+            return (daq_table){0};
+        }
+    }
+    trim_chunks_by_mad(madarr, nchunk, chunk_size, perc, &dt.start, &dt.end);
     free(madarr);
 
-    return rt;
+    return dt;
+}
+
+daq_table trim_and_segment_daq(daq_table dt, int trim_start, int trim_end, int varseg_chunk, float varseg_thresh) {
+    RETURN_NULL_IF(NULL == dt.raw, (daq_table){0});
+
+    int16_t * raw = dt.raw;
+    dt = trim_daq_by_mad(dt, varseg_chunk, varseg_thresh);
+    if (NULL == dt.raw) {
+        free(raw);
+        return (daq_table){0};
+    }
+
+    dt.start += trim_start;
+    dt.end -= trim_end;
+
+    if (dt.start >= dt.end) {
+        free(dt.raw);
+        return (daq_table){0};
+    }
+
+    return dt;
+}
+
+/**  Convert raw signal stored as DAQ values to floats
+ *
+ *  @param dt Structure containing raw signal
+ *  @param scale_to_pA Whether to scale signal from DAQ values to pA
+ *
+ *  @return Raw signal, with same start and end as dt.  The signal is NULL on failure.
+ **/
+raw_table raw_table_from_daq(const daq_table dt, bool scale_to_pA) {
+    RETURN_NULL_IF(NULL == dt.raw, (raw_table){0});
+    float *raw = calloc(dt.n, sizeof(float));
+    RETURN_NULL_IF(NULL == raw, (raw_table){0});
+
+    if (scale_to_pA) {
+        const float raw_unit = dt.range / dt.digitisation;
+        for (size_t i = 0; i < dt.n; i++) {
+            raw[i] = (dt.raw[i] + dt.offset) * raw_unit;
+        }
+    } else {
+        for (size_t i = 0; i < dt.n; i++) {
+            raw[i] = dt.raw[i];
+        }
+    }
+
+    return (raw_table){dt.n, dt.start, dt.end, raw};
 }
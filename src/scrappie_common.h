@@ -2,9 +2,13 @@
 #ifndef SCRAPPIE_COMMON_H
 #define SCRAPPIE_COMMON_H
 
+#include <stdbool.h>
 #include "scrappie_structures.h"
 
 raw_table trim_and_segment_raw(raw_table rt, int trim_start, int trim_end, int varseg_chunk, float varseg_thresh);
 raw_table trim_raw_by_mad(raw_table rt, int chunk_size, float proportion);
+daq_table trim_and_segment_daq(daq_table dt, int trim_start, int trim_end, int varseg_chunk, float varseg_thresh);
+daq_table trim_daq_by_mad(daq_table dt, int chunk_size, float proportion);
+raw_table raw_table_from_daq(const daq_table dt, bool scale_to_pA);
 
 #endif /* SCRAPPIE_COMMON_H */
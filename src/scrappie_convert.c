@@ -0,0 +1,279 @@
+#include <err.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+#include "read_pipeline.h"
+#include "scrappie_licence.h"
+#include "scrappie_stdlib.h"
+#include "signal_codec.h"
+#include "signal_file.h"
+
+#if defined(_OPENMP)
+#    include <omp.h>
+#endif
+
+// Doesn't play nice with other headers, include last
+#include <argp.h>
+
+
+extern const char *argp_program_version;
+extern const char *argp_program_bug_address;
+static char doc[] = "Scrappie convert -- convert fast5 files into a scrappie signal file\v"
+    "The raw signal of every read, as stored, is written to a single file, indexed by read "
+    "ID, that raw and events read by mapping it into memory rather than through HDF5.  "
+    "Reads are read from their files by the threads given by --readers, while their "
+    "signal is encoded and written in turn by a single thread.  Signal is encoded by the "
+    "delta-varint codec unless --encoding raw is given; --benchmark compares the speed of "
+    "encoding and decoding the signal of the reads converted to that of zlib.";
+static char args_doc[] = "fast5 [fast5 ...]";
+static struct argp_option options[] = {
+    {"output", 'o', "filename", 0, "Signal file to write"},
+    {"limit", 'l', "nreads", 0, "Maximum number of reads to convert (0 is unlimited)"},
+    {"readers", 20, "nthread", 0, "Number of threads reading reads (0 is number of threads)"},
+    {"prefetch", 21, "nreads", 0,
+     "Maximum number of reads read ahead (0 is twice number of readers)"},
+    {"in-memory", 24, "MB", 0,
+     "Read fast5 files of at most this size whole into memory when opened (0 is off)"},
+    {"encoding", 22, "name", 0, "Encoding of signal: \"delta-varint\" or \"raw\""},
+    {"benchmark", 23, 0, 0, "Report speed of encoding and decoding signal, against zlib, to stderr"},
+    {"input-list", 25, "filename", 0,
+     "Read further paths, one per line, from file (\"-\" for stdin)"},
+    {"licence", 10, 0, 0, "Print licensing information"},
+    {"license", 11, 0, OPTION_ALIAS, "Print licensing information"},
+    {0}
+};
+
+
+struct arguments {
+    char *output;
+    int limit;
+    int nreader;
+    int prefetch;
+    int in_memory;
+    enum signal_encoding encoding;
+    bool benchmark;
+    char *input_list;
+    char **files;
+};
+
+static struct arguments args = {
+    .output = NULL,
+    .limit = 0,
+    .nreader = 0,
+    .prefetch = 0,
+    .in_memory = 0,
+    .encoding = SIGNAL_ENCODING_DELTA_VARINT,
+    .benchmark = false,
+    .input_list = NULL,
+    .files = NULL
+};
+
+static error_t parse_arg(int key, char *arg, struct argp_state *state) {
+    int ret = 0;
+    switch (key) {
+    case 'o':
+        args.output = arg;
+        break;
+    case 'l':
+        args.limit = atoi(arg);
+        if (args.limit < 0) {
+            errx(EXIT_FAILURE, "Limit on reads should be non-negative, got \"%s\"", arg);
+        }
+        break;
+    case 20:
+        args.nreader = atoi(arg);
+        if (args.nreader < 0) {
+            errx(EXIT_FAILURE, "Number of readers should be non-negative, got \"%s\"", arg);
+        }
+        break;
+    case 21:
+        args.prefetch = atoi(arg);
+        if (args.prefetch < 0) {
+            errx(EXIT_FAILURE, "Number of reads to prefetch should be non-negative, got \"%s\"", arg);
+        }
+        break;
+    case 24:
+        args.in_memory = atoi(arg);
+        if (args.in_memory < 0) {
+            errx(EXIT_FAILURE, "Size of files read into memory should be non-negative, got \"%s\"", arg);
+        }
+        break;
+    case 22:
+        if (0 == strcmp(arg, "delta-varint")) {
+            args.encoding = SIGNAL_ENCODING_DELTA_VARINT;
+        } else if (0 == strcmp(arg, "raw")) {
+            args.encoding = SIGNAL_ENCODING_RAW;
+        } else {
+            errx(EXIT_FAILURE, "Invalid encoding \"%s\"", arg);
+        }
+        break;
+    case 23:
+        args.benchmark = true;
+        break;
+    case 10:
+    case 11:
+        ret = fputs(scrappie_licence_text, stdout);
+        exit((EOF != ret) ? EXIT_SUCCESS : EXIT_FAILURE);
+        break;
+
+    case ARGP_KEY_ARG:
+        args.files = &state->argv[state->next - 1];
+        state->next = state->argc;
+        break;
+
+    case 25:
+        args.input_list = arg;
+        break;
+
+    case ARGP_KEY_SUCCESS:
+        if (NULL == args.files && NULL == args.input_list) {
+            argp_usage(state);
+        }
+        if (NULL == args.output) {
+            argp_error(state, "Name of signal file to write, --output, is required");
+        }
+        break;
+
+    default:
+        return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+
+static struct argp argp = { options, parse_arg, args_doc, doc };
+
+
+//  Repetitions of each measurement, so reads short to decode are timed reliably
+#define NBENCHMARK_REPEAT 5
+
+enum benchmark_codec { BENCHMARK_DELTA_VARINT = 0, BENCHMARK_ZLIB_1, BENCHMARK_ZLIB_6,
+    NBENCHMARK_CODEC };
+static const char *benchmark_codec_name[NBENCHMARK_CODEC] = { "delta-varint", "zlib-1", "zlib-6" };
+
+struct codec_benchmark {
+    double nbyte;
+    double nbyte_encoded[NBENCHMARK_CODEC];
+    double encode_time[NBENCHMARK_CODEC];
+    double decode_time[NBENCHMARK_CODEC];
+};
+
+static double elapsed(const struct timespec *t0, const struct timespec *t1) {
+    return (t1->tv_sec - t0->tv_sec) + 1e-9 * (t1->tv_nsec - t0->tv_nsec);
+}
+
+/**  Time encoding and decoding of signal of read
+ *
+ *   @param dt Signal of read
+ *   @param bench [in/out] Sizes and times, to which the read is added
+ *
+ *   @returns true on success
+ **/
+static bool benchmark_read(const daq_table dt, struct codec_benchmark *bench) {
+    const size_t n = dt.end - dt.start;
+    const int16_t *x = dt.raw + dt.start;
+    const size_t nbyte = n * sizeof(int16_t);
+    const size_t bound = delta_varint_bound(n) > compressBound(nbyte) ? delta_varint_bound(n)
+                                                                       : compressBound(nbyte);
+    uint8_t *enc = malloc(bound);
+    int16_t *dec = malloc(nbyte + 1);
+    bool ok = (NULL != enc && NULL != dec);
+
+    for (int codec = 0; ok && codec < NBENCHMARK_CODEC; codec++) {
+        size_t nenc = 0;
+        struct timespec t0, t1, t2;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int rep = 0; ok && rep < NBENCHMARK_REPEAT; rep++) {
+            if (BENCHMARK_DELTA_VARINT == codec) {
+                nenc = encode_delta_varint(x, n, enc);
+            } else {
+                uLongf nout = bound;
+                ok = (Z_OK == compress2(enc, &nout, (const Bytef *)x, nbyte,
+                                        (BENCHMARK_ZLIB_1 == codec) ? 1 : 6));
+                nenc = nout;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        for (int rep = 0; ok && rep < NBENCHMARK_REPEAT; rep++) {
+            if (BENCHMARK_DELTA_VARINT == codec) {
+                ok = decode_delta_varint(enc, nenc, dec, n);
+            } else {
+                uLongf nout = nbyte + 1;
+                ok = (Z_OK == uncompress((Bytef *)dec, &nout, enc, nenc)) && (nbyte == nout);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        ok = ok && (0 == memcmp(x, dec, nbyte));
+
+        bench->nbyte_encoded[codec] += nenc;
+        bench->encode_time[codec] += elapsed(&t0, &t1) / NBENCHMARK_REPEAT;
+        bench->decode_time[codec] += elapsed(&t1, &t2) / NBENCHMARK_REPEAT;
+    }
+    bench->nbyte += nbyte;
+
+    free(dec);
+    free(enc);
+    return ok;
+}
+
+static void fprintf_benchmark(FILE * fp, const struct codec_benchmark *bench) {
+    fprintf(fp, "%-14s %8s %14s %14s\n", "codec", "ratio", "encode(GB/s)", "decode(GB/s)");
+    for (int codec = 0; codec < NBENCHMARK_CODEC; codec++) {
+        fprintf(fp, "%-14s %8.3f %14.3f %14.3f\n", benchmark_codec_name[codec],
+                bench->nbyte / bench->nbyte_encoded[codec],
+                1e-9 * bench->nbyte / bench->encode_time[codec],
+                1e-9 * bench->nbyte / bench->decode_time[codec]);
+    }
+}
+
+
+int main_convert(int argc, char *argv[]) {
+    argp_parse(&argp, argc, argv, 0, 0, NULL);
+
+#if defined(_OPENMP)
+    const int nthread = omp_get_max_threads();
+#else
+    const int nthread = 1;
+#endif
+    const int nreader = (args.nreader > 0) ? args.nreader : nthread;
+    const size_t prefetch = (args.prefetch > 0) ? args.prefetch : 2 * nreader;
+
+    struct signal_file_writer *writer = make_signal_file_writer(args.output, args.encoding);
+    if (NULL == writer) {
+        errx(EXIT_FAILURE, "Failed to create signal file %s", args.output);
+    }
+    //  Reads are converted as stored, without trimming, and any signal files
+    // given are read through their memory map
+    char *no_files[1] = { NULL };
+    struct read_pipeline *pipeline =
+        make_read_pipeline((NULL != args.files) ? args.files : no_files, args.input_list,
+                           nreader, prefetch, 0, (size_t)args.in_memory << 20, NULL, args.limit);
+    if (NULL == pipeline) {
+        errx(EXIT_FAILURE, "Failed to start reading fast5 files");
+    }
+
+    bool ok = true;
+    struct codec_benchmark bench = { 0 };
+    struct fast5_read read;
+    while (ok && next_pipeline_read(pipeline, &read)) {
+        ok = write_signal_file_read(writer, read.name, read.dt);
+        if (ok && args.benchmark && !benchmark_read(read.dt, &bench)) {
+            warnx("Failed to benchmark codecs on read %s", read.name);
+        }
+        free(read.dt.raw);
+        free(read.name);
+    }
+    pipeline = free_read_pipeline(pipeline);
+    ok = close_signal_file_writer(writer) && ok;
+    if (!ok) {
+        warnx("Failed to convert reads into %s", args.output);
+        return EXIT_FAILURE;
+    }
+    if (args.benchmark && bench.nbyte > 0) {
+        fprintf_benchmark(stderr, &bench);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -1,6 +1,3 @@
-#include <dirent.h>
-#include <glob.h>
-#include <libgen.h>
 #include <math.h>
 #if defined(_OPENMP)
 #    include <omp.h>
@@ -13,6 +10,7 @@
 #include "event_detection.h"
 #include "fast5_interface.h"
 #include "networks.h"
+#include "read_pipeline.h"
 #include "scrappie_common.h"
 #include "scrappie_licence.h"
 #include "scrappie_stdlib.h"
@@ -57,6 +55,8 @@ static struct argp_option options[] = {
     {"slip", 1, 0, 0, "Use slipping"},
     {"no-slip", 2, 0, OPTION_ALIAS, "Disable slipping"},
     {"dump", 4, "filename", 0, "Dump annotated events to HDF5 file"},
+    {"model-file", 16, "filename", 0, "Load weights of model from binary model file"},
+    {"approx", 15, "level", 0, "Approximation for exp, log and activations: \"exact\", \"polynomial\" or \"schraudolph\""},
     {"licence", 10, 0, 0, "Print licensing information"},
     {"license", 11, 0, OPTION_ALIAS, "Print licensing information"},
     {"hdf5-compression", 12, "level", 0,
@@ -67,6 +67,16 @@ static struct argp_option options[] = {
 #endif
     {"segmentation", 14, "chunk:percentile", 0,
      "Chunk size and percentile for variance based segmentation"},
+    {"readers", 17, "nthread", 0, "Number of threads reading reads ahead of calling"},
+    {"prefetch", 18, "nreads", 0,
+     "Maximum number of reads read ahead (0 is twice number of threads)"},
+    {"io-timing", 19, 0, 0, "Report time spent reading reads and waiting for them to stderr"},
+    {"io-depth", 20, "nreads", 0,
+     "Reads of signal files in flight at once (0 reads through memory map)"},
+    {"in-memory", 21, "MB", 0,
+     "Read fast5 files of at most this size whole into memory when opened (0 is off)"},
+    {"input-list", 22, "filename", 0,
+     "Read further paths, one per line, from file (\"-\" for stdin)"},
     {0}
 };
 
@@ -90,6 +100,13 @@ struct arguments {
     char *dump;
     int compression_level;
     int compression_chunk_size;
+    char *model_file;
+    int nreader;
+    int prefetch;
+    int io_depth;
+    int in_memory;
+    bool io_timing;
+    char *input_list;
     char **files;
 };
 
@@ -111,6 +128,13 @@ static struct arguments args = {
     .dump = NULL,
     .compression_level = 1,
     .compression_chunk_size = 200,
+    .model_file = NULL,
+    .nreader = 1,
+    .prefetch = 0,
+    .io_depth = 64,
+    .in_memory = 0,
+    .io_timing = false,
+    .input_list = NULL,
     .files = NULL
 };
 
@@ -181,6 +205,45 @@ static error_t parse_arg(int key, char *arg, struct argp_state *state) {
         args.local_pen = atof(arg);
         assert(isfinite(args.local_pen));
         break;
+    case 15:
+        {
+            const enum math_approx approx = get_math_approx(arg);
+            if(MATH_APPROX_INVALID == approx){
+                errx(EXIT_FAILURE, "Invalid approximation level \"%s\"", arg);
+            }
+            set_math_approx(approx);
+        }
+        break;
+    case 16:
+        args.model_file = arg;
+        break;
+    case 17:
+        args.nreader = atoi(arg);
+        if (args.nreader < 1) {
+            errx(EXIT_FAILURE, "Number of readers should be positive, got \"%s\"", arg);
+        }
+        break;
+    case 18:
+        args.prefetch = atoi(arg);
+        if (args.prefetch < 0) {
+            errx(EXIT_FAILURE, "Number of reads to prefetch should be non-negative, got \"%s\"", arg);
+        }
+        break;
+    case 19:
+        args.io_timing = true;
+        break;
+    case 20:
+        args.io_depth = atoi(arg);
+        if (args.io_depth < 0) {
+            errx(EXIT_FAILURE, "Number of reads in flight should be non-negative, got \"%s\"", arg);
+        }
+        break;
+    case 21:
+        args.in_memory = atoi(arg);
+        if (args.in_memory < 0) {
+            errx(EXIT_FAILURE, "Size of files read into memory should be non-negative, got \"%s\"", arg);
+        }
+        break;
     case 10:
     case 11:
         ret = fputs(scrappie_licence_text, stdout);
@@ -221,8 +284,14 @@ static error_t parse_arg(int key, char *arg, struct argp_state *state) {
         break;
 #endif
 
+    case 22:
+        args.input_list = arg;
+        break;
+
     case ARGP_KEY_NO_ARGS:
-        argp_usage(state);
+        if (NULL == args.input_list) {
+            argp_usage(state);
+        }
         break;
 
     case ARGP_KEY_ARG:
@@ -238,11 +307,11 @@ static error_t parse_arg(int key, char *arg, struct argp_state *state) {
 
 static struct argp argp = { options, parse_arg, args_doc, doc };
 
-static struct _bs calculate_post(char *filename) {
-    RETURN_NULL_IF(NULL == filename, (struct _bs){0};);
-    raw_table rt = read_raw(filename, true);
-    RETURN_NULL_IF(NULL == rt.raw, (struct _bs){0};);
-    rt = trim_and_segment_raw(rt, args.trim_start, args.trim_end, args.varseg_chunk, args.varseg_thresh);
+static struct _bs calculate_post(daq_table dt) {
+    RETURN_NULL_IF(NULL == dt.raw, (struct _bs){0};);
+    //  Signal has been trimmed by reader.  Event detection works in pA
+    raw_table rt = raw_table_from_daq(dt, true);
+    free(dt.raw);
     RETURN_NULL_IF(NULL == rt.raw, (struct _bs){0};);
 
     event_table et = detect_events(rt, event_detection_defaults);
@@ -311,13 +380,16 @@ static int fprintf_sam(FILE * fp, const char *readname, const char * prefix, con
 }
 
 int main_events(int argc, char *argv[]) {
-#if defined(_OPENMP)
-    omp_set_nested(1);
-#endif
     argp_parse(&argp, argc, argv, 0, 0, NULL);
     if(NULL == args.output){
         args.output = stdout;
     }
+    if(NULL != args.model_file && !load_events_model_file(args.model_file)){
+        errx(EXIT_FAILURE, "Failed to load model from \"%s\"", args.model_file);
+    }
+    if(!set_events_model_precision(SCRAPPIE_PRECISION_FLOAT32)){
+        errx(EXIT_FAILURE, "Failed to pack weights of model");
+    }
 
     hid_t hdf5out = -1;
     if (NULL != args.dump) {
@@ -328,85 +400,71 @@ int main_events(int argc, char *argv[]) {
         }
     }
 
-    int nfile = 0;
-    for (; args.files[nfile]; nfile++) ;
+#if defined(_OPENMP)
+    const int nthread = omp_get_max_threads();
+#else
+    const int nthread = 1;
+#endif
+    const size_t prefetch = (args.prefetch > 0) ? args.prefetch : 2 * nthread;
+    const struct read_trim trim = { args.trim_start, args.trim_end, args.varseg_chunk,
+                                    args.varseg_thresh };
+    char *no_files[1] = { NULL };
+    struct read_pipeline *pipeline =
+        make_read_pipeline((NULL != args.files) ? args.files : no_files, args.input_list,
+                           args.nreader, prefetch, args.io_depth,
+                           (size_t)args.in_memory << 20, &trim, args.limit);
+    if (NULL == pipeline) {
+        errx(EXIT_FAILURE, "Failed to start reading fast5 files");
+    }
 
-    int reads_started = 0;
-    const int reads_limit = args.limit;
-#pragma omp parallel for schedule(dynamic)
-    for (int fn = 0; fn < nfile; fn++) {
-        if (reads_limit > 0 && reads_started >= reads_limit) {
-            continue;
-        }
-        //  Iterate through all files and directories on command line.
-        //  Nested parallelism for OpenMP is enabled so worker threads are used for all open
-        // directories but this less than optimal since many directories may be open at once.
-        glob_t globbuf;
-        {
-            // Find all files matching commandline argument using system glob
-            const size_t rootlen = strlen(args.files[fn]);
-            char *globpath = calloc(rootlen + 9, sizeof(char));
-            memcpy(globpath, args.files[fn], rootlen * sizeof(char));
-            {
-                DIR *dirp = opendir(args.files[fn]);
-                if (NULL != dirp) {
-                    // If filename is a directory, add wildcard to find all fast5 files within it
-                    memcpy(globpath + rootlen, "/*.fast5", 8 * sizeof(char));
-                    closedir(dirp);
-                }
-            }
-            int globret = glob(globpath, GLOB_NOSORT, NULL, &globbuf);
-            free(globpath);
-            if (0 != globret) {
-                if(GLOB_NOMATCH == globret){
-                    warnx("File or directory \"%s\" does not exist or no fast5 files found.", args.files[fn]);
-                }
-                globfree(&globbuf);
-                continue;
+    //  Work is scheduled per read: each thread takes the next read, read and
+    // trimmed ahead of time by the reader threads of the pipeline.
+#pragma omp parallel
+    {
+        while (true) {
+            struct fast5_read read = { 0 };
+            if (!next_pipeline_read(pipeline, &read)) {
+                break;
             }
-        }
-#pragma omp parallel for schedule(dynamic)
-        for (int fn2 = 0; fn2 < globbuf.gl_pathc; fn2++) {
-            if (reads_limit > 0 && reads_started >= reads_limit) {
-                continue;
-            }
-#pragma omp atomic
-            reads_started += 1;
 
-            char *filename = globbuf.gl_pathv[fn2];
-            struct _bs res = calculate_post(filename);
+            struct _bs res = calculate_post(read.dt);
             if (NULL == res.bases) {
-                warnx("No basecall returned for %s", filename);
+                warnx("No basecall returned for %s", read.name);
+                free(read.name);
                 continue;
             }
 #pragma omp critical(sequence_output)
             {
                 switch (args.outformat) {
                 case FORMAT_FASTA:
-                    fprintf_fasta(args.output,
-                                  basename(filename),
-                                  args.prefix, res);
+                    fprintf_fasta(args.output, read.name, args.prefix, res);
                     break;
                 case FORMAT_SAM:
-                    fprintf_sam(args.output,
-                                basename(filename),
-                                args.prefix, res);
+                    fprintf_sam(args.output, read.name, args.prefix, res);
                     break;
                 default:
                     errx(EXIT_FAILURE, "Unrecognised output format");
                 }
 
                 if (hdf5out >= 0) {
-                    write_annotated_events(hdf5out, basename(filename), res.et,
+                    write_annotated_events(hdf5out, read.name, res.et,
                                            args.compression_chunk_size,
                                            args.compression_level);
                 }
             }
             free(res.et.event);
             free(res.bases);
+            free(read.name);
         }
-        globfree(&globbuf);
+        //  Threads of OpenMP outlive the region, so release the memory each
+        // holds for reuse between reads
+        free_network_workspace();
+        free_scrappie_matrix_pool();
+    }
+    if (args.io_timing) {
+        fprintf_read_pipeline_timing(stderr, pipeline);
     }
+    pipeline = free_read_pipeline(pipeline);
 
     if (hdf5out >= 0) {
         H5Fclose(hdf5out);
@@ -65,6 +65,14 @@ int main_help(int argc, char *argv[]) {
         help_options[0] = argv[1];
         ret = main_squiggle(2, help_options);
         break;
+    case SCRAPPIE_MODE_APPROX:
+        help_options[0] = argv[1];
+        ret = main_approx(2, help_options);
+        break;
+    case SCRAPPIE_MODE_CONVERT:
+        help_options[0] = argv[1];
+        ret = main_convert(2, help_options);
+        break;
     default:
         ret = EXIT_FAILURE;
         warnx("Unrecognised subcommand %s\n", argv[1]);
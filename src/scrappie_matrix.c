@@ -5,54 +5,246 @@
 #endif
 #include <float.h>
 #include <math.h>
+#include <pthread.h>
+#include "precision.h"
 #include "scrappie_matrix.h"
 #include "scrappie_stdlib.h"
 
-scrappie_matrix make_scrappie_matrix(int nr, int nc) {
+/*  Memory freed by matrices on this thread, kept for reuse by later
+ *  matrices.  Basecalling allocates and frees matrices of the same few
+ *  shapes for every read; reusing their memory avoids repeated calls to
+ *  aligned_alloc and the page faults from touching fresh memory.
+ *
+ *  Memory is reused for a matrix when it is no more than matrix_pool_slack
+ *  times larger than required.  When the pool is full, the smallest memory
+ *  held is released in favour of larger.  Sizes are in vectors; at most
+ *  32 MB is held by each thread.  The pool is freed when its thread exits,
+ *  or earlier by free_scrappie_matrix_pool.
+ */
+#define MATRIX_POOL_SIZE 16
+static const size_t matrix_pool_slack = 4;
+static const size_t matrix_pool_max_vectors = (size_t)1 << 21;
+
+struct matrix_pool {
+    void * mem[MATRIX_POOL_SIZE];
+    size_t capacity[MATRIX_POOL_SIZE];
+    size_t n;
+    size_t nvec;
+};
+static _Thread_local struct matrix_pool matrix_pool;
+//  Key whose destructor frees the pool of each thread that has used one
+static pthread_key_t matrix_pool_key;
+static pthread_once_t matrix_pool_key_once = PTHREAD_ONCE_INIT;
+
+
+static void drain_matrix_pool(struct matrix_pool * pool){
+    for (size_t i = 0; i < pool->n; i++) {
+        free(pool->mem[i]);
+    }
+    pool->n = 0;
+    pool->nvec = 0;
+}
+
+
+//  Destructor of key, run as a thread that has used its pool exits
+static void free_thread_matrix_pool(void * pool){
+    drain_matrix_pool(pool);
+}
+
+
+static void make_matrix_pool_key(void){
+    if (0 != pthread_key_create(&matrix_pool_key, free_thread_matrix_pool)) {
+        warnx("Failed to create key for freeing pools of matrix memory.");
+    }
+}
+
+
+/**  Free memory held in pool of calling thread
+ *
+ *   Pools are freed as their threads exit, but threads of OpenMP outlive
+ *   the parallel regions they run, so should call this as they finish.
+ **/
+void free_scrappie_matrix_pool(void){
+    drain_matrix_pool(&matrix_pool);
+}
+
+
+/**  Take memory from pool of calling thread, allocating if none fits
+ *
+ *   @param nvec Number of vectors required
+ *   @param capacity [out] Number of vectors available
+ *
+ *   @returns Memory aligned for vectors, or NULL on failure
+ **/
+static void * take_pooled_memory(size_t nvec, size_t * capacity){
+    struct matrix_pool * pool = &matrix_pool;
+    size_t best = MATRIX_POOL_SIZE;
+    for (size_t i = 0; i < pool->n; i++) {
+        if (pool->capacity[i] >= nvec && pool->capacity[i] <= matrix_pool_slack * nvec
+            && (MATRIX_POOL_SIZE == best || pool->capacity[i] < pool->capacity[best])) {
+            best = i;
+        }
+    }
+    if (MATRIX_POOL_SIZE != best) {
+        void * mem = pool->mem[best];
+        *capacity = pool->capacity[best];
+        pool->nvec -= pool->capacity[best];
+        pool->n -= 1;
+        pool->mem[best] = pool->mem[pool->n];
+        pool->capacity[best] = pool->capacity[pool->n];
+        return mem;
+    }
+
+    void * mem = aligned_alloc(16, nvec * sizeof(__m128));
+    if (NULL == mem) {
+        warnx("Error allocating memory in %s.\n", __func__);
+        return NULL;
+    }
+    *capacity = nvec;
+    return mem;
+}
+
+
+/**  Return memory to pool of calling thread
+ *
+ *   @param mem Memory from take_pooled_memory
+ *   @param capacity Number of vectors in memory
+ **/
+static void return_pooled_memory(void * mem, size_t capacity){
+    if (NULL == mem) {
+        return;
+    }
+    struct matrix_pool * pool = &matrix_pool;
+    if (pool->n == MATRIX_POOL_SIZE) {
+        //  Release smallest memory held if smaller than that returned
+        size_t smallest = 0;
+        for (size_t i = 1; i < pool->n; i++) {
+            if (pool->capacity[i] < pool->capacity[smallest]) {
+                smallest = i;
+            }
+        }
+        if (pool->capacity[smallest] >= capacity) {
+            free(mem);
+            return;
+        }
+        free(pool->mem[smallest]);
+        pool->nvec -= pool->capacity[smallest];
+        pool->n -= 1;
+        pool->mem[smallest] = pool->mem[pool->n];
+        pool->capacity[smallest] = pool->capacity[pool->n];
+    }
+    if (pool->nvec + capacity > matrix_pool_max_vectors) {
+        free(mem);
+        return;
+    }
+    if (0 == pool->n) {
+        //  Pool may have been emptied, so the key is set whenever it fills
+        pthread_once(&matrix_pool_key_once, make_matrix_pool_key);
+        (void)pthread_setspecific(matrix_pool_key, pool);
+    }
+    pool->mem[pool->n] = mem;
+    pool->capacity[pool->n] = capacity;
+    pool->nvec += capacity;
+    pool->n += 1;
+}
+
+
+//  Number of vectors for matrix, or zero on overflow
+static size_t matrix_nvec(int nrq, int nc){
+    // Check for overflow to please Coverity scanner
+    size_t tmp1 = nrq * sizeof(__m128);
+    size_t tmp2 = tmp1 * nc;
+    if (tmp1 != 0 && tmp2 / tmp1 != nc) {
+        return 0;
+    }
+    return (size_t)nrq * nc;
+}
+
+
+/**  Allocate matrix without initialising its contents
+ *
+ *   @param nr Number of rows
+ *   @param nc Number of columns
+ *
+ *   @returns Matrix or NULL on failure
+ **/
+static scrappie_matrix alloc_scrappie_matrix(int nr, int nc) {
     assert(nr > 0);
     assert(nc > 0);
     // Matrix padded so row length is multiple of 4
-    const int nrq = (int)ceil(nr / 4.0);
+    const int nrq = (nr + 3) / 4;
+    const size_t nvec = matrix_nvec(nrq, nc);
+    RETURN_NULL_IF(0 == nvec, NULL);
     scrappie_matrix mat = malloc(sizeof(*mat));
     RETURN_NULL_IF(NULL == mat, NULL);
 
     mat->nr = nr;
     mat->nrq = nrq;
     mat->nc = nc;
-
-    {
-        // Check for overflow to please Coverity scanner
-        size_t tmp1 = nrq * sizeof(__m128);
-        size_t tmp2 = tmp1 * nc;
-        if (tmp1 != 0 && tmp2 / tmp1 != nc) {
-            // Have overflow in memory allocation
-            free(mat);
-            return NULL;
-        }
-    }
-
-    mat->data.v = aligned_alloc(16, nrq * nc * sizeof(__m128));
+    mat->converted = NULL;
+    mat->data.v = take_pooled_memory(nvec, &mat->capacity);
     if (NULL == mat->data.v) {
-        warnx("Error allocating memory in %s.\n", __func__);
         free(mat);
         return NULL;
     }
-    memset(mat->data.v, 0, nrq * nc * sizeof(__m128));
     return mat;
 }
 
+
+//  Zero the padding at the end of each column of matrix
+static void zero_scrappie_matrix_padding(scrappie_matrix M) {
+    if (0 == M->nr % 4) {
+        return;
+    }
+    for (size_t c = 0; c < M->nc; c++) {
+        M->data.v[c * M->nrq + M->nrq - 1] = _mm_setzero_ps();
+    }
+}
+
+
+scrappie_matrix make_scrappie_matrix(int nr, int nc) {
+    scrappie_matrix mat = alloc_scrappie_matrix(nr, nc);
+    RETURN_NULL_IF(NULL == mat, NULL);
+    memset(mat->data.v, 0, mat->nrq * mat->nc * sizeof(__m128));
+    return mat;
+}
+
+
+/**  Remake matrix with a new shape
+ *
+ *   The memory of the matrix is reused when it is large enough, otherwise
+ *   the matrix is freed and a new one allocated.  If the shape changes, the
+ *   contents of the remade matrix are undefined except for the padding of
+ *   each column, which is zero.  Matrices with no capacity, such as views of
+ *   other matrices, must only be remade to their current shape.
+ *
+ *   @param M Matrix to remake, or NULL
+ *   @param nr Number of rows
+ *   @param nc Number of columns
+ *
+ *   @returns Matrix or NULL on failure
+ **/
 scrappie_matrix remake_scrappie_matrix(scrappie_matrix M, int nr, int nc) {
-    // Could be made more efficient when there is sufficent memory already allocated
-    if ((NULL == M) || (M->nr != nr) || (M->nc != nc)) {
+    if ((NULL != M) && (M->nr == nr) && (M->nc == nc)) {
+        return M;
+    }
+    const int nrq = (nr + 3) / 4;
+    if ((NULL != M) && (M->capacity >= matrix_nvec(nrq, nc)) && (matrix_nvec(nrq, nc) > 0)) {
+        M->nr = nr;
+        M->nrq = nrq;
+        M->nc = nc;
+    } else {
         M = free_scrappie_matrix(M);
-        M = make_scrappie_matrix(nr, nc);
+        M = alloc_scrappie_matrix(nr, nc);
+        RETURN_NULL_IF(NULL == M, NULL);
     }
+    zero_scrappie_matrix_padding(M);
     return M;
 }
 
 scrappie_matrix copy_scrappie_matrix(const_scrappie_matrix M){
     RETURN_NULL_IF(NULL == M, NULL);
-    scrappie_matrix C = make_scrappie_matrix(M->nr, M->nc);
+    scrappie_matrix C = alloc_scrappie_matrix(M->nr, M->nc);
     RETURN_NULL_IF(NULL == C, NULL);
     memcpy(C->data.f, M->data.f, sizeof(__m128) * C->nrq * C->nc);
     return C;
@@ -129,7 +321,11 @@ void fprint_scrappie_matrix(FILE * fh, const char *header,
 
 scrappie_matrix free_scrappie_matrix(scrappie_matrix mat) {
     if (NULL != mat) {
-        free(mat->data.v);
+        if (mat->capacity > 0) {
+            return_pooled_memory(mat->data.v, mat->capacity);
+        } else {
+            free(mat->data.v);
+        }
         free(mat);
     }
     return NULL;
@@ -265,39 +461,63 @@ bool equality_scrappie_matrix(const_scrappie_matrix mat1,
     return true;
 }
 
-scrappie_imatrix make_scrappie_imatrix(int nr, int nc) {
+static scrappie_imatrix alloc_scrappie_imatrix(int nr, int nc) {
     assert(nr > 0);
     assert(nc > 0);
     // Matrix padded so row length is multiple of 4
-    const int nrq = (int)ceil(nr / 4.0);
+    const int nrq = (nr + 3) / 4;
+    const size_t nvec = matrix_nvec(nrq, nc);
+    RETURN_NULL_IF(0 == nvec, NULL);
     scrappie_imatrix mat = malloc(sizeof(*mat));
     RETURN_NULL_IF(NULL == mat, NULL);
 
     mat->nr = nr;
     mat->nrq = nrq;
     mat->nc = nc;
-    mat->data.v = aligned_alloc(16, nrq * nc * sizeof(__m128i));
+    mat->data.v = take_pooled_memory(nvec, &mat->capacity);
     if (NULL == mat->data.v) {
-        warnx("Error allocating memory in %s.\n", __func__);
         free(mat);
         return NULL;
     }
-    memset(mat->data.v, 0, nrq * nc * sizeof(__m128));
     return mat;
 }
 
+scrappie_imatrix make_scrappie_imatrix(int nr, int nc) {
+    scrappie_imatrix mat = alloc_scrappie_imatrix(nr, nc);
+    RETURN_NULL_IF(NULL == mat, NULL);
+    memset(mat->data.v, 0, mat->nrq * mat->nc * sizeof(__m128i));
+    return mat;
+}
+
+/**  Remake integer matrix with a new shape
+ *
+ *   @see remake_scrappie_matrix
+ **/
 scrappie_imatrix remake_scrappie_imatrix(scrappie_imatrix M, int nr, int nc) {
-    // Could be made more efficient when there is sufficent memory already allocated
-    if ((NULL == M) || (M->nr != nr) || (M->nc != nc)) {
+    if ((NULL != M) && (M->nr == nr) && (M->nc == nc)) {
+        return M;
+    }
+    const int nrq = (nr + 3) / 4;
+    if ((NULL != M) && (M->capacity >= matrix_nvec(nrq, nc)) && (matrix_nvec(nrq, nc) > 0)) {
+        M->nr = nr;
+        M->nrq = nrq;
+        M->nc = nc;
+    } else {
         M = free_scrappie_imatrix(M);
-        M = make_scrappie_imatrix(nr, nc);
+        M = alloc_scrappie_imatrix(nr, nc);
+        RETURN_NULL_IF(NULL == M, NULL);
+    }
+    if (0 != nr % 4) {
+        for (size_t c = 0; c < M->nc; c++) {
+            M->data.v[c * M->nrq + M->nrq - 1] = _mm_setzero_si128();
+        }
     }
     return M;
 }
 
 scrappie_imatrix copy_scrappie_imatrix(const_scrappie_imatrix M){
     RETURN_NULL_IF(NULL == M, NULL);
-    scrappie_imatrix C = make_scrappie_imatrix(M->nr, M->nc);
+    scrappie_imatrix C = alloc_scrappie_imatrix(M->nr, M->nc);
     RETURN_NULL_IF(NULL == C, NULL);
     memcpy(C->data.f, M->data.f, sizeof(__m128i) * C->nrq * C->nc);
     return C;
@@ -305,7 +525,11 @@ scrappie_imatrix copy_scrappie_imatrix(const_scrappie_imatrix M){
 
 scrappie_imatrix free_scrappie_imatrix(scrappie_imatrix mat) {
     if (NULL != mat) {
-        free(mat->data.v);
+        if (mat->capacity > 0) {
+            return_pooled_memory(mat->data.v, mat->capacity);
+        } else {
+            free(mat->data.v);
+        }
         free(mat);
     }
     return NULL;
@@ -325,6 +549,8 @@ scrappie_matrix affine_map(const_scrappie_matrix X, const_scrappie_matrix W,
      *  W is [nr, nk]
      *  b is [nk]
      *  C is [nk, nc] or NULL.  If NULL then C is allocated.
+     *  On failure NULL is returned and C, which may be a view, is left to
+     *  the caller; only a matrix allocated here is freed.
      */
     RETURN_NULL_IF(NULL == X, NULL);
 
@@ -332,6 +558,7 @@ scrappie_matrix affine_map(const_scrappie_matrix X, const_scrappie_matrix W,
     assert(NULL != b);
     assert(W->nr == X->nr);
 
+    scrappie_matrix Cin = C;
     C = remake_scrappie_matrix(C, W->nc, X->nc);
     RETURN_NULL_IF(NULL == C, NULL);
 
@@ -341,6 +568,28 @@ scrappie_matrix affine_map(const_scrappie_matrix X, const_scrappie_matrix W,
     }
 
     /* Affine transform */
+    const_scrappie_qmatrix qW = get_int8_weights(W);
+    if (NULL != qW) {
+        qaffine_map(X, qW, C);
+        return C;
+    }
+    const_scrappie_hmatrix hW = get_half_weights(W);
+    if (NULL != hW) {
+        if (!haffine_map(X, hW, C)) {
+            return (C != Cin) ? free_scrappie_matrix(C) : NULL;
+        }
+        return C;
+    }
+    const_scrappie_smatrix sW = get_sparse_weights(W);
+    if (NULL != sW) {
+        saffine_map(X, sW, C);
+        return C;
+    }
+    const_scrappie_pmatrix pW = get_packed_weights(W);
+    if (NULL != pW) {
+        paffine_map(X, pW, C);
+        return C;
+    }
     cblas_sgemm(CblasColMajor, CblasTrans, CblasNoTrans, W->nc, X->nc, W->nr,
                 1.0, W->data.f, W->nrq * 4, X->data.f, X->nrq * 4, 1.0,
                 C->data.f, C->nrq * 4);
@@ -361,6 +610,8 @@ scrappie_matrix affine_map2(const_scrappie_matrix Xf, const_scrappie_matrix Xb,
     assert(Wb->nr == Xb->nr);
     assert(Xf->nc == Xb->nc);
     assert(Wf->nc == Wb->nc);
+    //  As affine_map, only a matrix allocated here is freed on failure
+    scrappie_matrix Cin = C;
     C = remake_scrappie_matrix(C, Wf->nc, Xf->nc);
     RETURN_NULL_IF(NULL == C, NULL);
 
@@ -369,6 +620,35 @@ scrappie_matrix affine_map2(const_scrappie_matrix Xf, const_scrappie_matrix Xb,
         memcpy(C->data.v + c * C->nrq, b->data.v, C->nrq * sizeof(__m128));
     }
 
+    const_scrappie_qmatrix qWf = get_int8_weights(Wf);
+    const_scrappie_qmatrix qWb = get_int8_weights(Wb);
+    if (NULL != qWf && NULL != qWb) {
+        qaffine_map(Xf, qWf, C);
+        qaffine_map(Xb, qWb, C);
+        return C;
+    }
+    const_scrappie_hmatrix hWf = get_half_weights(Wf);
+    const_scrappie_hmatrix hWb = get_half_weights(Wb);
+    if (NULL != hWf && NULL != hWb) {
+        if (!haffine_map(Xf, hWf, C) || !haffine_map(Xb, hWb, C)) {
+            return (C != Cin) ? free_scrappie_matrix(C) : NULL;
+        }
+        return C;
+    }
+    const_scrappie_smatrix sWf = get_sparse_weights(Wf);
+    const_scrappie_smatrix sWb = get_sparse_weights(Wb);
+    if (NULL != sWf && NULL != sWb) {
+        saffine_map(Xf, sWf, C);
+        saffine_map(Xb, sWb, C);
+        return C;
+    }
+    const_scrappie_pmatrix pWf = get_packed_weights(Wf);
+    const_scrappie_pmatrix pWb = get_packed_weights(Wb);
+    if (NULL != pWf && NULL != pWb) {
+        paffine_map(Xf, pWf, C);
+        paffine_map(Xb, pWb, C);
+        return C;
+    }
     /* Affine transform -- forwards */
     cblas_sgemm(CblasColMajor, CblasTrans, CblasNoTrans, Wf->nc, Xf->nc, Wf->nr,
                 1.0, Wf->data.f, Wf->nrq * 4, Xf->data.f, Xf->nrq * 4, 1.0,
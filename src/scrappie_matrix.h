@@ -7,16 +7,29 @@
 #    include <stdint.h>
 #    include <stdio.h>
 
+/*  Matrices are stored column major, each column padded to a multiple of
+ *  four rows.  Capacity is the number of vectors allocated for data, which
+ *  may be more than nrq * nc for matrices that have been remade smaller.
+ *  Matrices not allocated by make_scrappie_matrix, such as model weights,
+ *  have a capacity of zero.  Copies of weight matrices made as a layer is
+ *  built point to the converted versions of the weights (see precision.h),
+ *  which are otherwise looked up.
+ */
+struct scrappie_weights;
+
 typedef struct {
     unsigned int nr, nrq, nc;
+    size_t capacity;
     union {
         __m128 *v;
         float *f;
     } data;
+    const struct scrappie_weights *converted;
 } _Mat;
 
 typedef struct {
     unsigned int nr, nrq, nc;
+    size_t capacity;
     union {
         __m128i *v;
         int32_t *f;
@@ -51,6 +64,8 @@ scrappie_imatrix copy_scrappie_imatrix(const_scrappie_imatrix mat);
 scrappie_imatrix free_scrappie_imatrix(scrappie_imatrix mat);
 void zero_scrappie_imatrix(scrappie_imatrix M);
 
+void free_scrappie_matrix_pool(void);
+
 scrappie_matrix affine_map(const_scrappie_matrix X, const_scrappie_matrix W,
                            const_scrappie_matrix b, scrappie_matrix C);
 scrappie_matrix affine_map2(const_scrappie_matrix Xf, const_scrappie_matrix Xb,
@@ -1,6 +1,3 @@
-#include <dirent.h>
-#include <glob.h>
-#include <libgen.h>
 #include <math.h>
 
 #if defined(_OPENMP)
@@ -13,6 +10,7 @@
 #include "decode.h"
 #include "fast5_interface.h"
 #include "networks.h"
+#include "read_pipeline.h"
 #include "scrappie_common.h"
 #include "scrappie_licence.h"
 #include "scrappie_stdlib.h"
@@ -23,7 +21,7 @@
 
 struct _raw_basecall_info {
     float score;
-    raw_table rt;
+    daq_table dt;
 
     char *basecall;
     size_t basecall_length;
@@ -49,8 +47,19 @@ static struct argp_option options[] = {
     {"slip", 1, 0, 0, "Use slipping"},
     {"no-slip", 2, 0, OPTION_ALIAS, "Disable slipping"},
     {"model", 5, "name", 0, "Raw model to use: \"raw_r94\", \"rgr_r94\", \"rgrgr_r94\", \"rgrgr_r95\""},
-    // Currently disabled
-    //{"dump", 4, "filename", 0, "Dump annotated blocks to HDF5 file"},
+    {"dump", 4, "filename", 0, "Dump trimmed raw signal, delta-varint encoded, to HDF5 file"},
+    {"approx", 14, "level", 0, "Approximation for exp, log and activations: \"exact\", \"polynomial\" or \"schraudolph\""},
+    {"model-file", 16, "filename", 0, "Load weights of model from binary model file"},
+    {"precision", 15, "precision", 0, "Precision of weights: \"float32\", \"int8\", \"float16\" or \"bfloat16\""},
+    {"sparsity", 19, "fraction", 0, "Fraction of blocks of recurrent and output weights to prune (float32 only)"},
+    {"layer-timing", 17, 0, 0, "Report time spent in each layer of network to stderr"},
+    {"memory-plan", 18, 0, 0, "Report memory plan of network for longest read to stderr"},
+    {"readers", 20, "nthread", 0, "Number of threads reading reads ahead of calling"},
+    {"prefetch", 21, "nreads", 0, "Maximum number of reads read ahead (0 is twice number of threads)"},
+    {"io-timing", 22, 0, 0, "Report time spent reading reads and waiting for them to stderr"},
+    {"io-depth", 23, "nreads", 0, "Reads of signal files in flight at once (0 reads through memory map)"},
+    {"in-memory", 24, "MB", 0, "Read fast5 files of at most this size whole into memory when opened (0 is off)"},
+    {"input-list", 25, "filename", 0, "Read further paths, one per line, from file (\"-\" for stdin)"},
     {"licence", 10, 0, 0, "Print licensing information"},
     {"license", 11, 0, OPTION_ALIAS, "Print licensing information"},
     {"hdf5-compression", 12, "level", 0, "Gzip compression level for HDF5 output (0:off, 1: quickest, 9: best)"},
@@ -82,6 +91,17 @@ struct arguments {
     int compression_level;
     int compression_chunk_size;
     enum raw_model_type model_type;
+    enum scrappie_precision precision;
+    float sparsity;
+    char * model_file;
+    bool layer_timing;
+    bool memory_plan;
+    int nreader;
+    int prefetch;
+    int io_depth;
+    int in_memory;
+    bool io_timing;
+    char * input_list;
     char ** files;
 };
 
@@ -103,6 +123,17 @@ static struct arguments args = {
     .compression_level = 1,
     .compression_chunk_size = 200,
     .model_type = SCRAPPIE_MODEL_RGRGR_R94,
+    .precision = SCRAPPIE_PRECISION_FLOAT32,
+    .sparsity = 0.0f,
+    .model_file = NULL,
+    .layer_timing = false,
+    .memory_plan = false,
+    .nreader = 1,
+    .prefetch = 0,
+    .io_depth = 64,
+    .in_memory = 0,
+    .io_timing = false,
+    .input_list = NULL,
     .files = NULL
 };
 
@@ -184,6 +215,63 @@ static error_t parse_arg(int key, char * arg, struct  argp_state * state){
         args.local_pen = atof(arg);
         assert(isfinite(args.local_pen));
         break;
+    case 14:
+        {
+            const enum math_approx approx = get_math_approx(arg);
+            if(MATH_APPROX_INVALID == approx){
+                errx(EXIT_FAILURE, "Invalid approximation level \"%s\"", arg);
+            }
+            set_math_approx(approx);
+        }
+        break;
+    case 16:
+        args.model_file = arg;
+        break;
+    case 17:
+        args.layer_timing = true;
+        break;
+    case 18:
+        args.memory_plan = true;
+        break;
+    case 20:
+        args.nreader = atoi(arg);
+        if(args.nreader < 1){
+            errx(EXIT_FAILURE, "Number of readers should be positive, got \"%s\"", arg);
+        }
+        break;
+    case 21:
+        args.prefetch = atoi(arg);
+        if(args.prefetch < 0){
+            errx(EXIT_FAILURE, "Number of reads to prefetch should be non-negative, got \"%s\"", arg);
+        }
+        break;
+    case 22:
+        args.io_timing = true;
+        break;
+    case 23:
+        args.io_depth = atoi(arg);
+        if(args.io_depth < 0){
+            errx(EXIT_FAILURE, "Number of reads in flight should be non-negative, got \"%s\"", arg);
+        }
+        break;
+    case 24:
+        args.in_memory = atoi(arg);
+        if(args.in_memory < 0){
+            errx(EXIT_FAILURE, "Size of files read into memory should be non-negative, got \"%s\"", arg);
+        }
+        break;
+    case 15:
+        args.precision = get_scrappie_precision(arg);
+        if(SCRAPPIE_PRECISION_INVALID == args.precision){
+            errx(EXIT_FAILURE, "Invalid precision \"%s\"", arg);
+        }
+        break;
+    case 19:
+        args.sparsity = atof(arg);
+        if(!(args.sparsity >= 0.0f && args.sparsity <= 1.0f)){
+            errx(EXIT_FAILURE, "Sparsity should be between 0 and 1, got \"%s\"", arg);
+        }
+        break;
     case 10:
     case 11:
         ret = fputs(scrappie_licence_text, stdout);
@@ -191,11 +279,15 @@ static error_t parse_arg(int key, char * arg, struct  argp_state * state){
         break;
     case 12:
         args.compression_level = atoi(arg);
-        assert(args.compression_level >= 0 && args.compression_level <= 9);
+        if(args.compression_level < 0 || args.compression_level > 9){
+            errx(EXIT_FAILURE, "--hdf5-compression should be between 0 and 9");
+        }
         break;
     case 13:
         args.compression_chunk_size = atoi(arg);
-        assert(args.compression_chunk_size > 0);
+        if(args.compression_chunk_size <= 0){
+            errx(EXIT_FAILURE, "--hdf5-chunk should be positive");
+        }
         break;
     #if defined(_OPENMP)
     case '#':
@@ -209,8 +301,14 @@ static error_t parse_arg(int key, char * arg, struct  argp_state * state){
         break;
     #endif
 
+    case 25:
+        args.input_list = arg;
+        break;
+
     case ARGP_KEY_NO_ARGS:
-        argp_usage (state);
+        if(NULL == args.input_list){
+            argp_usage (state);
+        }
         break;
 
     case ARGP_KEY_ARG:
@@ -227,21 +325,17 @@ static error_t parse_arg(int key, char * arg, struct  argp_state * state){
 
 static struct argp argp = {options, parse_arg, args_doc, doc};
 
-static struct _raw_basecall_info calculate_post(char * filename, enum raw_model_type model){
-    RETURN_NULL_IF(NULL == filename, (struct _raw_basecall_info){0});
-    RETURN_NULL_IF(SCRAPPIE_MODEL_INVALID == model, (struct _raw_basecall_info){0});
-    posterior_function_ptr calcpost = get_posterior_function(model);
-
-    raw_table rt = read_raw(filename, true);
-    RETURN_NULL_IF(NULL == rt.raw, (struct _raw_basecall_info){0});
-
-    rt = trim_and_segment_raw(rt, args.trim_start, args.trim_end, args.varseg_chunk, args.varseg_thresh);
-    RETURN_NULL_IF(NULL == rt.raw, (struct _raw_basecall_info){0});
+static struct _raw_basecall_info calculate_post(daq_table dt, enum raw_model_type model){
+    RETURN_NULL_IF(NULL == dt.raw, (struct _raw_basecall_info){0});
+    if(SCRAPPIE_MODEL_INVALID == model){
+        free(dt.raw);
+        return (struct _raw_basecall_info){0};
+    }
 
-    medmad_normalise_array(rt.raw + rt.start, rt.end - rt.start);
-    scrappie_matrix post = calcpost(rt, args.min_prob, true);
+    //  Signal, trimmed by reader, is normalised as features are made
+    scrappie_matrix post = daq_posterior(model, dt, args.min_prob, true);
     if (NULL == post) {
-        free(rt.raw);
+        free(dt.raw);
         return (struct _raw_basecall_info){0};
     }
     const int nblock = post->nc;
@@ -266,7 +360,7 @@ static struct _raw_basecall_info calculate_post(char * filename, enum raw_model_
     const size_t basecall_len = strlen(basecall);
 
     return (struct _raw_basecall_info) {
-    score, rt, basecall, basecall_len, pos, nblock};
+    score, dt, basecall, basecall_len, pos, nblock};
 }
 
 static int fprintf_fasta(FILE * fp, const char *readname, const char * prefix,
@@ -276,7 +370,7 @@ static int fprintf_fasta(FILE * fp, const char *readname, const char * prefix,
                    prefix, readname, -res.score / res.nblock, res.nblock,
                    res.basecall_length,
                    (float)res.nblock / (float)res.basecall_length,
-                   res.rt.n, res.rt.start, res.rt.end, res.basecall);
+                   res.dt.n, res.dt.start, res.dt.end, res.basecall);
 }
 
 static int fprintf_sam(FILE * fp, const char *readname, const char * prefix,
@@ -286,13 +380,25 @@ static int fprintf_sam(FILE * fp, const char *readname, const char * prefix,
 }
 
 int main_raw(int argc, char * argv[]){
-    #if defined(_OPENMP)
-        omp_set_nested(1);
-    #endif
     argp_parse(&argp, argc, argv, 0, 0, NULL);
     if(NULL == args.output){
         args.output = stdout;
     }
+    if(NULL != args.model_file && !load_raw_model_file(args.model_type, args.model_file)){
+        errx(EXIT_FAILURE, "Failed to load model from \"%s\"", args.model_file);
+    }
+    if(!set_raw_model_precision(args.model_type, args.precision)){
+        errx(EXIT_FAILURE, "Failed to convert weights of model to %s", scrappie_precision_string(args.precision));
+    }
+    if(args.sparsity > 0.0f){
+        if(SCRAPPIE_PRECISION_FLOAT32 != args.precision){
+            errx(EXIT_FAILURE, "Pruning is only supported for float32 weights");
+        }
+        if(!set_raw_model_sparsity(args.model_type, args.sparsity)){
+            errx(EXIT_FAILURE, "Failed to prune weights of model");
+        }
+    }
+    set_network_timing(args.layer_timing);
 
     hid_t hdf5out = -1;
     if(NULL != args.dump){
@@ -302,55 +408,36 @@ int main_raw(int argc, char * argv[]){
         }
     }
 
-    int nfile = 0;
-    for( ; args.files[nfile] ; nfile++);
+    #if defined(_OPENMP)
+        const int nthread = omp_get_max_threads();
+    #else
+        const int nthread = 1;
+    #endif
+    const size_t prefetch = (args.prefetch > 0) ? args.prefetch : 2 * nthread;
+    const struct read_trim trim = {args.trim_start, args.trim_end, args.varseg_chunk, args.varseg_thresh};
+    char * no_files[1] = {NULL};
+    struct read_pipeline * pipeline = make_read_pipeline((NULL != args.files) ? args.files : no_files,
+                                                         args.input_list, args.nreader, prefetch, args.io_depth,
+                                                         (size_t)args.in_memory << 20, &trim, args.limit);
+    if(NULL == pipeline){
+        errx(EXIT_FAILURE, "Failed to start reading fast5 files");
+    }
 
-    int reads_started = 0;
-    const int reads_limit = args.limit;
-    #pragma omp parallel for schedule(dynamic)
-    for(int fn=0 ; fn < nfile ; fn++){
-        if(reads_limit > 0 && reads_started >= reads_limit){
-            continue;
-        }
-        //  Iterate through all files and directories on command line.
-        //  Nested parallelism for OpenMP is enabled so worker threads are used for all open
-        // directories but this less than optimal since many directories may be open at once.
-        glob_t globbuf;
-        {
-            // Find all files matching commandline argument using system glob
-            const size_t rootlen = strlen(args.files[fn]);
-            char * globpath = calloc(rootlen + 9, sizeof(char));
-            memcpy(globpath, args.files[fn], rootlen * sizeof(char));
-            {
-                DIR * dirp = opendir(args.files[fn]);
-                if(NULL != dirp){
-                    // If filename is a directory, add wildcard to find all fast5 files within it
-                    memcpy(globpath + rootlen, "/*.fast5", 8 * sizeof(char));
-                    closedir(dirp);
-                }
+    size_t longest_read = 0;
+    //  Work is scheduled per read: each thread takes the next read, read and
+    // trimmed ahead of time by the reader threads of the pipeline.
+    #pragma omp parallel
+    {
+        while(true){
+            struct fast5_read read = {0};
+            if(!next_pipeline_read(pipeline, &read)){
+                break;
             }
-            int globret = glob(globpath, GLOB_NOSORT, NULL, &globbuf);
-            free(globpath);
-            if(0 != globret){
-                if(GLOB_NOMATCH == globret){
-                    warnx("File or directory \"%s\" does not exist or no fast5 files found.", args.files[fn]);
-                }
-                globfree(&globbuf);
-                continue;
-            }
-        }
-        #pragma omp parallel for schedule(dynamic)
-        for(int fn2=0 ; fn2 < globbuf.gl_pathc ; fn2++){
-            if(reads_limit > 0 && reads_started >= reads_limit){
-                continue;
-            }
-            #pragma omp atomic
-            reads_started += 1;
 
-            char * filename = globbuf.gl_pathv[fn2];
-            struct _raw_basecall_info res = calculate_post(filename, args.model_type);
+            struct _raw_basecall_info res = calculate_post(read.dt, args.model_type);
             if(NULL == res.basecall){
-                warnx("No basecall returned for %s", filename);
+                warnx("No basecall returned for %s", read.name);
+                free(read.name);
                 continue;
             }
 
@@ -358,31 +445,51 @@ int main_raw(int argc, char * argv[]){
             {
                 switch(args.outformat){
                 case FORMAT_FASTA:
-                    fprintf_fasta(args.output, basename(filename), args.prefix, res);
+                    fprintf_fasta(args.output, read.name, args.prefix, res);
                     break;
                 case FORMAT_SAM:
-                    fprintf_sam(args.output, basename(filename), args.prefix, res);
+                    fprintf_sam(args.output, read.name, args.prefix, res);
                     break;
                 default:
                     errx(EXIT_FAILURE, "Unrecognised output format");
                 }
 
                 if(hdf5out >= 0){
-                    write_annotated_raw(hdf5out, basename(filename), res.rt,
+                    write_annotated_raw(hdf5out, read.name, res.dt,
                         args.compression_chunk_size, args.compression_level);
                 }
+                if(res.dt.end - res.dt.start > longest_read){
+                    longest_read = res.dt.end - res.dt.start;
+                }
             }
-            free(res.rt.raw);
+            free(res.dt.raw);
             free(res.basecall);
             free(res.pos);
+            free(read.name);
         }
-        globfree(&globbuf);
+        //  Threads of OpenMP outlive the region, so release the memory each
+        // holds for reuse between reads
+        free_network_workspace();
+        free_scrappie_matrix_pool();
+    }
+    if(args.io_timing){
+        fprintf_read_pipeline_timing(stderr, pipeline);
     }
+    pipeline = free_read_pipeline(pipeline);
 
     if(hdf5out >= 0){
         H5Fclose(hdf5out);
     }
 
+    if(args.layer_timing){
+        fprintf_network_timing(stderr, get_raw_network(args.model_type));
+    }
+    if(args.memory_plan && longest_read > 0){
+        struct network_plan * plan = make_network_plan(get_raw_network(args.model_type), 1, longest_read);
+        fprintf_network_plan(stderr, plan);
+        plan = free_network_plan(plan);
+    }
+
     if(stdout != args.output){
         fclose(args.output);
     }
@@ -28,4 +28,17 @@ typedef struct {
     float *raw;
 } raw_table;
 
+/*  Raw signal as stored by the sequencer.  DAQ values are converted to pA
+ *  as (raw + offset) * range / digitisation.
+ */
+typedef struct {
+    size_t n;
+    size_t start;
+    size_t end;
+    float offset;
+    float range;
+    float digitisation;
+    int16_t *raw;
+} daq_table;
+
 #endif                          /* SCRAPPIE_DATA_H */
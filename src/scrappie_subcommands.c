@@ -22,6 +22,12 @@ enum scrappie_mode get_scrappie_mode(const char *modestr) {
     if (0 == strcmp(modestr, "squiggle")){
         return SCRAPPIE_MODE_SQUIGGLE;
     }
+    if (0 == strcmp(modestr, "approx")){
+        return SCRAPPIE_MODE_APPROX;
+    }
+    if (0 == strcmp(modestr, "convert")){
+        return SCRAPPIE_MODE_CONVERT;
+    }
 
     return SCRAPPIE_MODE_INVALID;
 }
@@ -40,6 +46,10 @@ const char *scrappie_mode_string(const enum scrappie_mode mode) {
         return "version";
     case SCRAPPIE_MODE_SQUIGGLE:
         return "squiggle";
+    case SCRAPPIE_MODE_APPROX:
+        return "approx";
+    case SCRAPPIE_MODE_CONVERT:
+        return "convert";
     case SCRAPPIE_MODE_INVALID:
         errx(EXIT_FAILURE, "Invalid scrappie mode\n");
     default:
@@ -63,6 +73,10 @@ const char *scrappie_mode_description(const enum scrappie_mode mode) {
         return "Print version information.";
     case SCRAPPIE_MODE_SQUIGGLE:
         return "Create approximate squiggle for sequence";
+    case SCRAPPIE_MODE_APPROX:
+        return "Report accuracy of math approximations.";
+    case SCRAPPIE_MODE_CONVERT:
+        return "Convert fast5 files into a scrappie signal file.";
     case SCRAPPIE_MODE_INVALID:
         errx(EXIT_FAILURE, "Invalid scrappie mode\n");
     default:
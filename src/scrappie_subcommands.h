@@ -6,13 +6,15 @@
 #    include <stdio.h>
 
 // Helper functions for subcommmads
-static const int scrappie_ncommand = 5;
+static const int scrappie_ncommand = 8;
 enum scrappie_mode {SCRAPPIE_MODE_EVENTS = 0,
                     SCRAPPIE_MODE_HELP,
                     SCRAPPIE_MODE_LICENCE,
                     SCRAPPIE_MODE_RAW,
                     SCRAPPIE_MODE_VERSION,
                     SCRAPPIE_MODE_SQUIGGLE,
+                    SCRAPPIE_MODE_APPROX,
+                    SCRAPPIE_MODE_CONVERT,
                     SCRAPPIE_MODE_INVALID };
 
 enum scrappie_mode get_scrappie_mode(const char *modestr);
@@ -21,6 +23,8 @@ const char *scrappie_mode_description(const enum scrappie_mode mode);
 int fprint_scrappie_commands(FILE * fp, bool header);
 
 // Main routines for subcommands
+int main_approx(int argc, char *argv[]);
+int main_convert(int argc, char *argv[]);
 int main_events(int argc, char *argv[]);
 int main_help(int argc, char *argv[]);
 int main_help_short(void);
@@ -0,0 +1,151 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "scrappie_stdlib.h"
+#include "signal_codec.h"
+
+#ifdef __SSSE3__
+#    include <tmmintrin.h>
+#endif
+
+static inline uint16_t zigzag_encode(int16_t d) {
+    return ((uint16_t) d << 1) ^ (uint16_t) (d >> 15);
+}
+
+static inline uint16_t zigzag_decode(uint16_t z) {
+    return (z >> 1) ^ (uint16_t) (0 - (z & 1));
+}
+
+/**  Number of bytes required to encode signal, at most
+ *
+ *   @param n Length of signal
+ *
+ *   @returns Bound on size of encoded signal
+ **/
+size_t delta_varint_bound(size_t n) {
+    return (n + 7) / 8 + 2 * n;
+}
+
+/**  Encode signal
+ *
+ *   @param x Signal
+ *   @param n Length of signal
+ *   @param out [out] Encoded signal, of at least delta_varint_bound(n) bytes
+ *
+ *   @returns Size of encoded signal in bytes
+ **/
+size_t encode_delta_varint(const int16_t * x, size_t n, uint8_t * out) {
+    RETURN_NULL_IF(NULL == x, 0);
+    RETURN_NULL_IF(NULL == out, 0);
+    const size_t nctrl = (n + 7) / 8;
+    uint8_t *ctrl = out;
+    uint8_t *data = out + nctrl;
+    memset(ctrl, 0, nctrl);
+
+    uint16_t prev = 0;
+    for (size_t i = 0; i < n; i++) {
+        //  Difference wraps, as does the sum when decoding
+        const uint16_t z = zigzag_encode((int16_t) ((uint16_t) x[i] - prev));
+        prev = (uint16_t) x[i];
+        *data++ = z & 0xff;
+        if (z > 0xff) {
+            *data++ = z >> 8;
+            ctrl[i / 8] |= 1 << (i % 8);
+        }
+    }
+
+    return data - out;
+}
+
+#ifdef __SSSE3__
+/*  For each control byte, the shuffle gathering the bytes of its eight
+ *  samples into 16-bit lanes and the number of data bytes they take.
+ */
+static uint8_t shuffle_table[256][16] __attribute__ ((aligned(16)));
+static uint8_t length_table[256];
+static pthread_once_t table_once = PTHREAD_ONCE_INIT;
+
+static void init_shuffle_table(void) {
+    for (int c = 0; c < 256; c++) {
+        uint8_t offset = 0;
+        for (int i = 0; i < 8; i++) {
+            shuffle_table[c][2 * i] = offset++;
+            //  Shuffle index with high bit set gives zero
+            shuffle_table[c][2 * i + 1] = ((c >> i) & 1) ? offset++ : 0x80;
+        }
+        length_table[c] = offset;
+    }
+}
+#endif
+
+/**  Decode signal
+ *
+ *   @param in Encoded signal
+ *   @param nbyte Size of encoded signal in bytes
+ *   @param x [out] Signal
+ *   @param n Length of signal
+ *
+ *   @returns true on success, false if the encoded signal is not of the
+ *   length expected
+ **/
+bool decode_delta_varint(const uint8_t * in, size_t nbyte, int16_t * x, size_t n) {
+    RETURN_NULL_IF(NULL == in, false);
+    RETURN_NULL_IF(NULL == x, false);
+    const size_t nctrl = (n + 7) / 8;
+    if (nbyte < nctrl) {
+        return false;
+    }
+    const uint8_t *ctrl = in;
+    const uint8_t *data = in + nctrl;
+
+    //  Check length before reading data, so decoding cannot run off the end
+    size_t ndata = n;
+    for (size_t k = 0; k < nctrl; k++) {
+        for (uint8_t c = ctrl[k]; c; c &= c - 1) {
+            ndata += 1;
+        }
+    }
+    if (ndata != nbyte - nctrl) {
+        return false;
+    }
+
+    size_t i = 0;
+    uint16_t prev = 0;
+#ifdef __SSSE3__
+    pthread_once(&table_once, init_shuffle_table);
+    const uint8_t *end = in + nbyte;
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i broadcast_last = _mm_set1_epi16(0x0f0e);
+    __m128i vprev = _mm_setzero_si128();
+    //  Eight samples take at most sixteen bytes, so a full load stays in bounds
+    for (; i + 8 <= n && end - data >= 16; i += 8) {
+        const uint8_t c = ctrl[i / 8];
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data),
+                                     _mm_load_si128((const __m128i *)shuffle_table[c]));
+        data += length_table[c];
+        //  Zigzag decode
+        v = _mm_xor_si128(_mm_srli_epi16(v, 1),
+                          _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(v, one)));
+        //  Prefix sum of differences, carrying on from previous sample
+        v = _mm_add_epi16(v, _mm_slli_si128(v, 2));
+        v = _mm_add_epi16(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi16(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi16(v, vprev);
+        _mm_storeu_si128((__m128i *) (x + i), v);
+        vprev = _mm_shuffle_epi8(v, broadcast_last);
+    }
+    if (i > 0) {
+        prev = (uint16_t) x[i - 1];
+    }
+#endif
+    for (; i < n; i++) {
+        uint16_t z = *data++;
+        if ((ctrl[i / 8] >> (i % 8)) & 1) {
+            z |= (uint16_t) (*data++) << 8;
+        }
+        prev += zigzag_decode(z);
+        x[i] = (int16_t) prev;
+    }
+
+    return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#ifndef SIGNAL_CODEC_H
+#    define SIGNAL_CODEC_H
+
+#    include <stdbool.h>
+#    include <stddef.h>
+#    include <stdint.h>
+
+/*  Codec for raw signal, as int16 DAQ values.
+ *
+ *  Successive samples differ by little, so the difference from the previous
+ *  sample is taken (delta), mapped to an unsigned value that is small when
+ *  the difference is small in magnitude (zigzag) and stored in one byte, or
+ *  two when it does not fit (varint).  As for stream VByte, the lengths are
+ *  stored apart from the values, one bit per sample, so eight samples are
+ *  decoded at once by a single shuffle of their bytes.
+ *
+ *  Encoded block:
+ *    control  ceil(n / 8) bytes, bit i of byte k set if sample 8k + i
+ *             takes two bytes
+ *    data     low byte, then high byte if present, of each zigzag value
+ */
+enum signal_encoding {
+    SIGNAL_ENCODING_RAW = 0,
+    SIGNAL_ENCODING_DELTA_VARINT = 1
+};
+
+size_t delta_varint_bound(size_t n);
+size_t encode_delta_varint(const int16_t * x, size_t n, uint8_t * out);
+bool decode_delta_varint(const uint8_t * in, size_t nbyte, int16_t * x, size_t n);
+
+#endif                          /* SIGNAL_CODEC_H */
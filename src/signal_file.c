@@ -0,0 +1,581 @@
+#define _POSIX_C_SOURCE 200809L
+#include <err.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "scrappie_stdlib.h"
+#include "signal_file.h"
+
+_Static_assert(64 == sizeof(struct signal_file_header), "Header of signal file should be 64 bytes");
+_Static_assert(48 == sizeof(struct signal_file_entry), "Index entry of signal file should be 48 bytes");
+
+/**  Whether file is a scrappie signal file
+ *
+ *   @param filename Name of file
+ *
+ *   @returns true if the file starts with the magic of a signal file
+ **/
+bool is_signal_file(const char *filename) {
+    RETURN_NULL_IF(NULL == filename, false);
+    FILE *fh = fopen(filename, "rb");
+    if (NULL == fh) {
+        return false;
+    }
+    char magic[sizeof(SIGNAL_FILE_MAGIC)] = { 0 };
+    const bool is_signal = (1 == fread(magic, sizeof(magic), 1, fh))
+        && (0 == memcmp(magic, SIGNAL_FILE_MAGIC, sizeof(magic)));
+    fclose(fh);
+    return is_signal;
+}
+
+/**  Open a signal file by mapping it into memory
+ *
+ *   The header and extent of the index are checked.  No data is read until
+ *   the signal of a read is, and then only the pages it covers.
+ *
+ *   @param filename Name of signal file
+ *
+ *   @returns Opened file or NULL on failure
+ **/
+struct signal_file *open_signal_file(const char *filename) {
+    RETURN_NULL_IF(NULL == filename, NULL);
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        warnx("Failed to open %s for reading.", filename);
+        return NULL;
+    }
+    struct stat st;
+    if (0 != fstat(fd, &st) || st.st_size < (off_t) sizeof(struct signal_file_header)) {
+        warnx("%s is too short to be a signal file.", filename);
+        close(fd);
+        return NULL;
+    }
+    const size_t size = st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == map) {
+        warnx("Failed to map %s into memory.", filename);
+        close(fd);
+        return NULL;
+    }
+
+    const struct signal_file_header *header = map;
+    bool ok = (0 == memcmp(header->magic, SIGNAL_FILE_MAGIC, sizeof(SIGNAL_FILE_MAGIC)));
+    if (ok && SIGNAL_FILE_BYTE_ORDER != header->byte_order) {
+        warnx("%s was written by a machine of different byte order.", filename);
+        ok = false;
+    }
+    if (ok && SIGNAL_FILE_VERSION != header->version) {
+        warnx("%s is version %u of signal file, version %d expected.", filename,
+              header->version, SIGNAL_FILE_VERSION);
+        ok = false;
+    }
+    //  Each part must lie within file, without overflow
+    ok = ok && header->signal_offset <= size
+        && header->signal_size <= size - header->signal_offset;
+    ok = ok && header->names_offset <= size && header->names_size <= size - header->names_offset
+        && (0 == header->names_size || '\0' == ((const char *)map)[header->names_offset + header->names_size - 1]);
+    ok = ok && header->index_offset <= size
+        && header->nread <= (size - header->index_offset) / sizeof(struct signal_file_entry)
+        && 0 == header->index_offset % sizeof(uint64_t);
+    struct signal_file *sf = ok ? calloc(1, sizeof(struct signal_file)) : NULL;
+    if (NULL == sf) {
+        warnx("%s is not a valid signal file.", filename);
+        munmap(map, size);
+        close(fd);
+        return NULL;
+    }
+
+    sf->fd = fd;
+    sf->map = map;
+    sf->size = size;
+    sf->nread = header->nread;
+    sf->index = (const struct signal_file_entry *)(sf->map + header->index_offset);
+    sf->names = (const char *)(sf->map + header->names_offset);
+    sf->signal = sf->map + header->signal_offset;
+    sf->signal_size = header->signal_size;
+    return sf;
+}
+
+/**  Close signal file
+ *
+ *   @returns NULL
+ **/
+struct signal_file *free_signal_file(struct signal_file *sf) {
+    if (NULL == sf) {
+        return NULL;
+    }
+    munmap((void *)sf->map, sf->size);
+    close(sf->fd);
+    free(sf);
+    return NULL;
+}
+
+/**  Read ID of read in signal file
+ *
+ *   @param sf Open signal file
+ *   @param idx Index of read
+ *
+ *   @returns Read ID, owned by the file, or NULL if the index is invalid
+ **/
+const char *signal_file_read_id(const struct signal_file *sf, size_t idx) {
+    RETURN_NULL_IF(NULL == sf, NULL);
+    if (idx >= sf->nread) {
+        return NULL;
+    }
+    const struct signal_file_header *header = (const struct signal_file_header *)sf->map;
+    RETURN_NULL_IF(sf->index[idx].name >= header->names_size, NULL);
+    return sf->names + sf->index[idx].name;
+}
+
+/**  Index of read in signal file
+ *
+ *   @param sf Open signal file
+ *   @param read_id ID of read
+ *
+ *   @returns Index of read or -1 if the file does not contain the read
+ **/
+ssize_t signal_file_read_index(const struct signal_file *sf, const char *read_id) {
+    RETURN_NULL_IF(NULL == sf, -1);
+    RETURN_NULL_IF(NULL == read_id, -1);
+    //  Index is sorted by read ID
+    size_t lower = 0;
+    size_t upper = sf->nread;
+    while (lower < upper) {
+        const size_t mid = lower + (upper - lower) / 2;
+        const char *mid_id = signal_file_read_id(sf, mid);
+        RETURN_NULL_IF(NULL == mid_id, -1);
+        const int cmp = strcmp(read_id, mid_id);
+        if (0 == cmp) {
+            return mid;
+        }
+        if (cmp < 0) {
+            upper = mid;
+        } else {
+            lower = mid + 1;
+        }
+    }
+    return -1;
+}
+
+//  Whether signal of read lies within signal of file.  Every encoding takes
+// at least one byte per sample.
+static bool signal_entry_valid(const struct signal_file *sf, size_t idx) {
+    const struct signal_file_entry *entry = sf->index + idx;
+    if (entry->start > sf->signal_size || entry->nbyte > sf->signal_size - entry->start
+        || entry->nsample > entry->nbyte) {
+        warnx("Signal of read %zu lies outside of signal file.", idx);
+        return false;
+    }
+    return true;
+}
+
+/**  Decode signal of read
+ *
+ *   @param entry Entry of read in index
+ *   @param idx Index of read, for warnings
+ *   @param signal Signal of read, entry->nbyte bytes as stored
+ *
+ *   @returns Table of raw signal.  The signal is NULL on failure.
+ **/
+static daq_table decode_signal_entry(const struct signal_file_entry *entry, size_t idx,
+                                     const uint8_t * signal) {
+    daq_table daqtbl = { 0, 0, 0, NAN, NAN, NAN, NULL };
+    int16_t *raw = malloc(entry->nsample * sizeof(int16_t));
+    RETURN_NULL_IF(NULL == raw, daqtbl);
+    bool ok = false;
+    switch (entry->encoding) {
+    case SIGNAL_ENCODING_RAW:
+        ok = (entry->nbyte == entry->nsample * sizeof(int16_t));
+        if (ok) {
+            memcpy(raw, signal, entry->nbyte);
+        }
+        break;
+    case SIGNAL_ENCODING_DELTA_VARINT:
+        ok = decode_delta_varint(signal, entry->nbyte, raw, entry->nsample);
+        break;
+    default:
+        warnx("Signal of read %zu has unrecognised encoding %u.", idx, entry->encoding);
+    }
+    if (!ok) {
+        warnx("Failed to decode signal of read %zu.", idx);
+        free(raw);
+        return daqtbl;
+    }
+
+    return (daq_table) {
+    entry->nsample, 0, entry->nsample, entry->offset, entry->range, entry->digitisation, raw};
+}
+
+/**  Read raw signal of a read in a signal file
+ *
+ *   Signal is decoded, if encoded, straight from the mapped file.
+ *
+ *   @param sf Open signal file
+ *   @param idx Index of read
+ *
+ *   @returns Table of raw signal, a copy owned by caller.  The signal is
+ *   NULL on failure.
+ **/
+daq_table read_daq_from_signal_file(const struct signal_file *sf, size_t idx) {
+    daq_table daqtbl = { 0, 0, 0, NAN, NAN, NAN, NULL };
+    RETURN_NULL_IF(NULL == sf, daqtbl);
+    if (idx >= sf->nread) {
+        warnx("No read %zu in signal file, which has %zu reads.", idx, sf->nread);
+        return daqtbl;
+    }
+    if (!signal_entry_valid(sf, idx)) {
+        return daqtbl;
+    }
+    const struct signal_file_entry *entry = sf->index + idx;
+    return decode_signal_entry(entry, idx, sf->signal + entry->start);
+}
+
+static double elapsed(const struct timespec *t0, const struct timespec *t1) {
+    return (t1->tv_sec - t0->tv_sec) + 1e-9 * (t1->tv_nsec - t0->tv_nsec);
+}
+
+/**  Start stream of the reads of a signal file
+ *
+ *   @param sf Open signal file, which must outlive the stream
+ *   @param depth Maximum number of reads in flight
+ *   @param use_uring Whether to read by io_uring, if it is available,
+ *   rather than pread
+ *
+ *   @returns Stream or NULL on failure
+ **/
+struct signal_file_stream *make_signal_file_stream(const struct signal_file *sf, size_t depth,
+                                                   bool use_uring) {
+    RETURN_NULL_IF(NULL == sf, NULL);
+    RETURN_NULL_IF(0 == depth, NULL);
+    struct signal_file_stream *stream = calloc(1, sizeof(struct signal_file_stream));
+    RETURN_NULL_IF(NULL == stream, NULL);
+    stream->sf = sf;
+    stream->depth = depth;
+    stream->slot = calloc(depth, sizeof(struct signal_file_slot));
+    stream->batch = make_io_batch(sf->fd, depth, use_uring);
+    if (NULL == stream->slot || NULL == stream->batch) {
+        return free_signal_file_stream(stream);
+    }
+    return stream;
+}
+
+/**  Free stream
+ *
+ *   @returns NULL
+ **/
+struct signal_file_stream *free_signal_file_stream(struct signal_file_stream *stream) {
+    if (NULL == stream) {
+        return NULL;
+    }
+    //  Reads still in flight complete before their buffers are freed
+    stream->batch = free_io_batch(stream->batch);
+    if (NULL != stream->slot) {
+        for (size_t i = 0; i < stream->depth; i++) {
+            free(stream->slot[i].buffer);
+        }
+    }
+    free(stream->slot);
+    free(stream);
+    return NULL;
+}
+
+/**  Submit reads of signal until depth reads are in flight
+ *
+ *   Slots are refilled once half of them are free, so each system call
+ *   submits many reads.  Reads that cannot be submitted are marked complete,
+ *   having failed, and are reported when returned.
+ **/
+static void submit_stream_reads(struct signal_file_stream *stream) {
+    const struct signal_file *sf = stream->sf;
+    if (stream->next_submit - stream->next_read > stream->depth / 2) {
+        return;
+    }
+    const uint64_t signal_offset = sf->signal - sf->map;
+    while (stream->next_submit < sf->nread
+           && stream->next_submit - stream->next_read < stream->depth) {
+        const size_t idx = stream->next_submit;
+        stream->next_submit += 1;
+        struct signal_file_slot *slot = stream->slot + idx % stream->depth;
+        *slot = (struct signal_file_slot) {slot->buffer, slot->capacity, true, -1};
+        if (!signal_entry_valid(sf, idx)) {
+            continue;
+        }
+        const struct signal_file_entry *entry = sf->index + idx;
+        if (entry->nbyte > slot->capacity) {
+            free(slot->buffer);
+            slot->buffer = malloc(entry->nbyte);
+            slot->capacity = (NULL != slot->buffer) ? entry->nbyte : 0;
+            if (NULL == slot->buffer) {
+                continue;
+            }
+        }
+        slot->complete = !io_batch_submit(stream->batch, slot->buffer, entry->nbyte,
+                                          signal_offset + entry->start, idx);
+    }
+    io_batch_flush(stream->batch);
+}
+
+/**  Next read of stream
+ *
+ *   Not thread safe.
+ *
+ *   @param stream Stream
+ *   @param idx [out] Index of read in signal file
+ *   @param dt [out] Raw signal of read, to be freed by caller.  The signal is
+ *   NULL if the read could not be read.
+ *
+ *   @returns true if a read was returned, false when all reads have been read
+ **/
+bool next_signal_file_stream(struct signal_file_stream *stream, size_t *idx, daq_table * dt) {
+    RETURN_NULL_IF(NULL == stream, false);
+    RETURN_NULL_IF(NULL == idx, false);
+    RETURN_NULL_IF(NULL == dt, false);
+    const struct signal_file *sf = stream->sf;
+    if (stream->next_read >= sf->nread) {
+        return false;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    submit_stream_reads(stream);
+    const size_t i = stream->next_read;
+    struct signal_file_slot *slot = stream->slot + i % stream->depth;
+    while (!slot->complete) {
+        uint64_t tag;
+        ssize_t nread;
+        if (!io_batch_wait(stream->batch, &tag, &nread)) {
+            //  Reads in flight cannot be relied on, so submit no more
+            stream->next_submit = sf->nread;
+            break;
+        }
+        stream->slot[tag % stream->depth].complete = true;
+        stream->slot[tag % stream->depth].nread = nread;
+    }
+
+    const struct signal_file_entry *entry = sf->index + i;
+    if (slot->complete && slot->nread >= 0 && (size_t)slot->nread == entry->nbyte) {
+        *dt = decode_signal_entry(entry, i, slot->buffer);
+        stream->nbyte += entry->nbyte;
+    } else {
+        warnx("Failed to read signal of read %zu.", i);
+        *dt = (daq_table) { 0, 0, 0, NAN, NAN, NAN, NULL };
+    }
+    *idx = i;
+    stream->next_read += 1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    stream->time += elapsed(&t0, &t1);
+    return true;
+}
+
+/**  Create new signal file to write reads to
+ *
+ *   @param filename Name of file, which is overwritten
+ *   @param encoding Encoding of signal of reads written
+ *
+ *   @returns Writer or NULL on failure
+ **/
+struct signal_file_writer *make_signal_file_writer(const char *filename,
+                                                   enum signal_encoding encoding) {
+    RETURN_NULL_IF(NULL == filename, NULL);
+    struct signal_file_writer *writer = calloc(1, sizeof(struct signal_file_writer));
+    RETURN_NULL_IF(NULL == writer, NULL);
+
+    const size_t len = strlen(filename);
+    writer->filename = calloc(len + 1, sizeof(char));
+    writer->fh = fopen(filename, "wb");
+    if (NULL == writer->filename || NULL == writer->fh) {
+        warnx("Failed to open %s for writing.", filename);
+        if (NULL != writer->fh) {
+            fclose(writer->fh);
+        }
+        free(writer->filename);
+        free(writer);
+        return NULL;
+    }
+    memcpy(writer->filename, filename, len);
+    writer->encoding = encoding;
+
+    //  Header is written when writer is closed
+    const struct signal_file_header header = { { 0 } };
+    if (1 != fwrite(&header, sizeof(header), 1, writer->fh)) {
+        warnx("Failed to write to %s.", filename);
+        (void)close_signal_file_writer(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+/**  Append read to signal file
+ *
+ *   @param writer Writer
+ *   @param read_id ID of read
+ *   @param dt Raw signal, as stored, of read.  Only the samples from start
+ *   to end are written.
+ *
+ *   @returns true on success
+ **/
+bool write_signal_file_read(struct signal_file_writer *writer, const char *read_id,
+                            const daq_table dt) {
+    RETURN_NULL_IF(NULL == writer, false);
+    RETURN_NULL_IF(NULL == read_id, false);
+    RETURN_NULL_IF(NULL == dt.raw, false);
+    RETURN_NULL_IF(dt.end < dt.start || dt.end > dt.n, false);
+
+    if (writer->nread == writer->index_capacity) {
+        const size_t capacity = (0 == writer->index_capacity) ? 1024 : 2 * writer->index_capacity;
+        struct signal_file_entry *index =
+            realloc(writer->index, capacity * sizeof(struct signal_file_entry));
+        RETURN_NULL_IF(NULL == index, false);
+        writer->index = index;
+        writer->index_capacity = capacity;
+    }
+    const size_t len = strlen(read_id);
+    if (writer->names_size + len + 1 > writer->names_capacity) {
+        size_t capacity = (0 == writer->names_capacity) ? 65536 : writer->names_capacity;
+        while (writer->names_size + len + 1 > capacity) {
+            capacity *= 2;
+        }
+        char *names = realloc(writer->names, capacity);
+        RETURN_NULL_IF(NULL == names, false);
+        writer->names = names;
+        writer->names_capacity = capacity;
+    }
+
+    const size_t nsample = dt.end - dt.start;
+    const void *signal = dt.raw + dt.start;
+    size_t nbyte = nsample * sizeof(int16_t);
+    if (SIGNAL_ENCODING_DELTA_VARINT == writer->encoding) {
+        const size_t bound = delta_varint_bound(nsample);
+        if (bound > writer->buffer_size) {
+            uint8_t *buffer = realloc(writer->buffer, bound);
+            RETURN_NULL_IF(NULL == buffer, false);
+            writer->buffer = buffer;
+            writer->buffer_size = bound;
+        }
+        nbyte = encode_delta_varint(dt.raw + dt.start, nsample, writer->buffer);
+        signal = writer->buffer;
+    }
+    if (nbyte != fwrite(signal, 1, nbyte, writer->fh)) {
+        warnx("Failed to write signal of %s to %s.", read_id, writer->filename);
+        return false;
+    }
+
+    writer->index[writer->nread] = (struct signal_file_entry) {
+        .name = writer->names_size,
+        .start = writer->signal_size,
+        .nbyte = nbyte,
+        .nsample = nsample,
+        .offset = dt.offset,
+        .range = dt.range,
+        .digitisation = dt.digitisation,
+        .encoding = writer->encoding
+    };
+    memcpy(writer->names + writer->names_size, read_id, len + 1);
+    writer->names_size += len + 1;
+    writer->signal_size += nbyte;
+    writer->nread += 1;
+
+    return true;
+}
+
+struct named_entry {
+    const char *name;
+    struct signal_file_entry entry;
+};
+
+//  Order by read ID then, so the first copy written of a read is kept, by position of signal
+static int compare_named_entry(const void *a, const void *b) {
+    const struct named_entry *ea = a;
+    const struct named_entry *eb = b;
+    const int cmp = strcmp(ea->name, eb->name);
+    if (0 != cmp) {
+        return cmp;
+    }
+    return (ea->entry.start > eb->entry.start) - (ea->entry.start < eb->entry.start);
+}
+
+/**  Sort index by read ID, dropping reads whose ID has already been seen
+ *
+ *   @returns true on success
+ **/
+static bool sort_signal_file_index(struct signal_file_writer *writer) {
+    if (0 == writer->nread) {
+        return true;
+    }
+    struct named_entry *sorted = calloc(writer->nread, sizeof(struct named_entry));
+    RETURN_NULL_IF(NULL == sorted, false);
+    for (size_t i = 0; i < writer->nread; i++) {
+        sorted[i] = (struct named_entry) { writer->names + writer->index[i].name, writer->index[i] };
+    }
+    qsort(sorted, writer->nread, sizeof(struct named_entry), compare_named_entry);
+
+    size_t nread = 0;
+    for (size_t i = 0; i < writer->nread; i++) {
+        if (nread > 0 && 0 == strcmp(sorted[i].name, sorted[i - 1].name)) {
+            warnx("Read %s seen more than once, keeping first copy found.", sorted[i].name);
+            continue;
+        }
+        writer->index[nread] = sorted[i].entry;
+        nread += 1;
+    }
+    writer->nread = nread;
+    free(sorted);
+    return true;
+}
+
+/**  Finish writing signal file and free writer
+ *
+ *   The read IDs and sorted index are written after the signal, then the
+ *   header.  On failure, the incomplete file is removed.
+ *
+ *   @param writer Writer
+ *
+ *   @returns true on success
+ **/
+bool close_signal_file_writer(struct signal_file_writer *writer) {
+    RETURN_NULL_IF(NULL == writer, false);
+
+    bool ok = sort_signal_file_index(writer);
+
+    const uint64_t signal_offset = sizeof(struct signal_file_header);
+    const uint64_t names_offset = signal_offset + writer->signal_size;
+    //  Index is aligned to 8 bytes
+    const size_t npad = (8 - (names_offset + writer->names_size) % 8) % 8;
+    const char pad[8] = { 0 };
+    const struct signal_file_header header = {
+        .magic = SIGNAL_FILE_MAGIC,
+        .version = SIGNAL_FILE_VERSION,
+        .byte_order = SIGNAL_FILE_BYTE_ORDER,
+        .nread = writer->nread,
+        .signal_size = writer->signal_size,
+        .signal_offset = signal_offset,
+        .names_offset = names_offset,
+        .names_size = writer->names_size,
+        .index_offset = names_offset + writer->names_size + npad
+    };
+
+    ok = ok && writer->names_size == fwrite(writer->names, 1, writer->names_size, writer->fh);
+    ok = ok && npad == fwrite(pad, 1, npad, writer->fh);
+    ok = ok && writer->nread == fwrite(writer->index, sizeof(struct signal_file_entry),
+                                       writer->nread, writer->fh);
+    ok = ok && 0 == fseek(writer->fh, 0, SEEK_SET);
+    ok = ok && 1 == fwrite(&header, sizeof(header), 1, writer->fh);
+    ok = (0 == fclose(writer->fh)) && ok;
+    if (!ok) {
+        warnx("Failed to write signal file %s.", writer->filename);
+        unlink(writer->filename);
+    }
+
+    free(writer->buffer);
+    free(writer->names);
+    free(writer->index);
+    free(writer->filename);
+    free(writer);
+    return ok;
+}
@@ -0,0 +1,133 @@
+#pragma once
+#ifndef SIGNAL_FILE_H
+#    define SIGNAL_FILE_H
+
+#    include <stdbool.h>
+#    include <stdint.h>
+#    include <stdio.h>
+#    include <sys/types.h>
+#    include "io_batch.h"
+#    include "scrappie_structures.h"
+#    include "signal_codec.h"
+
+/*  Scrappie signal file: the raw signal of many reads in one file that is
+ *  read by mapping it into memory, without HDF5.
+ *
+ *  Layout, in the byte order of the machine that wrote the file, which is
+ *  checked when the file is opened:
+ *    header               struct signal_file_header
+ *    signal               DAQ values of every read, one after another, as
+ *                         int16 or encoded by the delta-varint codec
+ *    read IDs             NUL terminated strings
+ *    index                struct signal_file_entry for each read, sorted by
+ *                         read ID so reads can be found by binary search
+ */
+#    define SIGNAL_FILE_MAGIC "SCRPSIG"
+#    define SIGNAL_FILE_VERSION 2
+#    define SIGNAL_FILE_BYTE_ORDER 0x01020304
+
+struct signal_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t nread;
+    //  Offsets in bytes from start of file, and sizes of signal and read IDs
+    uint64_t signal_size;
+    uint64_t signal_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+    uint64_t index_offset;
+};
+
+struct signal_file_entry {
+    //  Offset of read ID in read IDs, offset and size in bytes of signal of
+    // read in signal and number of samples
+    uint64_t name;
+    uint64_t start;
+    uint64_t nbyte;
+    uint64_t nsample;
+    //  Scaling of DAQ values to pA
+    float offset;
+    float range;
+    float digitisation;
+    //  Encoding of signal, an enum signal_encoding
+    uint32_t encoding;
+};
+
+struct signal_file {
+    //  Descriptor of the file, kept open for reading by a stream
+    int fd;
+    const unsigned char *map;
+    size_t size;
+    size_t nread;
+    const struct signal_file_entry *index;
+    const char *names;
+    const uint8_t *signal;
+    size_t signal_size;
+};
+
+bool is_signal_file(const char *filename);
+struct signal_file *open_signal_file(const char *filename);
+struct signal_file *free_signal_file(struct signal_file *sf);
+const char *signal_file_read_id(const struct signal_file *sf, size_t idx);
+ssize_t signal_file_read_index(const struct signal_file *sf, const char *read_id);
+daq_table read_daq_from_signal_file(const struct signal_file *sf, size_t idx);
+
+/*  Stream of the reads of a signal file, in the order of the index.  Rather
+ *  than faulting in the pages of the mapped file as each read is decoded, the
+ *  signal of the next depth reads is kept in flight by a batch of reads, so
+ *  the device sees a deep queue of requests and few system calls are made.
+ */
+struct signal_file_slot {
+    uint8_t *buffer;
+    size_t capacity;
+    bool complete;
+    //  Bytes read, or negative on failure
+    ssize_t nread;
+};
+
+struct signal_file_stream {
+    const struct signal_file *sf;
+    struct io_batch *batch;
+    size_t depth;
+    //  Next read to submit and next read to return.  Read idx is held in
+    // slot idx % depth.
+    size_t next_submit;
+    size_t next_read;
+    struct signal_file_slot *slot;
+    //  Bytes of signal read and seconds spent reading and decoding them
+    size_t nbyte;
+    double time;
+};
+
+struct signal_file_stream *make_signal_file_stream(const struct signal_file *sf, size_t depth,
+                                                   bool use_uring);
+struct signal_file_stream *free_signal_file_stream(struct signal_file_stream *stream);
+bool next_signal_file_stream(struct signal_file_stream *stream, size_t *idx, daq_table * dt);
+
+/*  Writer appending reads to a new signal file.  Signal is written as reads
+ *  are added; the read IDs and index are written when the writer is closed.
+ */
+struct signal_file_writer {
+    FILE *fh;
+    char *filename;
+    enum signal_encoding encoding;
+    size_t nread;
+    size_t signal_size;
+    //  Buffer for encoded signal
+    uint8_t *buffer;
+    size_t buffer_size;
+    struct signal_file_entry *index;
+    size_t index_capacity;
+    char *names;
+    size_t names_size;
+    size_t names_capacity;
+};
+
+struct signal_file_writer *make_signal_file_writer(const char *filename,
+                                                   enum signal_encoding encoding);
+bool write_signal_file_read(struct signal_file_writer *writer, const char *read_id,
+                            const daq_table dt);
+bool close_signal_file_writer(struct signal_file_writer *writer);
+
+#endif                          /* SIGNAL_FILE_H */
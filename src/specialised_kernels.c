@@ -0,0 +1,48 @@
+#include "packed_kernels.h"
+#include "specialised_kernels.h"
+
+struct pgemm_specialisation {
+    size_t nr, nc;
+    pgemm_kernel kernel;
+};
+
+struct gru_step_specialisation {
+    size_t size;
+    gru_step_kernel kernel;
+};
+
+#include "models/specialised_kernels.h"
+
+
+/**  Find kernel specialised to shape of packed matrix
+ *
+ *   @param nr Number of rows of matrix
+ *   @param nc Number of columns of matrix
+ *
+ *   @returns Kernel or NULL if there is no kernel for the shape
+ **/
+pgemm_kernel get_pgemm_kernel(size_t nr, size_t nc){
+    const size_t n = sizeof(pgemm_specialisations) / sizeof(pgemm_specialisations[0]);
+    for(size_t i=0 ; i < n ; i++){
+        if(nr == pgemm_specialisations[i].nr && nc == pgemm_specialisations[i].nc){
+            return pgemm_specialisations[i].kernel;
+        }
+    }
+    return NULL;
+}
+
+/**  Find GRU step specialised to size of layer
+ *
+ *   @param size Number of units in layer
+ *
+ *   @returns Kernel or NULL if there is no kernel for the size
+ **/
+gru_step_kernel get_gru_step_kernel(size_t size){
+    const size_t n = sizeof(gru_step_specialisations) / sizeof(gru_step_specialisations[0]);
+    for(size_t i=0 ; i < n ; i++){
+        if(size == gru_step_specialisations[i].size){
+            return gru_step_specialisations[i].kernel;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#ifndef SPECIALISED_KERNELS_H
+#    define SPECIALISED_KERNELS_H
+
+#    include <stddef.h>
+#    include "precision.h"
+
+/*  Kernels specialised to the shapes of the weights of the shipped models,
+ *  generated by misc/specialise_kernels.py into
+ *  src/models/specialised_kernels.h.  Lookups return NULL for shapes
+ *  without a specialised kernel, for which the generic kernels are used.
+ */
+
+pgemm_kernel get_pgemm_kernel(size_t nr, size_t nc);
+gru_step_kernel get_gru_step_kernel(size_t size);
+
+#endif                          /* SPECIALISED_KERNELS_H */
@@ -0,0 +1,351 @@
+#define _POSIX_C_SOURCE 200809L
+#include <err.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scrappie_stdlib.h"
+#include "tar_reader.h"
+
+//  The archive is read sequentially, through a large buffer
+#define TAR_BUFFER_SIZE (1 << 20)
+
+//  Offsets and sizes of the fields of a header block used
+#define TAR_NAME 0
+#define TAR_NAME_SIZE 100
+#define TAR_SIZE 124
+#define TAR_SIZE_SIZE 12
+#define TAR_CHKSUM 148
+#define TAR_CHKSUM_SIZE 8
+#define TAR_TYPEFLAG 156
+#define TAR_MAGIC 257
+#define TAR_PREFIX 345
+#define TAR_PREFIX_SIZE 155
+
+//  Copy of string of at most len characters
+static char *copy_field(const char *field, size_t len) {
+    const size_t n = strnlen(field, len);
+    char *str = calloc(n + 1, sizeof(char));
+    RETURN_NULL_IF(NULL == str, NULL);
+    memcpy(str, field, n);
+    return str;
+}
+
+/**  Whether file is named as a tar archive
+ *
+ *   Archives are recognised by name, so that finding out costs no read of
+ *   the many fast5 files that are not archives.
+ *
+ *   @param filename Name of file
+ *
+ *   @returns true if the name ends with .tar
+ **/
+bool is_tar_filename(const char *filename) {
+    RETURN_NULL_IF(NULL == filename, false);
+    const size_t len = strlen(filename);
+    return len > 4 && 0 == strcmp(filename + len - 4, ".tar");
+}
+
+/**  Open tar archive for reading
+ *
+ *   @param filename Name of archive
+ *
+ *   @returns Reader or NULL on failure
+ **/
+struct tar_reader *open_tar_reader(const char *filename) {
+    RETURN_NULL_IF(NULL == filename, NULL);
+    struct tar_reader *tar = calloc(1, sizeof(struct tar_reader));
+    RETURN_NULL_IF(NULL == tar, NULL);
+    const size_t len = strlen(filename);
+    tar->filename = copy_field(filename, len);
+    tar->fh = fopen(filename, "rb");
+    if (NULL == tar->filename || NULL == tar->fh) {
+        warnx("Failed to open tar archive %s for reading.", filename);
+        return free_tar_reader(tar);
+    }
+    setvbuf(tar->fh, NULL, _IOFBF, TAR_BUFFER_SIZE);
+    (void)posix_fadvise(fileno(tar->fh), 0, 0, POSIX_FADV_SEQUENTIAL);
+    return tar;
+}
+
+/**  Close tar archive
+ *
+ *   @returns NULL
+ **/
+struct tar_reader *free_tar_reader(struct tar_reader *tar) {
+    if (NULL == tar) {
+        return NULL;
+    }
+    if (NULL != tar->fh) {
+        fclose(tar->fh);
+    }
+    free(tar->buffer);
+    free(tar->next_name);
+    free(tar->filename);
+    free(tar);
+    return NULL;
+}
+
+/**  Parse numeric field of header
+ *
+ *   Fields are octal, padded by spaces or NULs, or base-256 if the high bit
+ *   of the first byte is set, as GNU tar writes sizes too large for octal.
+ *
+ *   @returns true on success
+ **/
+static bool parse_number(const uint8_t * field, size_t len, uint64_t * val) {
+    uint64_t x = 0;
+    if (field[0] & 0x80) {
+        for (size_t i = 1; i < len; i++) {
+            if (x >> 56) {
+                return false;
+            }
+            x = (x << 8) | field[i];
+        }
+        *val = x;
+        return true;
+    }
+
+    size_t i = 0;
+    while (i < len && (' ' == field[i] || '\0' == field[i])) {
+        i++;
+    }
+    for (; i < len && field[i] >= '0' && field[i] <= '7'; i++) {
+        x = (x << 3) | (field[i] - '0');
+    }
+    for (; i < len; i++) {
+        if (' ' != field[i] && '\0' != field[i]) {
+            return false;
+        }
+    }
+    *val = x;
+    return true;
+}
+
+//  Whether checksum of header is valid.  Some old archivers summed signed
+// bytes, so either sum is accepted.
+static bool header_checksum_valid(const uint8_t * block) {
+    uint64_t chksum;
+    RETURN_NULL_IF(!parse_number(block + TAR_CHKSUM, TAR_CHKSUM_SIZE, &chksum), false);
+    uint64_t unsigned_sum = 0;
+    int64_t signed_sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; i++) {
+        const bool in_chksum = (i >= TAR_CHKSUM && i < TAR_CHKSUM + TAR_CHKSUM_SIZE);
+        unsigned_sum += in_chksum ? ' ' : block[i];
+        signed_sum += in_chksum ? ' ' : (int8_t) block[i];
+    }
+    return chksum == unsigned_sum || (int64_t) chksum == signed_sum;
+}
+
+static bool is_zero_block(const uint8_t * block) {
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; i++) {
+        if (0 != block[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//  Name of member from header, with the prefix of a POSIX ustar header
+static char *header_name(const uint8_t * block) {
+    const char *name = (const char *)block + TAR_NAME;
+    const char *prefix = (const char *)block + TAR_PREFIX;
+    const bool ustar = (0 == memcmp(block + TAR_MAGIC, "ustar\0", 6));
+    const size_t prefix_len = ustar ? strnlen(prefix, TAR_PREFIX_SIZE) : 0;
+    if (0 == prefix_len) {
+        return copy_field(name, TAR_NAME_SIZE);
+    }
+    const size_t name_len = strnlen(name, TAR_NAME_SIZE);
+    char *str = calloc(prefix_len + name_len + 2, sizeof(char));
+    RETURN_NULL_IF(NULL == str, NULL);
+    memcpy(str, prefix, prefix_len);
+    str[prefix_len] = '/';
+    memcpy(str + prefix_len + 1, name, name_len);
+    return str;
+}
+
+static size_t padding(uint64_t size) {
+    return (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+}
+
+//  Skip bytes of archive, seeking if possible
+static bool skip_bytes(FILE * fh, uint64_t nbyte) {
+    if (nbyte <= (uint64_t) INT64_MAX && 0 == fseeko(fh, (off_t) nbyte, SEEK_CUR)) {
+        return true;
+    }
+    uint8_t block[TAR_BLOCK_SIZE];
+    for (; nbyte > 0;) {
+        const size_t n = (nbyte < TAR_BLOCK_SIZE) ? nbyte : TAR_BLOCK_SIZE;
+        RETURN_NULL_IF(n != fread(block, 1, n, fh), false);
+        nbyte -= n;
+    }
+    return true;
+}
+
+/**  Read data of member and the padding after it
+ *
+ *   @param fh Archive
+ *   @param size Size of data
+ *   @param buffer [in/out] Buffer, grown as needed to hold the data
+ *   @param capacity [in/out] Size of buffer
+ *
+ *   @returns true on success, with data NUL terminated
+ **/
+static bool read_member_data(FILE * fh, uint64_t size, uint8_t ** buffer, size_t * capacity) {
+    RETURN_NULL_IF(size >= SIZE_MAX, false);
+    if (size + 1 > *capacity) {
+        uint8_t *new_buffer = realloc(*buffer, size + 1);
+        RETURN_NULL_IF(NULL == new_buffer, false);
+        *buffer = new_buffer;
+        *capacity = size + 1;
+    }
+    if (size != fread(*buffer, 1, size, fh) || !skip_bytes(fh, padding(size))) {
+        return false;
+    }
+    (*buffer)[size] = '\0';
+    return true;
+}
+
+/**  Take path and size of next member from pax extended header
+ *
+ *   Records are "length key=value\n", with the length of the whole record.
+ *
+ *   @returns true on success
+ **/
+static bool parse_pax_header(struct tar_reader *tar, const char *data, size_t size) {
+    const char *end = data + size;
+    for (const char *rec = data; rec < end && '\0' != *rec;) {
+        char *sp;
+        const unsigned long len = strtoul(rec, &sp, 10);
+        //  Record holds at least its length, a space and the closing newline
+        if (sp >= end || ' ' != *sp || len < (size_t)(sp - rec) + 2 || len > (size_t)(end - rec)
+            || '\n' != rec[len - 1]) {
+            return false;
+        }
+        const char *key = sp + 1;
+        const char *eq = memchr(key, '=', rec + len - key);
+        if (NULL == eq) {
+            return false;
+        }
+        const char *value = eq + 1;
+        const size_t value_len = rec + len - 1 - value;
+        if (eq - key == 4 && 0 == memcmp(key, "path", 4)) {
+            free(tar->next_name);
+            tar->next_name = copy_field(value, value_len);
+        } else if (eq - key == 4 && 0 == memcmp(key, "size", 4)) {
+            char *size_end;
+            tar->next_size = strtoull(value, &size_end, 10);
+            tar->have_next_size = (size_end == value + value_len);
+        }
+        rec += len;
+    }
+    return true;
+}
+
+/**  Read next regular file in archive
+ *
+ *   Directories, links and other members, and regular files whose names do
+ *   not end with suffix, are skipped without reading their data.  Data is
+ *   read into a buffer kept between members, rather than memory allocated
+ *   afresh for each.
+ *
+ *   @param tar Reader
+ *   @param suffix Suffix of names of members to return, or NULL for all
+ *   @param member [out] Name and data of member.  The name is to be freed by
+ *   the caller; the data is held by the reader, so stays valid only until
+ *   the next member is read or the reader freed.
+ *
+ *   @returns true if a member was returned, false at the end of the archive
+ *   or on failure
+ **/
+bool next_tar_member(struct tar_reader *tar, const char *suffix, struct tar_member *member) {
+    RETURN_NULL_IF(NULL == tar, false);
+    RETURN_NULL_IF(NULL == member, false);
+    const size_t suffix_len = (NULL != suffix) ? strlen(suffix) : 0;
+
+    uint8_t block[TAR_BLOCK_SIZE];
+    while (true) {
+        if (1 != fread(block, TAR_BLOCK_SIZE, 1, tar->fh)) {
+            //  Some archivers omit the blocks of zeros that end an archive
+            if (ferror(tar->fh)) {
+                warnx("Failed to read tar archive %s.", tar->filename);
+            }
+            return false;
+        }
+        if (is_zero_block(block)) {
+            return false;
+        }
+        uint64_t size;
+        if (!header_checksum_valid(block) || !parse_number(block + TAR_SIZE, TAR_SIZE_SIZE, &size)) {
+            warnx("Invalid header in tar archive %s.", tar->filename);
+            return false;
+        }
+
+        const char type = block[TAR_TYPEFLAG];
+        if ('L' == type || 'x' == type) {
+            //  Long name, from GNU tar, or pax extended header for next member
+            if (!read_member_data(tar->fh, size, &tar->buffer, &tar->capacity)) {
+                warnx("Failed to read extended header in tar archive %s.", tar->filename);
+                return false;
+            }
+            const char *data = (const char *)tar->buffer;
+            bool ok = true;
+            if ('L' == type) {
+                free(tar->next_name);
+                tar->next_name = copy_field(data, size);
+            } else {
+                ok = parse_pax_header(tar, data, size);
+            }
+            if (!ok) {
+                warnx("Invalid extended header in tar archive %s.", tar->filename);
+                return false;
+            }
+            continue;
+        }
+
+        if (tar->have_next_size) {
+            size = tar->next_size;
+            tar->have_next_size = false;
+        }
+        char *name = (NULL != tar->next_name) ? tar->next_name : header_name(block);
+        tar->next_name = NULL;
+        const size_t name_len = (NULL != name) ? strlen(name) : 0;
+        //  Contiguous files, type 7, are regular files
+        const bool regular = ('0' == type || '\0' == type || '7' == type);
+        const bool wanted = regular && NULL != name && name_len >= suffix_len
+            && (0 == suffix_len || 0 == strcmp(name + name_len - suffix_len, suffix));
+        if (!wanted) {
+            free(name);
+            if (!skip_bytes(tar->fh, size + padding(size))) {
+                warnx("Failed to read tar archive %s.", tar->filename);
+                return false;
+            }
+            continue;
+        }
+
+        if (!read_member_data(tar->fh, size, &tar->buffer, &tar->capacity)) {
+            warnx("Failed to read %s from tar archive %s.", name, tar->filename);
+            free(name);
+            return false;
+        }
+        *member = (struct tar_member) {name, tar->buffer, size};
+        return true;
+    }
+}
+
+/**  Take buffer holding data of the member last read
+ *
+ *   Lets the data outlive the reader reading further members, for which a
+ *   new buffer is then allocated.
+ *
+ *   @param tar Reader
+ *
+ *   @returns Buffer, to be freed by caller, or NULL if there is none
+ **/
+uint8_t *take_tar_buffer(struct tar_reader *tar) {
+    RETURN_NULL_IF(NULL == tar, NULL);
+    uint8_t *buffer = tar->buffer;
+    tar->buffer = NULL;
+    tar->capacity = 0;
+    return buffer;
+}
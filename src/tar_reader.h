@@ -0,0 +1,41 @@
+#pragma once
+#ifndef TAR_READER_H
+#    define TAR_READER_H
+
+#    include <stdbool.h>
+#    include <stddef.h>
+#    include <stdint.h>
+#    include <stdio.h>
+
+/*  Sequential reader of the regular files in a tar archive, so files can be
+ *  read out of an archive without extracting it.  POSIX ustar archives are
+ *  read, with the GNU extension for long names and pax extended headers
+ *  giving the path and size of a member.
+ */
+#    define TAR_BLOCK_SIZE 512
+
+struct tar_reader {
+    FILE *fh;
+    char *filename;
+    //  Path and size given by extended headers for the next member, if any
+    char *next_name;
+    bool have_next_size;
+    uint64_t next_size;
+    //  Data of current member, kept to be reused for the next
+    uint8_t *buffer;
+    size_t capacity;
+};
+
+struct tar_member {
+    char *name;
+    uint8_t *data;
+    size_t size;
+};
+
+bool is_tar_filename(const char *filename);
+struct tar_reader *open_tar_reader(const char *filename);
+struct tar_reader *free_tar_reader(struct tar_reader *tar);
+bool next_tar_member(struct tar_reader *tar, const char *suffix, struct tar_member *member);
+uint8_t *take_tar_buffer(struct tar_reader *tar);
+
+#endif                          /* TAR_READER_H */
@@ -8,9 +8,19 @@ int register_test_convolution(void);
 int register_test_decoding(void);
 int register_test_elu(void);
 int register_test_eventdetection(void);
+int register_test_fast5(void);
+int register_test_io_batch(void);
 int register_test_matrix(void);
+int register_test_model_file(void);
+int register_test_network_graph(void);
+int register_test_precision(void);
+int register_test_recurrent(void);
 int register_test_signal(void);
+int register_test_signal_codec(void);
+int register_test_signal_file(void);
+int register_test_softmax(void);
 int register_test_squiggle(void);
+int register_test_tar(void);
 int register_test_util(void);
 
 int (*test_suites[]) (void) = {
@@ -20,9 +30,19 @@ int (*test_suites[]) (void) = {
     register_test_decoding,
     register_test_elu,
     register_test_eventdetection,
+    register_test_fast5,
+    register_test_io_batch,
     register_test_matrix,
+    register_test_model_file,
+    register_test_network_graph,
+    register_test_precision,
+    register_test_recurrent,
     register_test_signal,
+    register_test_signal_codec,
+    register_test_signal_file,
+    register_test_softmax,
     register_test_squiggle,
+    register_test_tar,
     register_test_util,
     NULL // Last element of array should be NULL
 };
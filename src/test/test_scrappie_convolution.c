@@ -4,6 +4,7 @@
 #include <stdlib.h>
 
 #include <layers.h>
+#include "scrappie_util.h"
 #include "test_common.h"
 
 static float test_conv_tol = 1e-5;
@@ -407,6 +408,40 @@ void test_scrappie_convolution_f1s1(void) {
                                     filter_base);
 }
 
+/**  Window of features followed by affine map is a unit stride convolution
+ *
+ *   The events network applies its input weights to a window of three
+ *   events.  Check that the convolution, which forms the window implicitly,
+ *   agrees with explicitly forming the window.
+ **/
+void test_window_affine_convolution(void) {
+    const int winlen = 3;
+    const int nfeature = 4;
+    const int nout = 24;
+    scrappie_matrix X = random_scrappie_matrix(nfeature, 101, -1.0f, 1.0f);
+    scrappie_matrix W = random_scrappie_matrix(winlen * nfeature, nout, -1.0f, 1.0f);
+    scrappie_matrix b = random_scrappie_matrix(nout, 1, -1.0f, 1.0f);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(X);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+
+    scrappie_matrix Xwin = window(X, winlen, 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(Xwin);
+    scrappie_matrix expected = affine_map(Xwin, W, b, NULL);
+    scrappie_matrix res = convolution(X, W, b, 1, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(expected);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(res);
+
+    CU_ASSERT_TRUE(equality_scrappie_matrix(expected, res, test_conv_tol));
+
+    res = free_scrappie_matrix(res);
+    expected = free_scrappie_matrix(expected);
+    Xwin = free_scrappie_matrix(Xwin);
+    b = free_scrappie_matrix(b);
+    W = free_scrappie_matrix(W);
+    X = free_scrappie_matrix(X);
+}
+
 
 static const test_with_description tests[] = {
     {"Simple stride 1", test_stride1_convolution},
@@ -428,6 +463,7 @@ static const test_with_description tests[] = {
     {"Simple convolution, unit filter length 5", test_convolution_ones_f5},
     {"Simple convolution, antisymmetric filter length 3", test_convolution_antisymmetric_f3},
     {"Scrappie convolution, antisymmetric filter length 3", test_scrappie_convolution_f1s1},
+    {"Window and affine map equivalent to convolution", test_window_affine_convolution},
     {0}};
 
 /**   Register tests with CUnit
@@ -0,0 +1,613 @@
+#define BANANA 1
+#include <CUnit/CUnit.h>
+#include <hdf5.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fast5_interface.h>
+#include <read_pipeline.h>
+#include <scrappie_stdlib.h>
+#include "test_common.h"
+
+static const char * multiread_file_name = "test_multiread.fast5";
+static const char * gzip_file_name = "test_multiread_gzip.fast5";
+static const char * shuffle_file_name = "test_multiread_shuffle.fast5";
+static const char * checksum_file_name = "test_multiread_checksum.fast5";
+static const char * dump_file_name = "test_raw_dump.hdf5";
+static const char * path_list_name = "test_path_list.txt";
+static const char * single_read_file_name = "../../reads/MINICOL228_20161012_FNFAB42578_MN17976_mux_scan_HG_52221_ch271_read66_strand.fast5";
+
+#define NREAD 3
+static const char * read_ids[NREAD] = {"0a1b2c", "3d4e5f", "6a7b8c"};
+static const size_t read_nsample[NREAD] = {100, 257, 31};
+static const float digitisation = 8192.0f;
+static const float range = 1402.882f;
+static const float offset = 4.0f;
+
+
+//  Raw signal of sample i of read r
+static int16_t test_signal(size_t r, size_t i) {
+    return (int16_t)(100 * r + (i * 37) % 1000);
+}
+
+
+/**  Write float attributes of a group
+ *
+ *   @returns true on success
+ **/
+static bool write_float_attribute(hid_t group, const char * attribute, float val) {
+    hid_t space = H5Screate(H5S_SCALAR);
+    RETURN_NULL_IF(space < 0, false);
+    hid_t attr = H5Acreate(group, attribute, H5T_IEEE_F64LE, space, H5P_DEFAULT, H5P_DEFAULT);
+    herr_t status = -1;
+    if (attr >= 0) {
+        status = H5Awrite(attr, H5T_NATIVE_FLOAT, &val);
+        H5Aclose(attr);
+    }
+    H5Sclose(space);
+    return status >= 0;
+}
+
+
+/**  Write a multi-read fast5 file
+ *
+ *   Each read has a group /read_<read_id> containing the raw signal, as
+ *   int16, in Raw/Signal and the scaling in channel_id.
+ *
+ *   @param fn Name of file
+ *   @param dcpl Properties for creating signal datasets, for chunking and
+ *   compression
+ *
+ *   @returns true on success
+ **/
+static bool write_multiread_file(const char * fn, hid_t dcpl) {
+    hid_t hdf5file = H5Fcreate(fn, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    RETURN_NULL_IF(hdf5file < 0, false);
+    bool ok = true;
+    for (size_t r = 0; r < NREAD; r++) {
+        char path[64];
+        snprintf(path, 64, "/read_%s", read_ids[r]);
+        hid_t group = H5Gcreate(hdf5file, path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        hid_t raw = H5Gcreate(group, "Raw", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        hid_t channel = H5Gcreate(group, "channel_id", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        ok = ok && group >= 0 && raw >= 0 && channel >= 0;
+
+        ok = ok && write_float_attribute(channel, "digitisation", digitisation);
+        ok = ok && write_float_attribute(channel, "offset", offset + r);
+        ok = ok && write_float_attribute(channel, "range", range);
+        ok = ok && write_float_attribute(channel, "sampling_rate", 4000.0f);
+
+        int16_t * signal = calloc(read_nsample[r], sizeof(int16_t));
+        for (size_t i = 0; i < read_nsample[r]; i++) {
+            signal[i] = test_signal(r, i);
+        }
+        const hsize_t dims = read_nsample[r];
+        hid_t space = H5Screate_simple(1, &dims, NULL);
+        hid_t dset = H5Dcreate(raw, "Signal", H5T_STD_I16LE, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+        ok = ok && dset >= 0 && H5Dwrite(dset, H5T_NATIVE_INT16, H5S_ALL, H5S_ALL, H5P_DEFAULT, signal) >= 0;
+        free(signal);
+
+        H5Dclose(dset);
+        H5Sclose(space);
+        H5Gclose(channel);
+        H5Gclose(raw);
+        H5Gclose(group);
+    }
+    return (H5Fclose(hdf5file) >= 0) && ok;
+}
+
+
+/**  Initialise test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int init_test_fast5(void) {
+    bool ok = write_multiread_file(multiread_file_name, H5P_DEFAULT);
+
+    //  Chunks smaller than reads, so reads end part way through a chunk
+    const hsize_t chunk = 16;
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    ok = ok && dcpl >= 0 && H5Pset_chunk(dcpl, 1, &chunk) >= 0 && H5Pset_deflate(dcpl, 6) >= 0;
+    ok = ok && write_multiread_file(gzip_file_name, dcpl);
+    H5Pclose(dcpl);
+
+    dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    ok = ok && dcpl >= 0 && H5Pset_chunk(dcpl, 1, &chunk) >= 0 && H5Pset_shuffle(dcpl) >= 0
+        && H5Pset_deflate(dcpl, 1) >= 0;
+    ok = ok && write_multiread_file(shuffle_file_name, dcpl);
+    H5Pclose(dcpl);
+
+    //  Checksum filter is not decompressed by scrappie, so read by HDF5
+    dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    ok = ok && dcpl >= 0 && H5Pset_chunk(dcpl, 1, &chunk) >= 0 && H5Pset_deflate(dcpl, 6) >= 0
+        && H5Pset_fletcher32(dcpl) >= 0;
+    ok = ok && write_multiread_file(checksum_file_name, dcpl);
+    H5Pclose(dcpl);
+
+    return ok ? 0 : 1;
+}
+
+/**  Clean up after test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int clean_test_fast5(void) {
+    int ret = unlink(multiread_file_name);
+    ret |= unlink(gzip_file_name);
+    ret |= unlink(shuffle_file_name);
+    ret |= unlink(checksum_file_name);
+    return ret;
+}
+
+
+//  Check raw table holds signal of read r of the multi-read file
+static bool check_read_signal(raw_table rt, size_t r, bool scale_to_pA) {
+    if (NULL == rt.raw || read_nsample[r] != rt.n || 0 != rt.start || rt.n != rt.end) {
+        return false;
+    }
+    for (size_t i = 0; i < rt.n; i++) {
+        float expected = test_signal(r, i);
+        if (scale_to_pA) {
+            expected = (expected + offset + r) * range / digitisation;
+        }
+        if (fabsf(expected - rt.raw[i]) > 1e-4f * fmaxf(1.0f, fabsf(expected))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+//  Check DAQ table holds signal, as stored, of read r of the multi-read file
+static bool check_read_daq(daq_table dt, size_t r) {
+    if (NULL == dt.raw || read_nsample[r] != dt.n || 0 != dt.start || dt.n != dt.end) {
+        return false;
+    }
+    if (offset + r != dt.offset || range != dt.range || digitisation != dt.digitisation) {
+        return false;
+    }
+    for (size_t i = 0; i < dt.n; i++) {
+        if (test_signal(r, i) != dt.raw[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void test_fast5_multiread_open(void) {
+    struct fast5_file * f5 = open_fast5_file(multiread_file_name);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(f5);
+    CU_ASSERT_TRUE(f5->multiread);
+    CU_ASSERT_EQUAL_FATAL(f5->nread, NREAD);
+    for (size_t r = 0; r < NREAD; r++) {
+        CU_ASSERT_STRING_EQUAL(f5->read_id[r], read_ids[r]);
+    }
+    f5 = free_fast5_file(f5);
+}
+
+
+void test_fast5_multiread_by_index(void) {
+    struct fast5_file * f5 = open_fast5_file(multiread_file_name);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(f5);
+    for (size_t r = 0; r < NREAD; r++) {
+        raw_table rt = read_raw_from_fast5(f5, r, false);
+        CU_ASSERT(check_read_signal(rt, r, false));
+        free(rt.raw);
+
+        rt = read_raw_from_fast5(f5, r, true);
+        CU_ASSERT(check_read_signal(rt, r, true));
+        free(rt.raw);
+    }
+    for (size_t r = 0; r < NREAD; r++) {
+        daq_table dt = read_daq_from_fast5(f5, r);
+        CU_ASSERT(check_read_daq(dt, r));
+        free(dt.raw);
+    }
+    raw_table rt = read_raw_from_fast5(f5, NREAD, true);
+    CU_ASSERT_PTR_NULL(rt.raw);
+    f5 = free_fast5_file(f5);
+}
+
+
+//  Reads of compressed files are the same as those of the uncompressed file
+static void compressed_helper(const char * fn) {
+    struct fast5_file * f5 = open_fast5_file(fn);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(f5);
+    CU_ASSERT_EQUAL_FATAL(f5->nread, NREAD);
+    for (size_t r = 0; r < NREAD; r++) {
+        daq_table dt = read_daq_from_fast5(f5, r);
+        CU_ASSERT(check_read_daq(dt, r));
+        free(dt.raw);
+    }
+    f5 = free_fast5_file(f5);
+
+    //  Read whole into memory
+    f5 = open_fast5_file_in_memory(fn, 1 << 30);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(f5);
+    CU_ASSERT_EQUAL_FATAL(f5->nread, NREAD);
+    for (size_t r = 0; r < NREAD; r++) {
+        daq_table dt = read_daq_from_fast5(f5, r);
+        CU_ASSERT(check_read_daq(dt, r));
+        free(dt.raw);
+    }
+    f5 = free_fast5_file(f5);
+}
+
+
+void test_fast5_gzip(void) {
+    compressed_helper(gzip_file_name);
+}
+
+
+void test_fast5_shuffle(void) {
+    compressed_helper(shuffle_file_name);
+}
+
+
+void test_fast5_checksum(void) {
+    compressed_helper(checksum_file_name);
+}
+
+
+void test_fast5_in_memory(void) {
+    compressed_helper(multiread_file_name);
+
+    //  Files larger than the limit are opened in place
+    struct fast5_file * f5 = open_fast5_file_in_memory(multiread_file_name, 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(f5);
+    CU_ASSERT_EQUAL(f5->nread, NREAD);
+    f5 = free_fast5_file(f5);
+
+    f5 = open_fast5_file_in_memory(single_read_file_name, 1 << 30);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(f5);
+    raw_table rt = read_raw_from_fast5(f5, 0, true);
+    raw_table rt_file = read_raw(single_read_file_name, true);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rt.raw);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rt_file.raw);
+    CU_ASSERT_EQUAL_FATAL(rt.n, rt_file.n);
+    CU_ASSERT_EQUAL(0, memcmp(rt.raw, rt_file.raw, rt.n * sizeof(float)));
+    free(rt_file.raw);
+    free(rt.raw);
+    f5 = free_fast5_file(f5);
+
+    CU_ASSERT_PTR_NULL(open_fast5_file_in_memory("no_such_file.fast5", 1 << 30));
+}
+
+
+void test_fast5_multiread_by_id(void) {
+    struct fast5_file * f5 = open_fast5_file(multiread_file_name);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(f5);
+    //  Reverse order of file
+    for (size_t r = NREAD; r > 0; r--) {
+        CU_ASSERT_EQUAL(fast5_read_index(f5, read_ids[r - 1]), r - 1);
+        raw_table rt = read_raw_by_id(f5, read_ids[r - 1], true);
+        CU_ASSERT(check_read_signal(rt, r - 1, true));
+        free(rt.raw);
+    }
+    CU_ASSERT_EQUAL(fast5_read_index(f5, "no_such_read"), -1);
+    raw_table rt = read_raw_by_id(f5, "no_such_read", true);
+    CU_ASSERT_PTR_NULL(rt.raw);
+    f5 = free_fast5_file(f5);
+}
+
+
+void test_fast5_single_read(void) {
+    struct fast5_file * f5 = open_fast5_file(single_read_file_name);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(f5);
+    CU_ASSERT_FALSE(f5->multiread);
+    CU_ASSERT_EQUAL_FATAL(f5->nread, 1);
+
+    raw_table rt = read_raw_from_fast5(f5, 0, true);
+    raw_table rt_file = read_raw(single_read_file_name, true);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rt.raw);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rt_file.raw);
+    CU_ASSERT_EQUAL_FATAL(rt.n, rt_file.n);
+    CU_ASSERT_EQUAL(0, memcmp(rt.raw, rt_file.raw, rt.n * sizeof(float)));
+    free(rt_file.raw);
+    free(rt.raw);
+    f5 = free_fast5_file(f5);
+}
+
+
+void test_fast5_raw_dump(void) {
+    struct fast5_file * f5 = open_fast5_file(multiread_file_name);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(f5);
+    hid_t hdf5file = H5Fcreate(dump_file_name, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    CU_ASSERT_FATAL(hdf5file >= 0);
+    for (size_t r = 0; r < NREAD; r++) {
+        daq_table dt = read_daq_from_fast5(f5, r);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(dt.raw);
+        //  Only the trimmed signal is written
+        dt.start = r;
+        dt.end = dt.n - 2 * r;
+        //  Alternate reads are compressed again, in chunks smaller than the signal
+        write_annotated_raw(hdf5file, read_ids[r], dt, 64, (r % 2) ? 6 : 0);
+        daq_table dt_dump = read_annotated_raw(hdf5file, read_ids[r]);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(dt_dump.raw);
+        CU_ASSERT_EQUAL(dt_dump.n, dt.end - dt.start);
+        CU_ASSERT_EQUAL(dt_dump.start, 0);
+        CU_ASSERT_EQUAL(dt_dump.end, dt_dump.n);
+        CU_ASSERT_EQUAL(dt_dump.offset, dt.offset);
+        CU_ASSERT_EQUAL(dt_dump.range, dt.range);
+        CU_ASSERT_EQUAL(dt_dump.digitisation, dt.digitisation);
+        CU_ASSERT_EQUAL(0, memcmp(dt_dump.raw, dt.raw + dt.start, dt_dump.n * sizeof(int16_t)));
+        free(dt_dump.raw);
+        free(dt.raw);
+    }
+    daq_table dt = read_annotated_raw(hdf5file, "no_such_read");
+    CU_ASSERT_PTR_NULL(dt.raw);
+    H5Fclose(hdf5file);
+    CU_ASSERT_EQUAL(0, unlink(dump_file_name));
+    f5 = free_fast5_file(f5);
+}
+
+
+void test_fast5_reader(void) {
+    //  Both files, with the multi-read file given twice and a missing file
+    char * paths[5] = {(char *)multiread_file_name, (char *)single_read_file_name,
+                       "no_such_file.fast5", (char *)multiread_file_name, NULL};
+    struct fast5_reader * reader = make_fast5_reader(paths);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reader);
+
+    struct fast5_read read;
+    for (size_t r = 0; r < NREAD; r++) {
+        CU_ASSERT_FATAL(next_fast5_read(reader, &read));
+        CU_ASSERT_STRING_EQUAL(read.name, read_ids[r]);
+        CU_ASSERT(check_read_daq(read.dt, r));
+        free(read.dt.raw);
+        free(read.name);
+    }
+
+    //  Single read files are named after the file
+    CU_ASSERT_FATAL(next_fast5_read(reader, &read));
+    CU_ASSERT_STRING_EQUAL(read.name, "MINICOL228_20161012_FNFAB42578_MN17976_mux_scan_HG_52221_ch271_read66_strand.fast5");
+    CU_ASSERT_PTR_NOT_NULL(read.dt.raw);
+    free(read.dt.raw);
+    free(read.name);
+
+    for (size_t r = 0; r < NREAD; r++) {
+        CU_ASSERT_FATAL(next_fast5_read(reader, &read));
+        CU_ASSERT_STRING_EQUAL(read.name, read_ids[r]);
+        free(read.dt.raw);
+        free(read.name);
+    }
+    CU_ASSERT_FALSE(next_fast5_read(reader, &read));
+    CU_ASSERT_FALSE(next_fast5_read(reader, &read));
+    reader = free_fast5_reader(reader);
+}
+
+
+void test_fast5_reader_walk(void) {
+    //  Fast5 files in nested directories, alongside other files and an empty directory
+    const char * dirs[4] = {"test_walk", "test_walk/a", "test_walk/a/b", "test_walk/empty"};
+    const char * files[2] = {"test_walk/top.fast5", "test_walk/a/b/deep.fast5"};
+    const char * other = "test_walk/a/notes.txt";
+    for (size_t i = 0; i < 4; i++) {
+        CU_ASSERT_FATAL(0 == mkdir(dirs[i], 0755));
+    }
+    for (size_t i = 0; i < 2; i++) {
+        CU_ASSERT_FATAL(write_multiread_file(files[i], H5P_DEFAULT));
+    }
+    FILE * fh = fopen(other, "w");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(fh);
+    fputs("Not a fast5 file\n", fh);
+    fclose(fh);
+
+    char * paths[2] = {"test_walk", NULL};
+    struct fast5_reader * reader = make_fast5_reader(paths);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reader);
+    size_t nseen[2] = {0, 0};
+    struct fast5_read read;
+    while (next_fast5_read(reader, &read)) {
+        bool known = false;
+        for (size_t i = 0; i < 2; i++) {
+            if (0 == strcmp(reader->filename, files[i])) {
+                known = true;
+                CU_ASSERT_STRING_EQUAL(read.name, read_ids[nseen[i]]);
+                CU_ASSERT(check_read_daq(read.dt, nseen[i]));
+                nseen[i] += 1;
+            }
+        }
+        CU_ASSERT(known);
+        free(read.dt.raw);
+        free(read.name);
+    }
+    CU_ASSERT_EQUAL(nseen[0], NREAD);
+    CU_ASSERT_EQUAL(nseen[1], NREAD);
+    CU_ASSERT_PTR_NULL(reader->dir);
+    reader = free_fast5_reader(reader);
+
+    CU_ASSERT(0 == unlink(other));
+    for (size_t i = 0; i < 2; i++) {
+        CU_ASSERT(0 == unlink(files[i]));
+    }
+    for (size_t i = 4; i > 0; i--) {
+        CU_ASSERT(0 == rmdir(dirs[i - 1]));
+    }
+}
+
+
+void test_fast5_reader_path_list(void) {
+    //  Blank lines and DOS line endings, with the last line unterminated
+    FILE * fh = fopen(path_list_name, "w");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(fh);
+    fprintf(fh, "\n%s\r\n\n%s", multiread_file_name, single_read_file_name);
+    fclose(fh);
+
+    //  Paths listed follow those given
+    char * paths[2] = {(char *)multiread_file_name, NULL};
+    struct fast5_reader * reader = make_fast5_reader(paths);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reader);
+    reader->path_list = path_list_name;
+    struct fast5_read read;
+    for (size_t i = 0; i < 2 * NREAD; i++) {
+        CU_ASSERT_FATAL(next_fast5_read(reader, &read));
+        CU_ASSERT_STRING_EQUAL(read.name, read_ids[i % NREAD]);
+        CU_ASSERT(check_read_daq(read.dt, i % NREAD));
+        free(read.dt.raw);
+        free(read.name);
+    }
+    CU_ASSERT_FATAL(next_fast5_read(reader, &read));
+    CU_ASSERT_STRING_EQUAL(read.name, "MINICOL228_20161012_FNFAB42578_MN17976_mux_scan_HG_52221_ch271_read66_strand.fast5");
+    free(read.dt.raw);
+    free(read.name);
+    CU_ASSERT_FALSE(next_fast5_read(reader, &read));
+    CU_ASSERT_FALSE(next_fast5_read(reader, &read));
+    reader = free_fast5_reader(reader);
+
+    //  Only listed paths, through a pipeline
+    char * no_paths[1] = {NULL};
+    struct read_pipeline * pipeline = make_read_pipeline(no_paths, path_list_name, 2, 2, 0, 0, NULL, 0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pipeline);
+    size_t nread = 0;
+    while (next_pipeline_read(pipeline, &read)) {
+        nread += 1;
+        free(read.dt.raw);
+        free(read.name);
+    }
+    CU_ASSERT_EQUAL(nread, NREAD + 1);
+    pipeline = free_read_pipeline(pipeline);
+
+    //  Missing list ends the paths with a warning
+    reader = make_fast5_reader(no_paths);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reader);
+    reader->path_list = "no_such_list.txt";
+    CU_ASSERT_FALSE(next_fast5_read(reader, &read));
+    reader = free_fast5_reader(reader);
+
+    CU_ASSERT(0 == unlink(path_list_name));
+}
+
+
+void test_read_pipeline(void) {
+    //  Multi-read file three times, so readers compete for reads and queue fills
+    char * paths[4] = {(char *)multiread_file_name, (char *)multiread_file_name,
+                       (char *)multiread_file_name, NULL};
+    struct read_pipeline * pipeline = make_read_pipeline(paths, NULL, 2, 1, 0, 0, NULL, 0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pipeline);
+
+    size_t nseen[NREAD] = {0};
+    struct fast5_read read;
+    while (next_pipeline_read(pipeline, &read)) {
+        bool known = false;
+        for (size_t r = 0; r < NREAD; r++) {
+            if (0 == strcmp(read.name, read_ids[r])) {
+                known = true;
+                nseen[r] += 1;
+                CU_ASSERT(check_read_daq(read.dt, r));
+            }
+        }
+        CU_ASSERT(known);
+        free(read.dt.raw);
+        free(read.name);
+    }
+    CU_ASSERT_FALSE(next_pipeline_read(pipeline, &read));
+    for (size_t r = 0; r < NREAD; r++) {
+        CU_ASSERT_EQUAL(nseen[r], 3);
+    }
+    CU_ASSERT_EQUAL(pipeline->nread, 3 * NREAD);
+    pipeline = free_read_pipeline(pipeline);
+}
+
+
+static void read_pipeline_compressed_helper(size_t max_image_size) {
+    //  Readers decompress at the same time
+    char * paths[4] = {(char *)gzip_file_name, (char *)shuffle_file_name,
+                       (char *)gzip_file_name, NULL};
+    struct read_pipeline * pipeline = make_read_pipeline(paths, NULL, 3, 2, 0, max_image_size, NULL, 0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pipeline);
+
+    size_t nread = 0;
+    struct fast5_read read;
+    while (next_pipeline_read(pipeline, &read)) {
+        for (size_t r = 0; r < NREAD; r++) {
+            if (0 == strcmp(read.name, read_ids[r])) {
+                CU_ASSERT(check_read_daq(read.dt, r));
+                nread += 1;
+            }
+        }
+        free(read.dt.raw);
+        free(read.name);
+    }
+    CU_ASSERT_EQUAL(nread, 3 * NREAD);
+    CU_ASSERT_EQUAL(pipeline->reader->nfile_open, 3);
+    pipeline = free_read_pipeline(pipeline);
+}
+
+
+void test_read_pipeline_compressed(void) {
+    read_pipeline_compressed_helper(0);
+}
+
+
+void test_read_pipeline_in_memory(void) {
+    read_pipeline_compressed_helper(1 << 30);
+}
+
+
+void test_read_pipeline_limit(void) {
+    char * paths[3] = {(char *)multiread_file_name, (char *)multiread_file_name, NULL};
+    struct read_pipeline * pipeline = make_read_pipeline(paths, NULL, 3, 2, 0, 0, NULL, 4);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pipeline);
+
+    size_t nread = 0;
+    struct fast5_read read;
+    while (next_pipeline_read(pipeline, &read)) {
+        nread += 1;
+        free(read.dt.raw);
+        free(read.name);
+    }
+    CU_ASSERT_EQUAL(nread, 4);
+    pipeline = free_read_pipeline(pipeline);
+}
+
+
+void test_read_pipeline_stop_early(void) {
+    //  Readers are blocked on a full queue when pipeline is freed
+    char * paths[4] = {(char *)multiread_file_name, (char *)multiread_file_name,
+                       (char *)multiread_file_name, NULL};
+    struct read_pipeline * pipeline = make_read_pipeline(paths, NULL, 2, 2, 0, 0, NULL, 0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pipeline);
+
+    struct fast5_read read;
+    CU_ASSERT_FATAL(next_pipeline_read(pipeline, &read));
+    free(read.dt.raw);
+    free(read.name);
+    pipeline = free_read_pipeline(pipeline);
+    CU_ASSERT_PTR_NULL(pipeline);
+}
+
+
+static test_with_description tests[] = {
+    {"Open multi-read fast5 file", test_fast5_multiread_open},
+    {"Read multi-read fast5 file by index", test_fast5_multiread_by_index},
+    {"Read multi-read fast5 file by read ID", test_fast5_multiread_by_id},
+    {"Read gzip compressed signal", test_fast5_gzip},
+    {"Read shuffled and gzip compressed signal", test_fast5_shuffle},
+    {"Read signal with filter only HDF5 can undo", test_fast5_checksum},
+    {"Read single read fast5 file", test_fast5_single_read},
+    {"Read fast5 files whole into memory", test_fast5_in_memory},
+    {"Write and read back dumped raw signal", test_fast5_raw_dump},
+    {"Reader over fast5 files", test_fast5_reader},
+    {"Reader walking nested directories", test_fast5_reader_walk},
+    {"Reader over listed paths", test_fast5_reader_path_list},
+    {"Read pipeline delivers every read once", test_read_pipeline},
+    {"Read pipeline with compressed signal", test_read_pipeline_compressed},
+    {"Read pipeline reading files into memory", test_read_pipeline_in_memory},
+    {"Read pipeline respects limit", test_read_pipeline_limit},
+    {"Read pipeline stopped early", test_read_pipeline_stop_early},
+    {0}};
+
+/**   Register tests with CUnit
+ *
+ *    @returns 0 on success, non-zero on failure
+ **/
+int register_test_fast5(void) {
+    return scrappie_register_test_suite("Reading fast5 files", init_test_fast5, clean_test_fast5, tests);
+}
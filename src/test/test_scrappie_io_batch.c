@@ -0,0 +1,145 @@
+#define BANANA 1
+#include <CUnit/CUnit.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <io_batch.h>
+#include <scrappie_stdlib.h>
+#include "test_common.h"
+
+static const char * batch_file_name = "test_io_batch.bin";
+#define FILE_SIZE 100000
+static uint8_t contents[FILE_SIZE];
+
+
+/**  Initialise test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int init_test_io_batch(void) {
+    for (size_t i = 0; i < FILE_SIZE; i++) {
+        contents[i] = (uint8_t)((i * 7919) >> 3);
+    }
+    FILE * fh = fopen(batch_file_name, "wb");
+    bool ok = NULL != fh && 1 == fwrite(contents, FILE_SIZE, 1, fh);
+    if (NULL != fh) {
+        fclose(fh);
+    }
+    return ok ? 0 : 1;
+}
+
+/**  Clean up after test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int clean_test_io_batch(void) {
+    return unlink(batch_file_name);
+}
+
+
+//  Many reads, a few in flight at a time, each checked as it completes
+static void many_reads_helper(bool use_uring) {
+    const int fd = open(batch_file_name, O_RDONLY);
+    CU_ASSERT_FATAL(fd >= 0);
+    const size_t depth = 5;
+    struct io_batch * batch = make_io_batch(fd, depth, use_uring);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(batch);
+    if (!use_uring) {
+        CU_ASSERT_FALSE(batch->use_uring);
+    }
+
+    const size_t nread = 40;
+    uint8_t * buf[nread];
+    size_t nbyte[nread];
+    uint64_t offset[nread];
+    bool seen[nread];
+    size_t nsubmit = 0;
+    size_t ncomplete = 0;
+    while (ncomplete < nread) {
+        while (nsubmit < nread && io_batch_inflight(batch) < depth) {
+            //  Reads of all lengths, including none, scattered over the file
+            offset[nsubmit] = (nsubmit * 15485863) % FILE_SIZE;
+            nbyte[nsubmit] = (nsubmit * 104729) % (FILE_SIZE - offset[nsubmit]);
+            buf[nsubmit] = malloc(nbyte[nsubmit] + 1);
+            seen[nsubmit] = false;
+            CU_ASSERT_FATAL(io_batch_submit(batch, buf[nsubmit], nbyte[nsubmit], offset[nsubmit], nsubmit));
+            nsubmit += 1;
+        }
+        if (depth == io_batch_inflight(batch)) {
+            uint8_t extra;
+            CU_ASSERT_FALSE(io_batch_submit(batch, &extra, 1, 0, nread));
+        }
+        CU_ASSERT(io_batch_flush(batch));
+
+        uint64_t tag;
+        ssize_t n;
+        CU_ASSERT_FATAL(io_batch_wait(batch, &tag, &n));
+        CU_ASSERT_FATAL(tag < nsubmit);
+        CU_ASSERT_FALSE(seen[tag]);
+        seen[tag] = true;
+        CU_ASSERT_EQUAL(n, (ssize_t)nbyte[tag]);
+        CU_ASSERT(0 == memcmp(buf[tag], contents + offset[tag], nbyte[tag]));
+        free(buf[tag]);
+        ncomplete += 1;
+    }
+    uint64_t tag;
+    ssize_t n;
+    CU_ASSERT_FALSE(io_batch_wait(batch, &tag, &n));
+    CU_ASSERT_EQUAL(io_batch_inflight(batch), 0);
+
+    batch = free_io_batch(batch);
+    close(fd);
+}
+
+
+void test_io_batch_uring(void) {
+    many_reads_helper(true);
+}
+
+
+void test_io_batch_pread(void) {
+    many_reads_helper(false);
+}
+
+
+void test_io_batch_end_of_file(void) {
+    const int fd = open(batch_file_name, O_RDONLY);
+    CU_ASSERT_FATAL(fd >= 0);
+    for (int use_uring = 0; use_uring < 2; use_uring++) {
+        struct io_batch * batch = make_io_batch(fd, 2, use_uring);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(batch);
+        uint8_t buf[200];
+        //  Read runs past end of file, and read starts beyond it
+        CU_ASSERT(io_batch_submit(batch, buf, 200, FILE_SIZE - 100, 1));
+        CU_ASSERT(io_batch_submit(batch, buf + 100, 50, FILE_SIZE + 10, 2));
+        for (int i = 0; i < 2; i++) {
+            uint64_t tag;
+            ssize_t n;
+            CU_ASSERT_FATAL(io_batch_wait(batch, &tag, &n));
+            CU_ASSERT_EQUAL(n, (1 == tag) ? 100 : 0);
+        }
+        CU_ASSERT(0 == memcmp(buf, contents + FILE_SIZE - 100, 100));
+        batch = free_io_batch(batch);
+    }
+    close(fd);
+}
+
+
+static test_with_description tests[] = {
+    {"Batch of reads by io_uring, where available", test_io_batch_uring},
+    {"Batch of reads by pread", test_io_batch_pread},
+    {"Batch of reads reaching end of file", test_io_batch_end_of_file},
+    {0}};
+
+/**   Register tests with CUnit
+ *
+ *    @returns 0 on success, non-zero on failure
+ **/
+int register_test_io_batch(void) {
+    return scrappie_register_test_suite("Batched reads", init_test_io_batch, clean_test_io_batch, tests);
+}
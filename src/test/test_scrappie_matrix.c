@@ -18,6 +18,7 @@ int init_test_scrappie_matrix(void) {
  *   @returns 0 on success, non-zero on failure
  **/
 int clean_test_scrappie_matrix(void) {
+    free_scrappie_matrix_pool();
     return 0;
 }
 
@@ -49,11 +50,82 @@ void test_rownormalise_nr11scrappie_matrix(void){
     test_rownormalise_scrappie_matrix_helper(11);
 }
 
+void test_remake_scrappie_matrix_reuses_memory(void){
+    scrappie_matrix mat = make_scrappie_matrix(10, 20);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mat);
+    CU_ASSERT(mat->capacity >= mat->nrq * mat->nc);
+    const float * data = mat->data.f;
+    for(int i=0 ; i < mat->nrq * 4 * mat->nc ; i++){
+        mat->data.f[i] = 1.0f;
+    }
+
+    //  Smaller matrix fits in existing memory and has zero padding
+    mat = remake_scrappie_matrix(mat, 7, 10);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mat);
+    CU_ASSERT_PTR_EQUAL(mat->data.f, data);
+    CU_ASSERT_EQUAL(mat->nr, 7);
+    CU_ASSERT_EQUAL(mat->nrq, 2);
+    CU_ASSERT_EQUAL(mat->nc, 10);
+    for(int c=0 ; c < mat->nc ; c++){
+        CU_ASSERT_EQUAL(mat->data.f[c * mat->nrq * 4 + 7], 0.0f);
+    }
+
+    //  Larger matrix does not
+    mat = remake_scrappie_matrix(mat, 10, 40);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mat);
+    CU_ASSERT_EQUAL(mat->nc, 40);
+    CU_ASSERT(mat->capacity >= mat->nrq * mat->nc);
+
+    mat = free_scrappie_matrix(mat);
+}
+
+void test_make_scrappie_matrix_from_pool(void){
+    scrappie_matrix mat = make_scrappie_matrix(9, 5);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mat);
+    for(int i=0 ; i < mat->nrq * 4 * mat->nc ; i++){
+        mat->data.f[i] = 1.0f;
+    }
+    mat = free_scrappie_matrix(mat);
+
+    //  Memory returned to pool is zeroed when reused
+    mat = make_scrappie_matrix(9, 5);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mat);
+    for(int i=0 ; i < mat->nrq * 4 * mat->nc ; i++){
+        CU_ASSERT_EQUAL(mat->data.f[i], 0.0f);
+    }
+
+    scrappie_matrix copy = copy_scrappie_matrix(mat);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(copy);
+    CU_ASSERT(equality_scrappie_matrix(mat, copy, 0.0));
+
+    copy = free_scrappie_matrix(copy);
+    mat = free_scrappie_matrix(mat);
+}
+
+void test_remake_scrappie_imatrix_reuses_memory(void){
+    scrappie_imatrix mat = make_scrappie_imatrix(8, 6);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mat);
+    const int32_t * data = mat->data.f;
+
+    mat = remake_scrappie_imatrix(mat, 5, 8);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mat);
+    CU_ASSERT_PTR_EQUAL(mat->data.f, data);
+    CU_ASSERT_EQUAL(mat->nrq, 2);
+    for(int c=0 ; c < mat->nc ; c++){
+        CU_ASSERT_EQUAL(mat->data.f[c * mat->nrq * 4 + 5], 0);
+    }
+
+    mat = free_scrappie_imatrix(mat);
+}
+
 static test_with_description tests[] = {
     {"Row normalisation edge case nr  8", test_rownormalise_nr08scrappie_matrix},
     {"Row normalisation edge case nr  9", test_rownormalise_nr09scrappie_matrix},
     {"Row normalisation edge case nr 10", test_rownormalise_nr10scrappie_matrix},
     {"Row normalisation edge case nr 11", test_rownormalise_nr11scrappie_matrix},
+    {"Remake matrix within existing memory", test_remake_scrappie_matrix_reuses_memory},
+    {"Make matrix from memory pool", test_make_scrappie_matrix_from_pool},
+    {"Remake integer matrix within existing memory", test_remake_scrappie_imatrix_reuses_memory},
     {0}};
 
 /**   Register tests with CUnit
@@ -0,0 +1,166 @@
+#define BANANA 1
+#include <CUnit/CUnit.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <model_file.h>
+#include <scrappie_stdlib.h>
+#include "scrappie_util.h"
+#include "test_common.h"
+
+static const char * model_file_name = "test_model_file.crm";
+
+static scrappie_matrix test_W = NULL;
+static scrappie_matrix test_b = NULL;
+
+
+/**  Write a model file containing matrices
+ *
+ *   @param fn Name of file to write
+ *   @param names Names of matrices
+ *   @param mats Matrices
+ *   @param nmat Number of matrices
+ *   @param version Version to write in header
+ *
+ *   @returns true on success
+ **/
+static bool write_model_file(const char * fn, const char ** names, const_scrappie_matrix * mats,
+                             uint32_t nmat, uint32_t version) {
+    FILE * fh = fopen(fn, "wb");
+    RETURN_NULL_IF(NULL == fh, false);
+    fwrite(MODEL_FILE_MAGIC, 1, 8, fh);
+    fwrite(&version, sizeof(uint32_t), 1, fh);
+    fwrite(&nmat, sizeof(uint32_t), 1, fh);
+
+    size_t offset = 16 + nmat * sizeof(struct model_file_entry);
+    for (uint32_t i = 0; i < nmat; i++) {
+        offset = MODEL_FILE_ALIGN * ((offset + MODEL_FILE_ALIGN - 1) / MODEL_FILE_ALIGN);
+        struct model_file_entry entry = {
+            .nr = mats[i]->nr,
+            .nrq = mats[i]->nrq,
+            .nc = mats[i]->nc,
+            .offset = offset
+        };
+        strncpy(entry.name, names[i], MODEL_FILE_NAMELEN - 1);
+        fwrite(&entry, sizeof(entry), 1, fh);
+        offset += mats[i]->nrq * 4 * mats[i]->nc * sizeof(float);
+    }
+    for (uint32_t i = 0; i < nmat; i++) {
+        while (0 != ftell(fh) % MODEL_FILE_ALIGN) {
+            fputc(0, fh);
+        }
+        fwrite(mats[i]->data.f, sizeof(float), mats[i]->nrq * 4 * mats[i]->nc, fh);
+    }
+    return 0 == fclose(fh);
+}
+
+
+/**  Initialise test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int init_test_model_file(void) {
+    test_W = random_scrappie_matrix(13, 7, -1.0, 1.0);
+    test_b = random_scrappie_matrix(7, 1, -1.0, 1.0);
+    RETURN_NULL_IF(NULL == test_W || NULL == test_b, 1);
+    const char * names[2] = {"test_W", "test_b"};
+    const_scrappie_matrix mats[2] = {test_W, test_b};
+    return write_model_file(model_file_name, names, mats, 2, MODEL_FILE_VERSION) ? 0 : 1;
+}
+
+/**  Clean up after test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int clean_test_model_file(void) {
+    test_b = free_scrappie_matrix(test_b);
+    test_W = free_scrappie_matrix(test_W);
+    return unlink(model_file_name);
+}
+
+
+void test_model_file_open(void) {
+    scrappie_model_file model = open_model_file(model_file_name);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(model);
+    CU_ASSERT_EQUAL(model->nmatrix, 2);
+
+    const_scrappie_matrix W = model_file_matrix(model, "test_W");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_EQUAL(0, (uintptr_t)W->data.f % MODEL_FILE_ALIGN);
+    CU_ASSERT(equality_scrappie_matrix(W, test_W, 0.0));
+    const_scrappie_matrix b = model_file_matrix(model, "test_b");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    CU_ASSERT(equality_scrappie_matrix(b, test_b, 0.0));
+    CU_ASSERT_PTR_NULL(model_file_matrix(model, "test_c"));
+
+    model = close_model_file(model);
+}
+
+
+void test_model_file_bind(void) {
+    scrappie_model_file model = open_model_file(model_file_name);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(model);
+
+    scrappie_matrix W = make_scrappie_matrix(13, 7);
+    scrappie_matrix b = make_scrappie_matrix(7, 1);
+    scrappie_matrix b_wrong = make_scrappie_matrix(8, 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b_wrong);
+    _Mat W_compiled = *W;
+    _Mat b_compiled = *b;
+    _Mat b_wrong_compiled = *b_wrong;
+
+    //  Shape mismatch leaves all parameters unchanged
+    const struct model_parameter wrong_params[2] = {{"test_W", &W_compiled}, {"test_b", &b_wrong_compiled}};
+    CU_ASSERT_FALSE(bind_model_parameters(wrong_params, 2, model));
+    CU_ASSERT(W_compiled.data.f == W->data.f);
+
+    //  Missing parameter
+    const struct model_parameter missing_params[1] = {{"test_c", &b_compiled}};
+    CU_ASSERT_FALSE(bind_model_parameters(missing_params, 1, model));
+
+    const struct model_parameter params[2] = {{"test_W", &W_compiled}, {"test_b", &b_compiled}};
+    CU_ASSERT_TRUE(bind_model_parameters(params, 2, model));
+    CU_ASSERT(equality_scrappie_matrix(&W_compiled, test_W, 0.0));
+    CU_ASSERT(equality_scrappie_matrix(&b_compiled, test_b, 0.0));
+
+    b_wrong = free_scrappie_matrix(b_wrong);
+    b = free_scrappie_matrix(b);
+    W = free_scrappie_matrix(W);
+    model = close_model_file(model);
+}
+
+
+void test_model_file_bad_version(void) {
+    const char * fn = "test_model_file_bad.crm";
+    const char * names[1] = {"test_W"};
+    const_scrappie_matrix mats[1] = {test_W};
+    CU_ASSERT_FATAL(write_model_file(fn, names, mats, 1, MODEL_FILE_VERSION + 1));
+    CU_ASSERT_PTR_NULL(open_model_file(fn));
+    unlink(fn);
+}
+
+
+void test_model_file_missing(void) {
+    CU_ASSERT_PTR_NULL(open_model_file("no_such_model_file.crm"));
+}
+
+
+static test_with_description tests[] = {
+    {"Open model file", test_model_file_open},
+    {"Bind parameters to model file", test_model_file_bind},
+    {"Model file with wrong version", test_model_file_bad_version},
+    {"Missing model file", test_model_file_missing},
+    {0}};
+
+/**   Register tests with CUnit
+ *
+ *    @returns 0 on success, non-zero on failure
+ **/
+int register_test_model_file(void) {
+    return scrappie_register_test_suite("Binary model files", init_test_model_file, clean_test_model_file, tests);
+}
@@ -0,0 +1,233 @@
+#define BANANA 1
+#include <CUnit/Basic.h>
+#include <stdbool.h>
+
+#include "layers.h"
+#include "network_graph.h"
+#include "scrappie_util.h"
+#include "test_common.h"
+
+static const int graph_ninput = 4;
+static const int graph_size = 8;
+static const int graph_nblock = 51;
+static const int graph_stride = 2;
+
+static scrappie_matrix input = NULL;
+static scrappie_matrix conv_W = NULL;
+static scrappie_matrix conv_b = NULL;
+static scrappie_matrix gru_iW = NULL;
+static scrappie_matrix gru_b = NULL;
+static scrappie_matrix gru_sW = NULL;
+static scrappie_matrix gru_sW2 = NULL;
+static scrappie_matrix out_W = NULL;
+static scrappie_matrix out_b = NULL;
+
+/**  Initialise test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int init_test_network_graph(void) {
+    input = random_scrappie_matrix(graph_ninput, graph_nblock, -1.0, 1.0);
+    conv_W = random_scrappie_matrix(3 * graph_ninput, graph_size, -0.5, 0.5);
+    conv_b = random_scrappie_matrix(graph_size, 1, -0.5, 0.5);
+    gru_iW = random_scrappie_matrix(graph_size, 3 * graph_size, -0.5, 0.5);
+    gru_b = random_scrappie_matrix(3 * graph_size, 1, -0.5, 0.5);
+    gru_sW = random_scrappie_matrix(graph_size, 2 * graph_size, -0.5, 0.5);
+    gru_sW2 = random_scrappie_matrix(graph_size, graph_size, -0.5, 0.5);
+    out_W = random_scrappie_matrix(graph_size, 5, -0.5, 0.5);
+    out_b = random_scrappie_matrix(5, 1, -0.5, 0.5);
+    if (NULL == input || NULL == conv_W || NULL == conv_b || NULL == gru_iW || NULL == gru_b
+        || NULL == gru_sW || NULL == gru_sW2 || NULL == out_W || NULL == out_b) {
+        return 1;
+    }
+    return 0;
+}
+
+/**  Clean up after test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int clean_test_network_graph(void) {
+    input = free_scrappie_matrix(input);
+    conv_W = free_scrappie_matrix(conv_W);
+    conv_b = free_scrappie_matrix(conv_b);
+    gru_iW = free_scrappie_matrix(gru_iW);
+    gru_b = free_scrappie_matrix(gru_b);
+    gru_sW = free_scrappie_matrix(gru_sW);
+    gru_sW2 = free_scrappie_matrix(gru_sW2);
+    out_W = free_scrappie_matrix(out_W);
+    out_b = free_scrappie_matrix(out_b);
+    return 0;
+}
+
+
+void test_network_graph_validate(void) {
+    const struct network_layer layers[] = {
+        CONVOLUTION_LAYER(NETWORK_INPUT, conv_W, conv_b, &graph_stride),
+        ACTIVATION_LAYER(LAYER_TANH, 0)
+    };
+    double timing[NLAYER(layers)];
+    struct network_graph net = {"valid", NLAYER(layers), layers, timing};
+    CU_ASSERT_TRUE(validate_network_graph(&net));
+
+    //  Input from a later layer
+    const struct network_layer forward_ref[] = {
+        ACTIVATION_LAYER(LAYER_TANH, 1),
+        ACTIVATION_LAYER(LAYER_TANH, 0)
+    };
+    net.layers = forward_ref;
+    CU_ASSERT_FALSE(validate_network_graph(&net));
+
+    //  Convolution missing stride
+    const struct network_layer missing_param[] = {
+        FEEDFORWARD_LAYER(LAYER_CONVOLUTION, NETWORK_INPUT, conv_W, conv_b),
+        ACTIVATION_LAYER(LAYER_TANH, 0)
+    };
+    net.layers = missing_param;
+    CU_ASSERT_FALSE(validate_network_graph(&net));
+
+    net.nlayer = 0;
+    CU_ASSERT_FALSE(validate_network_graph(&net));
+}
+
+
+/**  Output of test network from direct calls to layers
+ *
+ *   @param X Input
+ *
+ *   @returns Output
+ **/
+static scrappie_matrix direct_network_output(const_scrappie_matrix X) {
+    scrappie_matrix conv = convolution(X, conv_W, conv_b, graph_stride, NULL);
+    elu_activation_inplace(conv);
+    scrappie_matrix gruB = gru_backward_tiled(conv, gru_iW, gru_b, gru_sW, gru_sW2, 64, NULL);
+    residual_inplace(conv, gruB);
+    scrappie_matrix gruF = gru_forward_tiled(gruB, gru_iW, gru_b, gru_sW, gru_sW2, 64, NULL);
+    scrappie_matrix output = logsoftmax(gruF, out_W, out_b, 1e-5f, NULL);
+    gruF = free_scrappie_matrix(gruF);
+    gruB = free_scrappie_matrix(gruB);
+    conv = free_scrappie_matrix(conv);
+    return output;
+}
+
+
+void test_network_graph_run(void) {
+    //  Convolution feeding both a GRU and the residual connection around it
+    const struct network_layer layers[] = {
+        CONVOLUTION_LAYER(NETWORK_INPUT, conv_W, conv_b, &graph_stride),
+        ACTIVATION_LAYER(LAYER_ELU, 0),
+        GRU_LAYER(LAYER_GRU_BACKWARD, 1, gru_iW, gru_b, gru_sW, gru_sW2),
+        RESIDUAL_LAYER(2, 1),
+        GRU_LAYER(LAYER_GRU_FORWARD, 3, gru_iW, gru_b, gru_sW, gru_sW2),
+        FEEDFORWARD_LAYER(LAYER_SOFTMAX, 4, out_W, out_b)
+    };
+    double timing[NLAYER(layers)];
+    const struct network_graph net = {"test", NLAYER(layers), layers, timing};
+    CU_ASSERT_FATAL(validate_network_graph(&net));
+
+    scrappie_matrix expected = direct_network_output(input);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(expected);
+
+    set_network_timing(true);
+    reset_network_timing(&net);
+    scrappie_matrix output = run_network_graph(&net, input, 1e-5f, true);
+    set_network_timing(false);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(output);
+    CU_ASSERT(equality_scrappie_matrix(output, expected, 1e-5));
+    for (size_t i = 0; i < net.nlayer; i++) {
+        CU_ASSERT(timing[i] >= 0.0);
+    }
+
+    output = free_scrappie_matrix(output);
+    expected = free_scrappie_matrix(expected);
+    free_network_workspace();
+}
+
+
+void test_network_plan(void) {
+    const struct network_layer layers[] = {
+        CONVOLUTION_LAYER(NETWORK_INPUT, conv_W, conv_b, &graph_stride),
+        ACTIVATION_LAYER(LAYER_ELU, 0),
+        GRU_LAYER(LAYER_GRU_BACKWARD, 1, gru_iW, gru_b, gru_sW, gru_sW2),
+        RESIDUAL_LAYER(2, 1),
+        GRU_LAYER(LAYER_GRU_FORWARD, 3, gru_iW, gru_b, gru_sW, gru_sW2),
+        FEEDFORWARD_LAYER(LAYER_SOFTMAX, 4, out_W, out_b)
+    };
+    double timing[NLAYER(layers)];
+    const struct network_graph net = {"test", NLAYER(layers), layers, timing};
+
+    struct network_plan * plan = make_network_plan(&net, graph_ninput, graph_nblock);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(plan);
+    const int ncol = (graph_nblock + graph_stride - 1) / graph_stride;
+    for (size_t i = 0; i < net.nlayer - 1; i++) {
+        CU_ASSERT_EQUAL(plan->nr[i], graph_size);
+        CU_ASSERT_EQUAL(plan->nc[i], ncol);
+    }
+    CU_ASSERT_EQUAL(plan->nr[5], 5);
+
+    //  In-place layers share the slab of their input, live outputs do not
+    CU_ASSERT_EQUAL(plan->slab[1], plan->slab[0]);
+    CU_ASSERT_EQUAL(plan->slab[3], plan->slab[2]);
+    CU_ASSERT_NOT_EQUAL(plan->slab[2], plan->slab[1]);
+    CU_ASSERT_NOT_EQUAL(plan->slab[4], plan->slab[3]);
+    CU_ASSERT_EQUAL(plan->slab[5], NETWORK_NO_SLAB);
+    CU_ASSERT_EQUAL(plan->nslab, 2);
+    CU_ASSERT(network_plan_bytes(plan) < network_unplanned_bytes(plan));
+
+    //  Placement is independent of length of input
+    const size_t nbyte = network_plan_bytes(plan);
+    CU_ASSERT_FATAL(update_network_plan(plan, graph_ninput, 4 * graph_nblock));
+    CU_ASSERT(network_plan_bytes(plan) > nbyte);
+    CU_ASSERT_EQUAL(plan->slab[4], plan->slab[0]);
+    CU_ASSERT_FALSE(update_network_plan(plan, graph_ninput, 0));
+
+    plan = free_network_plan(plan);
+}
+
+
+void test_network_graph_run_reuse(void) {
+    const struct network_layer layers[] = {
+        CONVOLUTION_LAYER(NETWORK_INPUT, conv_W, conv_b, &graph_stride),
+        ACTIVATION_LAYER(LAYER_ELU, 0),
+        GRU_LAYER(LAYER_GRU_BACKWARD, 1, gru_iW, gru_b, gru_sW, gru_sW2),
+        RESIDUAL_LAYER(2, 1),
+        GRU_LAYER(LAYER_GRU_FORWARD, 3, gru_iW, gru_b, gru_sW, gru_sW2),
+        FEEDFORWARD_LAYER(LAYER_SOFTMAX, 4, out_W, out_b)
+    };
+    double timing[NLAYER(layers)];
+    //  Tiles shorter than the inputs, so GRU layers project several tiles
+    const struct network_graph net = {"test", NLAYER(layers), layers, timing, 5};
+
+    //  Shorter input run after a longer one reuses slabs holding old outputs
+    scrappie_matrix short_input = random_scrappie_matrix(graph_ninput, graph_nblock / 3, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(short_input);
+    const_scrappie_matrix inputs[3] = {input, short_input, input};
+    for (int i = 0; i < 3; i++) {
+        scrappie_matrix expected = direct_network_output(inputs[i]);
+        scrappie_matrix output = run_network_graph(&net, inputs[i], 1e-5f, true);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(output);
+        CU_ASSERT(equality_scrappie_matrix(output, expected, 1e-5));
+        output = free_scrappie_matrix(output);
+        expected = free_scrappie_matrix(expected);
+    }
+
+    short_input = free_scrappie_matrix(short_input);
+    free_network_workspace();
+}
+
+
+static test_with_description tests[] = {
+    {"Validate network description", test_network_graph_validate},
+    {"Run network against direct calls to layers", test_network_graph_run},
+    {"Plan memory for intermediate outputs", test_network_plan},
+    {"Run network on inputs of different lengths", test_network_graph_run_reuse},
+    {0}};
+
+/**   Register tests with CUnit
+ *
+ *    @returns 0 on success, non-zero on failure
+ **/
+int register_test_network_graph(void) {
+    return scrappie_register_test_suite("Network graph", init_test_network_graph,
+                                        clean_test_network_graph, tests);
+}
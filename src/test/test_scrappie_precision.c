@@ -0,0 +1,850 @@
+#define BANANA 1
+#include <CUnit/CUnit.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <layers.h>
+#include <precision.h>
+#include <specialised_kernels.h>
+#include "scrappie_util.h"
+#include "test_common.h"
+
+//  Inputs and weights are drawn from [-1, 1] so each product carries an
+//  error of at most about 1/127 after quantisation.
+static const float int8_tol_per_row = 1.0f / 127.0f;
+//  Relative error of rounding to float16 and bfloat16
+static const float float16_eps = 1.0f / 2048.0f;
+static const float bfloat16_eps = 1.0f / 256.0f;
+
+static float half_eps(enum scrappie_precision precision) {
+    return (SCRAPPIE_PRECISION_FLOAT16 == precision) ? float16_eps : bfloat16_eps;
+}
+
+
+/**  Initialise test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int init_test_precision(void) {
+    return 0;
+}
+
+/**  Clean up after test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int clean_test_precision(void) {
+    return 0;
+}
+
+
+void test_precision_names(void) {
+    for (enum scrappie_precision p = 0; p < scrappie_nprecision; p++) {
+        CU_ASSERT_EQUAL(p, get_scrappie_precision(scrappie_precision_string(p)));
+    }
+    CU_ASSERT_EQUAL(SCRAPPIE_PRECISION_INVALID, get_scrappie_precision("float64"));
+}
+
+
+void test_qgemv_helper(int nr, int nc) {
+    scrappie_matrix W = random_scrappie_matrix(nr, nc, -1.0, 1.0);
+    scrappie_matrix x = random_scrappie_matrix(nr, 1, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(x);
+    scrappie_qmatrix qW = make_scrappie_qmatrix(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(qW);
+
+    float * y = calloc(nc, sizeof(float));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(y);
+    for (int c = 0; c < nc; c++) {
+        y[c] = 1.0f;
+    }
+    qgemv(qW, x->data.f, y);
+
+    for (int c = 0; c < nc; c++) {
+        float expected = 1.0f;
+        for (int r = 0; r < nr; r++) {
+            expected += W->data.f[c * W->nrq * 4 + r] * x->data.f[r];
+        }
+        CU_ASSERT_DOUBLE_EQUAL(y[c], expected, nr * int8_tol_per_row);
+    }
+
+    free(y);
+    qW = free_scrappie_qmatrix(qW);
+    x = free_scrappie_matrix(x);
+    W = free_scrappie_matrix(W);
+}
+
+void test_qgemv_aligned(void) {
+    test_qgemv_helper(64, 16);
+}
+
+void test_qgemv_unaligned(void) {
+    test_qgemv_helper(75, 13);
+}
+
+
+void test_int8_affine_map(void) {
+    const int nr = 96;
+    const int nc = 21;
+    scrappie_matrix X = random_scrappie_matrix(nr, 17, -1.0, 1.0);
+    scrappie_matrix W = random_scrappie_matrix(nr, nc, -1.0, 1.0);
+    scrappie_matrix b = random_scrappie_matrix(nc, 1, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(X);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+
+    scrappie_matrix C = affine_map(X, W, b, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(&W, 1, SCRAPPIE_PRECISION_INT8));
+    CU_ASSERT_PTR_NOT_NULL(get_int8_weights(W));
+    scrappie_matrix qC = affine_map(X, W, b, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32));
+    CU_ASSERT_PTR_NULL(get_int8_weights(W));
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(C);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(qC);
+    CU_ASSERT(equality_scrappie_matrix(C, qC, nr * int8_tol_per_row));
+
+    qC = free_scrappie_matrix(qC);
+    C = free_scrappie_matrix(C);
+    b = free_scrappie_matrix(b);
+    W = free_scrappie_matrix(W);
+    X = free_scrappie_matrix(X);
+}
+
+
+void test_int8_convolution_helper(int winlen, int stride) {
+    const int nfeature = 4;
+    const int nfilter = 32;
+    scrappie_matrix X = random_scrappie_matrix(nfeature, 51, -1.0, 1.0);
+    scrappie_matrix W = random_scrappie_matrix(nfeature * winlen, nfilter, -1.0, 1.0);
+    scrappie_matrix b = random_scrappie_matrix(nfilter, 1, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(X);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+
+    scrappie_matrix C = convolution(X, W, b, stride, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(&W, 1, SCRAPPIE_PRECISION_INT8));
+    scrappie_matrix qC = convolution(X, W, b, stride, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32));
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(C);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(qC);
+    CU_ASSERT(equality_scrappie_matrix(C, qC, nfeature * winlen * int8_tol_per_row));
+
+    qC = free_scrappie_matrix(qC);
+    C = free_scrappie_matrix(C);
+    b = free_scrappie_matrix(b);
+    W = free_scrappie_matrix(W);
+    X = free_scrappie_matrix(X);
+}
+
+void test_int8_convolution_w11_s2(void) {
+    test_int8_convolution_helper(11, 2);
+}
+
+void test_int8_convolution_w4_s1(void) {
+    test_int8_convolution_helper(4, 1);
+}
+
+
+void test_half_round_trip_helper(enum scrappie_precision precision) {
+    scrappie_matrix W = random_scrappie_matrix(37, 9, -100.0, 100.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    scrappie_hmatrix hW = make_scrappie_hmatrix(W, precision);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(hW);
+    scrappie_matrix Wwide = widen_scrappie_hmatrix(hW);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(Wwide);
+
+    for (int c = 0; c < W->nc; c++) {
+        for (int r = 0; r < W->nr; r++) {
+            const float w = W->data.f[c * W->nrq * 4 + r];
+            CU_ASSERT_DOUBLE_EQUAL(Wwide->data.f[c * W->nrq * 4 + r], w,
+                                   fabsf(w) * half_eps(precision));
+        }
+    }
+
+    Wwide = free_scrappie_matrix(Wwide);
+    hW = free_scrappie_hmatrix(hW);
+    W = free_scrappie_matrix(W);
+}
+
+void test_float16_round_trip(void) {
+    test_half_round_trip_helper(SCRAPPIE_PRECISION_FLOAT16);
+}
+
+void test_bfloat16_round_trip(void) {
+    test_half_round_trip_helper(SCRAPPIE_PRECISION_BFLOAT16);
+}
+
+
+void test_hgemv_helper(int nr, int nc, enum scrappie_precision precision) {
+    scrappie_matrix W = random_scrappie_matrix(nr, nc, -1.0, 1.0);
+    scrappie_matrix x = random_scrappie_matrix(nr, 1, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(x);
+    scrappie_hmatrix hW = make_scrappie_hmatrix(W, precision);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(hW);
+
+    float * y = calloc(nc, sizeof(float));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(y);
+    for (int c = 0; c < nc; c++) {
+        y[c] = 1.0f;
+    }
+    hgemv(hW, x->data.f, y);
+
+    for (int c = 0; c < nc; c++) {
+        float expected = 1.0f;
+        for (int r = 0; r < nr; r++) {
+            expected += W->data.f[c * W->nrq * 4 + r] * x->data.f[r];
+        }
+        CU_ASSERT_DOUBLE_EQUAL(y[c], expected, nr * half_eps(precision));
+    }
+
+    free(y);
+    hW = free_scrappie_hmatrix(hW);
+    x = free_scrappie_matrix(x);
+    W = free_scrappie_matrix(W);
+}
+
+void test_hgemv_float16(void) {
+    test_hgemv_helper(75, 13, SCRAPPIE_PRECISION_FLOAT16);
+}
+
+void test_hgemv_bfloat16(void) {
+    test_hgemv_helper(64, 16, SCRAPPIE_PRECISION_BFLOAT16);
+}
+
+
+void test_half_affine_map_helper(enum scrappie_precision precision) {
+    const int nr = 96;
+    //  More columns than are widened at once
+    const int nc = 70;
+    scrappie_matrix X = random_scrappie_matrix(nr, 17, -1.0, 1.0);
+    scrappie_matrix W = random_scrappie_matrix(nr, nc, -1.0, 1.0);
+    scrappie_matrix b = random_scrappie_matrix(nc, 1, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(X);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+
+    scrappie_matrix C = affine_map(X, W, b, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(&W, 1, precision));
+    CU_ASSERT_PTR_NOT_NULL(get_half_weights(W));
+    CU_ASSERT_PTR_NULL(get_int8_weights(W));
+    scrappie_matrix hC = affine_map(X, W, b, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32));
+    CU_ASSERT_PTR_NULL(get_half_weights(W));
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(C);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(hC);
+    CU_ASSERT(equality_scrappie_matrix(C, hC, nr * half_eps(precision)));
+
+    hC = free_scrappie_matrix(hC);
+    C = free_scrappie_matrix(C);
+    b = free_scrappie_matrix(b);
+    W = free_scrappie_matrix(W);
+    X = free_scrappie_matrix(X);
+}
+
+void test_float16_affine_map(void) {
+    test_half_affine_map_helper(SCRAPPIE_PRECISION_FLOAT16);
+}
+
+void test_bfloat16_affine_map(void) {
+    test_half_affine_map_helper(SCRAPPIE_PRECISION_BFLOAT16);
+}
+
+
+void test_float16_convolution(void) {
+    const int winlen = 11;
+    const int nfeature = 4;
+    const int nfilter = 32;
+    scrappie_matrix X = random_scrappie_matrix(nfeature, 51, -1.0, 1.0);
+    scrappie_matrix W = random_scrappie_matrix(nfeature * winlen, nfilter, -1.0, 1.0);
+    scrappie_matrix b = random_scrappie_matrix(nfilter, 1, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(X);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+
+    scrappie_matrix C = convolution(X, W, b, 2, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(&W, 1, SCRAPPIE_PRECISION_FLOAT16));
+    scrappie_matrix hC = convolution(X, W, b, 2, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32));
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(C);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(hC);
+    CU_ASSERT(equality_scrappie_matrix(C, hC, nfeature * winlen * float16_eps));
+
+    hC = free_scrappie_matrix(hC);
+    C = free_scrappie_matrix(C);
+    b = free_scrappie_matrix(b);
+    W = free_scrappie_matrix(W);
+    X = free_scrappie_matrix(X);
+}
+
+
+/**  Compare packed gemv with simple implementation on a block of rows
+ *
+ *   @param nr Number of rows of matrix
+ *   @param nc Number of columns of matrix
+ *   @param k0 First row used
+ *   @param nk Number of rows used
+ **/
+void test_pgemv_helper(int nr, int nc, int k0, int nk) {
+    scrappie_matrix W = random_scrappie_matrix(nr, nc, -1.0, 1.0);
+    scrappie_matrix x = random_scrappie_matrix(nk, 1, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(x);
+    scrappie_pmatrix pW = make_scrappie_pmatrix(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pW);
+
+    //  Guard element past end of output must be untouched
+    float * y = calloc(nc + 1, sizeof(float));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(y);
+    for (int c = 0; c <= nc; c++) {
+        y[c] = 1.0f;
+    }
+    pgemv(pW, k0, nk, x->data.f, y);
+
+    for (int c = 0; c < nc; c++) {
+        float expected = 1.0f;
+        for (int k = 0; k < nk; k++) {
+            expected += W->data.f[c * W->nrq * 4 + k0 + k] * x->data.f[k];
+        }
+        CU_ASSERT_DOUBLE_EQUAL(y[c], expected, 1e-4);
+    }
+    CU_ASSERT_EQUAL(y[nc], 1.0f);
+
+    free(y);
+    pW = free_scrappie_pmatrix(pW);
+    x = free_scrappie_matrix(x);
+    W = free_scrappie_matrix(W);
+}
+
+void test_pgemv_aligned(void) {
+    test_pgemv_helper(64, 96, 0, 64);
+}
+
+void test_pgemv_unaligned(void) {
+    test_pgemv_helper(75, 37, 6, 61);
+}
+
+
+void test_pgemm_strided(void) {
+    const int nr = 44;
+    const int nc = 29;
+    const int ncol = 11;
+    const int ldX = 2 * nr + 3;
+    const int ldC = nc + 5;
+    scrappie_matrix W = random_scrappie_matrix(nr, nc, -1.0, 1.0);
+    scrappie_matrix X = random_scrappie_matrix(ldX, ncol, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(X);
+    scrappie_pmatrix pW = make_scrappie_pmatrix(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pW);
+
+    float * C = calloc(ldC * ncol, sizeof(float));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(C);
+    //  Columns of X are taken with a stride, as in a convolution
+    pgemm(pW, 0, nr, X->data.f, 2 * X->nrq * 4, ncol / 2, C, ldC);
+
+    for (int j = 0; j < ldC * ncol; j++) {
+        const int col = j / ldC;
+        const int row = j % ldC;
+        float expected = 0.0f;
+        if (col < ncol / 2 && row < nc) {
+            const float * x = X->data.f + 2 * col * X->nrq * 4;
+            for (int k = 0; k < nr; k++) {
+                expected += W->data.f[row * W->nrq * 4 + k] * x[k];
+            }
+        }
+        CU_ASSERT_DOUBLE_EQUAL(C[j], expected, 1e-4);
+    }
+
+    free(C);
+    pW = free_scrappie_pmatrix(pW);
+    X = free_scrappie_matrix(X);
+    W = free_scrappie_matrix(W);
+}
+
+
+void test_packed_affine_map(void) {
+    const int nr = 96;
+    const int nc = 1025;
+    scrappie_matrix X = random_scrappie_matrix(nr, 17, -1.0, 1.0);
+    scrappie_matrix W = random_scrappie_matrix(nr, nc, -1.0, 1.0);
+    scrappie_matrix b = random_scrappie_matrix(nc, 1, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(X);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+
+    scrappie_matrix C = affine_map(X, W, b, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(&W, 1, SCRAPPIE_PRECISION_FLOAT32));
+    CU_ASSERT_PTR_NOT_NULL(get_packed_weights(W));
+    scrappie_matrix pC = affine_map(X, W, b, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32));
+    CU_ASSERT_PTR_NULL(get_packed_weights(W));
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(C);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pC);
+    CU_ASSERT(equality_scrappie_matrix(C, pC, 1e-4));
+
+    pC = free_scrappie_matrix(pC);
+    C = free_scrappie_matrix(C);
+    b = free_scrappie_matrix(b);
+    W = free_scrappie_matrix(W);
+    X = free_scrappie_matrix(X);
+}
+
+
+void test_packed_convolution_helper(int winlen, int stride) {
+    const int nfeature = 4;
+    const int nfilter = 36;
+    scrappie_matrix X = random_scrappie_matrix(nfeature, 51, -1.0, 1.0);
+    scrappie_matrix W = random_scrappie_matrix(nfeature * winlen, nfilter, -1.0, 1.0);
+    scrappie_matrix b = random_scrappie_matrix(nfilter, 1, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(X);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+
+    scrappie_matrix C = convolution(X, W, b, stride, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(&W, 1, SCRAPPIE_PRECISION_FLOAT32));
+    scrappie_matrix pC = convolution(X, W, b, stride, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32));
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(C);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pC);
+    CU_ASSERT(equality_scrappie_matrix(C, pC, 1e-4));
+
+    pC = free_scrappie_matrix(pC);
+    C = free_scrappie_matrix(C);
+    b = free_scrappie_matrix(b);
+    W = free_scrappie_matrix(W);
+    X = free_scrappie_matrix(X);
+}
+
+void test_packed_convolution_w11_s2(void) {
+    test_packed_convolution_helper(11, 2);
+}
+
+void test_packed_convolution_w4_s1(void) {
+    test_packed_convolution_helper(4, 1);
+}
+
+
+void test_packed_lstm_step(void) {
+    const int size = 20;
+    scrappie_matrix x = random_scrappie_matrix(4 * size, 1, -1.0, 1.0);
+    scrappie_matrix h = random_scrappie_matrix(size, 1, -1.0, 1.0);
+    scrappie_matrix sW = random_scrappie_matrix(size, 4 * size, -0.5, 0.5);
+    scrappie_matrix peep = random_scrappie_matrix(3 * size, 1, -0.5, 0.5);
+    scrappie_matrix state = random_scrappie_matrix(size, 1, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(x);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(h);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sW);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(peep);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(state);
+    scrappie_matrix pstate = copy_scrappie_matrix(state);
+    scrappie_matrix out = make_scrappie_matrix(size, 1);
+    scrappie_matrix pout = make_scrappie_matrix(size, 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pstate);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(out);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pout);
+
+    lstm_step(x, h, sW, peep, state, out);
+    CU_ASSERT_FATAL(set_weight_precision(&sW, 1, SCRAPPIE_PRECISION_FLOAT32));
+    lstm_step(x, h, sW, peep, pstate, pout);
+    CU_ASSERT_FATAL(set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32));
+
+    CU_ASSERT(equality_scrappie_matrix(state, pstate, 1e-5));
+    CU_ASSERT(equality_scrappie_matrix(out, pout, 1e-5));
+
+    pout = free_scrappie_matrix(pout);
+    out = free_scrappie_matrix(out);
+    pstate = free_scrappie_matrix(pstate);
+    state = free_scrappie_matrix(state);
+    peep = free_scrappie_matrix(peep);
+    sW = free_scrappie_matrix(sW);
+    h = free_scrappie_matrix(h);
+    x = free_scrappie_matrix(x);
+}
+
+
+void test_packed_gru(void) {
+    const int size = 36;
+    scrappie_matrix xin = random_scrappie_matrix(3 * size, 23, -1.0, 1.0);
+    scrappie_matrix sW = random_scrappie_matrix(size, 2 * size, -0.5, 0.5);
+    scrappie_matrix sW2 = random_scrappie_matrix(size, size, -0.5, 0.5);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(xin);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sW);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sW2);
+    scrappie_matrix weights[2] = {sW, sW2};
+
+    scrappie_matrix out = gru_forward(xin, sW, sW2, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(weights, 2, SCRAPPIE_PRECISION_FLOAT32));
+    scrappie_matrix pout = gru_forward(xin, sW, sW2, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32));
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(out);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pout);
+    CU_ASSERT(equality_scrappie_matrix(out, pout, 1e-5));
+
+    pout = free_scrappie_matrix(pout);
+    out = free_scrappie_matrix(out);
+    sW2 = free_scrappie_matrix(sW2);
+    sW = free_scrappie_matrix(sW);
+    xin = free_scrappie_matrix(xin);
+}
+
+
+/**  Compare kernel specialised to shape of matrix with generic kernel
+ *
+ *   @param nr Number of rows of matrix, a shape from a shipped model
+ *   @param nc Number of columns of matrix
+ *   @param ncol Number of columns of input
+ **/
+void test_specialised_pgemm_helper(int nr, int nc, int ncol) {
+    scrappie_matrix W = random_scrappie_matrix(nr, nc, -1.0, 1.0);
+    scrappie_matrix X = random_scrappie_matrix(nr, ncol, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(X);
+    scrappie_pmatrix pW = make_scrappie_pmatrix(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pW);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pW->kernel);
+    CU_ASSERT_PTR_EQUAL(pW->kernel, get_pgemm_kernel(nr, nc));
+
+    scrappie_matrix C = make_scrappie_matrix(nc, ncol);
+    scrappie_matrix gC = make_scrappie_matrix(nc, ncol);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(C);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(gC);
+    paffine_map(X, pW, C);
+    pgemv(pW, 0, nr, X->data.f, C->data.f + (ncol - 1) * C->nrq * 4);
+    pW->kernel = NULL;
+    paffine_map(X, pW, gC);
+    pgemv(pW, 0, nr, X->data.f, gC->data.f + (ncol - 1) * gC->nrq * 4);
+
+    CU_ASSERT(equality_scrappie_matrix(C, gC, 0.0));
+
+    gC = free_scrappie_matrix(gC);
+    C = free_scrappie_matrix(C);
+    pW = free_scrappie_pmatrix(pW);
+    X = free_scrappie_matrix(X);
+    W = free_scrappie_matrix(W);
+}
+
+void test_specialised_pgemm_convolution(void) {
+    test_specialised_pgemm_helper(41, 96, 9);
+}
+
+void test_specialised_pgemm_recurrent(void) {
+    test_specialised_pgemm_helper(96, 192, 1);
+}
+
+void test_specialised_pgemm_output(void) {
+    test_specialised_pgemm_helper(112, 1025, 7);
+}
+
+
+void test_specialised_gru(void) {
+    const int size = 96;
+    CU_ASSERT_PTR_NOT_NULL(get_gru_step_kernel(size));
+    CU_ASSERT_PTR_NULL(get_gru_step_kernel(size + 4));
+    scrappie_matrix xin = random_scrappie_matrix(3 * size, 23, -1.0, 1.0);
+    scrappie_matrix sW = random_scrappie_matrix(size, 2 * size, -0.5, 0.5);
+    scrappie_matrix sW2 = random_scrappie_matrix(size, size, -0.5, 0.5);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(xin);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sW);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sW2);
+    scrappie_matrix weights[2] = {sW, sW2};
+
+    scrappie_matrix out = gru_backward(xin, sW, sW2, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(weights, 2, SCRAPPIE_PRECISION_FLOAT32));
+    scrappie_matrix pout = gru_backward(xin, sW, sW2, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32));
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(out);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pout);
+    CU_ASSERT(equality_scrappie_matrix(out, pout, 1e-5));
+
+    pout = free_scrappie_matrix(pout);
+    out = free_scrappie_matrix(out);
+    sW2 = free_scrappie_matrix(sW2);
+    sW = free_scrappie_matrix(sW);
+    xin = free_scrappie_matrix(xin);
+}
+
+
+void test_resolved_weights(void) {
+    scrappie_matrix W = random_scrappie_matrix(96, 96, -0.5, 0.5);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+
+    //  Weights not converted resolve to no converted versions
+    struct scrappie_weights converted;
+    _Mat header = resolve_weights(W, &converted);
+    CU_ASSERT_PTR_NULL(get_packed_weights(&header));
+
+    const unsigned int generation = weight_registry_generation();
+    CU_ASSERT_FATAL(set_weight_precision(&W, 1, SCRAPPIE_PRECISION_FLOAT32));
+    CU_ASSERT(generation != weight_registry_generation());
+    header = resolve_weights(W, &converted);
+    CU_ASSERT_PTR_EQUAL(header.data.f, W->data.f);
+    CU_ASSERT_PTR_EQUAL(header.converted, &converted);
+    CU_ASSERT_PTR_NOT_NULL(get_packed_weights(&header));
+    CU_ASSERT_PTR_EQUAL(get_packed_weights(&header), get_packed_weights(W));
+    CU_ASSERT_PTR_EQUAL(get_packed_weights(&header)->step_kernel, get_gru_step_kernel(96));
+    CU_ASSERT_FATAL(set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32));
+    CU_ASSERT_PTR_NULL(get_packed_weights(W));
+
+    W = free_scrappie_matrix(W);
+}
+
+
+/**  Matrix with every other block of its whole panels scaled to be small,
+ *   and a copy with those blocks zeroed, which is what pruning the small
+ *   blocks should give.  Blocks of a final partial panel are never pruned,
+ *   so are left as they are.
+ *
+ *   @param nr Number of rows
+ *   @param nc Number of columns
+ *   @param Wpruned Set to copy of matrix with small blocks zeroed
+ *   @param nsmall Set to number of small blocks
+ *
+ *   @returns Matrix
+ **/
+static scrappie_matrix make_blocked_matrix(int nr, int nc, scrappie_matrix * Wpruned, int * nsmall) {
+    scrappie_matrix W = random_scrappie_matrix(nr, nc, 0.5, 1.0);
+    *Wpruned = copy_scrappie_matrix(W);
+    if (NULL == W || NULL == *Wpruned) {
+        *Wpruned = free_scrappie_matrix(*Wpruned);
+        return free_scrappie_matrix(W);
+    }
+    const int nrblock = (nr + SMAT_BLOCK - 1) / SMAT_BLOCK;
+    const int nwhole = (nc / PMAT_PANEL) * PMAT_PANEL;
+    for (int c = 0; c < nwhole; c++) {
+        for (int r = 0; r < nr; r++) {
+            const int block = (c / PMAT_PANEL) * nrblock + r / SMAT_BLOCK;
+            if (block % 2 == 1) {
+                W->data.f[c * W->nrq * 4 + r] *= 1e-3f;
+                (*Wpruned)->data.f[c * W->nrq * 4 + r] = 0.0f;
+            }
+        }
+    }
+    *nsmall = (nwhole / PMAT_PANEL) * nrblock / 2;
+    return W;
+}
+
+
+//  Sparsity at which exactly nprune of nblock blocks are pruned
+static float sparsity_for(int nprune, int nblock) {
+    return (nprune + 0.5f) / nblock;
+}
+
+void test_smatrix_helper(int nr, int nc, int ncol) {
+    scrappie_matrix Wpruned = NULL;
+    int nsmall = 0;
+    scrappie_matrix W = make_blocked_matrix(nr, nc, &Wpruned, &nsmall);
+    scrappie_matrix X = random_scrappie_matrix(nr, ncol, -1.0, 1.0);
+    scrappie_matrix b = random_scrappie_matrix(nc, 1, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(X);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+
+    const int nrblock = (nr + SMAT_BLOCK - 1) / SMAT_BLOCK;
+    const int nblock = nrblock * ((nc + PMAT_PANEL - 1) / PMAT_PANEL);
+    scrappie_smatrix sW = make_scrappie_smatrix(W, 0.0f);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sW);
+    CU_ASSERT_EQUAL(sW->nblock, nblock);
+    sW = free_scrappie_smatrix(sW);
+    const float sparsity = sparsity_for(nsmall, nblock);
+    sW = make_scrappie_smatrix(W, sparsity);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sW);
+    CU_ASSERT_EQUAL(sW->nblock, nblock - nsmall);
+
+    //  Product with pruned matrix is product with small blocks zeroed
+    scrappie_matrix C = affine_map(X, Wpruned, b, NULL);
+    CU_ASSERT_FATAL(set_weight_sparsity(&W, 1, sparsity));
+    CU_ASSERT_PTR_NOT_NULL(get_sparse_weights(W));
+    scrappie_matrix sC = affine_map(X, W, b, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32));
+    CU_ASSERT_PTR_NULL(get_sparse_weights(W));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(C);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sC);
+    CU_ASSERT(equality_scrappie_matrix(C, sC, 1e-4));
+
+    float * y = calloc(nc, sizeof(float));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(y);
+    sgemv(sW, X->data.f, y);
+    for (int c = 0; c < nc; c++) {
+        float expected = 0.0f;
+        for (int r = 0; r < nr; r++) {
+            expected += Wpruned->data.f[c * Wpruned->nrq * 4 + r] * X->data.f[r];
+        }
+        CU_ASSERT_DOUBLE_EQUAL(y[c], expected, 1e-4);
+    }
+
+    free(y);
+    sC = free_scrappie_matrix(sC);
+    C = free_scrappie_matrix(C);
+    sW = free_scrappie_smatrix(sW);
+    b = free_scrappie_matrix(b);
+    X = free_scrappie_matrix(X);
+    Wpruned = free_scrappie_matrix(Wpruned);
+    W = free_scrappie_matrix(W);
+}
+
+void test_smatrix_aligned(void) {
+    test_smatrix_helper(96, 192, 9);
+}
+
+void test_smatrix_unaligned(void) {
+    test_smatrix_helper(75, 37, 6);
+}
+
+
+void test_smatrix_close_to_dense(void) {
+    //  Output layer shape, whose final panel is the single column for staying
+    const int nr = 96;
+    const int nc = 1025;
+    scrappie_matrix W = random_scrappie_matrix(nr, nc, -0.5, 0.5);
+    scrappie_matrix X = random_scrappie_matrix(nr, 7, -1.0, 1.0);
+    scrappie_matrix b = random_scrappie_matrix(nc, 1, -1.0, 1.0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(X);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+
+    scrappie_matrix C = affine_map(X, W, b, NULL);
+    CU_ASSERT_FATAL(set_weight_sparsity(&W, 1, 0.05f));
+    scrappie_matrix sC = affine_map(X, W, b, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(C);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sC);
+
+    //  Partial panel is kept whole, and the rest loses little of its product
+    const size_t ldC = C->nrq * 4;
+    double err = 0.0, norm = 0.0;
+    for (int i = 0; i < C->nc; i++) {
+        CU_ASSERT_DOUBLE_EQUAL(sC->data.f[i * ldC + nc - 1], C->data.f[i * ldC + nc - 1], 1e-4);
+        for (int r = 0; r < nc; r++) {
+            const double d = sC->data.f[i * ldC + r] - C->data.f[i * ldC + r];
+            err += d * d;
+            norm += C->data.f[i * ldC + r] * C->data.f[i * ldC + r];
+        }
+    }
+    CU_ASSERT(err < 0.05 * norm);
+
+    sC = free_scrappie_matrix(sC);
+    C = free_scrappie_matrix(C);
+    b = free_scrappie_matrix(b);
+    X = free_scrappie_matrix(X);
+    W = free_scrappie_matrix(W);
+}
+
+
+void test_sparse_gru(void) {
+    const int size = 36;
+    scrappie_matrix xin = random_scrappie_matrix(3 * size, 23, -1.0, 1.0);
+    scrappie_matrix sW = random_scrappie_matrix(size, 2 * size, -0.5, 0.5);
+    scrappie_matrix sW2 = random_scrappie_matrix(size, size, -0.5, 0.5);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(xin);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sW);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sW2);
+    scrappie_matrix weights[2] = {sW, sW2};
+
+    //  Nothing pruned, so same as dense weights
+    scrappie_matrix out = gru_forward(xin, sW, sW2, NULL);
+    CU_ASSERT_FATAL(set_weight_sparsity(weights, 2, 0.0f));
+    scrappie_matrix sout = gru_forward(xin, sW, sW2, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32));
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(out);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sout);
+    CU_ASSERT(equality_scrappie_matrix(out, sout, 1e-5));
+
+    sout = free_scrappie_matrix(sout);
+    out = free_scrappie_matrix(out);
+    sW2 = free_scrappie_matrix(sW2);
+    sW = free_scrappie_matrix(sW);
+    xin = free_scrappie_matrix(xin);
+}
+
+
+void test_sparse_gru_pruned(void) {
+    const int size = 32;
+    scrappie_matrix xin = random_scrappie_matrix(3 * size, 23, -1.0, 1.0);
+    scrappie_matrix sWpruned = NULL, sW2pruned = NULL;
+    int nsmall = 0, nsmall2 = 0;
+    scrappie_matrix sW = make_blocked_matrix(size, 2 * size, &sWpruned, &nsmall);
+    scrappie_matrix sW2 = make_blocked_matrix(size, size, &sW2pruned, &nsmall2);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(xin);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sW);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sW2);
+    //  Half the blocks of each matrix are small
+    const int nblock2 = (size / SMAT_BLOCK) * (size / PMAT_PANEL);
+    CU_ASSERT_EQUAL_FATAL(2 * nsmall2, nblock2);
+    CU_ASSERT_EQUAL_FATAL(nsmall, nblock2);
+
+    //  Pruned GRU is GRU with small blocks zeroed
+    scrappie_matrix out = gru_forward(xin, sWpruned, sW2pruned, NULL);
+    scrappie_matrix weights[2] = {sW, sW2};
+    CU_ASSERT_FATAL(set_weight_sparsity(weights, 2, 0.5f));
+    scrappie_matrix sout = gru_forward(xin, sW, sW2, NULL);
+    CU_ASSERT_FATAL(set_weight_precision(NULL, 0, SCRAPPIE_PRECISION_FLOAT32));
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(out);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sout);
+    //  Order of summation differs, and differences grow through the recurrence
+    CU_ASSERT(equality_scrappie_matrix(out, sout, 1e-4));
+
+    sout = free_scrappie_matrix(sout);
+    out = free_scrappie_matrix(out);
+    sW2pruned = free_scrappie_matrix(sW2pruned);
+    sWpruned = free_scrappie_matrix(sWpruned);
+    sW2 = free_scrappie_matrix(sW2);
+    sW = free_scrappie_matrix(sW);
+    xin = free_scrappie_matrix(xin);
+}
+
+
+static test_with_description tests[] = {
+    {"Precision names round trip", test_precision_names},
+    {"Int8 gemv, aligned", test_qgemv_aligned},
+    {"Int8 gemv, unaligned", test_qgemv_unaligned},
+    {"Int8 affine map", test_int8_affine_map},
+    {"Int8 convolution, window 11 stride 2", test_int8_convolution_w11_s2},
+    {"Int8 convolution, window 4 stride 1", test_int8_convolution_w4_s1},
+    {"Float16 round trip", test_float16_round_trip},
+    {"Bfloat16 round trip", test_bfloat16_round_trip},
+    {"Float16 gemv", test_hgemv_float16},
+    {"Bfloat16 gemv", test_hgemv_bfloat16},
+    {"Float16 affine map", test_float16_affine_map},
+    {"Bfloat16 affine map", test_bfloat16_affine_map},
+    {"Float16 convolution", test_float16_convolution},
+    {"Packed gemv, aligned", test_pgemv_aligned},
+    {"Packed gemv, unaligned block of rows", test_pgemv_unaligned},
+    {"Packed gemm, strided", test_pgemm_strided},
+    {"Packed affine map", test_packed_affine_map},
+    {"Packed convolution, window 11 stride 2", test_packed_convolution_w11_s2},
+    {"Packed convolution, window 4 stride 1", test_packed_convolution_w4_s1},
+    {"Packed LSTM step", test_packed_lstm_step},
+    {"Packed GRU", test_packed_gru},
+    {"Specialised kernel, convolution shape", test_specialised_pgemm_convolution},
+    {"Specialised kernel, recurrent shape", test_specialised_pgemm_recurrent},
+    {"Specialised kernel, output shape", test_specialised_pgemm_output},
+    {"Specialised GRU step", test_specialised_gru},
+    {"Weights resolved to converted versions", test_resolved_weights},
+    {"Pruned matrix, aligned", test_smatrix_aligned},
+    {"Pruned matrix, unaligned", test_smatrix_unaligned},
+    {"Pruned matrix close to dense", test_smatrix_close_to_dense},
+    {"Pruned GRU", test_sparse_gru},
+    {"Pruned GRU with blocks zeroed", test_sparse_gru_pruned},
+    {0}};
+
+/**   Register tests with CUnit
+ *
+ *    @returns 0 on success, non-zero on failure
+ **/
+int register_test_precision(void) {
+    return scrappie_register_test_suite("Reduced precision, packed and pruned weights", init_test_precision, clean_test_precision, tests);
+}
@@ -0,0 +1,196 @@
+#define BANANA 1
+#include <CUnit/Basic.h>
+#include <math.h>
+#include <stdbool.h>
+
+#include "layers.h"
+#include "scrappie_util.h"
+#include "test_common.h"
+
+static const int lstm_size = 16;
+static const int lstm_nseq = 11;
+static const int gru_size = 12;
+static const int gru_ninput = 8;
+static const int gru_nblock = 37;
+
+/**  Initialise test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int init_test_recurrent(void) {
+    return 0;
+}
+
+/**  Clean up after test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int clean_test_recurrent(void) {
+    return 0;
+}
+
+static float logistic_ref(float x) {
+    return 1.0f / (1.0f + expf(-x));
+}
+
+/**  Simple implementation of a single LSTM step for one sequence
+ *
+ *   @param x Input vector, after affine transform [4 * size]
+ *   @param h Previous output [size]
+ *   @param sW Recurrent weights [size, 4 * size]
+ *   @param peep Peepholes [3 * size]
+ *   @param state State, updated in place [size]
+ *   @param out Output [size]
+ **/
+static void simple_lstm_step(const float * x, const float * h, const_scrappie_matrix sW,
+                             const float * peep, float * state, float * out) {
+    const int size = sW->nr;
+    const int ldW = sW->nrq * 4;
+    float gate[4 * size];
+    for (int j = 0; j < 4 * size; j++) {
+        gate[j] = x[j];
+        for (int k = 0; k < size; k++) {
+            gate[j] += sW->data.f[j * ldW + k] * h[k];
+        }
+    }
+    for (int u = 0; u < size; u++) {
+        const float update = logistic_ref(gate[size + u] + state[u] * peep[u]);
+        const float forget = logistic_ref(gate[2 * size + u] + state[u] * peep[size + u]);
+        state[u] = forget * state[u] + update * tanhf(gate[u]);
+        const float outgate = logistic_ref(gate[3 * size + u] + state[u] * peep[2 * size + u]);
+        out[u] = outgate * tanhf(state[u]);
+    }
+}
+
+/**  Apply LSTM step to each column of a matrix in turn
+ *
+ *   @param x Inputs, after affine transform [4 * size, nseq]
+ *   @param h Previous outputs [size, nseq]
+ *   @param sW Recurrent weights [size, 4 * size]
+ *   @param peep Peepholes [3 * size]
+ *   @param state States, updated in place [size, nseq]
+ *   @param out Outputs [size, nseq]
+ **/
+static void lstm_step_columns(const_scrappie_matrix x, const_scrappie_matrix h,
+                              const_scrappie_matrix sW, const_scrappie_matrix peep,
+                              scrappie_matrix state, scrappie_matrix out) {
+    _Mat xCol = *x, hCol = *h, stateCol = *state, outCol = *out;
+    xCol.nc = hCol.nc = stateCol.nc = outCol.nc = 1;
+    for (int b = 0; b < x->nc; b++) {
+        xCol.data.v = x->data.v + b * x->nrq;
+        hCol.data.v = h->data.v + b * h->nrq;
+        stateCol.data.v = state->data.v + b * state->nrq;
+        outCol.data.v = out->data.v + b * out->nrq;
+        lstm_step(&xCol, &hCol, sW, peep, &stateCol, &outCol);
+    }
+}
+
+void test_lstm_step(void) {
+    scrappie_matrix x = random_scrappie_matrix(4 * lstm_size, lstm_nseq, -1.0f, 1.0f);
+    scrappie_matrix h = random_scrappie_matrix(lstm_size, lstm_nseq, -1.0f, 1.0f);
+    scrappie_matrix sW = random_scrappie_matrix(lstm_size, 4 * lstm_size, -0.5f, 0.5f);
+    scrappie_matrix peep = random_scrappie_matrix(3 * lstm_size, 1, -0.5f, 0.5f);
+    scrappie_matrix state = random_scrappie_matrix(lstm_size, lstm_nseq, -1.0f, 1.0f);
+    scrappie_matrix out = make_scrappie_matrix(lstm_size, lstm_nseq);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(x);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(h);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sW);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(peep);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(state);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(out);
+
+    scrappie_matrix state_ref = copy_scrappie_matrix(state);
+    scrappie_matrix out_ref = make_scrappie_matrix(lstm_size, lstm_nseq);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(state_ref);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(out_ref);
+    for (int b = 0; b < lstm_nseq; b++) {
+        simple_lstm_step(x->data.f + b * x->nrq * 4, h->data.f + b * h->nrq * 4, sW,
+                         peep->data.f, state_ref->data.f + b * state_ref->nrq * 4,
+                         out_ref->data.f + b * out_ref->nrq * 4);
+    }
+
+    lstm_step_columns(x, h, sW, peep, state, out);
+
+    CU_ASSERT_TRUE(equality_scrappie_matrix(state_ref, state, 1e-5));
+    CU_ASSERT_TRUE(equality_scrappie_matrix(out_ref, out, 1e-5));
+
+    out_ref = free_scrappie_matrix(out_ref);
+    state_ref = free_scrappie_matrix(state_ref);
+    out = free_scrappie_matrix(out);
+    state = free_scrappie_matrix(state);
+    peep = free_scrappie_matrix(peep);
+    sW = free_scrappie_matrix(sW);
+    h = free_scrappie_matrix(h);
+    x = free_scrappie_matrix(x);
+}
+
+/**  Compare tiled GRU with a GRU applied to a precomputed input projection
+ *
+ *   @param backward Run GRU backwards in time
+ *   @param tile Number of blocks per tile
+ **/
+void test_gru_tiled_helper(bool backward, int tile) {
+    scrappie_matrix X = random_scrappie_matrix(gru_ninput, gru_nblock, -1.0f, 1.0f);
+    scrappie_matrix iW = random_scrappie_matrix(gru_ninput, 3 * gru_size, -0.5f, 0.5f);
+    scrappie_matrix b = random_scrappie_matrix(3 * gru_size, 1, -0.5f, 0.5f);
+    scrappie_matrix sW = random_scrappie_matrix(gru_size, 2 * gru_size, -0.5f, 0.5f);
+    scrappie_matrix sW2 = random_scrappie_matrix(gru_size, gru_size, -0.5f, 0.5f);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(X);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(iW);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sW);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sW2);
+
+    scrappie_matrix xin = feedforward_linear(X, iW, b, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(xin);
+    scrappie_matrix expected = backward ? gru_backward(xin, sW, sW2, NULL)
+                                        : gru_forward(xin, sW, sW2, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(expected);
+
+    scrappie_matrix tiled = backward ? gru_backward_tiled(X, iW, b, sW, sW2, tile, NULL)
+                                     : gru_forward_tiled(X, iW, b, sW, sW2, tile, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(tiled);
+
+    CU_ASSERT_TRUE(equality_scrappie_matrix(expected, tiled, 1e-5));
+
+    tiled = free_scrappie_matrix(tiled);
+    expected = free_scrappie_matrix(expected);
+    xin = free_scrappie_matrix(xin);
+    sW2 = free_scrappie_matrix(sW2);
+    sW = free_scrappie_matrix(sW);
+    b = free_scrappie_matrix(b);
+    iW = free_scrappie_matrix(iW);
+    X = free_scrappie_matrix(X);
+}
+
+void test_gru_forward_tiled(void) {
+    test_gru_tiled_helper(false, 8);
+}
+
+void test_gru_backward_tiled(void) {
+    test_gru_tiled_helper(true, 8);
+}
+
+void test_gru_forward_untiled(void) {
+    test_gru_tiled_helper(false, 0);
+}
+
+void test_gru_backward_untiled(void) {
+    test_gru_tiled_helper(true, 0);
+}
+
+static test_with_description tests[] = {
+    {"LSTM step against simple implementation", test_lstm_step},
+    {"Tiled forward GRU", test_gru_forward_tiled},
+    {"Tiled backward GRU", test_gru_backward_tiled},
+    {"Forward GRU with a single tile", test_gru_forward_untiled},
+    {"Backward GRU with a single tile", test_gru_backward_untiled},
+    {0}};
+
+/**   Register tests with CUnit
+ *
+ *    @returns 0 on success, non-zero on failure
+ **/
+int register_test_recurrent(void) {
+    return scrappie_register_test_suite("Recurrent layers", init_test_recurrent, clean_test_recurrent, tests);
+}
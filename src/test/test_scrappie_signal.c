@@ -3,6 +3,7 @@
 #include <stdbool.h>
 
 #include "layers.h"
+#include "nnfeatures.h"
 #include "scrappie_common.h"
 #include "scrappie_structures.h"
 #include "scrappie_util.h"
@@ -91,6 +92,71 @@ void test_trim_signal(void) {
     free(rt.raw);
 }
 
+//  DAQ values of raw signal, with the scaling used by test_trim_signal
+static daq_table daq_from_rawsignal(void) {
+    daq_table dt = {0};
+    dt.raw = calloc(rawsignal->nc, sizeof(int16_t));
+    if (NULL == dt.raw) {
+        return dt;
+    }
+    for(size_t i=0 ; i < rawsignal->nc ; i++){
+        dt.raw[i] = (int16_t)rawsignal->data.f[i * 4];
+    }
+    dt.n = dt.end = rawsignal->nc;
+    dt.range = 1373.41f;
+    dt.digitisation = 8192.0f;
+    dt.offset = 16.0f;
+    return dt;
+}
+
+void test_trim_daq(void) {
+    const int winlen = 100;
+    daq_table dt = daq_from_rawsignal();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dt.raw);
+
+    dt = trim_daq_by_mad(dt, winlen, 0.0f);
+    CU_ASSERT_EQUAL(dt.start, 0);
+    CU_ASSERT_EQUAL(dt.end, (dt.n / winlen) * winlen);
+
+    dt.start += 200;
+    dt.end -= 10;
+
+    raw_table rt = raw_table_from_daq(dt, true);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rt.raw);
+    CU_ASSERT_EQUAL(rt.start, dt.start);
+    CU_ASSERT_EQUAL(rt.end, dt.end);
+    scrappie_matrix mat_trim = mat_from_array(rt.raw + rt.start, 1, rt.end - rt.start);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mat_trim);
+    CU_ASSERT_EQUAL(mat_trim->nc, signal->nc);
+
+    CU_ASSERT_TRUE(equality_scrappie_matrix(mat_trim, signal, 1e-4));
+
+    (void)free_scrappie_matrix(mat_trim);
+    free(rt.raw);
+    free(dt.raw);
+}
+
+void test_features_from_daq(void) {
+    daq_table dt = daq_from_rawsignal();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dt.raw);
+    dt.start = 200;
+    dt.end = (dt.n / 100) * 100 - 10;
+
+    scrappie_matrix features = nanonet_features_from_daq(dt);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(features);
+    CU_ASSERT_EQUAL_FATAL(features->nc, normsignal->nc);
+    CU_ASSERT_TRUE(equality_scrappie_matrix(features, normsignal, 1e-4));
+    //  Padding of each column is zero
+    for(size_t i=0 ; i < features->nc ; i++){
+        CU_ASSERT_EQUAL(features->data.f[i * 4 + 1], 0.0f);
+        CU_ASSERT_EQUAL(features->data.f[i * 4 + 2], 0.0f);
+        CU_ASSERT_EQUAL(features->data.f[i * 4 + 3], 0.0f);
+    }
+
+    (void)free_scrappie_matrix(features);
+    free(dt.raw);
+}
+
 void test_normalise_signal(void) {
     float * sigarr = array_from_scrappie_matrix(signal);
     size_t n = signal->nc;
@@ -105,6 +171,8 @@ void test_normalise_signal(void) {
 static test_with_description tests[] = {
     {"Normalise trimmed signal", test_normalise_signal},
     {"Trimming of raw signal", test_trim_signal},
+    {"Trimming of raw signal as DAQ values", test_trim_daq},
+    {"Normalised features from DAQ values", test_features_from_daq},
     {0}};
 
 /**   Register tests with CUnit
@@ -0,0 +1,118 @@
+#define BANANA 1
+#include <CUnit/CUnit.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <scrappie_stdlib.h>
+#include <signal_codec.h>
+#include "test_common.h"
+
+
+/**  Initialise test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int init_test_signal_codec(void) {
+    return 0;
+}
+
+/**  Clean up after test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int clean_test_signal_codec(void) {
+    return 0;
+}
+
+
+//  Encode and decode signal, checking it is unchanged, and return encoded size
+static size_t roundtrip_helper(const int16_t * x, size_t n) {
+    uint8_t * enc = calloc(delta_varint_bound(n) + 1, sizeof(uint8_t));
+    int16_t * dec = calloc(n + 1, sizeof(int16_t));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(enc);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dec);
+
+    const size_t nbyte = encode_delta_varint(x, n, enc);
+    CU_ASSERT(nbyte <= delta_varint_bound(n));
+    CU_ASSERT(decode_delta_varint(enc, nbyte, dec, n));
+    CU_ASSERT(0 == memcmp(x, dec, n * sizeof(int16_t)));
+
+    //  Encoded signal of wrong length is rejected
+    if (n > 0) {
+        CU_ASSERT_FALSE(decode_delta_varint(enc, nbyte - 1, dec, n));
+        CU_ASSERT_FALSE(decode_delta_varint(enc, nbyte + 1, dec, n));
+    }
+
+    free(dec);
+    free(enc);
+    return nbyte;
+}
+
+
+void test_signal_codec_smooth(void) {
+    //  Slowly varying signal, as raw nanopore signal, of every length to
+    // cover the tail after whole blocks of eight samples
+    const size_t nmax = 200;
+    int16_t x[nmax];
+    for (size_t i = 0; i < nmax; i++) {
+        x[i] = 500 + (int16_t)((i * 7919) % 61) - 30;
+    }
+    for (size_t n = 0; n <= nmax; n++) {
+        const size_t nbyte = roundtrip_helper(x, n);
+        //  Differences fit in a byte, so a byte per sample and control,
+        // except the first sample which is relative to zero
+        CU_ASSERT_EQUAL(nbyte, (n + 7) / 8 + n + ((n > 0) ? 1 : 0));
+    }
+}
+
+
+void test_signal_codec_extremes(void) {
+    //  Differences wrap around the range of int16, so are all -32768, taking
+    // two bytes, except for the first sample
+    const size_t n = 67;
+    int16_t x[n];
+    for (size_t i = 0; i < n; i++) {
+        x[i] = (i % 2) ? INT16_MIN : 0;
+    }
+    CU_ASSERT_EQUAL(roundtrip_helper(x, n), (n + 7) / 8 + 2 * n - 1);
+
+    //  Alternating between largest and smallest values wraps to small differences
+    for (size_t i = 0; i < n; i++) {
+        x[i] = (i % 2) ? INT16_MIN : INT16_MAX;
+    }
+    CU_ASSERT_EQUAL(roundtrip_helper(x, n), (n + 7) / 8 + n + 1);
+}
+
+
+void test_signal_codec_random(void) {
+    const size_t n = 10007;
+    int16_t * x = calloc(n, sizeof(int16_t));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(x);
+    uint32_t state = 42;
+    int16_t level = 0;
+    for (size_t i = 0; i < n; i++) {
+        state = 1664525u * state + 1013904223u;
+        //  Mostly small steps with occasional large jumps
+        level += (0 == state % 97) ? (int16_t)(state >> 16) : (int16_t)((state >> 24) % 41) - 20;
+        x[i] = level;
+    }
+    roundtrip_helper(x, n);
+    free(x);
+}
+
+
+static test_with_description tests[] = {
+    {"Encode and decode smooth signal", test_signal_codec_smooth},
+    {"Encode and decode signal with extreme differences", test_signal_codec_extremes},
+    {"Encode and decode random signal", test_signal_codec_random},
+    {0}};
+
+/**   Register tests with CUnit
+ *
+ *    @returns 0 on success, non-zero on failure
+ **/
+int register_test_signal_codec(void) {
+    return scrappie_register_test_suite("Signal codec", init_test_signal_codec, clean_test_signal_codec, tests);
+}
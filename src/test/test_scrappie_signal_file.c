@@ -0,0 +1,260 @@
+#define BANANA 1
+#include <CUnit/CUnit.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fast5_interface.h>
+#include <scrappie_stdlib.h>
+#include <signal_file.h>
+#include "test_common.h"
+
+static const char * signal_file_name = "test_signal_file.ssf";
+static const char * unencoded_file_name = "test_signal_file_unencoded.ssf";
+static const char * empty_file_name = "test_signal_file_empty.ssf";
+static const char * bad_file_name = "test_signal_file_bad.ssf";
+
+//  Reads written out of order of read ID, and one read duplicated
+#define NREAD 4
+static const char * read_ids[NREAD] = {"f00d", "0a1b2c", "c0ffee", "0a1b2c"};
+static const size_t read_nsample[NREAD] = {100, 257, 1, 33};
+
+
+static int16_t test_signal(size_t r, size_t i) {
+    return (int16_t)(1000 * r - (i * 37) % 2000);
+}
+
+
+static daq_table test_read(size_t r) {
+    int16_t * raw = calloc(read_nsample[r], sizeof(int16_t));
+    for (size_t i = 0; i < read_nsample[r]; i++) {
+        raw[i] = test_signal(r, i);
+    }
+    return (daq_table){read_nsample[r], 0, read_nsample[r], 4.0f + r, 1402.882f, 8192.0f, raw};
+}
+
+
+//  Write test reads to signal file
+static bool write_test_signal_file(const char * fn, enum signal_encoding encoding) {
+    struct signal_file_writer * writer = make_signal_file_writer(fn, encoding);
+    RETURN_NULL_IF(NULL == writer, false);
+    bool ok = true;
+    for (size_t r = 0; r < NREAD; r++) {
+        daq_table dt = test_read(r);
+        ok = ok && write_signal_file_read(writer, read_ids[r], dt);
+        free(dt.raw);
+    }
+    return close_signal_file_writer(writer) && ok;
+}
+
+
+/**  Initialise test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int init_test_signal_file(void) {
+    bool ok = write_test_signal_file(signal_file_name, SIGNAL_ENCODING_DELTA_VARINT);
+    ok = ok && write_test_signal_file(unencoded_file_name, SIGNAL_ENCODING_RAW);
+
+    struct signal_file_writer * writer = make_signal_file_writer(empty_file_name, SIGNAL_ENCODING_DELTA_VARINT);
+    ok = ok && NULL != writer && close_signal_file_writer(writer);
+
+    //  Header claims more signal than the file holds
+    const struct signal_file_header header = {
+        .magic = SIGNAL_FILE_MAGIC,
+        .version = SIGNAL_FILE_VERSION,
+        .byte_order = SIGNAL_FILE_BYTE_ORDER,
+        .signal_size = 1000,
+        .signal_offset = sizeof(struct signal_file_header),
+        .names_offset = sizeof(struct signal_file_header),
+        .index_offset = sizeof(struct signal_file_header)
+    };
+    FILE * fh = fopen(bad_file_name, "wb");
+    ok = ok && NULL != fh && 1 == fwrite(&header, sizeof(header), 1, fh);
+    if (NULL != fh) {
+        fclose(fh);
+    }
+
+    return ok ? 0 : 1;
+}
+
+/**  Clean up after test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int clean_test_signal_file(void) {
+    int ret = unlink(signal_file_name);
+    ret |= unlink(unencoded_file_name);
+    ret |= unlink(empty_file_name);
+    ret |= unlink(bad_file_name);
+    return ret;
+}
+
+
+//  Check DAQ table holds signal of read r
+static bool check_read_daq(daq_table dt, size_t r) {
+    if (NULL == dt.raw || read_nsample[r] != dt.n || 0 != dt.start || dt.n != dt.end) {
+        return false;
+    }
+    if (4.0f + r != dt.offset || 1402.882f != dt.range || 8192.0f != dt.digitisation) {
+        return false;
+    }
+    for (size_t i = 0; i < dt.n; i++) {
+        if (test_signal(r, i) != dt.raw[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void test_signal_file_open(void) {
+    CU_ASSERT_TRUE(is_signal_file(signal_file_name));
+    CU_ASSERT_FALSE(is_signal_file("../../reads/MINICOL228_20161012_FNFAB42578_MN17976_mux_scan_HG_52221_ch271_read66_strand.fast5"));
+    CU_ASSERT_FALSE(is_signal_file("no_such_file.ssf"));
+
+    struct signal_file * sf = open_signal_file(signal_file_name);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sf);
+    //  Duplicate read is dropped and index sorted by read ID
+    CU_ASSERT_EQUAL_FATAL(sf->nread, NREAD - 1);
+    CU_ASSERT_STRING_EQUAL(signal_file_read_id(sf, 0), "0a1b2c");
+    CU_ASSERT_STRING_EQUAL(signal_file_read_id(sf, 1), "c0ffee");
+    CU_ASSERT_STRING_EQUAL(signal_file_read_id(sf, 2), "f00d");
+    CU_ASSERT_PTR_NULL(signal_file_read_id(sf, NREAD - 1));
+    sf = free_signal_file(sf);
+}
+
+
+static void signal_file_by_id_helper(const char * fn) {
+    struct signal_file * sf = open_signal_file(fn);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sf);
+    for (size_t r = 0; r < NREAD - 1; r++) {
+        const ssize_t idx = signal_file_read_index(sf, read_ids[r]);
+        CU_ASSERT_FATAL(idx >= 0);
+        daq_table dt = read_daq_from_signal_file(sf, idx);
+        CU_ASSERT(check_read_daq(dt, r));
+        free(dt.raw);
+    }
+    CU_ASSERT_EQUAL(signal_file_read_index(sf, "0a"), -1);
+    CU_ASSERT_EQUAL(signal_file_read_index(sf, "zzz"), -1);
+    daq_table dt = read_daq_from_signal_file(sf, NREAD - 1);
+    CU_ASSERT_PTR_NULL(dt.raw);
+    sf = free_signal_file(sf);
+}
+
+
+void test_signal_file_by_id(void) {
+    signal_file_by_id_helper(signal_file_name);
+}
+
+
+void test_signal_file_unencoded(void) {
+    signal_file_by_id_helper(unencoded_file_name);
+}
+
+
+//  Stream over signal file returns every read in the order of the index
+static void signal_file_stream_helper(const char * fn, size_t depth, bool use_uring) {
+    struct signal_file * sf = open_signal_file(fn);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sf);
+    struct signal_file_stream * stream = make_signal_file_stream(sf, depth, use_uring);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(stream);
+
+    const size_t order[NREAD - 1] = {1, 2, 0};
+    size_t idx;
+    daq_table dt;
+    size_t nbyte = 0;
+    for (size_t i = 0; i < NREAD - 1; i++) {
+        CU_ASSERT_FATAL(next_signal_file_stream(stream, &idx, &dt));
+        CU_ASSERT_EQUAL(idx, i);
+        CU_ASSERT(check_read_daq(dt, order[i]));
+        free(dt.raw);
+        nbyte += sf->index[i].nbyte;
+    }
+    CU_ASSERT_FALSE(next_signal_file_stream(stream, &idx, &dt));
+    CU_ASSERT_EQUAL(stream->nbyte, nbyte);
+
+    stream = free_signal_file_stream(stream);
+    sf = free_signal_file(sf);
+}
+
+
+void test_signal_file_stream(void) {
+    for (size_t depth = 1; depth <= NREAD; depth++) {
+        signal_file_stream_helper(signal_file_name, depth, true);
+        signal_file_stream_helper(signal_file_name, depth, false);
+        signal_file_stream_helper(unencoded_file_name, depth, true);
+    }
+}
+
+
+void test_signal_file_invalid(void) {
+    struct signal_file * sf = open_signal_file(empty_file_name);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(sf);
+    CU_ASSERT_EQUAL(sf->nread, 0);
+    CU_ASSERT_EQUAL(signal_file_read_index(sf, read_ids[0]), -1);
+    sf = free_signal_file(sf);
+
+    CU_ASSERT_PTR_NULL(open_signal_file(bad_file_name));
+    CU_ASSERT_PTR_NULL(open_signal_file("no_such_file.ssf"));
+}
+
+
+static void signal_file_reader_helper(size_t io_depth) {
+    //  Signal file given alongside a fast5 file
+    char * paths[3] = {(char *)signal_file_name,
+                       "../../reads/MINICOL228_20161012_FNFAB42578_MN17976_mux_scan_HG_52221_ch271_read66_strand.fast5",
+                       NULL};
+    struct fast5_reader * reader = make_fast5_reader(paths);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reader);
+    reader->io_depth = io_depth;
+
+    const size_t order[NREAD - 1] = {1, 2, 0};
+    struct fast5_read read;
+    for (size_t i = 0; i < NREAD - 1; i++) {
+        CU_ASSERT_FATAL(next_fast5_read(reader, &read));
+        CU_ASSERT_STRING_EQUAL(read.name, read_ids[order[i]]);
+        CU_ASSERT(check_read_daq(read.dt, order[i]));
+        free(read.dt.raw);
+        free(read.name);
+    }
+    CU_ASSERT_FATAL(next_fast5_read(reader, &read));
+    CU_ASSERT_STRING_EQUAL(read.name, "MINICOL228_20161012_FNFAB42578_MN17976_mux_scan_HG_52221_ch271_read66_strand.fast5");
+    free(read.dt.raw);
+    free(read.name);
+    CU_ASSERT_FALSE(next_fast5_read(reader, &read));
+    CU_ASSERT_EQUAL(reader->io_nbyte > 0, io_depth > 0);
+    reader = free_fast5_reader(reader);
+}
+
+
+void test_signal_file_reader(void) {
+    signal_file_reader_helper(0);
+}
+
+
+void test_signal_file_reader_stream(void) {
+    signal_file_reader_helper(2);
+}
+
+
+static test_with_description tests[] = {
+    {"Open signal file", test_signal_file_open},
+    {"Read signal file by read ID", test_signal_file_by_id},
+    {"Read signal file with unencoded signal", test_signal_file_unencoded},
+    {"Stream reads of signal file", test_signal_file_stream},
+    {"Empty and invalid signal files", test_signal_file_invalid},
+    {"Reader over signal and fast5 files", test_signal_file_reader},
+    {"Reader streaming signal files", test_signal_file_reader_stream},
+    {0}};
+
+/**   Register tests with CUnit
+ *
+ *    @returns 0 on success, non-zero on failure
+ **/
+int register_test_signal_file(void) {
+    return scrappie_register_test_suite("Scrappie signal files", init_test_signal_file, clean_test_signal_file, tests);
+}
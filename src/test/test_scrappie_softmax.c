@@ -0,0 +1,119 @@
+#define BANANA 1
+#include <CUnit/Basic.h>
+#include <stdbool.h>
+
+#include "layers.h"
+#include "scrappie_util.h"
+#include "test_common.h"
+#include "util.h"
+
+static const int softmax_ninput = 96;
+static const int softmax_nblock = 50;
+
+/**  Initialise test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int init_test_softmax(void) {
+    return 0;
+}
+
+/**  Clean up after test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int clean_test_softmax(void) {
+    return 0;
+}
+
+/**  Compare fused log-softmax with softmax followed by robust log
+ *
+ *   @param nout Number of outputs of softmax layer
+ *   @param min_prob Minimum probability
+ **/
+void test_logsoftmax_helper(int nout, float min_prob) {
+    scrappie_matrix X = random_scrappie_matrix(softmax_ninput, softmax_nblock, -1.0f, 1.0f);
+    scrappie_matrix W = random_scrappie_matrix(softmax_ninput, nout, -1.0f, 1.0f);
+    scrappie_matrix b = random_scrappie_matrix(nout, 1, -1.0f, 1.0f);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(X);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+
+    scrappie_matrix expected = softmax(X, W, b, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(expected);
+    robustlog_activation_inplace(expected, min_prob);
+
+    scrappie_matrix fused = logsoftmax(X, W, b, min_prob, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(fused);
+
+    CU_ASSERT_TRUE(equality_scrappie_matrix(expected, fused, 1e-4));
+
+    fused = free_scrappie_matrix(fused);
+    expected = free_scrappie_matrix(expected);
+    b = free_scrappie_matrix(b);
+    W = free_scrappie_matrix(W);
+    X = free_scrappie_matrix(X);
+}
+
+void test_logsoftmax_nout8(void) {
+    test_logsoftmax_helper(8, 1e-5f);
+}
+
+void test_logsoftmax_nout9(void) {
+    test_logsoftmax_helper(9, 1e-5f);
+}
+
+void test_logsoftmax_nout1025(void) {
+    test_logsoftmax_helper(1025, 1e-5f);
+}
+
+void test_logsoftmax_noprob(void) {
+    test_logsoftmax_helper(1025, 0.0f);
+}
+
+/**  Unfloored log-softmax follows the approximation level
+ *
+ *   The coarse approximation to the exponential should change the result
+ *   slightly from that with exact functions.
+ **/
+void test_logsoftmax_noprob_approx(void) {
+    scrappie_matrix X = random_scrappie_matrix(softmax_ninput, softmax_nblock, -1.0f, 1.0f);
+    scrappie_matrix W = random_scrappie_matrix(softmax_ninput, 1025, -1.0f, 1.0f);
+    scrappie_matrix b = random_scrappie_matrix(1025, 1, -1.0f, 1.0f);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(X);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(W);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+
+    set_math_approx(MATH_APPROX_EXACT);
+    scrappie_matrix exact = logsoftmax(X, W, b, 0.0f, NULL);
+    set_math_approx(MATH_APPROX_SCHRAUDOLPH);
+    scrappie_matrix coarse = logsoftmax(X, W, b, 0.0f, NULL);
+    set_math_approx(MATH_APPROX_POLYNOMIAL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(exact);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(coarse);
+
+    CU_ASSERT_FALSE(equality_scrappie_matrix(exact, coarse, 1e-5));
+    CU_ASSERT_TRUE(equality_scrappie_matrix(exact, coarse, 0.1));
+
+    coarse = free_scrappie_matrix(coarse);
+    exact = free_scrappie_matrix(exact);
+    b = free_scrappie_matrix(b);
+    W = free_scrappie_matrix(W);
+    X = free_scrappie_matrix(X);
+}
+
+static test_with_description tests[] = {
+    {"Fused log-softmax with 8 outputs", test_logsoftmax_nout8},
+    {"Fused log-softmax with 9 outputs", test_logsoftmax_nout9},
+    {"Fused log-softmax with 1025 outputs", test_logsoftmax_nout1025},
+    {"Fused log-softmax without minimum probability", test_logsoftmax_noprob},
+    {"Fused log-softmax without minimum probability follows approximation", test_logsoftmax_noprob_approx},
+    {0}};
+
+/**   Register tests with CUnit
+ *
+ *    @returns 0 on success, non-zero on failure
+ **/
+int register_test_softmax(void) {
+    return scrappie_register_test_suite("Softmax output layers", init_test_softmax, clean_test_softmax, tests);
+}
@@ -0,0 +1,386 @@
+#define BANANA 1
+#include <CUnit/CUnit.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fast5_interface.h>
+#include <scrappie_stdlib.h>
+#include <tar_reader.h>
+#include "test_common.h"
+
+static const char * tar_file_name = "test_reads.tar";
+static const char * bad_tar_file_name = "test_bad_checksum.tar";
+static const char * odd_tar_file_name = "test_odd_members.tar";
+static const char * fast5_file_names[2] = {
+    "../../reads/MINICOL228_20161012_FNFAB42578_MN17976_mux_scan_HG_52221_ch271_read66_strand.fast5",
+    "../../reads/MINICOL228_20161012_FNFAB42578_MN17976_mux_scan_HG_52221_ch174_read172_strand.fast5"};
+static uint8_t * fast5_data[2] = {NULL, NULL};
+static size_t fast5_size[2] = {0, 0};
+
+static const char notes[] = "Not a fast5 file\n";
+//  Too long for the name field of a header, so written as a GNU long name
+static const char * long_name = "reads/a_directory_with_a_name_long_enough_that_the_path_of_the_file_in_it"
+                                "_overflows_the_one_hundred_bytes_of_a_tar_header/long.fast5";
+
+//  Members of archive, in order, as read with no suffix given
+#define NMEMBER 5
+static const char * member_names[NMEMBER];
+static const uint8_t * member_data[NMEMBER];
+static size_t member_size[NMEMBER];
+
+
+/**  Read whole file into memory
+ *
+ *   @returns Contents of file, to be freed by caller, or NULL on failure
+ **/
+static uint8_t * read_whole_file(const char * fn, size_t * size) {
+    FILE * fh = fopen(fn, "rb");
+    RETURN_NULL_IF(NULL == fh, NULL);
+    fseek(fh, 0, SEEK_END);
+    const long len = ftell(fh);
+    fseek(fh, 0, SEEK_SET);
+    uint8_t * data = (len > 0) ? malloc(len) : NULL;
+    if (NULL != data && 1 != fread(data, len, 1, fh)) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fh);
+    *size = (NULL != data) ? len : 0;
+    return data;
+}
+
+
+/**  Write POSIX ustar header
+ *
+ *   @param fh File to write to
+ *   @param name Name of member, truncated to the 100 bytes of the field
+ *   @param prefix Prefix of name, or NULL
+ *   @param size Size of member
+ *   @param type Type flag of member
+ *
+ *   @returns true on success
+ **/
+static bool write_tar_header(FILE * fh, const char * name, const char * prefix,
+                             size_t size, char type) {
+    char block[TAR_BLOCK_SIZE] = {0};
+    strncpy(block, name, 100);
+    snprintf(block + 100, 8, "%07o", 0644);
+    snprintf(block + 108, 8, "%07o", 0);
+    snprintf(block + 116, 8, "%07o", 0);
+    snprintf(block + 124, 12, "%011zo", size);
+    snprintf(block + 136, 12, "%011o", 0);
+    block[156] = type;
+    memcpy(block + 257, "ustar\0" "00", 8);
+    if (NULL != prefix) {
+        strncpy(block + 345, prefix, 155);
+    }
+
+    memset(block + 148, ' ', 8);
+    unsigned int chksum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; i++) {
+        chksum += (uint8_t)block[i];
+    }
+    snprintf(block + 148, 7, "%06o", chksum);
+    return 1 == fwrite(block, TAR_BLOCK_SIZE, 1, fh);
+}
+
+
+//  Write data of member, padded to a whole number of blocks
+static bool write_tar_data(FILE * fh, const void * data, size_t size) {
+    const char zero[TAR_BLOCK_SIZE] = {0};
+    const size_t pad = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+    return size == fwrite(data, 1, size, fh) && pad == fwrite(zero, 1, pad, fh);
+}
+
+
+/**  Write archive of both fast5 files and others that should be skipped
+ *
+ *   Members are a directory, a text file, a fast5 file named in its header,
+ *   one with a GNU long name, one named by a pax extended header and one
+ *   whose name is split into prefix and name.
+ *
+ *   @returns true on success
+ **/
+static bool write_test_archive(const char * fn) {
+    FILE * fh = fopen(fn, "wb");
+    RETURN_NULL_IF(NULL == fh, false);
+    bool ok = write_tar_header(fh, "reads/", NULL, 0, '5');
+
+    ok = ok && write_tar_header(fh, "reads/notes.txt", NULL, sizeof(notes) - 1, '0');
+    ok = ok && write_tar_data(fh, notes, sizeof(notes) - 1);
+
+    ok = ok && write_tar_header(fh, "reads/single.fast5", NULL, fast5_size[0], '0');
+    ok = ok && write_tar_data(fh, fast5_data[0], fast5_size[0]);
+
+    const size_t long_name_len = strlen(long_name);
+    ok = ok && write_tar_header(fh, "././@LongLink", NULL, long_name_len + 1, 'L');
+    ok = ok && write_tar_data(fh, long_name, long_name_len + 1);
+    ok = ok && write_tar_header(fh, long_name, NULL, fast5_size[1], '0');
+    ok = ok && write_tar_data(fh, fast5_data[1], fast5_size[1]);
+
+    //  Length of record includes the digits of the length itself
+    const char pax[] = "26 path=pax/dir/pax.fast5\n";
+    ok = ok && write_tar_header(fh, "PaxHeaders/pax.fast5", NULL, sizeof(pax) - 1, 'x');
+    ok = ok && write_tar_data(fh, pax, sizeof(pax) - 1);
+    ok = ok && write_tar_header(fh, "truncated.fast5", NULL, fast5_size[0], '0');
+    ok = ok && write_tar_data(fh, fast5_data[0], fast5_size[0]);
+
+    ok = ok && write_tar_header(fh, "prefixed.fast5", "prefix/dir", fast5_size[1], '0');
+    ok = ok && write_tar_data(fh, fast5_data[1], fast5_size[1]);
+
+    const char zero[2 * TAR_BLOCK_SIZE] = {0};
+    ok = ok && 1 == fwrite(zero, 2 * TAR_BLOCK_SIZE, 1, fh);
+    fclose(fh);
+    return ok;
+}
+
+
+/**  Initialise test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int init_test_tar(void) {
+    for (size_t i = 0; i < 2; i++) {
+        fast5_data[i] = read_whole_file(fast5_file_names[i], fast5_size + i);
+        if (NULL == fast5_data[i]) {
+            return 1;
+        }
+    }
+    const char * names[NMEMBER] = {"reads/notes.txt", "reads/single.fast5", long_name,
+                                   "pax/dir/pax.fast5", "prefix/dir/prefixed.fast5"};
+    const uint8_t * data[NMEMBER] = {(const uint8_t *)notes, fast5_data[0], fast5_data[1],
+                                     fast5_data[0], fast5_data[1]};
+    const size_t size[NMEMBER] = {sizeof(notes) - 1, fast5_size[0], fast5_size[1],
+                                  fast5_size[0], fast5_size[1]};
+    for (size_t i = 0; i < NMEMBER; i++) {
+        member_names[i] = names[i];
+        member_data[i] = data[i];
+        member_size[i] = size[i];
+    }
+
+    if (!write_test_archive(tar_file_name)) {
+        return 1;
+    }
+
+    //  Copy of archive with the header of the second fast5 file corrupted
+    size_t tar_size;
+    uint8_t * tar = read_whole_file(tar_file_name, &tar_size);
+    if (NULL == tar) {
+        return 1;
+    }
+    const size_t header = 4 * TAR_BLOCK_SIZE + fast5_size[0]
+                        + (TAR_BLOCK_SIZE - fast5_size[0] % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+    tar[header + 2 * TAR_BLOCK_SIZE + 10] ^= 1;
+    FILE * fh = fopen(bad_tar_file_name, "wb");
+    bool ok = NULL != fh && 1 == fwrite(tar, tar_size, 1, fh);
+    if (NULL != fh) {
+        fclose(fh);
+    }
+    free(tar);
+    return ok ? 0 : 1;
+}
+
+/**  Clean up after test
+ *
+ *   @returns 0 on success, non-zero on failure
+ **/
+int clean_test_tar(void) {
+    for (size_t i = 0; i < 2; i++) {
+        free(fast5_data[i]);
+        fast5_data[i] = NULL;
+    }
+    return unlink(tar_file_name) | unlink(bad_tar_file_name);
+}
+
+
+void test_tar_filename(void) {
+    CU_ASSERT(is_tar_filename("reads.tar"));
+    CU_ASSERT(is_tar_filename("/path/to/reads.tar"));
+    CU_ASSERT_FALSE(is_tar_filename(".tar"));
+    CU_ASSERT_FALSE(is_tar_filename("reads.tar.gz"));
+    CU_ASSERT_FALSE(is_tar_filename("reads.fast5"));
+}
+
+
+void test_tar_members(void) {
+    struct tar_reader * tar = open_tar_reader(tar_file_name);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(tar);
+    struct tar_member member;
+    for (size_t i = 0; i < NMEMBER; i++) {
+        CU_ASSERT_FATAL(next_tar_member(tar, NULL, &member));
+        CU_ASSERT_STRING_EQUAL(member.name, member_names[i]);
+        CU_ASSERT_EQUAL(member.size, member_size[i]);
+        CU_ASSERT(0 == memcmp(member.data, member_data[i], member_size[i]));
+        free(member.name);
+    }
+    CU_ASSERT_FALSE(next_tar_member(tar, NULL, &member));
+    tar = free_tar_reader(tar);
+}
+
+
+void test_tar_members_by_suffix(void) {
+    struct tar_reader * tar = open_tar_reader(tar_file_name);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(tar);
+    struct tar_member member;
+    //  Text file is skipped
+    for (size_t i = 1; i < NMEMBER; i++) {
+        CU_ASSERT_FATAL(next_tar_member(tar, ".fast5", &member));
+        CU_ASSERT_STRING_EQUAL(member.name, member_names[i]);
+        CU_ASSERT_EQUAL(member.size, member_size[i]);
+        free(member.name);
+    }
+    CU_ASSERT_FALSE(next_tar_member(tar, ".fast5", &member));
+    tar = free_tar_reader(tar);
+}
+
+
+void test_tar_bad_checksum(void) {
+    struct tar_reader * tar = open_tar_reader(bad_tar_file_name);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(tar);
+    struct tar_member member;
+    CU_ASSERT_FATAL(next_tar_member(tar, ".fast5", &member));
+    CU_ASSERT_STRING_EQUAL(member.name, member_names[1]);
+    free(member.name);
+    CU_ASSERT_FALSE(next_tar_member(tar, ".fast5", &member));
+    tar = free_tar_reader(tar);
+
+    CU_ASSERT_PTR_NULL(open_tar_reader("no_such_file.tar"));
+}
+
+
+void test_tar_fast5_reader(void) {
+    //  Archive given alongside one of the files it contains
+    char * paths[3] = {(char *)tar_file_name, (char *)fast5_file_names[0], NULL};
+    struct fast5_reader * reader = make_fast5_reader(paths);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reader);
+
+    const char * names[5] = {"single.fast5", "long.fast5", "pax.fast5", "prefixed.fast5",
+                             "MINICOL228_20161012_FNFAB42578_MN17976_mux_scan_HG_52221_ch271_read66_strand.fast5"};
+    const size_t source[5] = {0, 1, 0, 1, 0};
+    daq_table expected[2] = {read_daq(fast5_file_names[0]), read_daq(fast5_file_names[1])};
+    CU_ASSERT_PTR_NOT_NULL_FATAL(expected[0].raw);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(expected[1].raw);
+
+    struct fast5_read read;
+    for (size_t i = 0; i < 5; i++) {
+        CU_ASSERT_FATAL(next_fast5_read(reader, &read));
+        CU_ASSERT_STRING_EQUAL(read.name, names[i]);
+        const daq_table dt = expected[source[i]];
+        CU_ASSERT_EQUAL_FATAL(read.dt.n, dt.n);
+        CU_ASSERT(0 == memcmp(read.dt.raw, dt.raw, dt.n * sizeof(dt.raw[0])));
+        CU_ASSERT_EQUAL(read.dt.offset, dt.offset);
+        CU_ASSERT_EQUAL(read.dt.range, dt.range);
+        CU_ASSERT_EQUAL(read.dt.digitisation, dt.digitisation);
+        free(read.dt.raw);
+        free(read.name);
+    }
+    CU_ASSERT_FALSE(next_fast5_read(reader, &read));
+    CU_ASSERT_EQUAL(reader->nfile_open, 5);
+    reader = free_fast5_reader(reader);
+    free(expected[0].raw);
+    free(expected[1].raw);
+}
+
+
+void test_tar_claimed_reads(void) {
+    //  Reads are read after the reader has moved on through the archive
+    char * paths[2] = {(char *)tar_file_name, NULL};
+    struct fast5_reader * reader = make_fast5_reader(paths);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reader);
+
+    const size_t source[4] = {0, 1, 0, 1};
+    daq_table expected[2] = {read_daq(fast5_file_names[0]), read_daq(fast5_file_names[1])};
+    CU_ASSERT_PTR_NOT_NULL_FATAL(expected[0].raw);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(expected[1].raw);
+
+    struct fast5_read_claim claims[4];
+    for (size_t i = 0; i < 4; i++) {
+        CU_ASSERT_FATAL(claim_fast5_read(reader, claims + i));
+    }
+    CU_ASSERT_FALSE(claim_fast5_read(reader, claims));
+    reader = free_fast5_reader(reader);
+
+    for (size_t i = 4; i > 0; i--) {
+        struct fast5_read read;
+        CU_ASSERT_FATAL(finish_fast5_read(claims + i - 1, &read));
+        const daq_table dt = expected[source[i - 1]];
+        CU_ASSERT_EQUAL_FATAL(read.dt.n, dt.n);
+        CU_ASSERT(0 == memcmp(read.dt.raw, dt.raw, dt.n * sizeof(dt.raw[0])));
+        free(read.dt.raw);
+        free(read.name);
+    }
+    free(expected[0].raw);
+    free(expected[1].raw);
+}
+
+
+void test_tar_odd_members(void) {
+    //  Empty fast5 file is skipped by the reader, rather than opened
+    FILE * fh = fopen(odd_tar_file_name, "wb");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(fh);
+    bool ok = write_tar_header(fh, "empty.fast5", NULL, 0, '0');
+    ok = ok && write_tar_header(fh, "single.fast5", NULL, fast5_size[0], '0');
+    ok = ok && write_tar_data(fh, fast5_data[0], fast5_size[0]);
+    const char zero[2 * TAR_BLOCK_SIZE] = {0};
+    ok = ok && 1 == fwrite(zero, 2 * TAR_BLOCK_SIZE, 1, fh);
+    fclose(fh);
+    CU_ASSERT_FATAL(ok);
+
+    char * paths[2] = {(char *)odd_tar_file_name, NULL};
+    struct fast5_reader * reader = make_fast5_reader(paths);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reader);
+    struct fast5_read read;
+    CU_ASSERT_FATAL(next_fast5_read(reader, &read));
+    CU_ASSERT_STRING_EQUAL(read.name, "single.fast5");
+    free(read.dt.raw);
+    free(read.name);
+    CU_ASSERT_FALSE(next_fast5_read(reader, &read));
+    reader = free_fast5_reader(reader);
+
+    //  Pax records too short to hold their length, a space and a newline,
+    //  or without a key and value, are rejected
+    const char * bad_pax[4] = {"0 path=a\n", "2 path=a\n", "3 \n", "6 path\n"};
+    for (size_t i = 0; i < 4; i++) {
+        const size_t pax_len = strlen(bad_pax[i]);
+        fh = fopen(odd_tar_file_name, "wb");
+        CU_ASSERT_PTR_NOT_NULL_FATAL(fh);
+        ok = write_tar_header(fh, "PaxHeaders/pax.fast5", NULL, pax_len, 'x');
+        ok = ok && write_tar_data(fh, bad_pax[i], pax_len);
+        ok = ok && write_tar_header(fh, "pax.fast5", NULL, fast5_size[0], '0');
+        ok = ok && write_tar_data(fh, fast5_data[0], fast5_size[0]);
+        ok = ok && 1 == fwrite(zero, 2 * TAR_BLOCK_SIZE, 1, fh);
+        fclose(fh);
+        CU_ASSERT_FATAL(ok);
+
+        struct tar_reader * tar = open_tar_reader(odd_tar_file_name);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(tar);
+        struct tar_member member;
+        CU_ASSERT_FALSE(next_tar_member(tar, NULL, &member));
+        tar = free_tar_reader(tar);
+    }
+
+    CU_ASSERT_EQUAL(unlink(odd_tar_file_name), 0);
+}
+
+
+static test_with_description tests[] = {
+    {"Archives recognised by name", test_tar_filename},
+    {"Members of tar archive", test_tar_members},
+    {"Members of tar archive with suffix", test_tar_members_by_suffix},
+    {"Tar archive with invalid header", test_tar_bad_checksum},
+    {"Reads of fast5 files in tar archive", test_tar_fast5_reader},
+    {"Reads claimed from tar archive read later", test_tar_claimed_reads},
+    {"Empty members and malformed pax headers", test_tar_odd_members},
+    {0}};
+
+/**   Register tests with CUnit
+ *
+ *    @returns 0 on success, non-zero on failure
+ **/
+int register_test_tar(void) {
+    return scrappie_register_test_suite("Tar archives", init_test_tar, clean_test_tar, tests);
+}
@@ -1,6 +1,8 @@
 #define BANANA 1
 #include <CUnit/Basic.h>
+#include <math.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include <util.h>
 #include <test_common.h>
@@ -33,9 +35,187 @@ void test_median_even_util(void) {
     CU_ASSERT_DOUBLE_EQUAL(med, 1.5f, 1e-5);
 }
 
+//  Histogram median and MAD of int16 should equal those of float
+static void medmad_int16_helper(const int16_t * x, size_t n) {
+    float * xf = calloc(n, sizeof(float));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(xf);
+    for (size_t i = 0; i < n; i++) {
+        xf[i] = x[i];
+    }
+    float med, mad;
+    CU_ASSERT_FATAL(medmad_int16(x, n, &med, &mad));
+    CU_ASSERT_EQUAL(med, medianf(xf, n));
+    CU_ASSERT_EQUAL(mad, madf(xf, n, NULL));
+    free(xf);
+}
+
+void test_medmad_int16_util(void) {
+    const size_t nmax = 301;
+    int16_t x[nmax + 1];
+    for (size_t n = 1; n <= nmax; n += 20) {
+        //  Spread of values, including negative
+        for (size_t i = 0; i < n; i++) {
+            x[i] = (int16_t)((i * 7919) % 523) - 200;
+        }
+        medmad_int16_helper(x, n);
+        medmad_int16_helper(x, n + 1);
+
+        //  Few distinct values, so many ties
+        for (size_t i = 0; i < n; i++) {
+            x[i] = (int16_t)(i % 3) + 450;
+        }
+        medmad_int16_helper(x, n);
+        medmad_int16_helper(x, n + 1);
+    }
+
+    const int16_t extremes[4] = {INT16_MIN, INT16_MAX, 0, -1};
+    medmad_int16_helper(extremes, 4);
+    medmad_int16_helper(extremes, 3);
+}
+
+//  Long enough to exercise every vector width and a partial final vector
+static const size_t array_len = 16 + 8 + 4 + 3;
+
+/**  Compare array function against the four wide vectorised function
+ *
+ *   Each element is evaluated individually through the four wide function.
+ *   The wider implementations should agree exactly with it, except where an
+ *   approximate reciprocal is used whose precision depends on vector width.
+ *
+ *   @param approx Approximation level to use for array function
+ *   @param farr Array function to test
+ *   @param fv Four wide function to compare against
+ *   @param lower Lower bound of input
+ *   @param upper Upper bound of input
+ *   @param tol Tolerance of comparison
+ **/
+static void test_array_helper(enum math_approx approx, void (*farr)(float *, size_t),
+                              __m128 (*fv)(__m128), float lower, float upper, float tol) {
+    set_math_approx(approx);
+    for (size_t n = 1; n <= array_len; n++) {
+        float x[array_len];
+        float expected[array_len];
+        for (size_t i = 0; i < n; i++) {
+            x[i] = lower + (upper - lower) * i / (float)(array_len - 1);
+            expected[i] = _mm_cvtss_f32(fv(_mm_set1_ps(x[i])));
+        }
+        farr(x, n);
+        CU_ASSERT_TRUE(equality_arrayf(expected, x, n, tol));
+    }
+    set_math_approx(MATH_APPROX_POLYNOMIAL);
+}
+
+static __m128 expfv_ref(__m128 x) {
+    return expfv(x);
+}
+
+static __m128 logfv_ref(__m128 x) {
+    return logfv(x);
+}
+
+static __m128 logisticfv_ref(__m128 x) {
+    return logisticfv(x);
+}
+
+static __m128 tanhfv_ref(__m128 x) {
+    return tanhfv(x);
+}
+
+static __m128 elufv_ref(__m128 x) {
+    return elufv(x);
+}
+
+static __m128 fast_logisticfv_ref(__m128 x) {
+    return fast_logisticfv(x);
+}
+
+static __m128 fast_tanhfv_ref(__m128 x) {
+    return fast_tanhfv(x);
+}
+
+void test_exp_arrayf(void) {
+    test_array_helper(MATH_APPROX_POLYNOMIAL, exp_arrayf, expfv_ref, -10.0f, 10.0f, 0.0f);
+}
+
+void test_log_arrayf(void) {
+    test_array_helper(MATH_APPROX_POLYNOMIAL, log_arrayf, logfv_ref, 1e-3f, 100.0f, 0.0f);
+}
+
+void test_logistic_arrayf(void) {
+    test_array_helper(MATH_APPROX_POLYNOMIAL, logistic_arrayf, logisticfv_ref, -10.0f, 10.0f, 0.0f);
+}
+
+void test_tanh_arrayf(void) {
+    test_array_helper(MATH_APPROX_POLYNOMIAL, tanh_arrayf, tanhfv_ref, -5.0f, 5.0f, 0.0f);
+}
+
+void test_elu_arrayf(void) {
+    test_array_helper(MATH_APPROX_POLYNOMIAL, elu_arrayf, elufv_ref, -5.0f, 5.0f, 0.0f);
+}
+
+void test_exp_arrayf_schraudolph(void) {
+    test_array_helper(MATH_APPROX_SCHRAUDOLPH, exp_arrayf, fast_expfv, -10.0f, 10.0f, 0.0f);
+}
+
+void test_log_arrayf_schraudolph(void) {
+    test_array_helper(MATH_APPROX_SCHRAUDOLPH, log_arrayf, fast_logfv, 1e-3f, 100.0f, 0.0f);
+}
+
+void test_tanh_arrayf_schraudolph(void) {
+    test_array_helper(MATH_APPROX_SCHRAUDOLPH, tanh_arrayf, fast_tanhfv_ref, -5.0f, 5.0f, 1e-3f);
+}
+
+void test_logistic_arrayf_schraudolph(void) {
+    test_array_helper(MATH_APPROX_SCHRAUDOLPH, logistic_arrayf, fast_logisticfv_ref, -10.0f, 10.0f, 1e-3f);
+}
+
+void test_tanh_arrayf_exact(void) {
+    set_math_approx(MATH_APPROX_EXACT);
+    float x[array_len];
+    float expected[array_len];
+    for (size_t i = 0; i < array_len; i++) {
+        x[i] = -5.0f + 10.0f * i / (float)(array_len - 1);
+        expected[i] = tanhf(x[i]);
+    }
+    tanh_arrayf(x, array_len);
+    CU_ASSERT_TRUE(equality_arrayf(expected, x, array_len, 0.0f));
+    set_math_approx(MATH_APPROX_POLYNOMIAL);
+}
+
+void test_math_approx_names(void) {
+    for (enum math_approx approx = 0; approx < math_napprox; approx++) {
+        CU_ASSERT_EQUAL(approx, get_math_approx(math_approx_string(approx)));
+    }
+    CU_ASSERT_EQUAL(MATH_APPROX_INVALID, get_math_approx("banana"));
+}
+
+void test_tanh_arrayf_accuracy(void) {
+    float x[array_len];
+    float expected[array_len];
+    for (size_t i = 0; i < array_len; i++) {
+        x[i] = -5.0f + 10.0f * i / (float)(array_len - 1);
+        expected[i] = tanhf(x[i]);
+    }
+    tanh_arrayf(x, array_len);
+    CU_ASSERT_TRUE(equality_arrayf(expected, x, array_len, 1e-5f));
+}
+
 static test_with_description tests[] = {
     {"Median of odd length array", test_median_odd_util},
     {"Median of even length array", test_median_even_util},
+    {"Median and MAD of int16 array", test_medmad_int16_util},
+    {"Exponential of array", test_exp_arrayf},
+    {"Logarithm of array", test_log_arrayf},
+    {"Logistic of array", test_logistic_arrayf},
+    {"Hyperbolic tangent of array", test_tanh_arrayf},
+    {"ELU of array", test_elu_arrayf},
+    {"Hyperbolic tangent of array against libm", test_tanh_arrayf_accuracy},
+    {"Schraudolph exponential of array", test_exp_arrayf_schraudolph},
+    {"Schraudolph logarithm of array", test_log_arrayf_schraudolph},
+    {"Schraudolph logistic of array", test_logistic_arrayf_schraudolph},
+    {"Schraudolph hyperbolic tangent of array", test_tanh_arrayf_schraudolph},
+    {"Exact hyperbolic tangent of array", test_tanh_arrayf_exact},
+    {"Names of approximation levels", test_math_approx_names},
     {0}};
 
 /**   Register tests with CUnit
@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <err.h>
 #include <math.h>
+#include <string.h>
 #include "scrappie_stdlib.h"
 #include "util.h"
 
@@ -203,6 +204,87 @@ void medmad_normalise_array(float *x, size_t n) {
     }
 }
 
+/**  Order statistic from a histogram
+ *
+ *   @param count Number of values in each bin
+ *   @param nbin Number of bins
+ *   @param k Order statistic to find, zero based
+ *
+ *   @returns Bin containing k-th smallest value
+ **/
+static size_t histogram_order_statistic(const size_t *count, size_t nbin, size_t k) {
+    size_t cumulative = 0;
+    for (size_t bin = 0; bin < nbin; bin++) {
+        cumulative += count[bin];
+        if (cumulative > k) {
+            return bin;
+        }
+    }
+    return nbin - 1;
+}
+
+/**  Median and MAD of an array of int16 values
+ *
+ *   Equal to medianf and madf of the values converted to float, but found
+ *   from histograms of the values in linear time without copying or sorting
+ *   the array.
+ *
+ *   @param x Array of values
+ *   @param n Length of array
+ *   @param med [out] Median
+ *   @param mad [out] MAD, scaled as by madf
+ *
+ *   @returns true on success
+ **/
+bool medmad_int16(const int16_t *x, size_t n, float *med, float *mad) {
+    const float mad_scaling_factor = 1.4826;
+    RETURN_NULL_IF(NULL == x, false);
+    RETURN_NULL_IF(0 == n, false);
+    RETURN_NULL_IF(NULL == med || NULL == mad, false);
+
+    int16_t xmin = x[0];
+    int16_t xmax = x[0];
+    for (size_t i = 1; i < n; i++) {
+        xmin = (x[i] < xmin) ? x[i] : xmin;
+        xmax = (x[i] > xmax) ? x[i] : xmax;
+    }
+    const size_t nbin = (size_t)(xmax - xmin) + 1;
+    size_t *count = calloc(nbin, sizeof(size_t));
+    RETURN_NULL_IF(NULL == count, false);
+    size_t *dcount = calloc(nbin, sizeof(size_t));
+    if (NULL == dcount) {
+        free(count);
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        count[x[i] - xmin] += 1;
+    }
+
+    //  Median interpolated between order statistics as by quantilef
+    const size_t idx = (n - 1) / 2;
+    const bool interpolate = (1 == (n - 1) % 2);
+    const size_t lo = histogram_order_statistic(count, nbin, idx);
+    const size_t hi = interpolate ? histogram_order_statistic(count, nbin, idx + 1) : lo;
+
+    //  Distances from median are whole numbers when the median is, else k + 0.5
+    const bool half = (lo != hi) && (1 == (hi - lo) % 2);
+    const size_t mid = half ? (lo + hi - 1) / 2 : (lo + hi) / 2;
+    for (size_t bin = 0; bin < nbin; bin++) {
+        const size_t dist = (bin <= mid) ? (mid - bin) : (bin - mid - (half ? 1 : 0));
+        dcount[dist] += count[bin];
+    }
+    const size_t dlo = histogram_order_statistic(dcount, nbin, idx);
+    const size_t dhi = interpolate ? histogram_order_statistic(dcount, nbin, idx + 1) : dlo;
+
+    free(dcount);
+    free(count);
+
+    *med = 0.5f * (float)(lo + hi) + (float)xmin;
+    *mad = (1 == n) ? 0.0f
+                    : (0.5f * (float)(dlo + dhi) + (half ? 0.5f : 0.0f)) * mad_scaling_factor;
+    return true;
+}
+
 /** Studentise array using Kahan summation algorithm
  *
  *  Studentise an array using the Kahan summation
@@ -286,3 +368,203 @@ bool equality_arrayi(int const * x, int const * y, size_t n){
 
     return true;
 }
+
+/*  Array versions of the vectorised functions.
+ *
+ *  Each approximation level has its own set of array functions.  The
+ *  vectorised levels process the bulk of the array using the widest vectors
+ *  enabled at compile time; the remainder is processed four elements at a
+ *  time, with any final partial vector copied through a temporary.  Loads
+ *  and stores are unaligned so the functions may be applied to any part of a
+ *  matrix.
+ */
+#ifdef __AVX512F__
+#    define _ARRAY_LOOP16(F16) \
+    for (; i + 16 <= n; i += 16) { \
+        _mm512_storeu_ps(x + i, F16(_mm512_loadu_ps(x + i))); \
+    }
+#else
+#    define _ARRAY_LOOP16(F16)
+#endif
+
+#ifdef __AVX2__
+#    define _ARRAY_LOOP8(F8) \
+    for (; i + 8 <= n; i += 8) { \
+        _mm256_storeu_ps(x + i, F8(_mm256_loadu_ps(x + i))); \
+    }
+#else
+#    define _ARRAY_LOOP8(F8)
+#endif
+
+#define _ARRAY_FUNCTION(NAME, F16, F8, F4) \
+static void NAME(float * x, size_t n) { \
+    size_t i = 0; \
+    _ARRAY_LOOP16(F16) \
+    _ARRAY_LOOP8(F8) \
+    for (; i + 4 <= n; i += 4) { \
+        _mm_storeu_ps(x + i, F4(_mm_loadu_ps(x + i))); \
+    } \
+    if (i < n) { \
+        float tmp[4] = {0.0f, 0.0f, 0.0f, 0.0f}; \
+        memcpy(tmp, x + i, (n - i) * sizeof(float)); \
+        _mm_storeu_ps(tmp, F4(_mm_loadu_ps(tmp))); \
+        memcpy(x + i, tmp, (n - i) * sizeof(float)); \
+    } \
+}
+
+#define _SCALAR_ARRAY_FUNCTION(NAME, F) \
+static void NAME(float * x, size_t n) { \
+    for (size_t i = 0; i < n; i++) { \
+        x[i] = F(x[i]); \
+    } \
+}
+
+_SCALAR_ARRAY_FUNCTION(exp_arrayf_exact, expf)
+_SCALAR_ARRAY_FUNCTION(log_arrayf_exact, logf)
+_SCALAR_ARRAY_FUNCTION(logistic_arrayf_exact, logisticf)
+_SCALAR_ARRAY_FUNCTION(tanh_arrayf_exact, tanhf)
+_SCALAR_ARRAY_FUNCTION(elu_arrayf_exact, eluf)
+
+_ARRAY_FUNCTION(exp_arrayf_polynomial, expfv16, expfv8, expfv)
+_ARRAY_FUNCTION(log_arrayf_polynomial, logfv16, logfv8, logfv)
+_ARRAY_FUNCTION(logistic_arrayf_polynomial, logisticfv16, logisticfv8, logisticfv)
+_ARRAY_FUNCTION(tanh_arrayf_polynomial, tanhfv16, tanhfv8, tanhfv)
+_ARRAY_FUNCTION(elu_arrayf_polynomial, elufv16, elufv8, elufv)
+
+_ARRAY_FUNCTION(exp_arrayf_schraudolph, fast_expfv16, fast_expfv8, fast_expfv)
+_ARRAY_FUNCTION(log_arrayf_schraudolph, fast_logfv16, fast_logfv8, fast_logfv)
+_ARRAY_FUNCTION(logistic_arrayf_schraudolph, fast_logisticfv16, fast_logisticfv8, fast_logisticfv)
+_ARRAY_FUNCTION(tanh_arrayf_schraudolph, fast_tanhfv16, fast_tanhfv8, fast_tanhfv)
+_ARRAY_FUNCTION(elu_arrayf_schraudolph, fast_elufv16, fast_elufv8, fast_elufv)
+
+static const struct math_functions math_functions_exact = {
+    exp_arrayf_exact, log_arrayf_exact, logistic_arrayf_exact,
+    tanh_arrayf_exact, elu_arrayf_exact
+};
+
+static const struct math_functions math_functions_polynomial = {
+    exp_arrayf_polynomial, log_arrayf_polynomial, logistic_arrayf_polynomial,
+    tanh_arrayf_polynomial, elu_arrayf_polynomial
+};
+
+static const struct math_functions math_functions_schraudolph = {
+    exp_arrayf_schraudolph, log_arrayf_schraudolph, logistic_arrayf_schraudolph,
+    tanh_arrayf_schraudolph, elu_arrayf_schraudolph
+};
+
+//  Functions used by the array entry points
+static const struct math_functions * math_current = &math_functions_polynomial;
+
+
+enum math_approx get_math_approx(const char * approxstr){
+    if(0 == strcmp(approxstr, "exact")){
+        return MATH_APPROX_EXACT;
+    }
+    if(0 == strcmp(approxstr, "polynomial")){
+        return MATH_APPROX_POLYNOMIAL;
+    }
+    if(0 == strcmp(approxstr, "schraudolph")){
+        return MATH_APPROX_SCHRAUDOLPH;
+    }
+    return MATH_APPROX_INVALID;
+}
+
+const char * math_approx_string(const enum math_approx approx){
+    switch(approx){
+    case MATH_APPROX_EXACT:
+        return "exact";
+    case MATH_APPROX_POLYNOMIAL:
+        return "polynomial";
+    case MATH_APPROX_SCHRAUDOLPH:
+        return "schraudolph";
+    case MATH_APPROX_INVALID:
+        errx(EXIT_FAILURE, "Invalid approximation level %s:%d", __FILE__, __LINE__);
+    default:
+        errx(EXIT_FAILURE, "Scrappie enum failure -- report bug\n");
+    }
+
+    return NULL;
+}
+
+const struct math_functions * get_math_functions(const enum math_approx approx){
+    switch(approx){
+    case MATH_APPROX_EXACT:
+        return &math_functions_exact;
+    case MATH_APPROX_POLYNOMIAL:
+        return &math_functions_polynomial;
+    case MATH_APPROX_SCHRAUDOLPH:
+        return &math_functions_schraudolph;
+    case MATH_APPROX_INVALID:
+        errx(EXIT_FAILURE, "Invalid approximation level %s:%d", __FILE__, __LINE__);
+    default:
+        errx(EXIT_FAILURE, "Scrappie enum failure -- report bug\n");
+    }
+
+    return NULL;
+}
+
+/** Set approximation level used by array functions
+ *
+ *  Not thread safe; should be called before any parallel work is started.
+ *
+ *  @param approx Approximation level
+ *  @return void
+ **/
+void set_math_approx(const enum math_approx approx){
+    math_current = get_math_functions(approx);
+}
+
+/** Exponential of array, in place
+ *
+ *  @param x Array
+ *  @param n Length of array
+ *  @return void
+ **/
+void exp_arrayf(float * x, size_t n) {
+    RETURN_NULL_IF(NULL == x, );
+    math_current->exp(x, n);
+}
+
+/** Natural logarithm of array, in place
+ *
+ *  @param x Array
+ *  @param n Length of array
+ *  @return void
+ **/
+void log_arrayf(float * x, size_t n) {
+    RETURN_NULL_IF(NULL == x, );
+    math_current->log(x, n);
+}
+
+/** Logistic function of array, in place
+ *
+ *  @param x Array
+ *  @param n Length of array
+ *  @return void
+ **/
+void logistic_arrayf(float * x, size_t n) {
+    RETURN_NULL_IF(NULL == x, );
+    math_current->logistic(x, n);
+}
+
+/** Hyperbolic tangent of array, in place
+ *
+ *  @param x Array
+ *  @param n Length of array
+ *  @return void
+ **/
+void tanh_arrayf(float * x, size_t n) {
+    RETURN_NULL_IF(NULL == x, );
+    math_current->tanh(x, n);
+}
+
+/** ELU activation of array, in place
+ *
+ *  @param x Array
+ *  @param n Length of array
+ *  @return void
+ **/
+void elu_arrayf(float * x, size_t n) {
+    RETURN_NULL_IF(NULL == x, );
+    math_current->elu(x, n);
+}
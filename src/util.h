@@ -7,6 +7,7 @@
 #    include <stdint.h>
 #    include <stdio.h>
 #    include "sse_mathfun.h"
+#    include "avx_mathfun.h"
 
 #    ifdef FAST_LOG
 #        define LOGFV fast_logfv
@@ -176,6 +177,160 @@ static inline __m128 __attribute__ ((__always_inline__)) fast_elufv(__m128 x) {
     return _mm_or_ps(_mm_and_ps(mask, x),  _mm_andnot_ps(mask, y));
 }
 
+#    ifdef __AVX2__
+/**
+ *    Eight wide versions, AVX2
+ **/
+static inline __m256 __attribute__ ((__always_inline__)) expfv8(__m256 x) {
+    return exp256_ps(x);
+}
+
+static inline __m256 __attribute__ ((__always_inline__)) logfv8(__m256 x) {
+    return log256_ps(x);
+}
+
+static inline __m256 __attribute__ ((__always_inline__)) logisticfv8(__m256 x) {
+    const __m256 ones = _mm256_set1_ps(1.0f);
+    return _mm256_div_ps(ones, _mm256_add_ps(ones, expfv8(_mm256_sub_ps(_mm256_setzero_ps(), x))));
+}
+
+static inline __m256 __attribute__ ((__always_inline__)) tanhfv8(__m256 x) {
+    const __m256 y = logisticfv8(_mm256_add_ps(x, x));
+    return _mm256_sub_ps(_mm256_add_ps(y, y), _mm256_set1_ps(1.0f));
+}
+
+static inline __m256 __attribute__ ((__always_inline__)) elufv8(__m256 x) {
+    if(0 == _mm256_movemask_ps(x)){
+        // All positive, early return.
+        return x;
+    }
+    const __m256 mask = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GE_OS);
+    const __m256 y = _mm256_sub_ps(expfv8(x), _mm256_set1_ps(1.0f));
+    return _mm256_or_ps(_mm256_and_ps(mask, x),  _mm256_andnot_ps(mask, y));
+}
+
+static inline __m256 fast_expfv8(__m256 x) {
+    const __m256 a = _mm256_set1_ps(_A);
+    const __m256 b = _mm256_set1_ps(_B);
+    const __m256 _bound = _mm256_set1_ps(_BOUND);
+    x = _mm256_max_ps(_mm256_sub_ps(_mm256_setzero_ps(), _bound), _mm256_min_ps(_bound, x));
+
+    __m256 y = _mm256_add_ps(_mm256_mul_ps(a, x), b);
+    return _mm256_castsi256_ps(_mm256_cvtps_epi32(y));
+}
+
+static inline __m256 fast_logfv8(__m256 x) {
+    const __m256 a = _mm256_set1_ps(_Alogfv);
+    const __m256 b = _mm256_set1_ps(_Blogfv);
+    x = _mm256_cvtepi32_ps(_mm256_castps_si256(x));
+    return _mm256_mul_ps(a, _mm256_sub_ps(x, b));
+}
+
+static inline __m256 __attribute__ ((__always_inline__)) fast_logisticfv8(__m256 x) {
+    const __m256 ones = _mm256_set1_ps(1.0f);
+    return _mm256_rcp_ps(_mm256_add_ps(ones, fast_expfv8(_mm256_sub_ps(_mm256_setzero_ps(), x))));
+}
+
+static inline __m256 __attribute__ ((__always_inline__)) fast_tanhfv8(__m256 x) {
+    const __m256 y = fast_logisticfv8(_mm256_add_ps(x, x));
+    return _mm256_sub_ps(_mm256_add_ps(y, y), _mm256_set1_ps(1.0f));
+}
+
+static inline __m256 __attribute__ ((__always_inline__)) fast_elufv8(__m256 x) {
+    if(0 == _mm256_movemask_ps(x)){
+        // All positive, early return.
+        return x;
+    }
+    const __m256 mask = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GE_OS);
+    const __m256 y = _mm256_sub_ps(fast_expfv8(x), _mm256_set1_ps(1.0f));
+    return _mm256_or_ps(_mm256_and_ps(mask, x),  _mm256_andnot_ps(mask, y));
+}
+#    endif /* __AVX2__ */
+
+#    ifdef __AVX512F__
+/**
+ *    Sixteen wide versions, AVX-512
+ **/
+static inline __m512 __attribute__ ((__always_inline__)) expfv16(__m512 x) {
+    return exp512_ps(x);
+}
+
+static inline __m512 __attribute__ ((__always_inline__)) logfv16(__m512 x) {
+    return log512_ps(x);
+}
+
+static inline __m512 __attribute__ ((__always_inline__)) logisticfv16(__m512 x) {
+    const __m512 ones = _mm512_set1_ps(1.0f);
+    return _mm512_div_ps(ones, _mm512_add_ps(ones, expfv16(_mm512_sub_ps(_mm512_setzero_ps(), x))));
+}
+
+static inline __m512 __attribute__ ((__always_inline__)) tanhfv16(__m512 x) {
+    const __m512 y = logisticfv16(_mm512_add_ps(x, x));
+    return _mm512_sub_ps(_mm512_add_ps(y, y), _mm512_set1_ps(1.0f));
+}
+
+static inline __m512 __attribute__ ((__always_inline__)) elufv16(__m512 x) {
+    const __mmask16 neg = _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_LT_OS);
+    if(0 == neg){
+        // All positive, early return.
+        return x;
+    }
+    const __m512 y = _mm512_sub_ps(expfv16(x), _mm512_set1_ps(1.0f));
+    return _mm512_mask_mov_ps(x, neg, y);
+}
+
+static inline __m512 fast_expfv16(__m512 x) {
+    const __m512 a = _mm512_set1_ps(_A);
+    const __m512 b = _mm512_set1_ps(_B);
+    const __m512 _bound = _mm512_set1_ps(_BOUND);
+    x = _mm512_max_ps(_mm512_sub_ps(_mm512_setzero_ps(), _bound), _mm512_min_ps(_bound, x));
+
+    __m512 y = _mm512_add_ps(_mm512_mul_ps(a, x), b);
+    return _mm512_castsi512_ps(_mm512_cvtps_epi32(y));
+}
+
+static inline __m512 fast_logfv16(__m512 x) {
+    const __m512 a = _mm512_set1_ps(_Alogfv);
+    const __m512 b = _mm512_set1_ps(_Blogfv);
+    x = _mm512_cvtepi32_ps(_mm512_castps_si512(x));
+    return _mm512_mul_ps(a, _mm512_sub_ps(x, b));
+}
+
+static inline __m512 __attribute__ ((__always_inline__)) fast_logisticfv16(__m512 x) {
+    const __m512 ones = _mm512_set1_ps(1.0f);
+    return _mm512_rcp14_ps(_mm512_add_ps(ones, fast_expfv16(_mm512_sub_ps(_mm512_setzero_ps(), x))));
+}
+
+static inline __m512 __attribute__ ((__always_inline__)) fast_tanhfv16(__m512 x) {
+    const __m512 y = fast_logisticfv16(_mm512_add_ps(x, x));
+    return _mm512_sub_ps(_mm512_add_ps(y, y), _mm512_set1_ps(1.0f));
+}
+
+static inline __m512 __attribute__ ((__always_inline__)) fast_elufv16(__m512 x) {
+    const __mmask16 neg = _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_LT_OS);
+    if(0 == neg){
+        // All positive, early return.
+        return x;
+    }
+    const __m512 y = _mm512_sub_ps(fast_expfv16(x), _mm512_set1_ps(1.0f));
+    return _mm512_mask_mov_ps(x, neg, y);
+}
+#    endif /* __AVX512F__ */
+
+/**
+ *    Horizontal reductions
+ **/
+static inline float hsumfv(__m128 x) {
+    const __m128 psum = _mm_hadd_ps(x, x);
+    return _mm_cvtss_f32(_mm_hadd_ps(psum, psum));
+}
+
+static inline float hmaxfv(__m128 x) {
+    x = _mm_max_ps(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1)));
+    x = _mm_max_ps(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(x);
+}
+
 int argmaxf(const float *x, int n);
 int argminf(const float *x, int n);
 float valmaxf(const float *x, int n);
@@ -189,10 +344,47 @@ static inline int ifloor(int x, int y) {
     return x / y;
 }
 
+/*  Approximation levels for the array functions.  The FAST_* macros above
+ *  only affect code that calls the four wide functions directly.
+ *    exact        Scalar functions from libm
+ *    polynomial   Cephes polynomial approximations (sse_mathfun.h)
+ *    schraudolph  Approximations based on manipulating the IEEE representation
+ */
+enum math_approx {
+    MATH_APPROX_EXACT = 0,
+    MATH_APPROX_POLYNOMIAL,
+    MATH_APPROX_SCHRAUDOLPH,
+    MATH_APPROX_INVALID
+};
+static const int math_napprox = 3;
+
+struct math_functions {
+    void (*exp)(float *, size_t);
+    void (*log)(float *, size_t);
+    void (*logistic)(float *, size_t);
+    void (*tanh)(float *, size_t);
+    void (*elu)(float *, size_t);
+};
+
+enum math_approx get_math_approx(const char * approxstr);
+const char * math_approx_string(const enum math_approx approx);
+const struct math_functions * get_math_functions(const enum math_approx approx);
+void set_math_approx(const enum math_approx approx);
+
+/*  Apply a function element-wise to an array, in place, using the current
+ *  approximation level and the widest vector instructions available.
+ */
+void exp_arrayf(float * x, size_t n);
+void log_arrayf(float * x, size_t n);
+void logistic_arrayf(float * x, size_t n);
+void tanh_arrayf(float * x, size_t n);
+void elu_arrayf(float * x, size_t n);
+
 void quantilef(const float *x, size_t nx, float *p, size_t np);
 float medianf(const float *x, size_t n);
 float madf(const float *x, size_t n, const float *med);
 void medmad_normalise_array(float *x, size_t n);
+bool medmad_int16(const int16_t *x, size_t n, float *med, float *mad);
 void studentise_array_kahan(float *x, size_t n);
 
 bool equality_array(double const * x, double const * y, size_t n, double const tol);